@@ -108,14 +108,24 @@ bool QPsdHandler::read(QImage *image)
     quint64 size = (quint64)channels * totalBytesPerChannel;
     QByteArray imageData;
 
+    // 8-bit RGB and CMYK are decoded straight into the scanlines
+    if (compression == RLE && depth == 8 &&
+        ((colorMode == RGB && channels == 3) ||
+         ((colorMode == CMYK || colorMode == MULTICHANNEL) && channels == 4))) {
+        QImage result = readRLEImage8(input, width, height, channels);
+        if (result.isNull())
+            return false;
+
+        *image = result;
+        return true;
+    }
+
     switch (compression) {
     case RLE:
 //        The RLE-compressed data is preceeded by a 2-byte(psd) or 4-byte(psb)
-//        data count for each row in the data
-        if (format() == "psd")
-            input.skipRawData(height * channels * 2);
-        else if (format() == "psb")
-            input.skipRawData(height * channels * 4);
+//        data count for each row in the data - it allows for decoding rows in parallel
+        imageData = readRLEImageData(input, (quint64)height * channels, ((quint64)width * depth + 7) / 8);
+        break;
     case RAW:
         imageData = readImageData(input, (Compression)compression, size);
         break;
@@ -26,6 +26,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
 #include <QImage>
 #include <QColor>
 #include <QVariant>
+#include <QVector>
 #include <qmath.h>
 
 class QPsdHandler : public QImageIOHandler
@@ -60,6 +61,9 @@ private:
         ZIP_WITH_PREDICTION = 3
     };
     QByteArray readImageData(QDataStream& input, Compression compression, quint64 size=0);
+    const quint8 *readRLERows(QDataStream& input, quint64 rows, QVector<quint64>& offsets, QByteArray& packed);
+    QByteArray readRLEImageData(QDataStream& input, quint64 rows, quint64 bytesPerRow);
+    QImage readRLEImage8(QDataStream& input, quint32 width, quint32 height, quint16 channels);
     enum ColorMode {
         BITMAP = 0,
         GRAYSCALE = 1,
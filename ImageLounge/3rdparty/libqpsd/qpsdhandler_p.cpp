@@ -21,10 +21,97 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
 
 #include "qpsdhandler.h"
 
+#include <QBuffer>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include <vector>
+
 #ifdef QT_DEBUG
 #include <QDebug>
 #endif
 
+/* Pulls chunks of rows until none are left. */
+template <typename Fn>
+class RowWorker : public QRunnable
+{
+public:
+    RowWorker(Fn& fn, std::atomic<quint64>& next, quint64 rows, quint64 chunk, QSemaphore& done)
+        : m_fn(fn), m_next(next), m_rows(rows), m_chunk(chunk), m_done(done)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        work(m_fn, m_next, m_rows, m_chunk);
+        m_done.release();
+    }
+
+    static void work(Fn& fn, std::atomic<quint64>& next, quint64 rows, quint64 chunk)
+    {
+        for (quint64 begin = next.fetch_add(chunk); begin < rows; begin = next.fetch_add(chunk))
+            fn(begin, qMin(rows, begin + chunk));
+    }
+
+private:
+    Fn& m_fn;
+    std::atomic<quint64>& m_next;
+    quint64 m_rows;
+    quint64 m_chunk;
+    QSemaphore& m_done;
+};
+
+/* Runs fn(begin, end) on chunks of [0, rows) in parallel.
+ * Helpers run in the global thread pool and the calling thread works too:
+ * if the pool is busy (e.g. other images are decoded in parallel),
+ * helpers that did not start yet are taken back and the calling thread
+ * processes all rows. Small images are processed in the calling thread. */
+template <typename Fn>
+static void parallelRows(quint64 rows, Fn fn)
+{
+    const quint64 minRowsPerThread = 64;
+    QThreadPool* pool = QThreadPool::globalInstance();
+    int numThreads = (int)qMin<quint64>(pool->maxThreadCount(), rows / minRowsPerThread);
+
+    if (numThreads <= 1) {
+        fn((quint64)0, rows);
+        return;
+    }
+
+    // smaller chunks balance the load if a helper starts late
+    const quint64 chunk = qMax<quint64>(minRowsPerThread, rows / (numThreads * 4));
+    std::atomic<quint64> next(0);
+    QSemaphore done;
+
+    std::vector<std::unique_ptr<RowWorker<Fn>>> helpers;
+    for (int idx = 1; idx < numThreads; ++idx) {
+        helpers.emplace_back(new RowWorker<Fn>(fn, next, rows, chunk, done));
+        pool->start(helpers.back().get());
+    }
+
+    RowWorker<Fn>::work(fn, next, rows, chunk);
+
+    int started = 0;
+    for (auto& h : helpers) {
+        if (!pool->tryTake(h.get()))
+            ++started;
+    }
+
+    done.acquire(started);
+}
+
+/* rounded x / 255 for x in [0, 255 * 255] */
+static inline quint32 div255(quint32 x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
 /* tristimulus reference: Adobe RGB (1998) Color Image Encoding
  * http://www.adobe.com/digitalimag/pdfs/AdobeRGB1998.pdf
  * D65 0.9505, 1.0000, 1.0891
@@ -304,6 +391,178 @@ QByteArray QPsdHandler::readImageData(QDataStream &input,
     return imageData;
 }
 
+/* Code based on PackBits implementation which is primarily used by
+ * Photoshop for RLE encoding/decoding.
+ * Returns false if the row does not decode to exactly dEnd - d bytes. */
+static bool unpackBitsRow(const quint8 *s, const quint8 *sEnd, quint8 *d, quint8 *dEnd)
+{
+    while (s < sEnd && d < dEnd) {
+        quint8 byte = *s++;
+        if (byte > 128) {
+            int count = qMin<qint64>(257 - byte, dEnd - d);
+            if (s >= sEnd)
+                break;
+            memset(d, *s++, count);
+            d += count;
+        } else if (byte < 128) {
+            int count = qMin<qint64>(qMin<qint64>(byte + 1, dEnd - d), sEnd - s);
+            memcpy(d, s, count);
+            d += count;
+            s += byte + 1;
+        }
+    }
+
+    return d == dEnd;
+}
+
+/* planar -> packed: the inner loop is simple enough to be vectorized by the compiler */
+static inline void rgb8Row(QRgb *p, const quint8 *r, const quint8 *g, const quint8 *b, quint32 width)
+{
+    for (quint32 x = 0; x < width; ++x)
+        p[x] = 0xff000000u | (quint32(r[x]) << 16) | (quint32(g[x]) << 8) | quint32(b[x]);
+}
+
+/* PSD stores inverted CMYK: r = (1-c)(1-k) = C*K/255 (same as QColor::fromCmyk, w/o the QColor roundtrip) */
+static inline void cmyk8Row(QRgb *p, const quint8 *c, const quint8 *m, const quint8 *y, const quint8 *k, quint32 width)
+{
+    for (quint32 x = 0; x < width; ++x)
+        p[x] = qRgb(div255(c[x] * k[x]), div255(m[x] * k[x]), div255(y[x] * k[x]));
+}
+
+/**
+ * @brief QPsdHandler::readRLERows Reads the byte count table and locates the compressed rows.
+ * If the device is a QBuffer, the compressed data is used in place, otherwise it is read into packed.
+ * @param input QDataStream positioned at the byte count table.
+ * @param rows quint64 number of rows (height * channels).
+ * @param offsets QVector<quint64> receives rows + 1 offsets of the compressed rows.
+ * @param packed QByteArray holds the compressed data if it cannot be used in place.
+ * @return const quint8* compressed data or nullptr if the data is corrupt.
+ */
+const quint8 *QPsdHandler::readRLERows(QDataStream &input, quint64 rows, QVector<quint64> &offsets, QByteArray &packed)
+{
+    offsets.resize(rows + 1);
+    offsets[0] = 0;
+
+    for (quint64 i = 0; i < rows; ++i) {
+        quint32 count = 0;
+        if (format() == "psb") {
+            input >> count;
+        } else {
+            quint16 count16 = 0;
+            input >> count16;
+            count = count16;
+        }
+        offsets[i + 1] = offsets[i] + count;
+    }
+
+    if (input.status() != QDataStream::Ok)
+        return nullptr;
+
+    // QImageReader mostly reads from buffered files - no need to copy them again
+    QBuffer *buffer = qobject_cast<QBuffer *>(input.device());
+    if (buffer) {
+        const quint64 pos = buffer->pos();
+        if (pos + offsets[rows] > (quint64)buffer->data().size() || !buffer->seek(pos + offsets[rows]))
+            return nullptr;
+
+        return (const quint8 *)buffer->data().constData() + pos;
+    }
+
+    // read the compressed rows at once
+    packed.resize(offsets[rows]);
+    if ((quint64)input.readRawData(packed.data(), packed.size()) != offsets[rows])
+        return nullptr;
+
+    return (const quint8 *)packed.constData();
+}
+
+/**
+ * @brief QPsdHandler::readRLEImageData Decodes PackBits compressed image data.
+ * The byte count table (one entry per row and channel) is used to locate
+ * each row, so rows are decoded in parallel into the pre-sized output.
+ * @param input QDataStream positioned at the byte count table.
+ * @param rows quint64 number of rows (height * channels).
+ * @param bytesPerRow quint64 decoded size of a row.
+ * @return QByteArray planar image data or an empty array if the data is corrupt.
+ */
+QByteArray QPsdHandler::readRLEImageData(QDataStream &input, quint64 rows, quint64 bytesPerRow)
+{
+    QVector<quint64> offsets;
+    QByteArray packed;
+    const quint8 *src = readRLERows(input, rows, offsets, packed);
+
+    if (!src)
+        return QByteArray();
+
+    QByteArray imageData(rows * bytesPerRow, 0);
+    quint8 *dst = (quint8 *)imageData.data();
+    std::atomic<bool> corrupt(false);
+
+    parallelRows(rows, [&](quint64 begin, quint64 end) {
+        for (quint64 r = begin; r < end; ++r) {
+            quint8 *d = dst + r * bytesPerRow;
+            if (!unpackBitsRow(src + offsets[r], src + offsets[r + 1], d, d + bytesPerRow))
+                corrupt = true;
+        }
+    });
+
+    if (corrupt)
+        return QByteArray();
+
+    return imageData;
+}
+
+/**
+ * @brief QPsdHandler::readRLEImage8 Decodes 8-bit PackBits compressed RGB or CMYK data
+ * straight into the image. Each thread unpacks the channel rows of a single
+ * scanline into a small line buffer, so no planar copy of the image is needed.
+ * @param input QDataStream positioned at the byte count table.
+ * @param width quint32.
+ * @param height quint32.
+ * @param channels quint16 3 (RGB) or 4 (CMYK).
+ * @return QImage or a null image if the data is corrupt.
+ */
+QImage QPsdHandler::readRLEImage8(QDataStream &input, quint32 width, quint32 height, quint16 channels)
+{
+    QVector<quint64> offsets;
+    QByteArray packed;
+    const quint8 *src = readRLERows(input, (quint64)height * channels, offsets, packed);
+
+    if (!src)
+        return QImage();
+
+    QImage result(width, height, QImage::Format_RGB32);
+    uchar *bits = result.bits();
+    const qsizetype bpl = result.bytesPerLine();
+    std::atomic<bool> corrupt(false);
+
+    parallelRows(height, [&](quint64 begin, quint64 end) {
+        std::vector<quint8> line((size_t)width * channels);
+
+        for (quint64 y = begin; y < end && !corrupt; ++y) {
+            // channel c of row y is stored in row c * height + y
+            for (quint16 c = 0; c < channels; ++c) {
+                const quint64 r = c * (quint64)height + y;
+                quint8 *d = line.data() + (size_t)c * width;
+                if (!unpackBitsRow(src + offsets[r], src + offsets[r + 1], d, d + width))
+                    corrupt = true;
+            }
+
+            QRgb *p = (QRgb *)(bits + y * bpl);
+            const quint8 *l = line.data();
+            if (channels == 3)
+                rgb8Row(p, l, l + width, l + 2 * width, width);
+            else
+                cmyk8Row(p, l, l + width, l + 2 * width, l + 3 * width, width);
+        }
+    });
+
+    if (corrupt)
+        return QImage();
+
+    return result;
+}
+
 /**
  * @brief QPsdHandler::processBitmap Generates bitmap image from imageData.
  * @param imageData QByteArray.
@@ -441,18 +700,18 @@ QImage QPsdHandler::processRGB8(QByteArray& imageData, quint32 width, quint32 he
     qDebug() << "8-bit RGB";
 #endif
     QImage result(width, height, QImage::Format_RGB32);
-    quint8 *red = (quint8*)imageData.constData();
-    quint8 *green = red + totalBytesPerChannel;
-    quint8 *blue = green + totalBytesPerChannel;
-    QRgb  *p, *end;
-    for (quint32 y = 0; y < height; ++y) {
-        p = (QRgb *)result.scanLine(y);
-        end = p + width;
-        while (p < end) {
-            *p = qRgb(*red, *green, *blue);
-            ++p; ++red; ++green; ++blue;
+    const quint8 *red = (const quint8*)imageData.constData();
+    const quint8 *green = red + totalBytesPerChannel;
+    const quint8 *blue = green + totalBytesPerChannel;
+    uchar *bits = result.bits();
+    const qsizetype bpl = result.bytesPerLine();
+
+    parallelRows(height, [&](quint64 begin, quint64 end) {
+        for (quint64 y = begin; y < end; ++y) {
+            const quint64 o = y * width;
+            rgb8Row((QRgb *)(bits + y * bpl), red + o, green + o, blue + o, width);
         }
-    }
+    });
     return result;
 }
 
@@ -579,19 +838,19 @@ QImage QPsdHandler::processCMYK8(QByteArray& imageData, quint32 width, quint32 h
     qDebug() << "8-bit CMYK";
 #endif
     QImage result(width, height, QImage::Format_RGB32);
-    quint8 *cyan = (quint8*)imageData.constData();
-    quint8 *magenta = cyan + totalBytesPerChannel;
-    quint8 *yellow = magenta + totalBytesPerChannel;
-    quint8 *key = yellow + totalBytesPerChannel;
-    QRgb  *p, *end;
-    for (quint32 y = 0; y < height; ++y) {
-        p = (QRgb *)result.scanLine(y);
-        end = p + width;
-        while (p < end) {
-            *p = QColor::fromCmyk(255 - *cyan, 255 - *magenta, 255 - *yellow, 255 - *key).rgba();
-            ++p; ++cyan; ++magenta; ++yellow; ++key;
+    const quint8 *cyan = (const quint8*)imageData.constData();
+    const quint8 *magenta = cyan + totalBytesPerChannel;
+    const quint8 *yellow = magenta + totalBytesPerChannel;
+    const quint8 *key = yellow + totalBytesPerChannel;
+    uchar *bits = result.bits();
+    const qsizetype bpl = result.bytesPerLine();
+
+    parallelRows(height, [&](quint64 begin, quint64 end) {
+        for (quint64 y = begin; y < end; ++y) {
+            const quint64 o = y * width;
+            cmyk8Row((QRgb *)(bits + y * bpl), cyan + o, magenta + o, yellow + o, key + o, width);
         }
-    }
+    });
     return result;
 }
 
@@ -79,6 +79,17 @@ if(ENABLE_RAW)
 	endif()
 endif(ENABLE_RAW)
 
+# search for TurboJPEG (optional - jpgs are re-encoded without it)
+unset(TURBOJPEG_FOUND CACHE)
+if(ENABLE_TURBOJPEG)
+	pkg_check_modules(TURBOJPEG libturbojpeg>=1.5)
+	if(TURBOJPEG_FOUND)
+		add_definitions(-DWITH_TURBOJPEG)
+	else()
+		message(WARNING "libturbojpeg not found - lossless jpg transforms are disabled")
+	endif()
+endif(ENABLE_TURBOJPEG)
+
 #search for multi-layer tiff
 if(ENABLE_TIFF)
 	if(NOT OpenCV_FOUND)
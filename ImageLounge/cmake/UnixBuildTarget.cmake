@@ -13,7 +13,7 @@ set(BINARY_NAME ${PROJECT_NAME})
 set(DLL_CORE_NAME ${PROJECT_NAME}Core)
 
 #binary
-link_directories(${LIBRAW_LIBRARY_DIRS} ${OpenCV_LIBRARY_DIRS} ${EXIV2_LIBRARY_DIRS} ${CMAKE_BINARY_DIR})
+link_directories(${LIBRAW_LIBRARY_DIRS} ${TURBOJPEG_LIBRARY_DIRS} ${OpenCV_LIBRARY_DIRS} ${EXIV2_LIBRARY_DIRS} ${CMAKE_BINARY_DIR})
 add_executable(${BINARY_NAME} WIN32  MACOSX_BUNDLE ${NOMACS_EXE_SOURCES} ${NOMACS_EXE_HEADERS} ${NOMACS_QM} ${NOMACS_TRANSLATIONS} ${NOMACS_RC} ${QUAZIP_SOURCES})
 target_link_libraries(
 	${BINARY_NAME}
@@ -45,6 +45,7 @@ target_link_libraries(
 	${DLL_CORE_NAME}
 	${EXIV2_LIBRARIES}
 	${LIBRAW_LIBRARIES}
+	${TURBOJPEG_LIBRARIES}
 	${OpenCV_LIBS}
 	${TIFF_LIBRARIES}
 	${QUAZIP_LIBRARIES}
@@ -425,6 +425,8 @@ QMenu *DkActionManager::createSortMenu(QWidget *parent)
     mSortMenu->addAction(mSortActions[menu_sort_file_size]);
     mSortMenu->addAction(mSortActions[menu_sort_date_created]);
     mSortMenu->addAction(mSortActions[menu_sort_date_modified]);
+    mSortMenu->addAction(mSortActions[menu_sort_date_taken]);
+    mSortMenu->addAction(mSortActions[menu_sort_rating]);
     mSortMenu->addAction(mSortActions[menu_sort_random]);
     mSortMenu->addSeparator();
     mSortMenu->addAction(mSortActions[menu_sort_ascending]);
@@ -1116,6 +1118,18 @@ void DkActionManager::createActions(QWidget *parent)
     mSortActions[menu_sort_random]->setCheckable(true);
     mSortActions[menu_sort_random]->setChecked(DkSettingsManager::param().global().sortMode == DkSettings::sort_random);
 
+    mSortActions[menu_sort_date_taken] = new QAction(QObject::tr("by Date &Taken"), parent);
+    mSortActions[menu_sort_date_taken]->setObjectName("menu_sort_date_taken");
+    mSortActions[menu_sort_date_taken]->setStatusTip(QObject::tr("Sort by the Date the Photo was Taken"));
+    mSortActions[menu_sort_date_taken]->setCheckable(true);
+    mSortActions[menu_sort_date_taken]->setChecked(DkSettingsManager::param().global().sortMode == DkSettings::sort_date_taken);
+
+    mSortActions[menu_sort_rating] = new QAction(QObject::tr("by &Rating"), parent);
+    mSortActions[menu_sort_rating]->setObjectName("menu_sort_rating");
+    mSortActions[menu_sort_rating]->setStatusTip(QObject::tr("Sort by Rating"));
+    mSortActions[menu_sort_rating]->setCheckable(true);
+    mSortActions[menu_sort_rating]->setChecked(DkSettingsManager::param().global().sortMode == DkSettings::sort_rating);
+
     mSortActions[menu_sort_ascending] = new QAction(QObject::tr("&Ascending"), parent);
     mSortActions[menu_sort_ascending]->setObjectName("menu_sort_ascending");
     mSortActions[menu_sort_ascending]->setStatusTip(QObject::tr("Sort in Ascending Order"));
@@ -27,6 +27,7 @@
 
 #include "DkBaseViewPort.h"
 #include "DkActionManager.h"
+#include "DkBasicLoader.h"
 #include "DkSettings.h"
 #include "DkStatusBar.h"
 #include "DkUtils.h"
@@ -40,6 +41,7 @@
 #include <QShortcut>
 #include <QSvgRenderer>
 #include <QTimer>
+#include <QtConcurrentRun>
 
 // gestures
 #include <QSwipeGesture>
@@ -101,6 +103,13 @@ DkBaseViewPort::DkBaseViewPort(QWidget *parent)
     mHideCursorTimer = new QTimer(this);
     mHideCursorTimer->setInterval(1000);
     connect(mHideCursorTimer, SIGNAL(timeout()), this, SLOT(hideCursor()));
+
+    // regions are decoded once zooming/panning stops
+    mRegionTimer = new QTimer(this);
+    mRegionTimer->setSingleShot(true);
+    mRegionTimer->setInterval(150);
+    connect(mRegionTimer, SIGNAL(timeout()), this, SLOT(updateRegion()));
+    connect(&mRegionWatcher, SIGNAL(finished()), this, SLOT(regionDecoded()));
 }
 
 DkBaseViewPort::~DkBaseViewPort()
@@ -340,9 +349,95 @@ QSize DkBaseViewPort::getImageSize() const
         return mSvg->defaultSize().scaled(size(), Qt::KeepAspectRatio);
     }
 
+    if (mRegionLoader)
+        return DkJpgTransform::transformedSize(mRegionLoader->size(), mRegionOrientation);
+
     return mImgStorage.size();
 }
 
+/**
+ * Huge images are displayed from a reduced image (see DkBasicLoader::setHugeImageDecodeSize).
+ * If a region loader is set, the visible region is decoded from the file when zooming in.
+ * Call this before setImage() since the image size is taken from the loader.
+ * @param loader the region loader of the current file (or an empty pointer)
+ * @param orientation the transform that displays the file upright
+ **/
+void DkBaseViewPort::setRegionLoader(QSharedPointer<DkRegionLoader> loader, DkJpgTransform::Transform orientation)
+{
+    mRegionLoader = loader && loader->isValid() ? loader : QSharedPointer<DkRegionLoader>();
+    mRegionOrientation = orientation == DkJpgTransform::transform_invalid ? DkJpgTransform::transform_identity : orientation;
+
+    mRegionWatcher.cancel(); // drop results of the last image
+    mRegionImg = QImage();
+    mRegionRect = QRectF();
+    mRegionRequest = QRectF();
+    mRegionRequestSize = QSize();
+}
+
+/**
+ * Decodes the visible region if the reduced image is not sharp enough.
+ **/
+void DkBaseViewPort::updateRegion()
+{
+    if (!mRegionLoader || mImgStorage.isEmpty())
+        return;
+
+    // one region at a time
+    if (mRegionWatcher.isRunning()) {
+        mRegionTimer->start();
+        return;
+    }
+
+    double scale = mImgMatrix.m11() * mWorldMatrix.m11(); // screen pixels per image pixel
+    double decodedScale = (double)mImgStorage.size().width() / getImageSize().width();
+
+    // the reduced image is sharp enough
+    if (scale <= decodedScale) {
+        mRegionImg = QImage();
+        mRegionRect = QRectF();
+        mRegionRequest = QRectF();
+        return;
+    }
+
+    QRectF visible = (mImgMatrix * mWorldMatrix).inverted().mapRect(QRectF(mViewportRect)).intersected(mImgRect);
+
+    // map the visible region to the file's pixels (Exif orientation not applied)
+    QSize fileSize = mRegionLoader->size();
+    QTransform ot = QImage::trueMatrix(DkJpgTransform::toQTransform(mRegionOrientation), fileSize.width(), fileSize.height());
+    QRect fileRect = ot.inverted().mapRect(visible).toAlignedRect().intersected(QRect(QPoint(), fileSize));
+
+    if (fileRect.isEmpty())
+        return;
+
+    // we never need more than 100%
+    double s = qMin(scale, 1.0);
+    QSize size(qMax(qRound(fileRect.width() * s), 1), qMax(qRound(fileRect.height() * s), 1));
+    QRectF rect = ot.mapRect(QRectF(fileRect));
+
+    if (rect == mRegionRequest && size == mRegionRequestSize)
+        return;
+
+    mRegionRequest = rect;
+    mRegionRequestSize = size;
+
+    QSharedPointer<DkRegionLoader> loader = mRegionLoader;
+    DkJpgTransform::Transform orientation = mRegionOrientation;
+
+    mRegionWatcher.setFuture(QtConcurrent::run([loader, fileRect, size, orientation]() {
+        return loader->read(fileRect, size, orientation);
+    }));
+}
+
+void DkBaseViewPort::regionDecoded()
+{
+    if (mRegionWatcher.isCanceled())
+        return;
+
+    mRegionImg = mRegionWatcher.result();
+    mRegionRect = mRegionImg.isNull() ? QRectF() : mRegionRequest;
+    update();
+}
+
 QRectF DkBaseViewPort::getImageViewRect() const
 {
     return mWorldMatrix.mapRect(mImgViewRect);
@@ -561,7 +656,10 @@ void DkBaseViewPort::draw(QPainter &painter, double opacity)
     }
 
     QRect displayRect = mWorldMatrix.mapRect(mImgViewRect).toRect();
-    QImage img = mImgStorage.image(displayRect.size());
+
+    // imgTransform applies the Exif orientation if the pixels are not rotated yet
+    QTransform imgTransform;
+    QImage img = mImgStorage.image(displayRect.size(), imgTransform);
 
     // opacity == 1.0f -> do not show pattern if we crossfade two images
     if (DkSettingsManager::param().display().tpPattern && img.hasAlphaChannel() && opacity == 1.0)
@@ -576,7 +674,7 @@ void DkBaseViewPort::draw(QPainter &painter, double opacity)
         painter.drawPixmap(mImgViewRect, mMovie->currentPixmap(), mMovie->frameRect());
     } else {
         // if we have the exact level cached: render it directly
-        if (displayRect.width() == img.width() && displayRect.height() == img.height() && mAngle == 0.0) {
+        if (displayRect.width() == img.width() && displayRect.height() == img.height() && mAngle == 0.0 && imgTransform.isIdentity()) {
             painter.setWorldMatrixEnabled(false);
             painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
             painter.drawImage(displayRect, img, img.rect());
@@ -584,13 +682,42 @@ void DkBaseViewPort::draw(QPainter &painter, double opacity)
         } else {
             if (mImgMatrix.m11() * mWorldMatrix.m11() - std::numeric_limits<double>::epsilon() < 1.0)
                 painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
-            painter.drawImage(mImgViewRect, img, img.rect());
+
+            if (imgTransform.isIdentity())
+                painter.drawImage(mImgViewRect, img, img.rect());
+            else {
+                // huge images are reduced - so we scale them to the image rect
+                QRectF ir = imgTransform.mapRect(QRectF(img.rect()));
+
+                painter.save();
+                painter.setWorldTransform(imgTransform * QTransform::fromScale(mImgRect.width() / ir.width(), mImgRect.height() / ir.height()) * mImgMatrix,
+                                          true);
+                painter.drawImage(QPointF(), img);
+                painter.restore();
+            }
+        }
+
+        if (mRegionLoader) {
+            drawRegion(painter);
+            mRegionTimer->start(); // decode the visible region once the view settles
         }
     }
 
     painter.setOpacity(oldOp);
 }
 
+/**
+ * Draws the decoded region of huge images on top of the reduced image.
+ * @param painter a painter with the world matrix set
+ **/
+void DkBaseViewPort::drawRegion(QPainter &painter)
+{
+    if (mRegionImg.isNull())
+        return;
+
+    painter.drawImage(mImgMatrix.mapRect(mRegionRect), mRegionImg, mRegionImg.rect());
+}
+
 void DkBaseViewPort::drawPattern(QPainter &painter) const
 {
     QBrush pt = mPattern;
@@ -55,6 +55,8 @@ class QSettings;
 namespace nmc
 {
 
+class DkRegionLoader;
+
 class DllCoreExport DkBaseViewPort : public QGraphicsView
 {
     Q_OBJECT
@@ -122,6 +124,8 @@ public:
 
     virtual QImage getImage() const;
     virtual QSize getImageSize() const;
+    void setRegionLoader(QSharedPointer<DkRegionLoader> loader = QSharedPointer<DkRegionLoader>(),
+                         DkJpgTransform::Transform orientation = DkJpgTransform::transform_identity);
     virtual QRectF getImageViewRect() const;
     virtual bool imageInside() const;
 
@@ -165,6 +169,11 @@ protected:
 
     virtual bool gestureEvent(QGestureEvent *event);
 
+protected slots:
+    void updateRegion();
+    void regionDecoded();
+
+protected:
     QVector<QShortcut *> mShortcuts; // TODO: add to actionManager
 
     Qt::KeyboardModifier mAltMod; // it makes sense to switch these modifiers on linux (alt + mouse moves windows there)
@@ -199,8 +208,19 @@ protected:
     bool mBlockZooming = false;
     QTimer *mZoomTimer;
 
+    // huge images: mImgStorage holds a reduced image and the visible region is decoded on demand
+    QSharedPointer<DkRegionLoader> mRegionLoader;
+    DkJpgTransform::Transform mRegionOrientation = DkJpgTransform::transform_identity;
+    QImage mRegionImg;
+    QRectF mRegionRect; // in image coordinates
+    QRectF mRegionRequest;
+    QSize mRegionRequestSize;
+    QFutureWatcher<QImage> mRegionWatcher;
+    QTimer *mRegionTimer;
+
     // functions
     virtual void draw(QPainter &painter, double opacity = 1.0);
+    void drawRegion(QPainter &painter);
     virtual void drawPattern(QPainter &painter) const;
     virtual void updateImageMatrix();
     void resetWorldMatrix();
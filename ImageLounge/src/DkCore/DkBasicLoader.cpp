@@ -38,15 +38,20 @@
 #pragma warning(push, 0)
 #include <QBuffer>
 #include <QDebug>
+#include <QFile>
 #include <QFileInfo>
 #include <QIcon>
 #include <QImage>
 #include <QImageReader>
 #include <QImageWriter>
+#include <QMutex>
 #include <QNetworkProxyFactory>
 #include <QNetworkReply>
 #include <QObject>
+#include <QPainter>
 #include <QPixmap>
+#include <QRandomGenerator>
+#include <QSaveFile>
 #include <QtConcurrentRun>
 
 #include <assert.h>
@@ -162,10 +167,21 @@ bool DkEditImage::hasNewMetaData() const
 void DkEditImage::setImage(const QImage &img)
 {
     mImg = img;
+    mOrientation = DkJpgTransform::transform_identity;
 }
 
 QImage DkEditImage::image() const
 {
+    if (!mOrientationMutex)
+        return mImg;
+
+    QMutexLocker locker(mOrientationMutex.data());
+
+    if (mOrientation != DkJpgTransform::transform_identity) {
+        mImg = DkJpgTransform::apply(mImg, mOrientation);
+        mOrientation = DkJpgTransform::transform_identity;
+    }
+
     return mImg;
 }
 
@@ -184,6 +200,253 @@ int DkEditImage::size() const
     return qRound(DkImage::getBufferSizeFloat(mImg.size(), mImg.depth()));
 }
 
+void DkEditImage::setTransform(DkJpgTransform::Transform transform)
+{
+    mTransform = transform;
+}
+
+DkJpgTransform::Transform DkEditImage::transform() const
+{
+    return mTransform;
+}
+
+/**
+ * Sets the orientation that displays the image upright.
+ * The pixels are not touched until image() is called.
+ * @param orientation the Exif orientation as transform
+ **/
+void DkEditImage::setOrientation(DkJpgTransform::Transform orientation)
+{
+    if (orientation == DkJpgTransform::transform_invalid || orientation == DkJpgTransform::transform_identity)
+        return;
+
+    mOrientation = orientation;
+    mOrientationMutex = QSharedPointer<QMutex>(new QMutex());
+}
+
+/**
+ * Returns the image without rotating its pixels.
+ * @param orientation if not null, it is set to the transform that displays the image upright
+ * @return QImage the image as decoded
+ **/
+QImage DkEditImage::rawImage(DkJpgTransform::Transform *orientation) const
+{
+    if (!mOrientationMutex) {
+        if (orientation)
+            *orientation = DkJpgTransform::transform_identity;
+        return mImg;
+    }
+
+    QMutexLocker locker(mOrientationMutex.data());
+
+    if (orientation)
+        *orientation = mOrientation;
+
+    return mImg;
+}
+
+// DkDecoderRegistry --------------------------------------------------------------------
+DkDecoderRegistry::DkDecoderRegistry()
+{
+    // QImageReader::supportedImageFormats() loads all plugins - so we just ask once
+    for (const QByteArray &f : QImageReader::supportedImageFormats())
+        mQtFormats.insert(QString::fromLatin1(f).toLower());
+    mQtFormats.insert("jpe"); // fixes #435 - thumbnail gets loaded in the RAW loader
+
+    // the order matters: the first match wins
+    addSignature("jpg", "FFD8FF");
+    addSignature("png", "89504E47 0D0A1A0A");
+    addSignature("gif", "47494638");
+    addSignature("bmp", "424D 00000000 00000000", "FFFF 00000000 FFFFFFFF"); // BM + reserved bytes
+    addSignature("webp", "52494646 00000000 57454250", "FFFFFFFF 00000000 FFFFFFFF"); // RIFF....WEBP
+    addSignature("psd", "38425053"); // 8BPS
+    addSignature("ico", "00000100");
+
+    // RAWs that look like TIFFs but cannot be read by TIFF decoders
+    addSignature("raw", "4949524F"); // ORF (IIRO)
+    addSignature("raw", "49495253"); // ORF (IIRS)
+    addSignature("raw", "49495500"); // RW2
+    addSignature("raw", "49491A00 00004845 41504343 4452"); // CRW
+    addSignature("raw", "46554A49 46494C4D"); // RAF (FUJIFILM)
+    addSignature("raw", "004D524D"); // MRW
+    addSignature("raw", "464F5662"); // X3F
+    addSignature("raw", "00000000 66747970 63727820", "00000000 FFFFFFFF FFFFFFFF"); // CR3 (ftypcrx )
+
+    // TIFFs and TIFF based RAWs (DNG, NEF, CR2, ARW...) - see decoders()
+    addSignature("tif", "49492A00");
+    addSignature("tif", "4D4D002A");
+    addSignature("tif", "49492B00"); // BigTIFF
+    addSignature("tif", "4D4D002B");
+
+    // ISO base media files
+    addSignature("avif", "00000000 66747970 61766966", "00000000 FFFFFFFF FFFFFFFF");
+    addSignature("avif", "00000000 66747970 61766973", "00000000 FFFFFFFF FFFFFFFF");
+    addSignature("heic", "00000000 66747970 68656963", "00000000 FFFFFFFF FFFFFFFF");
+    addSignature("heic", "00000000 66747970 68656978", "00000000 FFFFFFFF FFFFFFFF");
+    addSignature("heic", "00000000 66747970 6D696631", "00000000 FFFFFFFF FFFFFFFF"); // mif1
+
+    addSignature("jxl", "FF0A");
+    addSignature("jxl", "0000000C 4A584C20 0D0A870A");
+}
+
+DkDecoderRegistry &DkDecoderRegistry::instance()
+{
+    static DkDecoderRegistry inst;
+    return inst;
+}
+
+void DkDecoderRegistry::addSignature(const QString &format, const char *magic, const char *mask)
+{
+    Signature s;
+    s.magic = QByteArray::fromHex(magic); // spaces are skipped
+    s.mask = mask ? QByteArray::fromHex(mask) : QByteArray(s.magic.size(), (char)0xFF);
+    s.format = format;
+
+    Q_ASSERT(s.magic.size() == s.mask.size());
+    mSignatures << s;
+}
+
+/**
+ * Identifies the file format from the first bytes of a file.
+ * @param header the first bytes of a file (see readHeader()).
+ * @return QString the format (which is also Qt's format name) or an empty string if unknown.
+ **/
+QString DkDecoderRegistry::sniff(const QByteArray &header) const
+{
+    for (const Signature &s : mSignatures) {
+        if (header.size() < s.magic.size())
+            continue;
+
+        bool match = true;
+        for (int idx = 0; idx < s.magic.size() && match; idx++)
+            match = (header[idx] & s.mask[idx]) == s.magic[idx];
+
+        if (match)
+            return s.format;
+    }
+
+    return QString();
+}
+
+/**
+ * Returns the decoders that should be tried (in this order).
+ * Known formats only try the decoders that can read them.
+ * Files that cannot be identified are tried with the suffix based cascade.
+ * @param format the sniffed format (see sniff()).
+ * @param suffix the file's suffix.
+ * @param filePath if a decoder succeeded for this file before, it is tried first.
+ * @return QVector<DkDecoderRegistry::Decoder> the decoders.
+ **/
+QVector<DkDecoderRegistry::Decoder> DkDecoderRegistry::decoders(const QString &format, const QString &suffix, const QString &filePath) const
+{
+    QVector<Decoder> d;
+
+    auto add = [&d](Decoder decoder) {
+        if (!d.contains(decoder))
+            d << decoder;
+    };
+
+    if (!filePath.isEmpty()) {
+        QMutexLocker locker(&mMutex);
+        if (mDecoded.contains(filePath))
+            d << mDecoded.value(filePath);
+    }
+
+    QString suf = suffix.toLower();
+    bool isTif = suf == "tif" || suf == "tiff";
+
+    // drif files have their signature in the footer
+    if (suf == "drif" || suf == "yuv" || suf == "raw")
+        add(decoder_drif);
+
+    if (format == "tif") {
+        // most RAWs are TIFFs - but only TIFFs are named like that
+        if (!isTif)
+            add(decoder_raw);
+        add(decoder_tif_reduced);
+        add(decoder_qt);
+        add(decoder_tif); // supports jpg compressed tiffs
+        add(decoder_raw);
+    } else if (format == "raw") {
+        add(decoder_raw);
+    } else if (format == "jpg") {
+        add(decoder_qt);
+        add(decoder_samsung);
+    } else if (format == "psd") {
+        add(decoder_qt);
+        add(decoder_psd);
+    } else if (format == "ico") {
+        add(decoder_ico);
+        add(decoder_qt);
+    } else if (!format.isEmpty()) {
+        add(decoder_qt);
+        add(decoder_qt_buffer); // e.g. AVIFs with a HEIF brand
+    } else {
+        // no signature: fall back to the suffix
+        if (suf == "ico")
+            add(decoder_ico);
+        if (isTif)
+            add(decoder_tif_reduced);
+        if (isQtFormat(suf) || suf.isEmpty())
+            add(decoder_qt);
+        if (isTif)
+            add(decoder_tif);
+        add(decoder_psd);
+        if (!isQtFormat(suf))
+            add(decoder_raw);
+        if (suf == "tga")
+            add(decoder_tga);
+        if (suf != "roh") {
+            // if we first load files to buffers, we can additionally load images with wrong extensions (rainer bugfix : )
+            add(decoder_qt_buffer);
+        }
+        if (suf == "jpg" || suf == "jpeg" || suf == "jpe")
+            add(decoder_samsung);
+        if (suf == "roh")
+            add(decoder_roh);
+        if (suf == "vec")
+            add(decoder_vec);
+    }
+
+    return d;
+}
+
+void DkDecoderRegistry::setDecoded(const QString &filePath, Decoder decoder)
+{
+    QMutexLocker locker(&mMutex);
+
+    // don't grow without bounds when browsing large collections
+    if (mDecoded.size() > 10000)
+        mDecoded.clear();
+
+    mDecoded.insert(filePath, decoder);
+}
+
+bool DkDecoderRegistry::isQtFormat(const QString &format) const
+{
+    return mQtFormats.contains(format.toLower());
+}
+
+/**
+ * Returns the first bytes of the file (or buffer) that are needed to sniff it.
+ * @param filePath the file which is read if the buffer is empty.
+ * @param ba the file buffer (optional).
+ * @return QByteArray the header (empty if the file cannot be read).
+ **/
+QByteArray DkDecoderRegistry::readHeader(const QString &filePath, const QSharedPointer<QByteArray> ba)
+{
+    const int headerSize = 64;
+
+    if (ba && !ba->isEmpty())
+        return ba->left(headerSize);
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    return file.read(headerSize);
+}
+
 // Basic loader and image edit class --------------------------------------------------------------------
 DkBasicLoader::DkBasicLoader(int mode)
 {
@@ -209,6 +472,7 @@ bool DkBasicLoader::loadGeneral(const QString &filePath, bool loadMetaData, bool
 bool DkBasicLoader::loadGeneral(const QString &filePath, QSharedPointer<QByteArray> ba, bool loadMetaData, bool fast)
 {
     DkTimer dt;
+    DkTraceScope ts("loadGeneral", DkTraceLog::cat_decode, filePath);
     bool imgLoaded = false;
 
     mFile = DkUtils::resolveSymLink(filePath);
@@ -236,150 +500,198 @@ bool DkBasicLoader::loadGeneral(const QString &filePath, QSharedPointer<QByteArr
         qDebug() << "metaData is NULL!";
     }
 
-    QList<QByteArray> qtFormats = QImageReader::supportedImageFormats();
-    qtFormats << "jpe"; // fixes #435 - thumbnail gets loaded in the RAW loader
-    QString suf = fInfo.suffix().toLower();
+    QSize minSize = mMinDecodeSize;
+
+    // huge images are decoded with reduced resolution - zoomed views decode regions (see DkRegionLoader)
+    if (minSize.isEmpty() && !mHugeDecodeSize.isEmpty() && DkRegionLoader::isHuge(DkRegionLoader::imageSize(mFile, ba)))
+        minSize = mHugeDecodeSize;
+
+    // the minimal size is given for the rotated image
+    int orientation = mMetaData ? mMetaData->getOrientationDegree() : 0;
+    if (qAbs(orientation) == 90 && !DkSettingsManager::param().metaData().ignoreExifOrientation)
+        minSize.transpose();
 
     QImage img;
 
-    // load drif file
-    if (!imgLoaded && ("drif" == suf || "yuv" == suf || "raw" == suf))
-        imgLoaded = loadDrifFile(mFile, img, ba);
+    if (!imgLoaded) {
+        // the first bytes tell us which decoder to use - the suffix is just a hint
+        DkDecoderRegistry &registry = DkDecoderRegistry::instance();
+        QString format = registry.sniff(DkDecoderRegistry::readHeader(mFile, ba));
+        QByteArray lba; // file buffer - only read if a decoder needs it
 
-    if (!imgLoaded && !fInfo.exists() && ba && !ba->isEmpty()) {
-        imgLoaded = img.loadFromData(*ba.data());
+        for (DkDecoderRegistry::Decoder d : registry.decoders(format, newSuffix, mFile)) {
+            imgLoaded = decode(d, format, minSize, img, ba, lba, fast);
 
-        if (imgLoaded)
-            mLoader = qt_loader;
+            if (imgLoaded) {
+                registry.setDecoded(mFile, d);
+                break;
+            }
+        }
+    }
+
+    // tiff things
+    if (imgLoaded && !mPageIdxDirty)
+        indexPages(mFile, ba);
+    mPageIdxDirty = false;
+
+    // jpgs can be rotated losslessly later on - so we remember how the file was transformed
+    DkJpgTransform::Transform transform = DkJpgTransform::transform_invalid;
+    if (imgLoaded && mLoader == qt_loader && DkJpgTransform::isJpg(mFile))
+        transform = DkJpgTransform::transform_identity;
+
+    DkJpgTransform::Transform exifOrientation = DkJpgTransform::transform_identity;
+
+    if (imgLoaded && loadMetaData && mMetaData) {
+        try {
+            mMetaData->setQtValues(img);
+            int orientation = mMetaData->getOrientationDegree();
+
+            // the orientation is applied when drawing - pixels are only rotated if someone needs them upright
+            if (orientation != -1 && !mMetaData->isTiff() && !mMetaData->isAVIF() && !mMetaData->isHEIF() && !mMetaData->isJXL()
+                && !DkSettingsManager::param().metaData().ignoreExifOrientation) {
+                exifOrientation = DkJpgTransform::fromAngle(orientation);
+                transform = DkJpgTransform::combine(transform, exifOrientation);
+            }
+
+        } catch (...) {
+        } // ignore if we cannot read the metadata
+    } else if (!mMetaData) {
+        qDebug() << "metaData is NULL!";
     }
 
-    // load large icons
-    if (!imgLoaded && suf == "ico") {
+    if (imgLoaded) {
+        setEditImage(img, tr("Original Image"), transform);
+        mImages.last().setOrientation(exifOrientation);
+    }
+
+    if (imgLoaded)
+        qInfo() << "[Basic Loader]" << filePath << "loaded in" << dt;
+    else
+        qWarning() << "[Basic Loader] could not load" << filePath;
+
+    return imgLoaded;
+}
+
+/**
+ * Decodes the current file with the decoder given.
+ * @param decoder the decoder (see DkDecoderRegistry::decoders()).
+ * @param format the sniffed format - if empty, the suffix is used.
+ * @param minSize if not empty, decoders that can downscale while decoding are asked for reduced images.
+ * @param img the decoded image.
+ * @param ba the file buffer (optional).
+ * @param lba the file buffer that is read if a decoder needs it (shared between decoders).
+ * @param fast if true, RAWs are demosaiced with low quality.
+ * @return bool true if the image was decoded.
+ **/
+bool DkBasicLoader::decode(DkDecoderRegistry::Decoder decoder,
+                           const QString &format,
+                           const QSize &minSize,
+                           QImage &img,
+                           QSharedPointer<QByteArray> ba,
+                           QByteArray &lba,
+                           bool fast)
+{
+    QString fmt = format.isEmpty() ? QFileInfo(mFile).suffix().toLower() : format;
+    QByteArray fmtStr = fmt.toLatin1(); // 1 byte per char
+    const char *qtFmt = fmtStr.isEmpty() ? 0 : fmtStr.constData();
+
+    auto buffer = [&]() -> const QByteArray & {
+        if (ba && !ba->isEmpty())
+            return *ba;
+        if (lba.isEmpty())
+            loadFileToBuffer(mFile, lba);
+        return lba;
+    };
+
+    bool imgLoaded = false;
+
+    switch (decoder) {
+    case DkDecoderRegistry::decoder_drif:
+        imgLoaded = loadDrifFile(mFile, img, ba);
+        break;
+    case DkDecoderRegistry::decoder_ico: {
+        // load large icons
         QIcon icon(mFile);
 
         if (!icon.isNull()) {
             img = icon.pixmap(QSize(256, 256)).toImage();
-            imgLoaded = true;
+            imgLoaded = !img.isNull();
         }
-    }
-
-    // default Qt loader
-    // here we just try those formats that are officially supported
-    if (!imgLoaded && qtFormats.contains(suf.toStdString().c_str()) || suf.isEmpty()) {
+    } break;
+    case DkDecoderRegistry::decoder_tif_reduced:
+        // reduced TIFFs are read from a pyramid level (or downscaled while decoding)
+        if (!minSize.isEmpty())
+            imgLoaded = loadReducedTiff(mFile, img, minSize);
+        if (imgLoaded)
+            mLoader = tif_loader;
+        break;
+    case DkDecoderRegistry::decoder_qt:
         // if image has Indexed8 + alpha channel -> we crash... sorry for that
-        if (!ba || ba->isEmpty())
-            imgLoaded = img.load(mFile, suf.toStdString().c_str());
+        if (!minSize.isEmpty() && loadReducedQt(mFile, img, fmt, minSize, ba))
+            imgLoaded = true;
+        else if (!ba || ba->isEmpty())
+            imgLoaded = img.load(mFile, qtFmt);
         else
-            imgLoaded = img.loadFromData(*ba.data(), suf.toStdString().c_str()); // toStdString() in order get 1 byte per char
-
+            imgLoaded = img.loadFromData(*ba, qtFmt);
         if (imgLoaded)
             mLoader = qt_loader;
-    }
-
-    // OpenCV Tiff loader - supports jpg compressed tiffs
-    if (!imgLoaded && newSuffix.contains(QRegExp("(tif|tiff)", Qt::CaseInsensitive))) {
+        break;
+    case DkDecoderRegistry::decoder_tif:
+        // libtiff loader - supports jpg compressed tiffs
         imgLoaded = loadTIFFile(mFile, img, ba);
-
         if (imgLoaded)
             mLoader = tif_loader;
-    }
-
-    // PSD loader
-    if (!imgLoaded) {
+        break;
+    case DkDecoderRegistry::decoder_psd:
         imgLoaded = loadPSDFile(mFile, img, ba);
         if (imgLoaded)
             mLoader = psd_loader;
-    }
-
-    // RAW loader
-    if (!imgLoaded && !qtFormats.contains(suf.toStdString().c_str())) {
+        break;
+    case DkDecoderRegistry::decoder_raw:
         // TODO: sometimes (e.g. _DSC6289.tif) strange opencv errors are thrown - catch them!
-        // load raw files
         imgLoaded = loadRawFile(mFile, img, ba, fast);
         if (imgLoaded)
             mLoader = raw_loader;
-    }
-
-    // TGA loader
-    if (!imgLoaded && newSuffix.contains(QRegExp("(tga)", Qt::CaseInsensitive))) {
+        break;
+    case DkDecoderRegistry::decoder_tga:
         imgLoaded = loadTgaFile(mFile, img, ba);
-
-        if (imgLoaded)
-            mLoader = tga_loader; // TODO: add tga loader
-    }
-
-    QByteArray lba;
-
-    // default Qt loader
-    if (!imgLoaded && !newSuffix.contains(QRegExp("(roh)", Qt::CaseInsensitive))) {
-        // if we first load files to buffers, we can additionally load images with wrong extensions (rainer bugfix : )
-        // TODO: add warning here
-        loadFileToBuffer(mFile, lba);
-        imgLoaded = img.loadFromData(lba);
-
         if (imgLoaded)
+            mLoader = tga_loader;
+        break;
+    case DkDecoderRegistry::decoder_qt_buffer:
+        // Qt guesses the format from the buffer
+        imgLoaded = img.loadFromData(buffer());
+        if (imgLoaded) {
             qWarning() << "The image seems to have a wrong extension";
-
-        if (imgLoaded)
             mLoader = qt_loader;
-    }
-
-    // add marker to fix broken panorama images from SAMSUNG
-    // see: https://github.com/nomacs/nomacs/issues/254
-    if (!imgLoaded && newSuffix.contains(QRegExp("(jpg|jpeg|jpe)", Qt::CaseInsensitive))) {
-        // prefer external buffer
-        QByteArray baf = DkImage::fixSamsungPanorama(ba && !ba->isEmpty() ? *ba : lba);
+        }
+        break;
+    case DkDecoderRegistry::decoder_samsung: {
+        // add marker to fix broken panorama images from SAMSUNG
+        // see: https://github.com/nomacs/nomacs/issues/254
+        QByteArray baf = DkImage::fixSamsungPanorama(buffer());
 
         if (!baf.isEmpty())
-            imgLoaded = img.loadFromData(baf, suf.toStdString().c_str());
-
+            imgLoaded = img.loadFromData(baf, qtFmt);
         if (imgLoaded)
             mLoader = qt_loader;
-    }
-
-    // this loader is a bit buggy -> be carefull
-    if (!imgLoaded && newSuffix.contains(QRegExp("(roh)", Qt::CaseInsensitive))) {
+    } break;
+    case DkDecoderRegistry::decoder_roh:
+        // this loader is a bit buggy -> be carefull
         imgLoaded = loadRohFile(mFile, img, ba);
         if (imgLoaded)
             mLoader = roh_loader;
-    }
-
-    // this loader is for OpenCV cascade training files
-    if (!imgLoaded && newSuffix.contains(QRegExp("(vec)", Qt::CaseInsensitive))) {
+        break;
+    case DkDecoderRegistry::decoder_vec:
+        // this loader is for OpenCV cascade training files
         imgLoaded = loadOpenCVVecFile(mFile, img, ba);
         if (imgLoaded)
             mLoader = roh_loader;
+        break;
+    default:
+        break;
     }
 
-    // tiff things
-    if (imgLoaded && !mPageIdxDirty)
-        indexPages(mFile, ba);
-    mPageIdxDirty = false;
-
-    if (imgLoaded && loadMetaData && mMetaData) {
-        try {
-            mMetaData->setQtValues(img);
-            int orientation = mMetaData->getOrientationDegree();
-
-            if (orientation != -1 && !mMetaData->isTiff() && !mMetaData->isAVIF() && !mMetaData->isHEIF() && !mMetaData->isJXL()
-                && !DkSettingsManager::param().metaData().ignoreExifOrientation) {
-                img = DkImage::rotate(img, orientation);
-            }
-
-        } catch (...) {
-        } // ignore if we cannot read the metadata
-    } else if (!mMetaData) {
-        qDebug() << "metaData is NULL!";
-    }
-
-    if (imgLoaded)
-        setEditImage(img, tr("Original Image"));
-
-    if (imgLoaded)
-        qInfo() << "[Basic Loader]" << filePath << "loaded in" << dt;
-    else
-        qWarning() << "[Basic Loader] could not load" << filePath;
-
     return imgLoaded;
 }
 
@@ -762,11 +1074,21 @@ void DkBasicLoader::pruneEditHistory()
     }
 }
 
-void DkBasicLoader::setEditImage(const QImage &img, const QString &editName)
+/**
+ * Adds a new image to the edit history.
+ * @param img the edited image
+ * @param editName the name shown in the history
+ * @param transform if img is a lossless transform of the last image (e.g. a rotation by 90°), jpgs are saved without re-encoding
+ **/
+void DkBasicLoader::setEditImage(const QImage &img, const QString &editName, DkJpgTransform::Transform transform)
 {
     if (img.isNull())
         return;
 
+    // the first image's transform relates to the file
+    if (!mImages.isEmpty())
+        transform = DkJpgTransform::combine(lastTransform(), transform);
+
     // delete all hidden edit states
     pruneEditHistory();
 
@@ -781,6 +1103,7 @@ void DkBasicLoader::setEditImage(const QImage &img, const QString &editName)
         mMetaData->clearOrientation();
     // new history item with new pixmap (and old or original metadata)
     DkEditImage newImg(img, mMetaData->copy(), editName); // new image, old/unchanged metadata
+    newImg.setTransform(transform);
 
     if (historySize + newImg.size() > DkSettingsManager::param().resources().historyMemory && mImages.size() > mMinHistorySize) {
         mImages.removeAt(1);
@@ -834,6 +1157,22 @@ QImage DkBasicLoader::lastImage() const
     return QImage();
 }
 
+/**
+ * Returns the lossless transform between the loaded file and lastImage().
+ * @return DkJpgTransform::Transform transform_invalid if lastImage() was edited otherwise
+ **/
+DkJpgTransform::Transform DkBasicLoader::lastTransform() const
+{
+    // see lastImage()
+    for (int idx = mImageIndex; idx >= 0 && idx < mImages.size(); idx--) {
+        if (mImages[idx].hasNewImage()) {
+            return mImages[idx].transform();
+        }
+    }
+
+    return DkJpgTransform::transform_invalid;
+}
+
 QImage DkBasicLoader::image() const
 {
     return pixmap();
@@ -855,6 +1194,39 @@ QImage DkBasicLoader::pixmap() const
     return mImages.at(mImageIndex).image();
 }
 
+/**
+ * Returns the current pixmap without applying the Exif orientation.
+ * Viewers should draw it transformed rather than calling pixmap() which rotates the pixels.
+ * @param orientation if not null, it is set to the transform that displays the pixmap upright
+ * @return QImage the pixmap as decoded
+ **/
+QImage DkBasicLoader::rawPixmap(DkJpgTransform::Transform *orientation) const
+{
+    if (orientation)
+        *orientation = DkJpgTransform::transform_identity;
+
+    // see pixmap()
+    if (mImages.isEmpty())
+        return QImage();
+    else if (mImageIndex < 0 || mImageIndex >= mImages.size())
+        return mImages.last().rawImage(orientation);
+
+    return mImages.at(mImageIndex).rawImage(orientation);
+}
+
+/**
+ * Returns the size of the current pixmap as it is displayed (i.e. with the Exif orientation applied).
+ * In contrast to pixmap().size(), the pixels are not rotated.
+ * @return QSize the upright pixmap size
+ **/
+QSize DkBasicLoader::pixmapSize() const
+{
+    DkJpgTransform::Transform orientation = DkJpgTransform::transform_identity;
+    QImage img = rawPixmap(&orientation);
+
+    return DkJpgTransform::transformedSize(img.size(), orientation);
+}
+
 /**
  * @brief Returns the pointer to the current metadata object which belongs to the loaded image.
  *
@@ -869,6 +1241,11 @@ QSharedPointer<DkMetaDataT> DkBasicLoader::getMetaData() const
     return metaData;
 };
 
+void DkBasicLoader::setMetaData(QSharedPointer<DkMetaDataT> metaData)
+{
+    mMetaData = metaData;
+}
+
 QSharedPointer<DkMetaDataT> DkBasicLoader::lastMetaDataEdit(bool return_nullptr, bool return_orig) const
 {
     QSharedPointer<DkMetaDataT> lastEdit; // null edit
@@ -968,46 +1345,162 @@ void DkBasicLoader::setMinHistorySize(int size)
     mMinHistorySize = size;
 }
 
-void DkBasicLoader::setHistoryIndex(int idx)
+/**
+ * Allows decoders to downscale images while decoding.
+ * The decoded image is at least size (in the upright orientation).
+ * Use decodeScale() to find out if (and how much) the image was reduced.
+ * @param size the minimal size needed - an empty size disables reduced decoding
+ **/
+void DkBasicLoader::setMinDecodeSize(const QSize &size)
 {
-    mImageIndex = idx;
-    // TODO update mMetaData, see undo()
+    mMinDecodeSize = size;
 }
 
-void DkBasicLoader::loadFileToBuffer(const QString &filePath, QByteArray &ba) const
+/**
+ * Like setMinDecodeSize() but only applied to huge images (see DkRegionLoader::isHuge).
+ * The viewer sets the screen size here so that gigapixel images can be opened at all.
+ * @param size the minimal size needed - an empty size disables reduced decoding
+ **/
+void DkBasicLoader::setHugeImageDecodeSize(const QSize &size)
 {
-    QFileInfo fi(filePath);
-
-    if (!fi.exists())
-        return;
-
-#ifdef WITH_QUAZIP
-    if (fi.dir().path().contains(DkZipContainer::zipMarker()))
-        DkZipContainer::extractImage(DkZipContainer::decodeZipFile(filePath), DkZipContainer::decodeImageFile(filePath), ba);
-#endif
-
-    QFile file(filePath);
-    file.open(QIODevice::ReadOnly);
+    mHugeDecodeSize = size;
+}
 
-    ba = file.readAll();
+/**
+ * Returns the scale of the decoded image w.r.t. the image file.
+ * @return double 1.0 if the image was decoded with full resolution
+ **/
+double DkBasicLoader::decodeScale() const
+{
+    return mDecodeScale;
 }
 
-QSharedPointer<QByteArray> DkBasicLoader::loadFileToBuffer(const QString &filePath) const
+/**
+ * Decodes a reduced image if the decoder supports scaling (e.g. jpg DCT scaling).
+ * Images are reduced by powers of 2 (down to 1/8) as long as they are larger than minSize.
+ * @param filePath the image file
+ * @param img the decoded image
+ * @param suffix the image format
+ * @param minSize the minimal size needed (in the stored orientation)
+ * @param ba the file buffer (optional)
+ * @return bool false if the image was not loaded (it is not worth reducing or the decoder cannot do it)
+ **/
+bool DkBasicLoader::loadReducedQt(const QString &filePath, QImage &img, const QString &suffix, const QSize &minSize, QSharedPointer<QByteArray> ba)
 {
-    QFileInfo fi(filePath);
+    QBuffer buffer;
+    QFile file(filePath);
+    QIODevice *device = &file;
 
-#ifdef WITH_QUAZIP
-    if (fi.dir().path().contains(DkZipContainer::zipMarker()))
-        return DkZipContainer::extractImage(DkZipContainer::decodeZipFile(filePath), DkZipContainer::decodeImageFile(filePath));
-#endif
+    if (ba && !ba->isEmpty()) {
+        buffer.setData(*ba);
+        device = &buffer;
+    }
+
+    if (!device->open(QIODevice::ReadOnly))
+        return false;
+
+    QImageReader reader(device, suffix.toLatin1());
+    QSize size = reader.size();
+
+    if (size.isEmpty() || !reader.supportsOption(QImageIOHandler::ScaledSize))
+        return false;
+
+    int denom = 1;
+    while (denom < 8 && size.width() / (denom * 2) >= minSize.width() && size.height() / (denom * 2) >= minSize.height())
+        denom *= 2;
+
+    if (denom == 1)
+        return false;
+
+    // jpgs decode exactly to ceil(size/denom)
+    reader.setScaledSize(QSize((size.width() + denom - 1) / denom, (size.height() + denom - 1) / denom));
+
+    if (!reader.read(&img))
+        return false;
+
+    mDecodeScale = (double)img.width() / size.width();
+    qInfo() << "[Basic Loader] reduced decoding" << size << "->" << img.size();
+
+    return true;
+}
+
+/**
+ * Decodes a reduced TIFF.
+ * Pyramid TIFFs provide reduced resolution pages. Otherwise, the image is decoded
+ * strip by strip (or tile row by tile row) and downscaled on the fly.
+ * Either way, the full resolution image is never kept in memory.
+ * @param filePath the TIFF file
+ * @param img the decoded image
+ * @param minSize the minimal size needed (in the stored orientation)
+ * @return bool false if the image was not loaded (it is not worth reducing or the file cannot be read this way)
+ **/
+bool DkBasicLoader::loadReducedTiff(const QString &filePath, QImage &img, const QSize &minSize)
+{
+    DkTiffPageReader reader;
+
+    if (!reader.open(filePath))
+        return false;
+
+    QSize size = reader.pageSize(1);
+
+    if (size.width() < 2 * minSize.width() || size.height() < 2 * minSize.height())
+        return false;
+
+    int page = reader.reducedPage(minSize);
+
+    if (page > 0)
+        img = reader.readPage(page);
+
+    if (img.isNull())
+        img = reader.readRegion(1, QRect(QPoint(), size), size.scaled(minSize, Qt::KeepAspectRatioByExpanding));
+
+    if (img.isNull())
+        return false;
+
+    mDecodeScale = (double)img.width() / size.width();
+    qInfo() << "[Basic Loader] reduced TIFF decoding" << size << "->" << img.size() << (page > 0 ? "(pyramid level)" : "(streamed)");
+
+    return true;
+}
+
+void DkBasicLoader::setHistoryIndex(int idx)
+{
+    mImageIndex = idx;
+    // TODO update mMetaData, see undo()
+}
+
+void DkBasicLoader::loadFileToBuffer(const QString &filePath, QByteArray &ba) const
+{
+    DkTraceScope ts("loadFileToBuffer", DkTraceLog::cat_io, filePath);
+
+    QFileInfo fi(filePath);
+
+    if (!fi.exists())
+        return;
+
+#ifdef WITH_QUAZIP
+    if (fi.dir().path().contains(DkZipContainer::zipMarker()))
+        DkZipContainer::extractImage(DkZipContainer::decodeZipFile(filePath), DkZipContainer::decodeImageFile(filePath), ba);
+#endif
 
     QFile file(filePath);
     file.open(QIODevice::ReadOnly);
 
-    QSharedPointer<QByteArray> ba(new QByteArray(file.readAll()));
-    file.close();
+    ba = file.readAll();
+}
 
-    return ba;
+QSharedPointer<QByteArray> DkBasicLoader::loadFileToBuffer(const QString &filePath) const
+{
+    DkTraceScope ts("loadFileToBuffer", DkTraceLog::cat_io, filePath);
+
+    QFileInfo fi(filePath);
+
+#ifdef WITH_QUAZIP
+    if (fi.dir().path().contains(DkZipContainer::zipMarker()))
+        return DkZipContainer::extractImage(DkZipContainer::decodeZipFile(filePath), DkZipContainer::decodeImageFile(filePath));
+#endif
+
+    return DkFileBuffer::load(filePath);
 }
 
 /**
@@ -1024,16 +1517,21 @@ bool DkBasicLoader::writeBufferToFile(const QString &fileInfo, const QSharedPoin
     if (!ba || ba->isEmpty())
         return false;
 
-    QFile file(fileInfo);
-    file.open(QIODevice::WriteOnly);
+    // QSaveFile writes to a temporary file and renames it on commit - so we never leave torn files
+    QFileInfo fInfo(fileInfo);
+    QSaveFile file(fInfo.isSymLink() ? fInfo.symLinkTarget() : fileInfo);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
     qint64 bytesWritten = file.write(*ba.data(), ba->size());
-    file.close();
     qDebug() << "[DkBasicLoader] buffer saved, bytes written: " << bytesWritten;
 
-    if (!bytesWritten || bytesWritten == -1)
+    if (!bytesWritten || bytesWritten == -1) {
+        file.cancelWriting();
         return false;
+    }
 
-    return true;
+    return file.commit();
 }
 
 void DkBasicLoader::indexPages(const QString &filePath, const QSharedPointer<QByteArray> ba)
@@ -1131,57 +1629,15 @@ bool DkBasicLoader::loadPageAt(int pageIdx)
     if (pageIdx > mNumPages || pageIdx < 1)
         return imgLoaded;
 
-    // first turn off nasty warning/error dialogs - (we do the GUI : )
-    TIFFErrorHandler oldErrorHandler, oldWarningHandler;
-    oldWarningHandler = TIFFSetWarningHandler(NULL);
-    oldErrorHandler = TIFFSetErrorHandler(NULL);
-
-    DkTimer dt;
-    TIFF *tiff = TIFFOpen(mFile.toLatin1(), "r");
-
-#if defined(Q_OS_WIN)
-
-    // loading from buffer allows us to load files with non-latin names
-    QSharedPointer<QByteArray> ba;
-    if (!tiff)
-        ba = loadFileToBuffer(mFile);
-
-    std::istringstream is(ba ? ba->toStdString() : "");
-    if (ba)
-        tiff = TIFFStreamOpen("MemTIFF", &is);
-#endif
-
-    if (!tiff)
+    DkTiffPageReader reader;
+    if (!reader.open(mFile))
         return imgLoaded;
 
-    uint32 width = 0;
-    uint32 height = 0;
-
-    // go to current directory
-    for (int idx = 1; idx < pageIdx; idx++) {
-        if (!TIFFReadDirectory(tiff))
-            return false;
-    }
-    TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &width);
-    TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &height);
-
-    // init the qImage
-    QImage img = QImage(width, height, QImage::Format_ARGB32);
-
-    const int stopOnError = 1;
-    imgLoaded = TIFFReadRGBAImageOriented(tiff, width, height, reinterpret_cast<uint32 *>(img.bits()), ORIENTATION_TOPLEFT, stopOnError) != 0;
-
-    if (imgLoaded) {
-        for (uint32 y = 0; y < height; ++y)
-            convert32BitOrder(img.scanLine(y), width);
-    }
-
-    TIFFClose(tiff);
-
-    TIFFSetWarningHandler(oldWarningHandler);
-    TIFFSetWarningHandler(oldErrorHandler);
+    QImage img = reader.readPage(pageIdx);
+    imgLoaded = !img.isNull();
 
-    setEditImage(img, tr("Original Image"));
+    if (imgLoaded)
+        setEditImage(img, tr("Original Image"));
 #else
     Q_UNUSED(pageIdx);
 #endif
@@ -1232,8 +1688,9 @@ void DkBasicLoader::convert32BitOrder(void *buffer, int width) const
 /**
  * @brief saves the image and its metadata to the specified file.
  *
- * It writes the image to a file buffer and then writes that buffer back to the original file.
- * Modified metadata is saved afterwards.
+ * The encoder streams to a temporary file next to the target, metadata is
+ * written to that file and it finally replaces the target atomically.
+ * Icons are still encoded to a buffer first.
  *
  * @param filePath target path to image file
  * @param img source image to be written to file (may be converted along the way)
@@ -1241,19 +1698,97 @@ void DkBasicLoader::convert32BitOrder(void *buffer, int width) const
  */
 QString DkBasicLoader::save(const QString &filePath, const QImage &img, int compression)
 {
-    QSharedPointer<QByteArray> ba;
-
     DkTimer dt;
-    if (saveToBuffer(filePath, img, ba, compression) && ba) {
-        if (writeBufferToFile(filePath, ba)) {
-            qInfo() << "saved to" << filePath << "in" << dt;
-            return filePath;
-        }
+    DkTraceScope ts("save", DkTraceLog::cat_io, filePath);
+
+    bool saved = false;
+
+    if (QFileInfo(filePath).suffix().contains("ico", Qt::CaseInsensitive)) {
+        QSharedPointer<QByteArray> ba;
+        saved = saveToBuffer(filePath, img, ba, compression) && ba && writeBufferToFile(filePath, ba);
+    } else
+        saved = saveToFile(filePath, img, compression);
+
+    if (saved) {
+        qInfo() << "saved to" << filePath << "in" << dt;
+        return filePath;
     }
 
     return QString();
 }
 
+/**
+ * @brief saveToFile() streams the image to a temporary file and renames it to filePath.
+ *
+ * Other than saveToBuffer(), the encoded image is never held in memory.
+ * If the target exists, its permissions are kept.
+ *
+ * @param filePath target path to image file
+ * @param img image to be written
+ * @param compression compression flag for QImageWriter
+ * @return bool true if the file was written
+ */
+bool DkBasicLoader::saveToFile(const QString &filePath, const QImage &img, int compression) const
+{
+    // copy current metadata object (see saveToBuffer)
+    QSharedPointer<DkMetaDataT> metaData = mMetaData;
+
+    QFileInfo fInfo(filePath);
+    QFileInfo targetInfo(fInfo.isSymLink() ? fInfo.symLinkTarget() : fInfo.absoluteFilePath());
+
+    // the temp file must be on the same volume - otherwise we cannot rename it
+    // it is created as a plain file (not a QTemporaryFile) so that new files get the user's umask
+    QFile tmpFile;
+    for (int idx = 0; idx < 100 && !tmpFile.isOpen(); idx++) {
+        QString suffix = QString::number(QRandomGenerator::global()->generate(), 36);
+        tmpFile.setFileName(targetInfo.absolutePath() + "/." + targetInfo.completeBaseName() + "." + suffix + "." + fInfo.suffix());
+        tmpFile.open(QIODevice::ReadWrite | QIODevice::NewOnly);
+    }
+
+    bool created = tmpFile.isOpen();
+    bool saved = created && (writeLossless(&tmpFile, filePath, img) || (tmpFile.resize(0) && writeImage(&tmpFile, fInfo.suffix(), img, compression)));
+    tmpFile.close();
+
+    if (saved && metaData) {
+        if (!metaData->isLoaded() || !metaData->hasMetaData())
+            metaData->readMetaData(filePath);
+
+        if (metaData->isLoaded()) {
+            bool mdSaved = false;
+
+            try {
+                metaData->updateImageMetaData(img, false); // set dimensions in exif (do not reset exif orientation)
+                mdSaved = metaData->saveMetaDataToFile(tmpFile.fileName());
+            } catch (...) {
+                qInfo() << "Sorry, I could not save the meta data...";
+            }
+
+            // the temp file might be broken now - write the image without metadata (see #514)
+            if (!mdSaved) {
+                metaData->clearExifState();
+                saved = tmpFile.open(QIODevice::ReadWrite) && tmpFile.resize(0) && writeImage(&tmpFile, fInfo.suffix(), img, compression);
+                tmpFile.close();
+            }
+        }
+    }
+
+    if (saved) {
+        // keep the permissions of files we overwrite
+        if (targetInfo.exists())
+            tmpFile.setPermissions(targetInfo.permissions());
+
+        saved = DkUtils::replaceFile(tmpFile.fileName(), targetInfo.absoluteFilePath());
+    }
+
+    if (!saved && created)
+        tmpFile.remove();
+
+    if (!saved)
+        emit errorDialogSignal(tr("Sorry, I could not save: %1").arg(fInfo.fileName()));
+
+    return saved;
+}
+
 /**
  * @brief saveToBuffer() writes the image matrix img to the file buffer.
  *
@@ -1283,41 +1818,9 @@ bool DkBasicLoader::saveToBuffer(const QString &filePath, const QImage &img, QSh
     if (fInfo.suffix().contains("ico", Qt::CaseInsensitive)) {
         saved = saveWindowsIcon(img, ba);
     } else {
-        bool hasAlpha = DkImage::alphaChannelUsed(img);
-        QImage sImg = img;
-
-        // JPEG 2000 can only handle 32 or 8bit images
-        if (!hasAlpha && img.colorTable().empty() && !fInfo.suffix().contains(QRegExp("(avif|j2k|jp2|jpf|jpx|jxl|png)"))) {
-            sImg = sImg.convertToFormat(QImage::Format_RGB888);
-        } else if (fInfo.suffix().contains(QRegExp("(j2k|jp2|jpf|jpx)")) && sImg.depth() != 32 && sImg.depth() != 8) {
-            if (sImg.hasAlphaChannel()) {
-                sImg = sImg.convertToFormat(QImage::Format_ARGB32);
-            } else {
-                sImg = sImg.convertToFormat(QImage::Format_RGB32);
-            }
-        }
-
-        if (fInfo.suffix().contains(QRegExp("(png)")))
-            compression = -1;
-
         QBuffer fileBuffer(ba.data());
-        // size_t s = fileBuffer.size();
         fileBuffer.open(QIODevice::WriteOnly);
-        QImageWriter *imgWriter = new QImageWriter(&fileBuffer, fInfo.suffix().toStdString().c_str());
-
-        if (compression >= 0) { // -1 -> use Qt's default
-            imgWriter->setCompression(compression);
-            imgWriter->setQuality(compression);
-        }
-        if (compression == -1 && imgWriter->format() == "jpg") {
-            imgWriter->setQuality(DkSettingsManager::instance().settings().app().defaultJpgQuality);
-        }
-
-        imgWriter->setOptimizedWrite(true); // this saves space TODO: user option here?
-        imgWriter->setProgressiveScanWrite(true);
-
-        saved = imgWriter->write(sImg); // hint: release() might run now, resetting mMetaData which is used below [2022-08, pse]
-        delete imgWriter;
+        saved = writeImage(&fileBuffer, fInfo.suffix(), img, compression); // hint: release() might run now, resetting mMetaData which is used below [2022-08, pse]
     }
 
     if (saved && metaData) {
@@ -1353,6 +1856,87 @@ bool DkBasicLoader::saveToBuffer(const QString &filePath, const QImage &img, QSh
     return saved;
 }
 
+/**
+ * @brief writeLossless() writes img by transforming the original jpg.
+ *
+ * This is only possible if img is the last image, and it was created
+ * from the loaded jpg by 90° rotations only (see DkJpgTransform).
+ * The metadata is not updated here.
+ *
+ * @param device the (opened) device the jpg is written to
+ * @param filePath the target file path (must be a jpg too)
+ * @param img image to be written
+ * @return bool true if the jpg was written
+ */
+bool DkBasicLoader::writeLossless(QIODevice *device, const QString &filePath, const QImage &img) const
+{
+    DkJpgTransform::Transform transform = lastTransform();
+
+    if (!DkJpgTransform::isAvailable() || transform == DkJpgTransform::transform_invalid || !DkJpgTransform::isJpg(filePath) || !DkJpgTransform::isJpg(mFile)
+        || img.cacheKey() != lastImage().cacheKey())
+        return false;
+
+    QSharedPointer<QByteArray> ba = loadFileToBuffer(mFile);
+    QByteArray jpg;
+
+    if (!ba || !DkJpgTransform::canTransform(*ba, transform) || !DkJpgTransform::transform(*ba, jpg, transform))
+        return false;
+
+    // the file changed since we loaded it
+    if (DkJpgTransform::imageSize(jpg) != img.size())
+        return false;
+
+    qInfo() << "[Basic Loader] jpg transformed losslessly";
+
+    return device->write(jpg) == jpg.size();
+}
+
+/**
+ * @brief writeImage() encodes img to device.
+ *
+ * The image is converted based on the file suffix.
+ *
+ * @param device the (opened) device the encoder writes to
+ * @param suffix the file suffix which selects the format
+ * @param img image to be written
+ * @param compression compression flag for QImageWriter
+ * @return bool true if the image was encoded
+ */
+bool DkBasicLoader::writeImage(QIODevice *device, const QString &suffix, const QImage &img, int compression) const
+{
+    bool hasAlpha = DkImage::alphaChannelUsed(img);
+    QImage sImg = img;
+
+    // JPEG 2000 can only handle 32 or 8bit images
+    if (!hasAlpha && img.colorTable().empty() && !suffix.contains(QRegExp("(avif|j2k|jp2|jpf|jpx|jxl|png)"))) {
+        sImg = sImg.convertToFormat(QImage::Format_RGB888);
+    } else if (suffix.contains(QRegExp("(j2k|jp2|jpf|jpx)")) && sImg.depth() != 32 && sImg.depth() != 8) {
+        if (sImg.hasAlphaChannel()) {
+            sImg = sImg.convertToFormat(QImage::Format_ARGB32);
+        } else {
+            sImg = sImg.convertToFormat(QImage::Format_RGB32);
+        }
+    }
+
+    if (suffix.contains(QRegExp("(png)")))
+        compression = -1;
+
+    QImageWriter imgWriter(device, suffix.toStdString().c_str());
+
+    if (compression >= 0) { // -1 -> use Qt's default
+        imgWriter.setCompression(compression);
+        imgWriter.setQuality(compression);
+    }
+    if (compression == -1 && imgWriter.format() == "jpg") {
+        imgWriter.setQuality(DkSettingsManager::instance().settings().app().defaultJpgQuality);
+    }
+
+    imgWriter.setOptimizedWrite(true); // this saves space TODO: user option here?
+    imgWriter.setProgressiveScanWrite(true);
+
+    return imgWriter.write(sImg);
+}
+
 void DkBasicLoader::saveThumbToMetaData(const QString &filePath)
 {
     QSharedPointer<QByteArray> ba; // dummy
@@ -1457,6 +2041,7 @@ void DkBasicLoader::release()
 
     mImages.clear(); // clear history
     mImageIndex = -1;
+    mDecodeScale = 1.0;
 
     // Unload metadata
     mMetaData = QSharedPointer<DkMetaDataT>(new DkMetaDataT());
@@ -1788,6 +2373,502 @@ int DkBasicLoader::mergeVecFiles(const QStringList &vecFilePaths, QString &saveF
 
 #endif // #ifdef WITH_OPENCV
 
+// DkTiffPageReader --------------------------------------------------------------------
+DkTiffPageReader::DkTiffPageReader()
+{
+}
+
+DkTiffPageReader::~DkTiffPageReader()
+{
+    close();
+}
+
+bool DkTiffPageReader::open(const QString &filePath)
+{
+    close();
+
+#ifdef WITH_LIBTIFF
+    // first turn off nasty warning/error dialogs - (we do the GUI : )
+    TIFFErrorHandler oldErrorHandler = TIFFSetErrorHandler(NULL);
+    TIFFErrorHandler oldWarningHandler = TIFFSetWarningHandler(NULL);
+
+#if defined(Q_OS_WIN)
+    mTiff = TIFFOpen(filePath.toLatin1(), "r");
+
+    // loading from buffer allows us to load files with non-latin names
+    if (!mTiff) {
+        QFile file(filePath);
+
+        if (file.open(QIODevice::ReadOnly)) {
+            mStream = QSharedPointer<std::istringstream>(new std::istringstream(file.readAll().toStdString()));
+            mTiff = TIFFStreamOpen("MemTIFF", mStream.data());
+        }
+    }
+#else
+    mTiff = TIFFOpen(QFile::encodeName(filePath), "r");
+#endif
+
+    TIFFSetErrorHandler(oldErrorHandler);
+    TIFFSetWarningHandler(oldWarningHandler);
+
+    if (mTiff)
+        mPageIdx = 1;
+#else
+    Q_UNUSED(filePath);
+#endif
+
+    return isOpen();
+}
+
+void DkTiffPageReader::close()
+{
+#ifdef WITH_LIBTIFF
+    if (mTiff)
+        TIFFClose(mTiff);
+#endif
+
+    mTiff = 0;
+    mPageIdx = 0;
+    mStream.clear();
+}
+
+bool DkTiffPageReader::isOpen() const
+{
+    return mTiff != 0;
+}
+
+/**
+ * Reads a page of the TIFF.
+ * Reading forward is cheap, going back needs to rewind the directories.
+ * @param pageIdx the page index (starting with 1)
+ * @return QImage the page or a null image if it cannot be decoded
+ **/
+QImage DkTiffPageReader::readPage(int pageIdx)
+{
+    QImage img;
+
+#ifdef WITH_LIBTIFF
+    if (!mTiff || pageIdx < 1)
+        return img;
+
+    TIFFErrorHandler oldErrorHandler = TIFFSetErrorHandler(NULL);
+    TIFFErrorHandler oldWarningHandler = TIFFSetWarningHandler(NULL);
+
+    if (setPage(pageIdx)) {
+        uint32 width = 0;
+        uint32 height = 0;
+        TIFFGetField(mTiff, TIFFTAG_IMAGEWIDTH, &width);
+        TIFFGetField(mTiff, TIFFTAG_IMAGELENGTH, &height);
+
+        img = QImage(width, height, QImage::Format_ARGB32);
+
+        const int stopOnError = 1;
+        if (!img.isNull() && TIFFReadRGBAImageOriented(mTiff, width, height, reinterpret_cast<uint32 *>(img.bits()), ORIENTATION_TOPLEFT, stopOnError)) {
+            // code from Qt QTiffHandler - convert between ABGR and ARGB
+            for (uint32 y = 0; y < height; ++y) {
+                uint32 *line = reinterpret_cast<uint32 *>(img.scanLine(y));
+
+                for (uint32 x = 0; x < width; ++x) {
+                    uint32 p = line[x];
+                    line[x] = (p & 0xff000000) | ((p & 0x00ff0000) >> 16) | (p & 0x0000ff00) | ((p & 0x000000ff) << 16);
+                }
+            }
+        } else
+            img = QImage();
+    }
+
+    TIFFSetErrorHandler(oldErrorHandler);
+    TIFFSetWarningHandler(oldWarningHandler);
+#else
+    Q_UNUSED(pageIdx);
+#endif
+
+    return img;
+}
+
+/**
+ * Reads a region of a page.
+ * Only the tiles (or strips) that intersect the region are decoded.
+ * They are collected in bands of at most 16 MPix that are scaled right away,
+ * so that neither the page nor the full region need to fit into memory.
+ * @param pageIdx the page index (starting with 1)
+ * @param region the region in page coordinates
+ * @param size the size of the returned image (the region's size if empty)
+ * @return QImage the region or a null image if it cannot be decoded
+ **/
+QImage DkTiffPageReader::readRegion(int pageIdx, const QRect &region, const QSize &size)
+{
+    QImage img;
+
+#ifdef WITH_LIBTIFF
+    if (!mTiff || pageIdx < 1)
+        return img;
+
+    TIFFErrorHandler oldErrorHandler = TIFFSetErrorHandler(NULL);
+    TIFFErrorHandler oldWarningHandler = TIFFSetWarningHandler(NULL);
+
+    uint32 width = 0;
+    uint32 height = 0;
+    uint16 orientation = ORIENTATION_TOPLEFT;
+    uint32 unitWidth = 0;
+    uint32 unitHeight = 0;
+    bool tiled = false;
+
+    if (setPage(pageIdx)) {
+        TIFFGetField(mTiff, TIFFTAG_IMAGEWIDTH, &width);
+        TIFFGetField(mTiff, TIFFTAG_IMAGELENGTH, &height);
+        TIFFGetFieldDefaulted(mTiff, TIFFTAG_ORIENTATION, &orientation);
+
+        tiled = TIFFIsTiled(mTiff) != 0;
+
+        if (tiled) {
+            TIFFGetField(mTiff, TIFFTAG_TILEWIDTH, &unitWidth);
+            TIFFGetField(mTiff, TIFFTAG_TILELENGTH, &unitHeight);
+        } else {
+            unitWidth = width;
+            TIFFGetFieldDefaulted(mTiff, TIFFTAG_ROWSPERSTRIP, &unitHeight);
+            unitHeight = qMin(unitHeight, height);
+        }
+    }
+
+    QRect r = region.intersected(QRect(0, 0, (int)width, (int)height));
+    QSize dstSize = size.isEmpty() ? r.size() : size;
+
+    // we only read tiles of TOPLEFT images & we don't want to decode (single strip) images in one go
+    const qint64 maxUnitSize = 64 * 1024 * 1024;
+    bool valid = !r.isEmpty() && unitWidth > 0 && unitHeight > 0 && orientation == ORIENTATION_TOPLEFT
+        && (qint64)unitWidth * unitHeight * 4 < maxUnitSize;
+
+    if (valid) {
+        img = QImage(dstSize, QImage::Format_ARGB32_Premultiplied);
+        valid = !img.isNull();
+    }
+
+    if (valid) {
+        DkTimer dt;
+
+        double sy = (double)dstSize.height() / r.height();
+        QVector<uint32> raster(unitWidth * unitHeight);
+        QPoint rasterUnit(-1, -1); // the tile (strip) that is currently decoded in raster
+
+        // a band holds the source rows of ~64 output rows - but never more than maxBandPixels
+        const qint64 maxBandPixels = 16 * 1024 * 1024;
+        int bandHeight = qMin(qMax(qCeil(64.0 / sy), 1), r.height());
+        bandHeight = (int)qMax(qMin((qint64)bandHeight, maxBandPixels / r.width()), (qint64)1);
+
+        // horizontally scaled bands that do not make up an output row yet
+        QImage pending;
+        int pendingTop = r.top();
+
+        QPainter painter(&img);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+
+        for (int top = r.top(); valid && top <= r.bottom(); top += bandHeight) {
+            int bottom = qMin(top + bandHeight, r.bottom() + 1);
+
+            QImage band(r.width(), bottom - top, QImage::Format_ARGB32_Premultiplied);
+            band.fill(Qt::transparent);
+
+            for (int uy = (top / unitHeight) * unitHeight; valid && uy < bottom; uy += unitHeight) {
+                int firstCol = tiled ? (r.left() / unitWidth) * unitWidth : 0;
+
+                for (int ux = firstCol; ux <= r.right(); ux += unitWidth) {
+                    // RGBA tiles/strips are stored bottom-up
+                    int rows = tiled ? unitHeight : qMin((int)unitHeight, (int)height - uy);
+
+                    // bands can be thinner than tiles (strips) - don't decode them twice in a row
+                    if (rasterUnit != QPoint(ux, uy)) {
+                        if (tiled)
+                            valid = TIFFReadRGBATile(mTiff, ux, uy, raster.data()) != 0;
+                        else
+                            valid = TIFFReadRGBAStrip(mTiff, uy, raster.data()) != 0;
+
+                        if (!valid)
+                            break;
+
+                        rasterUnit = QPoint(ux, uy);
+                    }
+
+                    int x0 = qMax(ux, r.left());
+                    int x1 = qMin(ux + (int)unitWidth, r.right() + 1);
+
+                    for (int y = qMax(uy, top); y < qMin(uy + rows, bottom); y++) {
+                        const uint32 *src = raster.constData() + (rows - 1 - (y - uy)) * unitWidth + (x0 - ux);
+                        uint32 *dst = reinterpret_cast<uint32 *>(band.scanLine(y - top)) + (x0 - r.left());
+
+                        // code from Qt QTiffHandler - convert between ABGR and ARGB
+                        for (int x = x0; x < x1; x++, src++, dst++)
+                            *dst = (*src & 0xff00ff00) | ((*src & 0x00ff0000) >> 16) | ((*src & 0x000000ff) << 16);
+                    }
+                }
+            }
+
+            if (!valid)
+                break;
+
+            if (band.width() != dstSize.width())
+                band = band.scaled(dstSize.width(), band.height(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+            if (pending.isNull())
+                pending = band;
+            else {
+                QImage merged(dstSize.width(), pending.height() + band.height(), QImage::Format_ARGB32_Premultiplied);
+                QPainter p(&merged);
+                p.setCompositionMode(QPainter::CompositionMode_Source);
+                p.drawImage(QPoint(0, 0), pending);
+                p.drawImage(QPoint(0, pending.height()), band);
+                p.end();
+                pending = merged;
+            }
+
+            int dy0 = qRound((pendingTop - r.top()) * sy);
+            int dy1 = qRound((bottom - r.top()) * sy);
+
+            if (dy1 > dy0) {
+                if (pending.height() != dy1 - dy0)
+                    pending = pending.scaled(dstSize.width(), dy1 - dy0, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+                painter.drawImage(QPoint(0, dy0), pending);
+                pending = QImage();
+                pendingTop = bottom;
+            }
+        }
+
+        painter.end();
+
+        if (valid)
+            qDebug() << "[DkTiffPageReader]" << r << "->" << dstSize << "decoded in" << dt;
+        else
+            img = QImage();
+    }
+
+    TIFFSetErrorHandler(oldErrorHandler);
+    TIFFSetWarningHandler(oldWarningHandler);
+#else
+    Q_UNUSED(pageIdx);
+    Q_UNUSED(region);
+    Q_UNUSED(size);
+#endif
+
+    return img;
+}
+
+/**
+ * Returns the size of a page.
+ * @param pageIdx the page index (starting with 1)
+ * @return QSize the page's size or an empty size if the page does not exist
+ **/
+QSize DkTiffPageReader::pageSize(int pageIdx)
+{
+    QSize size;
+
+#ifdef WITH_LIBTIFF
+    if (!mTiff || pageIdx < 1)
+        return size;
+
+    TIFFErrorHandler oldErrorHandler = TIFFSetErrorHandler(NULL);
+    TIFFErrorHandler oldWarningHandler = TIFFSetWarningHandler(NULL);
+
+    if (setPage(pageIdx)) {
+        uint32 width = 0;
+        uint32 height = 0;
+        TIFFGetField(mTiff, TIFFTAG_IMAGEWIDTH, &width);
+        TIFFGetField(mTiff, TIFFTAG_IMAGELENGTH, &height);
+        size = QSize(width, height);
+    }
+
+    TIFFSetErrorHandler(oldErrorHandler);
+    TIFFSetWarningHandler(oldWarningHandler);
+#else
+    Q_UNUSED(pageIdx);
+#endif
+
+    return size;
+}
+
+/**
+ * Finds the smallest reduced resolution page (pyramid level) that is at least minSize.
+ * @param minSize the minimal size needed
+ * @return int the page index (starting with 1) or 0 if there is no such page
+ **/
+int DkTiffPageReader::reducedPage(const QSize &minSize)
+{
+    int bestIdx = 0;
+
+#ifdef WITH_LIBTIFF
+    if (!mTiff)
+        return bestIdx;
+
+    TIFFErrorHandler oldErrorHandler = TIFFSetErrorHandler(NULL);
+    TIFFErrorHandler oldWarningHandler = TIFFSetWarningHandler(NULL);
+
+    qint64 bestArea = -1;
+
+    for (int idx = 2; setPage(idx); idx++) {
+        uint32 type = 0;
+        uint32 width = 0;
+        uint32 height = 0;
+        TIFFGetFieldDefaulted(mTiff, TIFFTAG_SUBFILETYPE, &type);
+        TIFFGetField(mTiff, TIFFTAG_IMAGEWIDTH, &width);
+        TIFFGetField(mTiff, TIFFTAG_IMAGELENGTH, &height);
+
+        qint64 area = (qint64)width * height;
+
+        if ((type & FILETYPE_REDUCEDIMAGE) && (int)width >= minSize.width() && (int)height >= minSize.height()
+            && (bestArea == -1 || area < bestArea)) {
+            bestIdx = idx;
+            bestArea = area;
+        }
+    }
+
+    TIFFSetErrorHandler(oldErrorHandler);
+    TIFFSetWarningHandler(oldWarningHandler);
+#else
+    Q_UNUSED(minSize);
+#endif
+
+    return bestIdx;
+}
+
+/**
+ * Moves to a page (directory) of the TIFF.
+ * Error handlers need to be disabled by the caller.
+ * @param pageIdx the page index (starting with 1)
+ * @return bool true if the page exists
+ **/
+bool DkTiffPageReader::setPage(int pageIdx)
+{
+#ifdef WITH_LIBTIFF
+    bool found = true;
+
+    if (pageIdx < mPageIdx || mPageIdx == 0) {
+        found = TIFFSetDirectory(mTiff, pageIdx - 1) != 0;
+        mPageIdx = found ? pageIdx : 0;
+    }
+
+    while (found && mPageIdx < pageIdx) {
+        found = TIFFReadDirectory(mTiff) != 0;
+        mPageIdx++;
+    }
+
+    if (!found)
+        mPageIdx = 0; // we are lost - the next read starts over
+
+    return found;
+#else
+    Q_UNUSED(pageIdx);
+    return false;
+#endif
+}
+
+// DkRegionLoader --------------------------------------------------------------------
+DkRegionLoader::DkRegionLoader(const QString &filePath)
+{
+    mFilePath = filePath;
+
+    if (filePath.isEmpty())
+        return;
+
+    QImageReader reader(filePath);
+    mIsTiff = reader.format() == "tiff" || QFileInfo(filePath).suffix().contains(QRegExp("(tif|tiff)", Qt::CaseInsensitive));
+
+    if (mIsTiff) {
+        DkTiffPageReader tiffReader;
+        if (tiffReader.open(filePath))
+            mSize = tiffReader.pageSize(1);
+
+        mIsValid = !mSize.isEmpty();
+    } else {
+        // Qt emulates clipping for other formats by decoding the full image
+        mSize = reader.size();
+        mIsValid = !mSize.isEmpty() && reader.supportsOption(QImageIOHandler::ClipRect);
+    }
+}
+
+bool DkRegionLoader::isValid() const
+{
+    return mIsValid;
+}
+
+QString DkRegionLoader::filePath() const
+{
+    return mFilePath;
+}
+
+QSize DkRegionLoader::size() const
+{
+    return mSize;
+}
+
+/**
+ * Decodes a region of the image.
+ * @param region the region in file coordinates (Exif orientation not applied)
+ * @param size the size of the decoded region (the region's size if empty)
+ * @param orientation is applied to the decoded region
+ * @return QImage the region or a null image if it cannot be decoded
+ **/
+QImage DkRegionLoader::read(const QRect &region, const QSize &size, DkJpgTransform::Transform orientation) const
+{
+    DkTraceScope ts("readRegion", DkTraceLog::cat_decode, mFilePath);
+
+    QImage img;
+    QRect r = region.intersected(QRect(QPoint(), mSize));
+
+    if (!mIsValid || r.isEmpty())
+        return img;
+
+    if (mIsTiff) {
+        DkTiffPageReader reader;
+
+        if (reader.open(mFilePath))
+            img = reader.readRegion(1, r, size);
+    } else {
+        QImageReader reader(mFilePath);
+        reader.setClipRect(r);
+
+        if (!size.isEmpty())
+            reader.setScaledSize(size);
+
+        reader.read(&img);
+    }
+
+    return DkJpgTransform::apply(img, orientation);
+}
+
+/**
+ * Returns true if images of size should not be decoded with full resolution.
+ * Such images need more than 1 GB if decoded (ARGB32).
+ * @param size the image size
+ * @return bool true if the image is huge
+ **/
+bool DkRegionLoader::isHuge(const QSize &size)
+{
+    return (qint64)size.width() * size.height() > 256 * 1024 * 1024;
+}
+
+/**
+ * Returns the image size as stored in the file's header.
+ * Other than the constructor, this does not open the file if it is already buffered.
+ * @param filePath the image file
+ * @param ba the file buffer (optional)
+ * @return QSize the image size or an empty size if it is unknown
+ **/
+QSize DkRegionLoader::imageSize(const QString &filePath, const QSharedPointer<QByteArray> ba)
+{
+    if (ba && !ba->isEmpty()) {
+        QBuffer buffer(ba.data());
+        buffer.open(QIODevice::ReadOnly);
+
+        QImageReader reader(&buffer, QFileInfo(filePath).suffix().toLatin1());
+        reader.setDecideFormatFromContent(true);
+
+        return reader.size();
+    }
+
+    QImageReader reader(filePath);
+    return reader.size();
+}
+
 // FileDownloader --------------------------------------------------------------------
 FileDownloader::FileDownloader(const QUrl &imageUrl, const QString &filePath, QObject *parent)
     : QObject(parent)
@@ -2483,7 +3564,7 @@ bool DkTgaLoader::load(QSharedPointer<QByteArray> ba)
     // thanks!
     Header header;
 
-    const char *dataC = ba->data();
+    const char *dataC = ba->constData(); // don't detach (mapped) buffers
 
     /* Display the header fields */
     header.idlength = *dataC;
@@ -29,14 +29,19 @@
 
 #pragma warning(push, 0)
 #include <QFutureWatcher>
+#include <QHash>
 #include <QImage>
+#include <QMutex>
 #include <QNetworkAccessManager>
+#include <QSet>
 #include <QSharedPointer>
 #include <QUrl>
+#include <iosfwd>
 #pragma warning(pop)
 
 #pragma warning(disable : 4251) // TODO: remove
 //#include "DkImageStorage.h"
+#include "DkJpgTransform.h"
 
 #ifndef Q_OS_WIN
 #include "qpsdhandler.h"
@@ -63,8 +68,11 @@
 #endif
 
 // Qt defines
+class QIODevice;
+class QMutex;
 class QNetworkReply;
 class LibRaw;
+struct tiff;
 
 namespace nmc
 {
@@ -114,12 +122,25 @@ public:
     QSharedPointer<DkMetaDataT> metaData() const;
     int size() const;
 
+    void setTransform(DkJpgTransform::Transform transform);
+    DkJpgTransform::Transform transform() const;
+
+    void setOrientation(DkJpgTransform::Transform orientation);
+    QImage rawImage(DkJpgTransform::Transform *orientation) const;
+
 protected:
     QString mEditName;
-    QImage mImg;
+    mutable QImage mImg;
     bool mNewImg;
     bool mNewMetaData;
     QSharedPointer<DkMetaDataT> mMetaData;
+
+    // Exif orientation that is not yet applied to mImg - the pixels are rotated once someone needs them upright
+    mutable DkJpgTransform::Transform mOrientation = DkJpgTransform::transform_identity;
+    QSharedPointer<QMutex> mOrientationMutex;
+
+    // maps the pixels of the original jpg to this image (if it is a lossless transform)
+    DkJpgTransform::Transform mTransform = DkJpgTransform::transform_invalid;
 };
 
 class DllCoreExport DkRawLoader
@@ -193,6 +214,63 @@ protected:
 #endif
 };
 
+/**
+ * Maps file contents to the decoders that can read them.
+ * Formats are identified by their magic bytes, the suffix is just a hint for
+ * files without signature (e.g. TGA, ROH, VEC) or with an ambiguous one (TIFF based RAWs).
+ * The registry is built once and remembers which decoder succeeded for a file,
+ * so that reloading it does not pay for failing decoders again.
+ * All public functions are thread-safe.
+ **/
+class DllCoreExport DkDecoderRegistry
+{
+public:
+    enum Decoder {
+        decoder_drif = 0,
+        decoder_ico,
+        decoder_tif_reduced,
+        decoder_qt,
+        decoder_tif,
+        decoder_psd,
+        decoder_raw,
+        decoder_tga,
+        decoder_qt_buffer,
+        decoder_samsung,
+        decoder_roh,
+        decoder_vec,
+
+        decoder_end
+    };
+
+    static DkDecoderRegistry &instance();
+
+    QString sniff(const QByteArray &header) const;
+    QVector<Decoder> decoders(const QString &format, const QString &suffix, const QString &filePath = QString()) const;
+    void setDecoded(const QString &filePath, Decoder decoder);
+
+    bool isQtFormat(const QString &format) const;
+
+    static QByteArray readHeader(const QString &filePath, const QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
+
+private:
+    DkDecoderRegistry();
+    DkDecoderRegistry(const DkDecoderRegistry &);
+
+    void addSignature(const QString &format, const char *magic, const char *mask = 0);
+
+    struct Signature {
+        QByteArray magic;
+        QByteArray mask; // 0x00 bytes are not compared
+        QString format;
+    };
+
+    QVector<Signature> mSignatures;
+    QSet<QString> mQtFormats;
+
+    mutable QMutex mMutex;
+    QHash<QString, Decoder> mDecoded; // file path -> decoder that succeeded
+};
+
 /**
  * This class provides image loading and editing capabilities.
  * It additionally stores the currently loaded image.
@@ -259,6 +337,7 @@ public:
 
     QString save(const QString &filePath, const QImage &img, int compression = -1);
     bool saveToBuffer(const QString &filePath, const QImage &img, QSharedPointer<QByteArray> &ba, int compression = -1) const;
+    bool saveToFile(const QString &filePath, const QImage &img, int compression = -1) const;
     void saveThumbToMetaData(const QString &filePath, QSharedPointer<QByteArray> &ba);
     void saveMetaData(const QString &filePath, QSharedPointer<QByteArray> &ba);
     void saveThumbToMetaData(const QString &filePath);
@@ -273,7 +352,7 @@ public:
      **/
     void setImage(const QImage &img, const QString &editName, const QString &file);
     void pruneEditHistory();
-    void setEditImage(const QImage &img, const QString &editName = "");
+    void setEditImage(const QImage &img, const QString &editName = "", DkJpgTransform::Transform transform = DkJpgTransform::transform_invalid);
     void setEditMetaData(const QSharedPointer<DkMetaDataT> &metaData, const QImage &img, const QString &editName = "");
     void setEditMetaData(const QSharedPointer<DkMetaDataT> &metaData, const QString &editName = "");
     void setEditMetaData(const QString &editName);
@@ -294,6 +373,7 @@ public:
     };
 
     QSharedPointer<DkMetaDataT> getMetaData() const;
+    void setMetaData(QSharedPointer<DkMetaDataT> metaData);
 
     /**
      * Returns the 8-bit image, which is rendered.
@@ -301,6 +381,9 @@ public:
      **/
     QImage image() const;
     QImage lastImage() const;
+    QImage rawPixmap(DkJpgTransform::Transform *orientation) const;
+    QSize pixmapSize() const;
+    DkJpgTransform::Transform lastTransform() const;
     QImage pixmap() const;
 
     QSharedPointer<DkMetaDataT> lastMetaDataEdit(bool return_nullptr = true, bool return_orig = false) const;
@@ -324,7 +407,7 @@ public:
      **/
     QSize size()
     {
-        return image().size();
+        return pixmapSize();
     };
 
     /**
@@ -333,7 +416,7 @@ public:
      **/
     bool hasImage()
     {
-        return !image().isNull();
+        return !rawPixmap(0).isNull();
     };
 
     void undo();
@@ -342,12 +425,18 @@ public:
     DkEditImage lastEdit() const;
 
     void setMinHistorySize(int size);
+
+    void setMinDecodeSize(const QSize &size);
+    void setHugeImageDecodeSize(const QSize &size);
+    double decodeScale() const;
     void setHistoryIndex(int idx);
     int historyIndex() const;
 
     void loadFileToBuffer(const QString &filePath, QByteArray &ba) const;
     QSharedPointer<QByteArray> loadFileToBuffer(const QString &filePath) const;
     bool writeBufferToFile(const QString &fileInfo, const QSharedPointer<QByteArray> ba) const;
+    bool writeImage(QIODevice *device, const QString &suffix, const QImage &img, int compression = -1) const;
+    bool writeLossless(QIODevice *device, const QString &filePath, const QImage &img) const;
 
     void release();
 
@@ -401,9 +490,18 @@ signals:
     void resetMetaDataSignal();
 
 protected:
+    bool decode(DkDecoderRegistry::Decoder decoder,
+                const QString &format,
+                const QSize &minSize,
+                QImage &img,
+                QSharedPointer<QByteArray> ba,
+                QByteArray &lba,
+                bool fast);
     bool loadRohFile(const QString &filePath, QImage &img, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>()) const;
     bool loadTgaFile(const QString &filePath, QImage &img, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>()) const;
     bool loadRawFile(const QString &filePath, QImage &img, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>(), bool fast = false) const;
+    bool loadReducedQt(const QString &filePath, QImage &img, const QString &suffix, const QSize &minSize, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
+    bool loadReducedTiff(const QString &filePath, QImage &img, const QSize &minSize);
     void indexPages(const QString &filePath, const QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
     void convert32BitOrder(void *buffer, int width) const;
 
@@ -419,6 +517,73 @@ protected:
     QVector<DkEditImage> mImages;
     int mMinHistorySize = 2;
     int mImageIndex = 0;
+
+    // decoders that can downscale while decoding (e.g. jpg) are asked for reduced images
+    QSize mMinDecodeSize;
+    QSize mHugeDecodeSize; // same as mMinDecodeSize - but only for huge images
+    double mDecodeScale = 1.0;
+};
+
+/**
+ * Reads the pages of a multi-page TIFF from one open handle.
+ * Other than DkBasicLoader::loadPageAt(), which walks all directories
+ * from the first page, reading consecutive pages costs one directory read each.
+ * The reader is not thread-safe - decode on one thread, encode on many.
+ **/
+class DllCoreExport DkTiffPageReader
+{
+public:
+    DkTiffPageReader();
+    ~DkTiffPageReader();
+
+    bool open(const QString &filePath);
+    void close();
+    bool isOpen() const;
+
+    QImage readPage(int pageIdx);
+    QImage readRegion(int pageIdx, const QRect &region, const QSize &size = QSize());
+    QSize pageSize(int pageIdx);
+    int reducedPage(const QSize &minSize);
+
+protected:
+    Q_DISABLE_COPY(DkTiffPageReader)
+
+    bool setPage(int pageIdx);
+
+    struct tiff *mTiff = 0;
+    int mPageIdx = 0; // 1-based like DkBasicLoader
+
+    // on Windows, non-latin file names are read from a stream
+    QSharedPointer<std::istringstream> mStream;
+};
+
+/**
+ * Decodes regions of images that are too large to be kept in memory.
+ * JPGs are clipped by the decoder, tiled or stripped TIFFs
+ * only decode the tiles (strips) that intersect the region.
+ * read() is thread-safe: each call opens the file on its own.
+ **/
+class DllCoreExport DkRegionLoader
+{
+public:
+    DkRegionLoader(const QString &filePath = QString());
+
+    bool isValid() const;
+    QString filePath() const;
+    QSize size() const;
+
+    QImage read(const QRect &region,
+                const QSize &size = QSize(),
+                DkJpgTransform::Transform orientation = DkJpgTransform::transform_identity) const;
+
+    static bool isHuge(const QSize &size);
+    static QSize imageSize(const QString &filePath, const QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
+
+protected:
+    QString mFilePath;
+    QSize mSize; // as stored in the file (Exif orientation is not applied)
+    bool mIsTiff = false;
+    bool mIsValid = false;
 };
 
 namespace tga
@@ -0,0 +1,670 @@
+/*******************************************************************************************************
+ DkExifReader.cpp
+ Created on:	19.10.2026
+
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+
+ Copyright (C) 2011-2026 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2026 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2026 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkExifReader.h"
+#include "DkMetaData.h"
+#include "DkTimer.h"
+
+#pragma warning(push, 0) // no warnings from includes - begin
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+
+#include <cstring>
+#pragma warning(pop) // no warnings from includes - end
+
+namespace nmc
+{
+
+// TIFF tags we are interested in
+namespace
+{
+enum ExifTag {
+    tag_jpg_from_raw = 0x002e, // Panasonic RW2
+    tag_subfile_type = 0x00fe,
+    tag_width = 0x0100,
+    tag_height = 0x0101,
+    tag_compression = 0x0103,
+    tag_strip_offsets = 0x0111,
+    tag_strip_byte_counts = 0x0117,
+    tag_sub_ifds = 0x014a,
+    tag_orientation = 0x0112,
+    tag_thumb_offset = 0x0201,
+    tag_thumb_length = 0x0202,
+    tag_xmp = 0x02bc,
+    tag_rating = 0x4746,
+    tag_exif_ifd = 0x8769,
+    tag_date_time_original = 0x9003,
+    tag_pixel_x = 0xa002,
+    tag_pixel_y = 0xa003,
+};
+
+enum ExifType {
+    type_byte = 1,
+    type_ascii = 2,
+    type_short = 3,
+    type_long = 4,
+    type_undefined = 7,
+};
+
+enum IfdIndex {
+    ifd_0 = 0,
+    ifd_1,
+    ifd_exif,
+    ifd_sub,
+};
+
+enum Compression {
+    compression_old_jpg = 6,
+    compression_jpg = 7,
+};
+
+const int maxIfdEntries = 1000; // protects us from corrupted files
+const qint64 maxFallbackRead = 256 * 1024; // if the file cannot be mapped
+const int maxPages = 64; // number of IFDs we follow in TIFF files
+const quint32 maxSubIfds = 16;
+}
+
+// DkExifReader --------------------------------------------------------------------
+DkExifReader::DkExifReader()
+{
+}
+
+/**
+ * Parses the Exif data of filePath.
+ * If ba is set, the buffer is parsed, otherwise the file is mapped.
+ * @param filePath the file path
+ * @param ba the (optional) file buffer
+ * @return bool false if the container is not supported (use Exiv2 then)
+ **/
+bool DkExifReader::read(const QString &filePath, QSharedPointer<QByteArray> ba)
+{
+    DkTraceScope ts("readExifFast", DkTraceLog::cat_metadata, filePath);
+
+    clear();
+
+    if (ba && !ba->isEmpty()) {
+        mBuffer = ba;
+        mData = reinterpret_cast<const uchar *>(ba->constData());
+        mSize = ba->size();
+    } else if (!mapFile(filePath))
+        return false;
+
+    mIsRaw = DkMetaDataT::isRaw(filePath);
+
+    if (mSize < 12)
+        return false;
+
+    if (mData[0] == 0xff && mData[1] == 0xd8) {
+        if (parseJpg()) {
+            mContainer = container_jpg;
+            return true;
+        }
+    } else if (parseTiff(0, mSize)) {
+        mContainer = container_tiff;
+        return true;
+    }
+
+    clear();
+    return false;
+}
+
+void DkExifReader::clear()
+{
+    mBuffer.clear();
+    mFile.clear();
+    mData = 0;
+    mSize = 0;
+
+    mContainer = container_unknown;
+    mBigEndian = false;
+    mOrientation = 0;
+    mExifRating = -1;
+    mXmpRating = -1;
+    mDateTimeOriginal.clear();
+    mExifSize = QSize();
+    mSofSize = QSize();
+    mThumbOffset = -1;
+    mThumbLength = 0;
+    mIsRaw = false;
+    mPreviews.clear();
+}
+
+bool DkExifReader::isValid() const
+{
+    return mContainer != container_unknown;
+}
+
+DkExifReader::Container DkExifReader::container() const
+{
+    return mContainer;
+}
+
+/**
+ * Returns the raw Exif orientation.
+ * @return int 1-8 or 0 if the orientation is not set
+ **/
+int DkExifReader::orientation() const
+{
+    return mOrientation;
+}
+
+/**
+ * Returns the orientation in degrees.
+ * The mapping is the same as DkMetaDataT::getOrientationDegree().
+ * @return int the rotation angle, 0 if not set and -1 if illegal
+ **/
+int DkExifReader::orientationDegree() const
+{
+    if (mOrientation == 0)
+        return 0;
+
+    return DkMetaDataT::orientationToDegree(mOrientation);
+}
+
+/**
+ * Returns the rating.
+ * Like DkMetaDataT::getRating() the Exif rating is preferred
+ * and the XMP rating (xmp or MicrosoftPhoto) is used if
+ * there is no Exif rating.
+ * @return int the rating (-1 if there is none)
+ **/
+int DkExifReader::rating() const
+{
+    if (mExifRating == -1)
+        return mXmpRating;
+
+    return mExifRating;
+}
+
+/**
+ * Returns Exif.Photo.DateTimeOriginal.
+ * @return QString the date as stored (e.g. 2013:04:19 12:00:00)
+ **/
+QString DkExifReader::dateTimeOriginal() const
+{
+    return mDateTimeOriginal;
+}
+
+/**
+ * Returns the image size.
+ * Exif.Photo.PixelX/YDimension are used - for JPGs
+ * without these tags the frame header is used.
+ * @return QSize the image size or an empty size
+ **/
+QSize DkExifReader::imageSize() const
+{
+    if (!mExifSize.isEmpty())
+        return mExifSize;
+
+    return mSofSize;
+}
+
+bool DkExifReader::hasThumbnail() const
+{
+    return mThumbOffset >= 0 && mThumbLength > 0;
+}
+
+/**
+ * Returns the embedded JPG thumbnail (IFD1).
+ * The data is not copied - the array is only
+ * valid as long as this reader lives.
+ * @return QByteArray the compressed thumbnail
+ **/
+QByteArray DkExifReader::thumbnailData() const
+{
+    if (!hasThumbnail())
+        return QByteArray();
+
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(mData + mThumbOffset), (int)mThumbLength);
+}
+
+QImage DkExifReader::thumbnail() const
+{
+    QImage thumb;
+
+    if (hasThumbnail())
+        thumb.loadFromData(thumbnailData(), "jpg");
+
+    return thumb;
+}
+
+/**
+ * Returns all embedded previews of TIFF based files.
+ * These are JPG previews (e.g. of RAW files) and reduced resolution pages.
+ * @return QVector<DkExifReader::Preview> the previews (not sorted)
+ **/
+QVector<DkExifReader::Preview> DkExifReader::previews() const
+{
+    return mPreviews;
+}
+
+/**
+ * Returns the JPG stream of a preview.
+ * The data is not copied - the array is only
+ * valid as long as this reader lives.
+ * @param preview a preview returned by previews()
+ * @return QByteArray the compressed preview (empty for TIFF pages)
+ **/
+QByteArray DkExifReader::previewData(const Preview &preview) const
+{
+    if (preview.offset < 0 || preview.offset + preview.length > mSize)
+        return QByteArray();
+
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(mData + preview.offset), (int)preview.length);
+}
+
+bool DkExifReader::mapFile(const QString &filePath)
+{
+    QFileInfo fi(filePath);
+    mFile = QSharedPointer<QFile>(new QFile(fi.isSymLink() ? fi.symLinkTarget() : filePath));
+
+    if (!mFile->open(QIODevice::ReadOnly)) {
+        mFile.clear();
+        return false;
+    }
+
+    mSize = mFile->size();
+    mData = mFile->map(0, mSize);
+
+    // e.g. network shares - read the head which contains the APP1 of JPGs
+    if (!mData) {
+        mBuffer = QSharedPointer<QByteArray>(new QByteArray(mFile->read(maxFallbackRead)));
+        mFile.clear();
+        mData = reinterpret_cast<const uchar *>(mBuffer->constData());
+        mSize = mBuffer->size();
+    }
+
+    return mData != 0;
+}
+
+bool DkExifReader::parseJpg()
+{
+    qint64 pos = 2;
+    bool exifFound = false;
+
+    while (pos + 4 <= mSize) {
+        if (mData[pos] != 0xff)
+            return exifFound || !mSofSize.isEmpty(); // corrupted - but keep what we have
+
+        uchar marker = mData[pos + 1];
+
+        // fill bytes
+        if (marker == 0xff) {
+            pos++;
+            continue;
+        }
+
+        // markers without a payload
+        if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)) {
+            pos += 2;
+            continue;
+        }
+
+        // start of scan or end of image - no metadata after this point
+        if (marker == 0xda || marker == 0xd9)
+            break;
+
+        // the length is always big endian
+        qint64 length = (mData[pos + 2] << 8) | mData[pos + 3];
+        const uchar *segment = mData + pos + 4;
+        qint64 segmentSize = length - 2;
+
+        if (length < 2 || pos + 2 + length > mSize)
+            break;
+
+        if (marker == 0xe1 && segmentSize > 14 && memcmp(segment, "Exif\0\0", 6) == 0 && !exifFound) {
+            exifFound = parseTiff(pos + 10, segmentSize - 6);
+        } else if (marker == 0xe1 && segmentSize > 29 && memcmp(segment, "http://ns.adobe.com/xap/1.0/", 29) == 0) {
+            parseXmp(segment + 29, segmentSize - 29);
+        } else if (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc && segmentSize >= 5) {
+            // start of frame: precision, height, width
+            int height = (segment[1] << 8) | segment[2];
+            int width = (segment[3] << 8) | segment[4];
+            mSofSize = QSize(width, height);
+        }
+
+        pos += 2 + length;
+    }
+
+    return true;
+}
+
+bool DkExifReader::parseTiff(qint64 base, qint64 size)
+{
+    if (size < 8 || base + size > mSize)
+        return false;
+
+    const uchar *tiff = mData + base;
+
+    if (tiff[0] == 'I' && tiff[1] == 'I')
+        mBigEndian = false;
+    else if (tiff[0] == 'M' && tiff[1] == 'M')
+        mBigEndian = true;
+    else
+        return false;
+
+    // 42 is TIFF, 0x55 is Panasonic RW2, ORF uses RO and RS
+    quint16 magic = readShort(tiff + 2);
+    if (magic != 42 && magic != 0x55 && magic != 0x4f52 && magic != 0x5352)
+        return false;
+
+    quint32 ifd0 = readLong(tiff + 4);
+    parseIfd(base, size, ifd0, ifd_0);
+
+    return true;
+}
+
+void DkExifReader::parseIfd(qint64 base, qint64 size, quint32 offset, int ifdIdx, int page)
+{
+    if (offset < 8 || (qint64)offset + 2 > size)
+        return;
+
+    const uchar *tiff = mData + base;
+    int numEntries = readShort(tiff + offset);
+
+    if (numEntries > maxIfdEntries || (qint64)offset + 2 + numEntries * 12 + 4 > size)
+        return;
+
+    quint32 thumbOffset = 0;
+    quint32 thumbLength = 0;
+
+    // previews are only indexed for TIFF files (the APP1 of JPGs is at base > 0)
+    bool tiffFile = base == 0;
+    quint32 subfileType = 0;
+    quint32 compression = 0;
+    QSize ifdSize;
+    quint32 stripOffset = 0;
+    quint32 stripLength = 0;
+
+    for (int idx = 0; idx < numEntries; idx++) {
+        const uchar *entry = tiff + offset + 2 + idx * 12;
+        quint16 tag = readShort(entry);
+        quint16 type = readShort(entry + 2);
+        quint32 count = readLong(entry + 4);
+
+        switch (tag) {
+        case tag_orientation:
+            if (ifdIdx == ifd_0)
+                mOrientation = entryValue(entry);
+            break;
+        case tag_rating:
+            if (ifdIdx == ifd_0)
+                mExifRating = entryValue(entry);
+            break;
+        case tag_exif_ifd:
+            if (ifdIdx == ifd_0)
+                parseIfd(base, size, entryValue(entry), ifd_exif);
+            break;
+        case tag_xmp: {
+            quint32 xmpOffset = count > 4 ? readLong(entry + 8) : 0;
+            if ((type == type_byte || type == type_undefined) && xmpOffset && (qint64)xmpOffset + count <= size)
+                parseXmp(tiff + xmpOffset, count);
+            break;
+        }
+        case tag_thumb_offset:
+            thumbOffset = entryValue(entry);
+            break;
+        case tag_thumb_length:
+            thumbLength = entryValue(entry);
+            break;
+        case tag_date_time_original: {
+            quint32 dateOffset = count > 4 ? readLong(entry + 8) : 0;
+            if (ifdIdx == ifd_exif && type == type_ascii && dateOffset && (qint64)dateOffset + count <= size)
+                mDateTimeOriginal = QString::fromLatin1(reinterpret_cast<const char *>(tiff + dateOffset), (int)qstrnlen(reinterpret_cast<const char *>(tiff + dateOffset), count));
+            break;
+        }
+        case tag_pixel_x:
+            if (ifdIdx == ifd_exif)
+                mExifSize.setWidth(entryValue(entry));
+            break;
+        case tag_pixel_y:
+            if (ifdIdx == ifd_exif)
+                mExifSize.setHeight(entryValue(entry));
+            break;
+        case tag_subfile_type:
+            subfileType = entryValue(entry);
+            break;
+        case tag_width:
+            ifdSize.setWidth(entryValue(entry));
+            break;
+        case tag_height:
+            ifdSize.setHeight(entryValue(entry));
+            break;
+        case tag_compression:
+            compression = entryValue(entry);
+            break;
+        case tag_strip_offsets:
+            if (count == 1)
+                stripOffset = entryValue(entry);
+            break;
+        case tag_strip_byte_counts:
+            if (count == 1)
+                stripLength = entryValue(entry);
+            break;
+        case tag_jpg_from_raw:
+            if (tiffFile && type == type_undefined && count > 4)
+                addJpgPreview(readLong(entry + 8), count);
+            break;
+        case tag_sub_ifds:
+            if (tiffFile && ifdIdx != ifd_sub && ifdIdx != ifd_exif && count <= maxSubIfds) {
+                quint32 subOffset = count > 1 ? readLong(entry + 8) : 0;
+
+                for (quint32 sIdx = 0; sIdx < count; sIdx++) {
+                    if (count == 1)
+                        parseIfd(base, size, entryValue(entry), ifd_sub, -1);
+                    else if ((qint64)subOffset + 4 * (sIdx + 1) <= size)
+                        parseIfd(base, size, readLong(tiff + subOffset + 4 * sIdx), ifd_sub, -1);
+                }
+            }
+            break;
+        }
+    }
+
+    // the Exif thumbnail lives in IFD1 (that's what Exiv2 calls Exif.Thumbnail)
+    if (ifdIdx == ifd_1 && page == 1 && thumbOffset && thumbLength && (qint64)thumbOffset + thumbLength <= size) {
+        const uchar *thumb = tiff + thumbOffset;
+
+        if (thumbLength > 2 && thumb[0] == 0xff && thumb[1] == 0xd8) {
+            mThumbOffset = base + thumbOffset;
+            mThumbLength = thumbLength;
+        }
+    }
+
+    if (tiffFile) {
+        bool reduced = (subfileType & 1) != 0;
+
+        if (thumbOffset && thumbLength)
+            addJpgPreview(thumbOffset, thumbLength);
+
+        // RAW files store their previews as JPG strips (e.g. IFD0 of CR2, SubIFDs of NEF, DNG)
+        if ((compression == compression_jpg || compression == compression_old_jpg) && stripOffset && stripLength && (reduced || mIsRaw))
+            addJpgPreview(stripOffset, stripLength);
+        else if (reduced && page > 0 && !ifdSize.isEmpty()) {
+            Preview p;
+            p.size = ifdSize;
+            p.page = page;
+            mPreviews << p;
+        }
+    }
+
+    // TIFFs might have more than 2 IFDs (pages)
+    if (ifdIdx == ifd_0 || (tiffFile && ifdIdx == ifd_1 && page + 1 < maxPages)) {
+        quint32 next = readLong(tiff + offset + 2 + numEntries * 12);
+        if (next != offset)
+            parseIfd(base, size, next, ifd_1, page + 1);
+    }
+}
+
+/**
+ * Adds a JPG preview if the stream is a baseline or progressive JPG.
+ * Lossless JPGs (e.g. the raw data of CR2 files) are skipped.
+ * @param offset the stream offset (relative to the file start)
+ * @param length the stream length
+ **/
+void DkExifReader::addJpgPreview(qint64 offset, qint64 length)
+{
+    if (offset <= 0 || length <= 2 || offset + length > mSize)
+        return;
+
+    const uchar *jpg = mData + offset;
+
+    if (jpg[0] != 0xff || jpg[1] != 0xd8)
+        return;
+
+    for (const Preview &p : mPreviews) {
+        if (p.offset == offset)
+            return;
+    }
+
+    Preview p;
+    p.size = jpgSize(jpg, length);
+    p.offset = offset;
+    p.length = length;
+
+    if (!p.size.isEmpty())
+        mPreviews << p;
+}
+
+/**
+ * Returns the size of a baseline or progressive JPG.
+ * @param data the JPG stream
+ * @param size the stream size
+ * @return QSize the image size or an empty size (e.g. for lossless JPGs)
+ **/
+QSize DkExifReader::jpgSize(const uchar *data, qint64 size) const
+{
+    qint64 pos = 2;
+
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xff)
+            return QSize();
+
+        uchar marker = data[pos + 1];
+
+        if (marker == 0xff) {
+            pos++;
+            continue;
+        }
+
+        if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)) {
+            pos += 2;
+            continue;
+        }
+
+        if (marker == 0xda || marker == 0xd9)
+            return QSize();
+
+        qint64 length = (data[pos + 2] << 8) | data[pos + 3];
+
+        if (length < 2 || pos + 2 + length > size)
+            return QSize();
+
+        // baseline, extended & progressive - everything else is not supported by Qt
+        if (marker >= 0xc0 && marker <= 0xc2) {
+            if (length < 7)
+                return QSize();
+
+            const uchar *segment = data + pos + 4;
+            return QSize((segment[3] << 8) | segment[4], (segment[1] << 8) | segment[2]);
+        }
+
+        if (marker >= 0xc3 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc)
+            return QSize();
+
+        pos += 2 + length;
+    }
+
+    return QSize();
+}
+
+/**
+ * Finds the rating in an XMP packet.
+ * We do not parse the XML, we just look for
+ * xmp:Rating (attribute or element).
+ * @param data the XMP packet
+ * @param size the packet size
+ **/
+void DkExifReader::parseXmp(const uchar *data, qint64 size)
+{
+    QByteArray xmp = QByteArray::fromRawData(reinterpret_cast<const char *>(data), (int)size);
+
+    for (const char *key : {"xmp:Rating", "MicrosoftPhoto:Rating"}) {
+        int idx = xmp.indexOf(key);
+        if (idx == -1)
+            continue;
+
+        idx += (int)qstrlen(key);
+
+        // skip =" or >
+        while (idx < xmp.size() && (xmp[idx] == '=' || xmp[idx] == '"' || xmp[idx] == '\'' || xmp[idx] == '>' || xmp[idx] == ' '))
+            idx++;
+
+        int start = idx;
+        while (idx < xmp.size() && ((xmp[idx] >= '0' && xmp[idx] <= '9') || xmp[idx] == '-'))
+            idx++;
+
+        bool ok = false;
+        int rating = xmp.mid(start, idx - start).toInt(&ok);
+
+        if (ok) {
+            // MicrosoftPhoto stores percentages
+            mXmpRating = qstrcmp(key, "MicrosoftPhoto:Rating") == 0 ? DkMetaDataT::ratingFromPercent(rating) : rating;
+            return;
+        }
+    }
+}
+
+quint16 DkExifReader::readShort(const uchar *ptr) const
+{
+    return mBigEndian ? (quint16)((ptr[0] << 8) | ptr[1]) : (quint16)((ptr[1] << 8) | ptr[0]);
+}
+
+quint32 DkExifReader::readLong(const uchar *ptr) const
+{
+    if (mBigEndian)
+        return ((quint32)ptr[0] << 24) | ((quint32)ptr[1] << 16) | ((quint32)ptr[2] << 8) | ptr[3];
+
+    return ((quint32)ptr[3] << 24) | ((quint32)ptr[2] << 16) | ((quint32)ptr[1] << 8) | ptr[0];
+}
+
+/**
+ * Returns the first value of a SHORT or LONG entry.
+ * @param entry pointer to the 12 byte IFD entry
+ * @return quint32 the value
+ **/
+quint32 DkExifReader::entryValue(const uchar *entry) const
+{
+    quint16 type = readShort(entry + 2);
+
+    if (type == type_short)
+        return readShort(entry + 8);
+
+    return readLong(entry + 8);
+}
+
+}
@@ -0,0 +1,138 @@
+/*******************************************************************************************************
+ DkExifReader.h
+ Created on:	19.10.2026
+
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+
+ Copyright (C) 2011-2026 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2026 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2026 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0) // no warnings from includes - begin
+#include <QByteArray>
+#include <QImage>
+#include <QSharedPointer>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#pragma warning(pop) // no warnings from includes - end
+
+#ifndef DllCoreExport
+#ifdef DK_CORE_DLL_EXPORT
+#define DllCoreExport Q_DECL_EXPORT
+#elif DK_DLL_IMPORT
+#define DllCoreExport Q_DECL_IMPORT
+#else
+#define DllCoreExport Q_DECL_IMPORT
+#endif
+#endif
+
+class QFile;
+
+namespace nmc
+{
+
+/**
+ * Minimal read-only Exif parser.
+ * It walks the TIFF IFDs of JPEG (APP1) and TIFF based files (TIFF, DNG, CR2, NEF, ARW, ORF, RW2)
+ * and picks the few fields that are needed for thumbnails and sorting.
+ * For TIFF based files, embedded previews (JPG previews of RAWs, reduced resolution pages) are indexed too.
+ * Nothing is copied: files are memory mapped and the thumbnail is sliced from the buffer.
+ * Use DkMetaDataT (Exiv2) for everything else and whenever metadata is edited.
+ **/
+class DllCoreExport DkExifReader
+{
+public:
+    DkExifReader();
+
+    enum Container {
+        container_unknown = 0,
+        container_jpg,
+        container_tiff,
+
+        container_end
+    };
+
+    // an embedded preview is either a JPG stream or a (reduced resolution) TIFF page
+    struct Preview {
+        QSize size;
+        qint64 offset = -1; // JPG stream - relative to the file start
+        qint64 length = 0;
+        int page = -1; // TIFF directory index
+    };
+
+    bool read(const QString &filePath, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
+    void clear();
+
+    bool isValid() const;
+    Container container() const;
+
+    int orientation() const;
+    int orientationDegree() const;
+    int rating() const;
+    QString dateTimeOriginal() const;
+    QSize imageSize() const;
+
+    bool hasThumbnail() const;
+    QByteArray thumbnailData() const;
+    QImage thumbnail() const;
+
+    QVector<Preview> previews() const;
+    QByteArray previewData(const Preview &preview) const;
+
+protected:
+    bool mapFile(const QString &filePath);
+    bool parseJpg();
+    bool parseTiff(qint64 base, qint64 size);
+    void parseIfd(qint64 base, qint64 size, quint32 offset, int ifdIdx, int page = 0);
+    void addJpgPreview(qint64 offset, qint64 length);
+    QSize jpgSize(const uchar *data, qint64 size) const;
+    void parseXmp(const uchar *data, qint64 size);
+
+    quint16 readShort(const uchar *ptr) const;
+    quint32 readLong(const uchar *ptr) const;
+    quint32 entryValue(const uchar *entry) const;
+
+    // data source - we keep the owner alive as long as the reader lives
+    QSharedPointer<QByteArray> mBuffer;
+    QSharedPointer<QFile> mFile;
+    const uchar *mData = 0;
+    qint64 mSize = 0;
+
+    Container mContainer = container_unknown;
+    bool mBigEndian = false;
+
+    int mOrientation = 0;
+    int mExifRating = -1;
+    int mXmpRating = -1;
+    QString mDateTimeOriginal;
+    QSize mExifSize;
+    QSize mSofSize;
+
+    qint64 mThumbOffset = -1; // relative to mData
+    qint64 mThumbLength = 0;
+
+    bool mIsRaw = false;
+    QVector<Preview> mPreviews;
+};
+
+}
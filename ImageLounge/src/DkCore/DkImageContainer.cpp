@@ -27,6 +27,7 @@
 
 #include "DkImageContainer.h"
 #include "DkBasicLoader.h"
+#include "DkExifReader.h"
 #include "DkImageStorage.h"
 #include "DkMetaData.h"
 #include "DkSettings.h"
@@ -35,8 +36,10 @@
 #include "DkUtils.h"
 
 #pragma warning(push, 0) // no warnings from includes - begin
+#include <QGuiApplication>
 #include <QImage>
 #include <QObject>
+#include <QScreen>
 #include <QtConcurrentRun>
 
 // quazip
@@ -119,8 +122,7 @@ void DkImageContainer::clear()
 {
     if (mLoader)
         mLoader->release();
-    if (mFileBuffer)
-        mFileBuffer->clear();
+    mFileBuffer.clear(); // releases mapped files too
     init();
 }
 
@@ -281,7 +283,8 @@ float DkImageContainer::getMemoryUsage() const
         return 0;
 
     float memSize = mFileBuffer ? mFileBuffer->size() / (1024.0f * 1024.0f) : 0;
-    memSize += DkImage::getBufferSizeFloat(mLoader->image().size(), mLoader->image().depth());
+    QImage img = mLoader->rawPixmap(0);
+    memSize += DkImage::getBufferSizeFloat(img.size(), img.depth());
 
     return memSize;
 }
@@ -291,6 +294,53 @@ float DkImageContainer::getFileSize() const
     return QFileInfo(mFilePath).size() / (1024.0f * 1024.0f);
 }
 
+/**
+ * Returns Exif.Photo.DateTimeOriginal.
+ * If the metadata is not loaded yet, it is read with the fast Exif reader.
+ * @return QString the date as stored (e.g. 2013:04:19 12:00:00) - empty if there is none
+ **/
+QString DkImageContainer::dateTaken() const
+{
+    if (mLoader && mLoader->getMetaData() && mLoader->getMetaData()->isLoaded())
+        return mLoader->getMetaData()->getExifValue("DateTimeOriginal");
+
+    readSortInfo();
+    return mDateTaken;
+}
+
+/**
+ * Returns the rating.
+ * If the metadata is not loaded yet, it is read with the fast Exif reader.
+ * @return int the rating (-1 if there is none)
+ **/
+int DkImageContainer::rating() const
+{
+    if (mLoader && mLoader->getMetaData() && mLoader->getMetaData()->isLoaded())
+        return mLoader->getMetaData()->getRating();
+
+    readSortInfo();
+    return mRating;
+}
+
+/**
+ * Reads the date and the rating without Exiv2.
+ * Sorting needs these for all images of a folder - so they are cached.
+ **/
+void DkImageContainer::readSortInfo() const
+{
+    if (mSortInfoRead)
+        return;
+
+    mSortInfoRead = true;
+
+    DkExifReader reader;
+    if (!reader.read(filePath(), mFileBuffer))
+        return;
+
+    mDateTaken = reader.dateTimeOriginal();
+    mRating = reader.rating();
+}
+
 DkRotatingRect DkImageContainer::cropRect()
 {
     QSharedPointer<DkMetaDataT> metaData = getMetaData();
@@ -305,7 +355,7 @@ DkRotatingRect DkImageContainer::cropRect()
 
 QImage DkImageContainer::image()
 {
-    if (getLoader()->image().isNull() && getLoadState() == not_loaded)
+    if (!getLoader()->hasImage() && getLoadState() == not_loaded)
         loadImage();
 
     return mLoader->pixmap(); // current pixmap (rotated pixmap after exif rotation)
@@ -316,6 +366,25 @@ QImage DkImageContainer::pixmap()
     return mLoader->pixmap();
 }
 
+/**
+ * Returns the current pixmap without rotating it according to its Exif orientation.
+ * @param orientation if not null, it is set to the transform that displays the pixmap upright
+ * @return QImage the pixmap as decoded
+ **/
+QImage DkImageContainer::rawPixmap(DkJpgTransform::Transform *orientation)
+{
+    return mLoader->rawPixmap(orientation);
+}
+
+/**
+ * Returns the size of the current pixmap with the Exif orientation applied, without rotating its pixels.
+ * @return QSize the upright pixmap size
+ **/
+QSize DkImageContainer::pixmapSize() const
+{
+    return mLoader->pixmapSize();
+}
+
 QImage DkImageContainer::imageScaledToHeight(int height)
 {
     // check cash first
@@ -354,9 +423,9 @@ QImage DkImageContainer::imageScaledToWidth(int width)
     return sImg;
 }
 
-void DkImageContainer::setImage(const QImage &img, const QString &editName)
+void DkImageContainer::setImage(const QImage &img, const QString &editName, DkJpgTransform::Transform transform)
 {
-    getLoader()->setEditImage(img, editName);
+    getLoader()->setEditImage(img, editName, transform);
     mEdited = true;
 }
 
@@ -460,6 +529,8 @@ bool DkImageContainer::saveImage(const QString &filePath, const QImage saveImg,
 
 QSharedPointer<QByteArray> DkImageContainer::loadFileToBuffer(const QString &filePath)
 {
+    DkTraceScope ts("loadFileToBuffer", DkTraceLog::cat_io, filePath);
+
     QFileInfo fInfo = filePath;
 
     if (fInfo.isSymLink())
@@ -474,13 +545,13 @@ QSharedPointer<QByteArray> DkImageContainer::loadFileToBuffer(const QString &fil
         return QSharedPointer<QByteArray>(new QByteArray());
     }
 
-    QFile file(fInfo.absoluteFilePath());
-    file.open(QIODevice::ReadOnly);
-
-    QSharedPointer<QByteArray> ba(new QByteArray(file.readAll()));
-    file.close();
+    // the buffer is cached - so it must not be mapped (see DkFileBuffer)
+    // files that can be mapped are read ahead by the OS instead and only mapped while they are decoded
+    // svgs are kept because they are rendered from the buffer
+    if (!hasSvg() && DkFileBuffer::prefetch(fInfo.absoluteFilePath()))
+        return QSharedPointer<QByteArray>(new QByteArray());
 
-    return ba;
+    return DkFileBuffer::load(fInfo.absoluteFilePath(), false);
 }
 
 QSharedPointer<DkBasicLoader>
@@ -610,6 +681,17 @@ bool imageContainerLessThan(const DkImageContainer &l, const DkImageContainer &r
     case DkSettings::sort_random:
         return DkUtils::compRandom(l.fileInfo(), r.fileInfo());
 
+    case DkSettings::sort_date_taken:
+        // images without date are sorted by filename
+        if (l.dateTaken() != r.dateTaken())
+            return (l.dateTaken() < r.dateTaken()) == (DkSettingsManager::param().global().sortDir == DkSettings::sort_ascending);
+        return DkUtils::compFilename(l.fileInfo(), r.fileInfo());
+
+    case DkSettings::sort_rating:
+        if (l.rating() != r.rating())
+            return (l.rating() < r.rating()) == (DkSettingsManager::param().global().sortDir == DkSettings::sort_ascending);
+        return DkUtils::compFilename(l.fileInfo(), r.fileInfo());
+
     default:
         // filename
         return DkUtils::compFilename(l.fileInfo(), r.fileInfo());
@@ -860,7 +942,10 @@ void DkImageContainerT::loadingFinished()
         mLoadState = exists_not;
         return;
     } else if (!getThumb()->hasImage()) {
-        getThumb()->setImage(getLoader()->image());
+        // rotate the thumbnail rather than the image
+        DkJpgTransform::Transform orientation = DkJpgTransform::transform_identity;
+        QImage img = getLoader()->rawPixmap(&orientation);
+        getThumb()->setImage(DkJpgTransform::apply(DkImage::createThumb(img), orientation));
     }
 
     // clear file buffer if it exceeds a certain size?! e.g. psd files
@@ -869,7 +954,7 @@ void DkImageContainerT::loadingFinished()
 
         // if the file buffer is more than 5MB - we check if we need to delete it
         if (bs > 5 && bs > DkSettingsManager::param().resources().cacheMemory * 0.5f)
-            mFileBuffer->clear();
+            mFileBuffer.clear();
     }
 
     mLoadState = loaded;
@@ -992,6 +1077,12 @@ bool DkImageContainerT::saveImageThreaded(const QString &filePath, const QImage
         emit errorDialogSignal(msg);
         return false;
     }
+    // huge images are opened with reduced resolution - we must not overwrite the original
+    if (getLoader()->decodeScale() < 1.0 && fInfo == QFileInfo(this->filePath())) {
+        QString msg = tr("%1 was opened with reduced resolution, it cannot be overwritten.").arg(fInfo.fileName());
+        emit errorDialogSignal(msg);
+        return false;
+    }
 
     qDebug() << "attempting to save: " << filePath;
 
@@ -1017,8 +1108,7 @@ void DkImageContainerT::savingFinished()
         //// reset thumb - loadImageThreaded should do it anyway
         // thumb = QSharedPointer<DkThumbNailT>(new DkThumbNailT(saveFile, loader->image()));
 
-        if (mFileBuffer)
-            mFileBuffer->clear(); // do a complete clear?
+        mFileBuffer.clear(); // do a complete clear?
 
         if (DkSettingsManager::param().resources().loadSavedImage == DkSettings::ls_load || filePath().isEmpty() || dirPath() == sInfo.absolutePath()) {
             setFilePath(savePath);
@@ -1063,6 +1153,11 @@ QSharedPointer<DkBasicLoader> DkImageContainerT::getLoader()
     if (!mLoader) {
         DkImageContainer::getLoader();
         connect(mLoader.data(), SIGNAL(errorDialogSignal(const QString &)), this, SIGNAL(errorDialogSignal(const QString &)));
+
+        // huge images are opened with screen resolution - the viewport decodes zoomed regions
+        QScreen *screen = QGuiApplication::primaryScreen();
+        if (screen)
+            mLoader->setHugeImageDecodeSize(screen->size() * screen->devicePixelRatio());
     }
 
     return mLoader;
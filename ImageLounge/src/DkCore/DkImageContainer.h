@@ -45,6 +45,7 @@
 #endif
 #endif
 
+#include "DkJpgTransform.h"
 #include "DkThumbs.h"
 
 namespace nmc
@@ -78,6 +79,8 @@ public:
 
     QImage image();
     QImage pixmap();
+    QImage rawPixmap(DkJpgTransform::Transform *orientation);
+    QSize pixmapSize() const;
     QImage imageScaledToHeight(int height);
     QImage imageScaledToWidth(int width);
 
@@ -97,6 +100,8 @@ public:
     QString getTitleAttribute() const;
     float getMemoryUsage() const;
     float getFileSize() const;
+    QString dateTaken() const;
+    int rating() const;
 
     virtual QSharedPointer<DkBasicLoader> getLoader();
     virtual QSharedPointer<DkMetaDataT> getMetaData();
@@ -114,7 +119,7 @@ public:
 
     QSharedPointer<QByteArray> loadFileToBuffer(const QString &filePath);
     bool loadImage();
-    void setImage(const QImage &img, const QString &editName);
+    void setImage(const QImage &img, const QString &editName, DkJpgTransform::Transform transform = DkJpgTransform::transform_invalid);
     void setImage(const QImage &img, const QString &editName, const QString &filePath);
     void setMetaData(QSharedPointer<DkMetaDataT> editedMetaData, const QImage &img, const QString &editName);
     void setMetaData(QSharedPointer<DkMetaDataT> editedMetaData, const QString &editName);
@@ -137,6 +142,7 @@ protected:
     QString saveImageIntern(const QString &filePath, QSharedPointer<DkBasicLoader> loader, QImage saveImg, int compression);
     void setFilePath(const QString &filePath);
     void init();
+    void readSortInfo() const;
 
     QSharedPointer<QByteArray> mFileBuffer;
     QSharedPointer<DkBasicLoader> mLoader;
@@ -149,6 +155,11 @@ protected:
     QFileInfo mFileInfo;
     QVector<QImage> scaledImages;
 
+    // read with DkExifReader for sorting (see readSortInfo)
+    mutable bool mSortInfoRead = false;
+    mutable QString mDateTaken;
+    mutable int mRating = -1;
+
 #ifdef WITH_QUAZIP
     QSharedPointer<DkZipContainer> mZipData;
 #endif
@@ -55,6 +55,7 @@
 #include <QFileIconProvider>
 #include <QFileInfo>
 #include <QFileSystemWatcher>
+#include <QHash>
 #include <QImageReader>
 #include <QImageWriter>
 #include <QMessageBox>
@@ -65,10 +66,12 @@
 #include <QProgressDialog>
 #include <QReadLocker>
 #include <QReadWriteLock>
+#include <QRegularExpression>
 #include <QSettings>
 #include <QStandardPaths>
 #include <QStringBuilder>
 #include <QStringList>
+#include <QStringMatcher>
 #include <QThread>
 #include <QTimer>
 #include <QWidget>
@@ -99,6 +102,10 @@
 #include <winsock2.h> // needed since libraw 0.16
 #endif
 
+#ifndef Q_OS_WIN
+#include <dirent.h>
+#endif
+
 #pragma warning(pop) // no warnings from includes - end
 
 namespace nmc
@@ -345,6 +352,7 @@ void DkImageLoader::createImages(const QFileInfoList &files, bool sort)
 {
     // TODO: change files to QStringList
     DkTimer dt;
+    DkTraceScope ts("createImages", DkTraceLog::cat_io);
     QVector<QSharedPointer<DkImageContainerT>> oldImages = mImages;
     mImages.clear();
 
@@ -1355,6 +1363,10 @@ void DkImageLoader::saveFile(const QString &filePath, const QImage &saveImg, con
         lFilePath.append(newSuffix.left(endSuffix));
     }
 
+    // the original cannot be overwritten (see DkImageContainerT::saveImageThreaded)
+    if (QFileInfo(lFilePath) != imgC->fileInfo() && !confirmReducedResolution())
+        return;
+
     emit updateSpinnerSignalDelayed(true);
     QImage sImg = (saveImg.isNull()) ? imgC->image() : saveImg;
 
@@ -1522,7 +1534,8 @@ void DkImageLoader::rotateImage(double angle)
         // Update the image itself, along with the history and everything
         // In other words, the rotated image is saved to the history and the edit flag is set
         // the exif rotation flag will be reset when adding the new image to the history (BasicLoader)
-        mCurrentImage->setImage(img, tr("Rotated")); // new edit with rotated pixmap (clears orientation)
+        // jpgs that were only rotated are saved losslessly
+        mCurrentImage->setImage(img, tr("Rotated"), DkJpgTransform::fromAngle(qRound(angle))); // new edit with rotated pixmap (clears orientation)
         setImageUpdated();
         // TODO There's a glitch when rotating/changing the image after switching back from settings
         // which causes the containers to be reloaded. If we call the local setImage() overload,
@@ -1868,86 +1881,52 @@ void DkImageLoader::updateCacher(QSharedPointer<DkImageContainerT> imgC)
 QFileInfoList DkImageLoader::getFilteredFileInfoList(const QString &dirPath, QStringList ignoreKeywords, QStringList keywords, QString folderKeywords)
 {
     DkTimer dt;
+    DkTraceScope ts("getFilteredFileInfoList", DkTraceLog::cat_io, dirPath);
 
     if (dirPath.isEmpty())
         return QFileInfoList();
 
-#ifdef Q_OS_WIN
-
-    QString winPath = QDir::toNativeSeparators(dirPath) + "\\*.*";
-
-    const wchar_t *fname = reinterpret_cast<const wchar_t *>(winPath.utf16());
-
-    WIN32_FIND_DATAW findFileData;
-    HANDLE MyHandle = FindFirstFileW(fname, &findFileData);
-
-    std::vector<std::wstring> fileNameList;
-    std::wstring fileName;
-
-    if (MyHandle != INVALID_HANDLE_VALUE) {
-        do {
-            fileName = findFileData.cFileName;
-            fileNameList.push_back(fileName); // TODO: sort correct according to numbers
-        } while (FindNextFileW(MyHandle, &findFileData) != 0);
-    }
-
-    FindClose(MyHandle);
-
-    // remove the * in fileFilters
-    QStringList fileFiltersClean = DkSettingsManager::param().app().browseFilters;
-    for (QString &filter : fileFiltersClean)
-        filter.replace("*", "");
+    // compile all filters once - the directory is then traversed a single time
+    DkFileFilter browseFilter(DkSettingsManager::param().app().browseFilters);
 
-    // qDebug() << "browse filters: " << DkSettingsManager::param().app().browseFilters;
+    QRegularExpression ignoreExp;
+    if (!ignoreKeywords.isEmpty()) {
+        ignoreExp.setPattern("(" + ignoreKeywords.join(")|(") + ")");
+        ignoreExp.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+        ignoreExp.optimize();
 
-    QStringList fileList;
-    std::vector<std::wstring>::iterator lIter = fileNameList.begin();
-
-    // convert to QStringList
-    for (unsigned int idx = 0; idx < fileNameList.size(); idx++, lIter++) {
-        QString qFilename = DkUtils::stdWStringToQString(*lIter);
-
-        // believe it or not, but this is 10 times faster than QRegExp
-        // drawback: we also get files that contain *.jpg*
-        for (int i = 0; i < fileFiltersClean.size(); i++) {
-            if (qFilename.contains(fileFiltersClean[i], Qt::CaseInsensitive)) {
-                fileList.append(qFilename);
-                break;
-            }
+        if (!ignoreExp.isValid()) {
+            qWarning() << "illegal ignore keywords:" << ignoreKeywords << ignoreExp.errorString();
+            ignoreExp = QRegularExpression();
         }
     }
 
-    qInfoClean() << "WinAPI, indexed (" << fileList.size() << ") files in: " << dt;
-#else
-
-    // true file list
-    QDir tmpDir(dirPath);
-    tmpDir.setSorting(QDir::LocaleAware);
-    QStringList fileList = tmpDir.entryList(DkSettingsManager::param().app().browseFilters);
+    QVector<QStringMatcher> keywordMatchers;
+    for (const QString &kw : keywords)
+        keywordMatchers << QStringMatcher(kw, Qt::CaseInsensitive);
 
-#endif
+    auto accept = [&](const QString &name) -> bool {
+        // files with no suffix are checked by content
+        if (!name.contains(".")) {
+            if (!DkUtils::isValid(QFileInfo(dirPath, name)))
+                return false;
+        } else if (!browseFilter.matches(name))
+            return false;
 
-    // append files with no suffix
-    QDir cDir(dirPath);
-    QStringList allFiles = cDir.entryList();
-    QStringList noSuffixFiles;
+        if (!ignoreExp.pattern().isEmpty() && ignoreExp.match(name).hasMatch())
+            return false;
 
-    for (const QString &name : allFiles) {
-        if (!name.contains(".") && DkUtils::isValid(QFileInfo(dirPath, name))) {
-            fileList << name;
+        for (const QStringMatcher &m : keywordMatchers) {
+            if (m.indexIn(name) == -1)
+                return false;
         }
-    }
 
-    // remove files that contain ignore keywords
-    for (int idx = 0; idx < ignoreKeywords.size(); idx++) {
-        QRegExp exp = QRegExp("^((?!" + ignoreKeywords[idx] + ").)*$");
-        exp.setCaseSensitivity(Qt::CaseInsensitive);
-        fileList = fileList.filter(exp);
-    }
+        return true;
+    };
 
-    for (int idx = 0; idx < keywords.size(); idx++) {
-        fileList = fileList.filter(keywords[idx], Qt::CaseInsensitive);
-    }
+    QStringList fileList = listDirectory(dirPath, accept);
+
+    qInfoClean() << "indexed (" << fileList.size() << ") files in: " << dt;
 
     if (folderKeywords != "") {
         QStringList filterList = fileList;
@@ -1959,44 +1938,113 @@ QFileInfoList DkImageLoader::getFilteredFileInfoList(const QString &dirPath, QSt
         preferredExtension = preferredExtension.replace("*.", "");
         qDebug() << "preferred extension: " << preferredExtension;
 
+        // count the files per base name that contain the preferred extension
+        auto baseName = [](const QString &name) -> QString {
+            return name.section('.', 0, 0);
+        };
+
+        QHash<QString, int> preferredCount;
+        for (const QString &name : fileList) {
+            if (name.contains(preferredExtension, Qt::CaseInsensitive))
+                preferredCount[baseName(name)]++;
+        }
+
         QStringList resultList = fileList;
         fileList.clear();
 
-        for (int idx = 0; idx < resultList.size(); idx++) {
-            QFileInfo cFName = QFileInfo(resultList.at(idx));
+        for (const QString &name : resultList) {
+            QString suffix = name.section('.', -1);
 
-            if (preferredExtension.compare(cFName.suffix(), Qt::CaseInsensitive) == 0) {
-                fileList.append(resultList.at(idx));
+            if (name.contains(".") && preferredExtension.compare(suffix, Qt::CaseInsensitive) == 0) {
+                fileList.append(name);
                 continue;
             }
 
-            QString cFBase = cFName.baseName();
-            bool remove = false;
+            // do not count the file itself
+            int cnt = preferredCount.value(baseName(name), 0);
+            if (name.contains(preferredExtension, Qt::CaseInsensitive))
+                cnt--;
 
-            for (int cIdx = 0; cIdx < resultList.size(); cIdx++) {
-                QString ccBase = QFileInfo(resultList.at(cIdx)).baseName();
-
-                if (cIdx != idx && ccBase == cFBase && resultList.at(cIdx).contains(preferredExtension, Qt::CaseInsensitive)) {
-                    remove = true;
-                    break;
-                }
-            }
-
-            if (!remove)
-                fileList.append(resultList.at(idx));
+            if (cnt <= 0)
+                fileList.append(name);
         }
     }
 
-    // fileList = sort(fileList, dir);
-
     QFileInfoList fileInfoList;
+    fileInfoList.reserve(fileList.size());
 
-    for (int idx = 0; idx < fileList.size(); idx++)
-        fileInfoList.append(QFileInfo(mCurrentDir, fileList.at(idx)));
+    for (const QString &name : fileList)
+        fileInfoList.append(QFileInfo(dirPath, name));
 
     return fileInfoList;
 }
 
+/**
+ * Lists all files (not directories) of dirPath that are accepted by accept.
+ * The directory is traversed once using the native API so that no
+ * QFileInfo (i.e. stat) is needed per file.
+ * Hidden files (starting with a dot) are skipped.
+ * @param dirPath the directory
+ * @param accept is called for each file name
+ * @return QStringList the accepted file names (unsorted)
+ **/
+QStringList DkImageLoader::listDirectory(const QString &dirPath, const std::function<bool(const QString &)> &accept)
+{
+    QStringList fileList;
+
+#ifdef Q_OS_WIN
+
+    QString winPath = QDir::toNativeSeparators(dirPath) + "\\*";
+
+    const wchar_t *fname = reinterpret_cast<const wchar_t *>(winPath.utf16());
+
+    WIN32_FIND_DATAW findFileData;
+    HANDLE MyHandle = FindFirstFileExW(fname, FindExInfoBasic, &findFileData, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+
+    if (MyHandle != INVALID_HANDLE_VALUE) {
+        do {
+            if (findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                continue;
+
+            QString name = QString::fromWCharArray(findFileData.cFileName);
+
+            if (!name.startsWith(".") && accept(name))
+                fileList << name;
+
+        } while (FindNextFileW(MyHandle, &findFileData) != 0);
+
+        FindClose(MyHandle);
+    }
+#else
+
+    DIR *dir = opendir(QFile::encodeName(dirPath).constData());
+
+    if (!dir)
+        return fileList;
+
+    while (struct dirent *entry = readdir(dir)) {
+        // skip ., .. and hidden files
+        if (entry->d_name[0] == '.')
+            continue;
+
+        QString name = QFile::decodeName(entry->d_name);
+
+        bool isFile = entry->d_type == DT_REG;
+
+        // symlinks or file systems that do not report the type (e.g. some network shares)
+        if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN)
+            isFile = QFileInfo(dirPath, name).isFile();
+
+        if (isFile && accept(name))
+            fileList << name;
+    }
+
+    closedir(dir);
+#endif
+
+    return fileList;
+}
+
 void DkImageLoader::sort()
 {
     std::sort(mImages.begin(), mImages.end(), imageContainerLessThanPtr);
@@ -2049,6 +2097,40 @@ bool DkImageLoader::isEdited() const
     return mCurrentImage && mCurrentImage->isEdited();
 }
 
+/**
+ * Huge images are opened with reduced resolution.
+ * Asks the user if the reduced image should be used before it is exported (saved, copied, printed).
+ * @return bool true if the current image has full resolution or the user accepted the reduced image
+ **/
+bool DkImageLoader::confirmReducedResolution() const
+{
+    if (!mCurrentImage || mCurrentImage->getLoader()->decodeScale() >= 1.0)
+        return true;
+
+    double scale = mCurrentImage->getLoader()->decodeScale();
+    QSize size = mCurrentImage->pixmapSize();
+    QSize fullSize(qRound(size.width() / scale), qRound(size.height() / scale));
+
+    DkMessageBox *msgBox = new DkMessageBox(QMessageBox::Warning,
+                                            tr("Reduced Resolution"),
+                                            tr("%1 was opened with reduced resolution.\n"
+                                               "Only %2 x %3 of %4 x %5 pixels will be used. Do you want to continue?")
+                                                .arg(mCurrentImage->fileName())
+                                                .arg(size.width())
+                                                .arg(size.height())
+                                                .arg(fullSize.width())
+                                                .arg(fullSize.height()),
+                                            (QMessageBox::Yes | QMessageBox::No),
+                                            DkUtils::getMainWindow());
+
+    msgBox->setDefaultButton(QMessageBox::No);
+    msgBox->setObjectName("reducedResolutionDialog");
+
+    int answer = msgBox->exec();
+
+    return answer == QMessageBox::Accepted || answer == QMessageBox::Yes;
+}
+
 int DkImageLoader::numFiles() const
 {
     return mImages.size();
@@ -2099,6 +2181,24 @@ QImage DkImageLoader::getPixmap()
     return mCurrentImage->getLoader()->pixmap();
 }
 
+/**
+ * @brief Returns the currently loaded pixmap without applying its Exif orientation.
+ * Viewers draw it with the orientation as transform so that the pixels need not be rotated.
+ *
+ * @param orientation if not null, it is set to the transform that displays the pixmap upright
+ * @return QImage
+ */
+QImage DkImageLoader::getRawPixmap(DkJpgTransform::Transform *orientation)
+{
+    if (!mCurrentImage) {
+        if (orientation)
+            *orientation = DkJpgTransform::transform_identity;
+        return QImage();
+    }
+
+    return mCurrentImage->rawPixmap(orientation);
+}
+
 bool DkImageLoader::dirtyTiff()
 {
     if (!mCurrentImage)
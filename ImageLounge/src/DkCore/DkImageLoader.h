@@ -30,6 +30,7 @@
 #pragma warning(push, 0) // no warnings from includes - begin
 #include <QImage>
 #include <QTimer>
+#include <functional>
 #pragma warning(pop) // no warnings from includes - end
 
 #ifndef DllCoreExport
@@ -77,6 +78,7 @@ public:
                                           QStringList ignoreKeywords = QStringList(),
                                           QStringList keywords = QStringList(),
                                           QString folderKeywords = QString());
+    static QStringList listDirectory(const QString &dirPath, const std::function<bool(const QString &)> &accept);
 
     void rotateImage(double angle);
     QSharedPointer<DkImageContainerT> getCurrentImage() const;
@@ -118,9 +120,11 @@ public:
     void activate(bool isActive = true);
     bool hasImage() const;
     bool isEdited() const;
+    bool confirmReducedResolution() const;
     int numFiles() const;
     QImage getImage();
     QImage getPixmap();
+    QImage getRawPixmap(DkJpgTransform::Transform *orientation);
     bool dirtyTiff();
 
     QStringList ignoreKeywords() const;
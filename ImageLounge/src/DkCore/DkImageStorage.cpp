@@ -35,12 +35,16 @@
 #pragma warning(push, 0) // no warnings from includes - begin
 #include <QBitmap>
 #include <QDebug>
+#include <QMutex>
 #include <QPainter>
 #include <QPixmap>
 #include <QSvgRenderer>
+#include <QThread>
 #include <QTimer>
+#include <QtConcurrentMap>
 #include <QtConcurrentRun>
 #include <qmath.h>
+#include <atomic>
 #pragma warning(pop) // no warnings from includes - end
 
 #if defined(Q_OS_WIN) && !defined(SOCK_STREAM)
@@ -51,6 +55,34 @@ namespace nmc
 
 // DkImage --------------------------------------------------------------------
 
+/**
+ * Splits numRows into blocks and processes them on the global thread pool.
+ * fn is called with [startRow, endRow) and must only touch these rows.
+ * Small images are processed in the calling thread.
+ * @param numRows the number of rows (typically the image height)
+ * @param fn the kernel that processes a block of rows
+ * @param minRows the minimum number of rows per block
+ **/
+void DkImage::parallelRows(int numRows, const std::function<void(int, int)> &fn, int minRows)
+{
+    int numBlocks = qMin(QThread::idealThreadCount() * 4, numRows / qMax(minRows, 1));
+
+    if (numBlocks <= 1) {
+        fn(0, numRows);
+        return;
+    }
+
+    QVector<QPair<int, int>> blocks;
+    blocks.reserve(numBlocks);
+
+    for (int idx = 0; idx < numBlocks; idx++)
+        blocks << QPair<int, int>(numRows * idx / numBlocks, numRows * (idx + 1) / numBlocks);
+
+    QtConcurrent::blockingMap(blocks, [&fn](const QPair<int, int> &b) {
+        fn(b.first, b.second);
+    });
+}
+
 /**
  * Returns a string with the buffer size of an image.
  * @param img a QImage
@@ -109,6 +141,8 @@ float DkImage::getBufferSizeFloat(const QSize &imgSize, const int depth)
 QImage
 DkImage::resizeImage(const QImage &img, const QSize &newSize, double factor /* = 1.0 */, int interpolation /* = ipl_cubic */, bool correctGamma /* = true */)
 {
+    DkTraceScope ts("resizeImage", DkTraceLog::cat_resize);
+
     QSize nSize = newSize;
 
     // nothing to do
@@ -205,24 +239,28 @@ DkImage::resizeImage(const QImage &img, const QSize &newSize, double factor /* =
 
 bool DkImage::alphaChannelUsed(const QImage &img)
 {
-    if (img.format() != QImage::Format_ARGB32 && img.format() != QImage::Format_ARGB32)
+    if (img.format() != QImage::Format_ARGB32 && img.format() != QImage::Format_ARGB32_Premultiplied)
         return false;
 
-    // number of used bytes per line
-    int bpl = (img.width() * img.depth() + 7) / 8;
-    int pad = img.bytesPerLine() - bpl;
-    const uchar *ptr = img.bits();
+    // blocks stop as soon as any of them found a transparent pixel
+    std::atomic<bool> used(false);
+    const int w = img.width();
 
-    for (int rIdx = 0; rIdx < img.height(); rIdx++) {
-        for (int cIdx = 0; cIdx < bpl; cIdx++, ptr++) {
-            if (cIdx % 4 == 3 && *ptr != 255)
-                return true;
-        }
+    parallelRows(img.height(), [&](int start, int end) {
+        for (int rIdx = start; rIdx < end && !used.load(std::memory_order_relaxed); rIdx++) {
+            const QRgb *ptr = reinterpret_cast<const QRgb *>(img.constScanLine(rIdx));
 
-        ptr += pad;
-    }
+            // and-ing keeps the loop branch free
+            uint alpha = 0xff;
+            for (int cIdx = 0; cIdx < w; cIdx++)
+                alpha &= qAlpha(ptr[cIdx]);
 
-    return false;
+            if (alpha != 0xff)
+                used = true;
+        }
+    });
+
+    return used;
 }
 
 QImage DkImage::thresholdImage(const QImage &img, double thr, bool color)
@@ -234,18 +272,11 @@ QImage DkImage::thresholdImage(const QImage &img, double thr, bool color)
 
     QImage tImg = color ? img.copy() : grayscaleImage(img);
 
-    // number of bytes per line used
-    int bpl = (tImg.width() * tImg.depth() + 7) / 8;
-    int pad = tImg.bytesPerLine() - bpl;
+    uchar lut[256];
+    for (int idx = 0; idx < 256; idx++)
+        lut[idx] = idx > thr ? 255 : 0;
 
-    uchar *mPtr = tImg.bits();
-
-    for (int rIdx = 0; rIdx < tImg.height(); rIdx++) {
-        for (int cIdx = 0; cIdx < bpl; cIdx++, mPtr++) {
-            *mPtr = *mPtr > thr ? 255 : 0;
-        }
-        mPtr += pad;
-    }
+    mapLut(tImg, lut);
 
     qDebug() << "thresholding takes: " << dt;
 
@@ -394,29 +425,12 @@ void DkImage::mapGammaTable(QImage &img, const QVector<uchar> &gammaTable)
 {
     DkTimer dt;
 
-    // number of bytes per line used
-    int bpl = (img.width() * img.depth() + 7) / 8;
-    int pad = img.bytesPerLine() - bpl;
-
-    // int channels = (img.hasAlphaChannel() || img.format() == QImage::Format_RGB32) ? 4 : 3;
-
-    uchar *mPtr = img.bits();
-
-    for (int rIdx = 0; rIdx < img.height(); rIdx++) {
-        for (int cIdx = 0; cIdx < bpl; cIdx++, mPtr++) {
-            if (*mPtr < 0 || *mPtr > gammaTable.size()) {
-                qDebug() << "WRONG VALUE: " << *mPtr;
-                continue;
-            }
-            if ((int)gammaTable[*mPtr] < 0 || (int)gammaTable[*mPtr] > USHRT_MAX) {
-                qDebug() << "WRONG VALUE: " << *mPtr;
-                continue;
-            }
+    // values that are not covered by the table are kept
+    uchar lut[256];
+    for (int idx = 0; idx < 256; idx++)
+        lut[idx] = idx < gammaTable.size() ? gammaTable[idx] : (uchar)idx;
 
-            *mPtr = gammaTable[*mPtr];
-        }
-        mPtr += pad;
-    }
+    mapLut(img, lut);
 
     qDebug() << "gamma computation takes: " << dt;
 }
@@ -431,44 +445,54 @@ QImage DkImage::normImage(const QImage &img)
 
 bool DkImage::normImage(QImage &img)
 {
+    if (img.isNull())
+        return false;
+
+    // the 4th byte (alpha or padding) is neither measured nor changed
+    const bool hasAlpha = img.hasAlphaChannel() || img.format() == QImage::Format_RGB32;
+
+    // number of used bytes per line
+    const int bpl = (img.width() * img.depth() + 7) / 8;
+
+    QMutex mutex;
     uchar maxVal = 0;
     uchar minVal = 255;
 
-    // number of used bytes per line
-    int bpl = (img.width() * img.depth() + 7) / 8;
-    int pad = img.bytesPerLine() - bpl;
-    uchar *mPtr = img.bits();
-    bool hasAlpha = img.hasAlphaChannel() || img.format() == QImage::Format_RGB32;
+    parallelRows(img.height(), [&](int start, int end) {
+        uchar bMin = 255, bMax = 0;
 
-    for (int rIdx = 0; rIdx < img.height(); rIdx++) {
-        for (int cIdx = 0; cIdx < bpl; cIdx++, mPtr++) {
-            if (hasAlpha && cIdx % 4 == 3)
-                continue;
+        for (int rIdx = start; rIdx < end; rIdx++) {
+            const uchar *ptr = img.constScanLine(rIdx);
 
-            if (*mPtr > maxVal)
-                maxVal = *mPtr;
-            if (*mPtr < minVal)
-                minVal = *mPtr;
+            if (hasAlpha) {
+                for (int cIdx = 0; cIdx + 3 < bpl; cIdx += 4) {
+                    bMin = qMin(bMin, qMin(ptr[cIdx], qMin(ptr[cIdx + 1], ptr[cIdx + 2])));
+                    bMax = qMax(bMax, qMax(ptr[cIdx], qMax(ptr[cIdx + 1], ptr[cIdx + 2])));
+                }
+            } else {
+                for (int cIdx = 0; cIdx < bpl; cIdx++) {
+                    bMin = qMin(bMin, ptr[cIdx]);
+                    bMax = qMax(bMax, ptr[cIdx]);
+                }
+            }
         }
 
-        mPtr += pad;
-    }
+        QMutexLocker l(&mutex);
+        minVal = qMin(minVal, bMin);
+        maxVal = qMax(maxVal, bMax);
+    });
 
-    if ((minVal == 0 && maxVal == 255) || maxVal - minVal == 0)
+    if ((minVal == 0 && maxVal == 255) || maxVal - minVal <= 0)
         return false;
 
-    uchar *ptr = img.bits();
-
-    for (int rIdx = 0; rIdx < img.height(); rIdx++) {
-        for (int cIdx = 0; cIdx < bpl; cIdx++, ptr++) {
-            if (hasAlpha && cIdx % 4 == 3)
-                continue;
-
-            *ptr = (uchar)qRound(255.0f * (*ptr - minVal) / (maxVal - minVal));
-        }
+    uchar lut[256];
+    for (int idx = 0; idx < 256; idx++)
+        lut[idx] = (uchar)qRound(255.0f * (qBound((int)minVal, idx, (int)maxVal) - minVal) / (maxVal - minVal));
 
-        ptr += pad;
-    }
+    if (hasAlpha)
+        mapLut(img, lut, lut, lut, 4);
+    else
+        mapLut(img, lut);
 
     return true;
 }
@@ -489,136 +513,135 @@ bool DkImage::autoAdjustImage(QImage &img)
     qDebug() << "[Auto Adjust] image format: " << img.format();
 
     // for grayscale image - normalize is the same
-    if (img.format() <= QImage::Format_Indexed8) {
+    if (img.format() <= QImage::Format_Indexed8 || img.format() == QImage::Format_Grayscale8) {
         qDebug() << "[Auto Adjust] Grayscale - switching to Normalize: " << img.format();
         return normImage(img);
-    } else if (img.format() != QImage::Format_ARGB32 && img.format() != QImage::Format_ARGB32 && img.format() != QImage::Format_RGB32
-               && img.format() != QImage::Format_RGB888) {
+    } else if (img.format() != QImage::Format_ARGB32 && img.format() != QImage::Format_RGB32 && img.format() != QImage::Format_RGB888) {
         qDebug() << "[Auto Adjust] Format not supported: " << img.format();
         return false;
     }
 
-    int channels = (img.hasAlphaChannel() || img.format() == QImage::Format_RGB32) ? 4 : 3;
-
-    uchar maxR = 0, maxG = 0, maxB = 0;
-    uchar minR = 255, minG = 255, minB = 255;
+    const int channels = img.format() == QImage::Format_RGB888 ? 3 : 4;
+    const int w = img.width();
 
-    // number of bytes per line used
-    int bpl = (img.width() * img.depth() + 7) / 8;
-    int pad = img.bytesPerLine() - bpl;
+    // per block histograms are merged afterwards
+    QMutex mutex;
+    int hist[3][256] = {{0}};
 
-    uchar *mPtr = img.bits();
-    uchar r, g, b;
+    parallelRows(img.height(), [&](int start, int end) {
+        int bHist[3][256] = {{0}};
 
-    int histR[256] = {0};
-    int histG[256] = {0};
-    int histB[256] = {0};
+        for (int rIdx = start; rIdx < end; rIdx++) {
+            const uchar *ptr = img.constScanLine(rIdx);
 
-    for (int rIdx = 0; rIdx < img.height(); rIdx++) {
-        for (int cIdx = 0; cIdx < bpl;) {
-            r = *mPtr;
-            mPtr++;
-            g = *mPtr;
-            mPtr++;
-            b = *mPtr;
-            mPtr++;
-            cIdx += 3;
-
-            if (r > maxR)
-                maxR = r;
-            if (r < minR)
-                minR = r;
-
-            if (g > maxG)
-                maxG = g;
-            if (g < minG)
-                minG = g;
-
-            if (b > maxB)
-                maxB = b;
-            if (b < minB)
-                minB = b;
-
-            histR[r]++;
-            histG[g]++;
-            histB[b]++;
-
-            // ?? strange but I would expect the alpha channel to be the first (big endian?)
-            if (channels == 4) {
-                mPtr++;
-                cIdx++;
+            for (int cIdx = 0; cIdx < w; cIdx++, ptr += channels) {
+                bHist[0][ptr[0]]++;
+                bHist[1][ptr[1]]++;
+                bHist[2][ptr[2]]++;
             }
         }
-        mPtr += pad;
-    }
 
-    QColor ignoreChannel;
-    bool ignoreR = maxR - minR == 0 || maxR - minR == 255;
-    bool ignoreG = maxR - minR == 0 || maxG - minG == 255;
-    bool ignoreB = maxR - minR == 0 || maxB - minB == 255;
+        QMutexLocker l(&mutex);
+        for (int ch = 0; ch < 3; ch++) {
+            for (int idx = 0; idx < 256; idx++)
+                hist[ch][idx] += bHist[ch][idx];
+        }
+    });
 
-    uchar *ptr = img.bits();
+    uchar lut[3][256];
+    bool ignoreAll = true;
 
-    if (ignoreR) {
-        maxR = findHistPeak(histR);
-        ignoreR = maxR - minR == 0 || maxR - minR == 255;
-    }
-    if (ignoreG) {
-        maxG = findHistPeak(histG);
-        ignoreG = maxG - minG == 0 || maxG - minG == 255;
-    }
-    if (ignoreB) {
-        maxB = findHistPeak(histB);
-        ignoreB = maxB - minB == 0 || maxB - minB == 255;
-    }
+    for (int ch = 0; ch < 3; ch++) {
+        // min/max are the first/last used bins
+        int minV = 0, maxV = 255;
+        while (minV < 255 && !hist[ch][minV])
+            minV++;
+        while (maxV > 0 && !hist[ch][maxV])
+            maxV--;
+
+        bool ignore = maxV - minV <= 0 || maxV - minV == 255;
+
+        if (ignore) {
+            maxV = findHistPeak(hist[ch]);
+            ignore = maxV - minV <= 0 || maxV - minV == 255;
+        }
 
-    // qDebug() << "red max: " << maxR << " min: " << minR << " ignored: " << ignoreR;
-    // qDebug() << "green max: " << maxG << " min: " << minG << " ignored: " << ignoreG;
-    // qDebug() << "blue max: " << maxB << " min: " << minB << " ignored: " << ignoreB;
-    // qDebug() << "computed in: " << dt;
+        for (int idx = 0; idx < 256; idx++) {
+            if (ignore)
+                lut[ch][idx] = (uchar)idx;
+            else if (idx < maxV)
+                lut[ch][idx] = (uchar)qRound(255.0f * (qMax(idx, minV) - minV) / (maxV - minV));
+            else
+                lut[ch][idx] = 255;
+        }
+
+        ignoreAll &= ignore;
+    }
 
-    if (ignoreR && ignoreG && ignoreB) {
+    if (ignoreAll) {
         qDebug() << "[Auto Adjust] There is no need to adjust the image";
         return false;
     }
 
-    for (int rIdx = 0; rIdx < img.height(); rIdx++) {
-        for (int cIdx = 0; cIdx < bpl;) {
-            // don't check values - speed (but you see under-/overflows anyway)
-            if (!ignoreR && *ptr < maxR)
-                *ptr = (uchar)qRound(255.0f * ((float)*ptr - minR) / (maxR - minR));
-            else if (!ignoreR)
-                *ptr = 255;
+    mapLut(img, lut[0], lut[1], lut[2], channels);
 
-            ptr++;
-            cIdx++;
+    qDebug() << "[Auto Adjust] image adjusted in: " << dt;
 
-            if (!ignoreG && *ptr < maxG)
-                *ptr = (uchar)qRound(255.0f * ((float)*ptr - minG) / (maxG - minG));
-            else if (!ignoreG)
-                *ptr = 255;
+    return true;
+}
 
-            ptr++;
-            cIdx++;
+/**
+ * Maps all used bytes of img through lut (in parallel).
+ * @param img the image that is changed in place
+ * @param lut a 256 entry look-up table
+ **/
+void DkImage::mapLut(QImage &img, const uchar *lut)
+{
+    // number of used bytes per line
+    const int bpl = (img.width() * img.depth() + 7) / 8;
 
-            if (!ignoreB && *ptr < maxB)
-                *ptr = (uchar)qRound(255.0f * ((float)*ptr - minB) / (maxB - minB));
-            else if (!ignoreB)
-                *ptr = 255;
-            ptr++;
-            cIdx++;
+    // detach once in this thread - scanLine() is not thread-safe
+    uchar *bits = img.bits();
+    const int stride = img.bytesPerLine();
 
-            if (channels == 4) {
-                ptr++;
-                cIdx++;
-            }
+    parallelRows(img.height(), [&](int start, int end) {
+        for (int rIdx = start; rIdx < end; rIdx++) {
+            uchar *ptr = bits + (qint64)rIdx * stride;
+
+            for (int cIdx = 0; cIdx < bpl; cIdx++)
+                ptr[cIdx] = lut[ptr[cIdx]];
         }
-        ptr += pad;
-    }
+    });
+}
 
-    qDebug() << "[Auto Adjust] image adjusted in: " << dt;
+/**
+ * Maps the first three channels of an interleaved 8bit image.
+ * Any further channel (e.g. alpha) is kept.
+ * @param img the image that is changed in place
+ * @param lut0 look-up table of the first channel
+ * @param lut1 look-up table of the second channel
+ * @param lut2 look-up table of the third channel
+ * @param channels the number of bytes per pixel (3 or 4)
+ **/
+void DkImage::mapLut(QImage &img, const uchar *lut0, const uchar *lut1, const uchar *lut2, int channels)
+{
+    const int w = img.width();
 
-    return true;
+    // detach once in this thread - scanLine() is not thread-safe
+    uchar *bits = img.bits();
+    const int stride = img.bytesPerLine();
+
+    parallelRows(img.height(), [&](int start, int end) {
+        for (int rIdx = start; rIdx < end; rIdx++) {
+            uchar *ptr = bits + (qint64)rIdx * stride;
+
+            for (int cIdx = 0; cIdx < w; cIdx++, ptr += channels) {
+                ptr[0] = lut0[ptr[0]];
+                ptr[1] = lut1[ptr[1]];
+                ptr[2] = lut2[ptr[2]];
+            }
+        }
+    });
 }
 
 uchar DkImage::findHistPeak(const int *hist, float quantile)
@@ -762,37 +785,32 @@ QImage DkImage::hueSaturation(const QImage &src, int hue, int sat, int brightnes
 
     cv::cvtColor(hsvImg, hsvImg, CV_BGR2HSV);
 
+    // hue is in [0 180) for 8bit images
+    uchar hueLut[256], satLut[256], valLut[256];
+    for (int idx = 0; idx < 256; idx++) {
+        int h = idx + hue;
+        if (h < 0)
+            h += 180;
+        if (h >= 180)
+            h -= 180;
+
+        hueLut[idx] = (uchar)qBound(0, h, 255);
+        satLut[idx] = (uchar)qBound(0, qRound(idx * satN), 255);
+        valLut[idx] = (uchar)qBound(0, idx + brightnessN, 255);
+    }
+
     // apply hue/saturation changes
-    for (int rIdx = 0; rIdx < hsvImg.rows; rIdx++) {
-        unsigned char *iPtr = hsvImg.ptr<unsigned char>(rIdx);
-
-        for (int cIdx = 0; cIdx < hsvImg.cols * 3; cIdx += 3) {
-            // adopt hue
-            int h = iPtr[cIdx] + hue;
-            if (h < 0)
-                h += 180;
-            if (h >= 180)
-                h -= 180;
-
-            iPtr[cIdx] = (unsigned char)h;
-
-            // adopt value
-            int v = iPtr[cIdx + 2] + brightnessN;
-            if (v < 0)
-                v = 0;
-            if (v > 255)
-                v = 255;
-            iPtr[cIdx + 2] = (unsigned char)v;
-
-            // adopt saturation
-            int s = qRound(iPtr[cIdx + 1] * satN);
-            if (s < 0)
-                s = 0;
-            if (s > 255)
-                s = 255;
-            iPtr[cIdx + 1] = (unsigned char)s;
+    parallelRows(hsvImg.rows, [&](int start, int end) {
+        for (int rIdx = start; rIdx < end; rIdx++) {
+            unsigned char *iPtr = hsvImg.ptr<unsigned char>(rIdx);
+
+            for (int cIdx = 0; cIdx < hsvImg.cols * 3; cIdx += 3) {
+                iPtr[cIdx] = hueLut[iPtr[cIdx]];
+                iPtr[cIdx + 1] = satLut[iPtr[cIdx + 1]];
+                iPtr[cIdx + 2] = valLut[iPtr[cIdx + 2]];
+            }
         }
-    }
+    });
 
     cv::cvtColor(hsvImg, hsvImg, CV_HSV2BGR);
     imgR = DkImage::mat2QImage(hsvImg);
@@ -1310,51 +1328,204 @@ void DkImage::tinyPlanet(QImage &img, double scaleLog, double angle, QSize s, bo
 
 bool DkImage::gaussianBlur(QImage &img, float sigma)
 {
-#ifdef WITH_OPENCV
-    DkTimer dt;
-    cv::Mat imgCv = DkImage::qImage2Mat(img);
+    if (img.isNull() || sigma <= 0.0f)
+        return false;
 
-    cv::Mat imgG;
-    cv::Mat gx = cv::getGaussianKernel(qRound(4 * sigma + 1), sigma);
-    cv::Mat gy = gx.t();
-    cv::sepFilter2D(imgCv, imgG, CV_8U, gx, gy);
-    img = DkImage::mat2QImage(imgG);
+    DkTimer dt;
 
-    qDebug() << "gaussian blur takes: " << dt;
-#else
-    Q_UNUSED(img);
-    Q_UNUSED(sigma);
+#ifdef WITH_OPENCV
+    // small kernels are cheap - so keep the exact gaussian
+    // larger ones are approximated by box filters (constant costs per pixel)
+    if (sigma < 3.0f) {
+        cv::Mat imgCv = DkImage::qImage2Mat(img);
+
+        cv::Mat imgG;
+        cv::Mat gx = cv::getGaussianKernel(qRound(4 * sigma + 1), sigma);
+        cv::Mat gy = gx.t();
+        cv::sepFilter2D(imgCv, imgG, CV_8U, gx, gy);
+        img = DkImage::mat2QImage(imgG);
+
+        qDebug() << "gaussian blur takes: " << dt;
+        return true;
+    }
 #endif
 
+    boxBlur(img, sigma);
+    qDebug() << "box blur (sigma" << sigma << ") takes: " << dt;
+
     return true;
 }
 
 bool DkImage::unsharpMask(QImage &img, float sigma, float weight)
 {
-#ifdef WITH_OPENCV
     DkTimer dt;
-    // DkImage::gammaToLinear(img);
-    cv::Mat imgCv = DkImage::qImage2Mat(img);
 
-    cv::Mat imgG;
-    cv::Mat gx = cv::getGaussianKernel(qRound(4 * sigma + 1), sigma);
-    cv::Mat gy = gx.t();
-    cv::sepFilter2D(imgCv, imgG, CV_8U, gx, gy);
-    // cv::GaussianBlur(imgCv, imgG, cv::Size(4*sigma+1, 4*sigma+1), sigma);		// this is awesomely slow
-    cv::addWeighted(imgCv, weight, imgG, 1 - weight, 0, imgCv);
-    img = DkImage::mat2QImage(imgCv);
+    QImage imgG = img.copy();
+    if (!gaussianBlur(imgG, sigma))
+        return false;
 
+    bool ok = unsharpMask(img, imgG, weight);
     qDebug() << "unsharp mask takes: " << dt;
-    // DkImage::linearToGamma(img);
-#else
-    Q_UNUSED(img);
-    Q_UNUSED(sigma);
-    Q_UNUSED(weight);
-#endif
+
+    return ok;
+}
+
+/**
+ * Sharpens img using an already blurred copy of it.
+ * This allows for changing the weight without blurring again.
+ * @param img the image that is sharpened in place
+ * @param blurred img blurred with gaussianBlur()
+ * @param weight the weight of the original image (> 1 sharpens)
+ * @return bool false if the images do not match
+ **/
+bool DkImage::unsharpMask(QImage &img, const QImage &blurred, float weight)
+{
+    if (img.isNull() || img.size() != blurred.size() || img.format() != blurred.format())
+        return false;
+
+    // img * weight + blurred * (1 - weight) in 8 bit fixed point
+    const int w = qRound(weight * 256.0f);
+    const int bpl = (img.width() * img.depth() + 7) / 8;
+
+    uchar *bits = img.bits();
+    const int stride = img.bytesPerLine();
+
+    parallelRows(img.height(), [&](int start, int end) {
+        for (int rIdx = start; rIdx < end; rIdx++) {
+            uchar *ptr = bits + (qint64)rIdx * stride;
+            const uchar *bPtr = blurred.constScanLine(rIdx);
+
+            for (int cIdx = 0; cIdx < bpl; cIdx++) {
+                int v = (ptr[cIdx] * w + bPtr[cIdx] * (256 - w) + 128) >> 8;
+                ptr[cIdx] = (uchar)qBound(0, v, 255);
+            }
+        }
+    });
 
     return true;
 }
 
+/**
+ * Approximates a gaussian with three stacked box filters.
+ * Running sums make the costs independent of sigma.
+ * Rows are filtered in parallel, columns are filtered in parallel
+ * blocks of adjacent columns so that memory is read row by row.
+ * @param img the image that is blurred in place
+ * @param sigma the standard deviation of the gaussian
+ **/
+void DkImage::boxBlur(QImage &img, float sigma)
+{
+    // we work on interleaved 8 bit channels
+    switch (img.format()) {
+    case QImage::Format_Grayscale8:
+    case QImage::Format_RGB888:
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+    case QImage::Format_RGBX8888:
+    case QImage::Format_RGBA8888:
+    case QImage::Format_RGBA8888_Premultiplied:
+        break;
+    default:
+        img = img.convertToFormat(img.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+    }
+
+    const int channels = img.depth() / 8;
+    const int w = img.width();
+    const int h = img.height();
+    const int bpl = w * channels;
+    const int stride = img.bytesPerLine();
+
+    uchar *bits = img.bits();
+    QVector<uchar> tmp((qint64)bpl * h);
+    uchar *tBits = tmp.data();
+
+    for (int r : boxRadii(sigma, 3)) {
+        // running sums are scaled with a 24 bit fixed point reciprocal
+        const quint64 mul = ((quint64(1) << 24) + r) / (2 * r + 1);
+
+        // horizontal: img -> tmp
+        parallelRows(h, [&](int start, int end) {
+            for (int rIdx = start; rIdx < end; rIdx++) {
+                const uchar *src = bits + (qint64)rIdx * stride;
+                uchar *dst = tBits + (qint64)rIdx * bpl;
+
+                for (int ch = 0; ch < channels; ch++) {
+                    // replicate the border
+                    quint32 sum = (r + 1) * src[ch];
+                    for (int idx = 1; idx <= r; idx++)
+                        sum += src[qMin(idx, w - 1) * channels + ch];
+
+                    for (int x = 0; x < w; x++) {
+                        dst[x * channels + ch] = (uchar)((sum * mul + (1 << 23)) >> 24);
+                        sum += src[qMin(x + r + 1, w - 1) * channels + ch];
+                        sum -= src[qMax(x - r, 0) * channels + ch];
+                    }
+                }
+            }
+        });
+
+        // vertical: tmp -> img
+        parallelRows(
+            bpl,
+            [&](int start, int end) {
+                QVector<quint32> sums(end - start);
+                quint32 *sum = sums.data();
+                const int n = end - start;
+
+                const uchar *first = tBits + start;
+                for (int cIdx = 0; cIdx < n; cIdx++)
+                    sum[cIdx] = (r + 1) * first[cIdx];
+
+                for (int idx = 1; idx <= r; idx++) {
+                    const uchar *row = tBits + (qint64)qMin(idx, h - 1) * bpl + start;
+                    for (int cIdx = 0; cIdx < n; cIdx++)
+                        sum[cIdx] += row[cIdx];
+                }
+
+                for (int y = 0; y < h; y++) {
+                    uchar *dst = bits + (qint64)y * stride + start;
+                    const uchar *add = tBits + (qint64)qMin(y + r + 1, h - 1) * bpl + start;
+                    const uchar *sub = tBits + (qint64)qMax(y - r, 0) * bpl + start;
+
+                    for (int cIdx = 0; cIdx < n; cIdx++) {
+                        dst[cIdx] = (uchar)((sum[cIdx] * mul + (1 << 23)) >> 24);
+                        sum[cIdx] += add[cIdx];
+                        sum[cIdx] -= sub[cIdx];
+                    }
+                }
+            },
+            256);
+    }
+}
+
+/**
+ * Computes the radii of numBoxes box filters that approximate a gaussian.
+ * See W. Wells: Efficient Synthesis of Gaussian Filters by Cascaded Uniform Filters (1986).
+ * @param sigma the standard deviation of the gaussian
+ * @param numBoxes the number of box filters
+ * @return QVector<int> the box radii
+ **/
+QVector<int> DkImage::boxRadii(float sigma, int numBoxes)
+{
+    // ideal width of equal boxes
+    double wIdeal = qSqrt(12.0 * sigma * sigma / numBoxes + 1.0);
+    int wl = qFloor(wIdeal);
+    if (wl % 2 == 0)
+        wl--;
+    int wu = wl + 2;
+
+    // m boxes get the lower width so that the variances sum up to sigma^2
+    double mIdeal = (12.0 * sigma * sigma - numBoxes * wl * wl - 4.0 * numBoxes * wl - 3.0 * numBoxes) / (-4.0 * wl - 4.0);
+    int m = qRound(mIdeal);
+
+    QVector<int> radii;
+    for (int idx = 0; idx < numBoxes; idx++)
+        radii << ((idx < m ? wl : wu) - 1) / 2;
+
+    return radii;
+}
+
 QImage DkImage::createThumb(const QImage &image, int maxSize)
 {
     if (image.isNull())
@@ -1496,10 +1667,16 @@ void DkImageStorage::init()
     mSize = QSize();
 }
 
-void DkImageStorage::setImage(const QImage &img)
+/**
+ * Sets the image.
+ * @param img the image
+ * @param orientation the transform that displays img upright (e.g. its Exif orientation)
+ **/
+void DkImageStorage::setImage(const QImage &img, DkJpgTransform::Transform orientation)
 {
     init();
     mImg = img;
+    mOrientation = orientation == DkJpgTransform::transform_invalid ? DkJpgTransform::transform_identity : orientation;
 
     mComputeState = l_cancelled;
 }
@@ -1517,15 +1694,43 @@ void DkImageStorage::antiAliasingChanged(bool antiAliasing)
 
 QImage DkImageStorage::imageConst() const
 {
+    // rotate the pixels only if someone needs them
+    if (mOrientation != DkJpgTransform::transform_identity) {
+        mImg = DkJpgTransform::apply(mImg, mOrientation);
+        mOrientation = DkJpgTransform::transform_identity;
+    }
+
     return mImg;
 }
 
 QImage DkImageStorage::image(const QSize &size)
 {
+    QTransform imgTransform;
+    QImage img = image(size, imgTransform);
+
+    if (!imgTransform.isIdentity())
+        img = imageConst();
+
+    return img;
+}
+
+/**
+ * Returns the image that is best suited for rendering it with size.
+ * Other than image(), the full resolution image is returned as is.
+ * @param size the size of the image on the screen
+ * @param imgTransform is set to the transform that maps the returned image to the upright image
+ * @return QImage the image
+ **/
+QImage DkImageStorage::image(const QSize &size, QTransform &imgTransform)
+{
+    imgTransform.reset();
+
     if (size.isEmpty() || mImg.isNull() || !DkSettingsManager::param().display().antiAliasing || // user disabled?
-        mImg.size().width() < size.width() // scale factor > 1?
-    )
+        this->size().width() < size.width() // scale factor > 1?
+    ) {
+        imgTransform = QImage::trueMatrix(DkJpgTransform::toQTransform(mOrientation), mImg.width(), mImg.height());
         return mImg;
+    }
 
     if (mScaledImg.size() == size)
         return mScaledImg;
@@ -1538,9 +1743,42 @@ QImage DkImageStorage::image(const QSize &size)
     }
 
     // currently no alternative is available
+    imgTransform = QImage::trueMatrix(DkJpgTransform::toQTransform(mOrientation), mImg.width(), mImg.height());
     return mImg;
 }
 
+/**
+ * Starts computing the image for size right away.
+ * Other than image(), this does not wait for further size changes.
+ * Call it once a new image is set to have the display sized image ready soon.
+ * @param size the size of the image on the screen
+ **/
+void DkImageStorage::prefetch(const QSize &size)
+{
+    if (size.isEmpty() || mImg.isNull() || !DkSettingsManager::param().display().antiAliasing || this->size().width() <= size.width())
+        return;
+
+    if (mScaledImg.size() == size || mComputeState == l_computing)
+        return;
+
+    init();
+    mSize = size;
+    compute();
+}
+
+/**
+ * Returns true if image() can return the final image for size right away.
+ * If not, imageUpdated() is emitted once it is computed.
+ * @param size the size of the image on the screen
+ **/
+bool DkImageStorage::isReady(const QSize &size) const
+{
+    if (size.isEmpty() || mImg.isNull() || !DkSettingsManager::param().display().antiAliasing || this->size().width() <= size.width())
+        return true;
+
+    return mScaledImg.size() == size;
+}
+
 void DkImageStorage::cancel()
 {
     mComputeState = l_cancelled;
@@ -1559,15 +1797,18 @@ void DkImageStorage::compute()
 
     mComputeState = l_computing;
 
-    mFutureWatcher.setFuture(QtConcurrent::run(this, &nmc::DkImageStorage::computeIntern, mImg, mSize));
+    mFutureWatcher.setFuture(QtConcurrent::run(this, &nmc::DkImageStorage::computeIntern, mImg, mSize, mOrientation));
 }
 
-QImage DkImageStorage::computeIntern(const QImage &src, const QSize &size)
+QImage DkImageStorage::computeIntern(const QImage &src, const QSize &size, DkJpgTransform::Transform orientation)
 {
+    // the image is resized in its original orientation and the (small) result is rotated
+    QSize s = DkJpgTransform::transformedSize(size, orientation);
+
     // should not happen
-    if (size.width() >= mImg.width()) {
+    if (s.width() >= src.width()) {
         qWarning() << "DkImageStorage::computeIntern was called without a need...";
-        return src;
+        return DkJpgTransform::apply(src, orientation);
     }
 
     DkTimer dt;
@@ -1582,13 +1823,11 @@ QImage DkImageStorage::computeIntern(const QImage &src, const QSize &size)
         }
 
         // for extreme panorama images the Qt scaling crashes (if we have a width > 30000) so we simply
-        if (cs != mImg.size()) {
+        if (cs != src.size()) {
             resizedImg = resizedImg.scaled(cs, Qt::KeepAspectRatio, Qt::FastTransformation);
         }
     }
 
-    QSize s = mSize;
-
     if (s.height() == 0)
         s.setHeight(1);
     if (s.width() == 0)
@@ -1607,7 +1846,7 @@ QImage DkImageStorage::computeIntern(const QImage &src, const QSize &size)
     resizedImg = resizedImg.scaled(s, Qt::KeepAspectRatio, Qt::SmoothTransformation);
 #endif
 
-    return resizedImg;
+    return DkJpgTransform::apply(resizedImg, orientation);
 }
 
 void DkImageStorage::imageComputed()
@@ -1621,9 +1860,10 @@ void DkImageStorage::imageComputed()
 
     mComputeState = (mScaledImg.isNull()) ? l_empty : l_computed;
 
-    if (mComputeState == l_computed)
-        emit imageUpdated();
-    else
+    if (mComputeState != l_computed)
         qWarning() << "could not compute interpolated image...";
+
+    // notify anyways - someone might wait for the image
+    emit imageUpdated();
 }
 }
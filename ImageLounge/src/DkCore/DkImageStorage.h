@@ -33,6 +33,7 @@
 #include <QImage>
 #include <QObject>
 #include <QVector>
+#include <functional>
 
 // opencv
 #ifdef WITH_OPENCV
@@ -42,6 +43,8 @@
 #endif
 #pragma warning(pop) // no warnings from includes - end
 
+#include "DkJpgTransform.h"
+
 #ifdef Q_OS_WIN
 #pragma warning(disable : 4251) // TODO: remove
 #pragma warning(disable : 4714) // Qt's force inline
@@ -94,6 +97,8 @@ public:
     static void tinyPlanet(QImage &img, double scaleLog, double angle, QSize s, bool invert = false);
 #endif
 
+    static void parallelRows(int numRows, const std::function<void(int, int)> &fn, int minRows = 32);
+
     static QString getBufferSize(const QImage &img);
     static QString getBufferSize(const QSize &imgSize, const int depth);
     static float getBufferSizeFloat(const QSize &imgSize, const int depth);
@@ -112,6 +117,7 @@ public:
     static bool autoAdjustImage(QImage &img);
     static bool gaussianBlur(QImage &img, float sigma = 20.0f);
     static bool unsharpMask(QImage &img, float sigma = 20.0f, float weight = 1.5f);
+    static bool unsharpMask(QImage &img, const QImage &blurred, float weight);
     static bool alphaChannelUsed(const QImage &img);
     static QImage thresholdImage(const QImage &img, double thr, bool color = false);
     static QImage rotate(const QImage &img, double angle);
@@ -145,6 +151,10 @@ public:
 
 private:
     static QImage rotateSimple(const QImage &img, double angle);
+    static void boxBlur(QImage &img, float sigma);
+    static QVector<int> boxRadii(float sigma, int numBoxes);
+    static void mapLut(QImage &img, const uchar *lut);
+    static void mapLut(QImage &img, const uchar *lut0, const uchar *lut1, const uchar *lut2, int channels);
 };
 
 class DllCoreExport DkImageStorage : public QObject
@@ -171,12 +181,15 @@ public:
 
     QSize size() const
     {
-        return mImg.size();
+        return DkJpgTransform::transformedSize(mImg.size(), mOrientation);
     };
 
-    void setImage(const QImage &img);
+    void setImage(const QImage &img, DkJpgTransform::Transform orientation = DkJpgTransform::transform_identity);
     QImage imageConst() const;
     QImage image(const QSize &size = QSize());
+    QImage image(const QSize &size, QTransform &imgTransform);
+    void prefetch(const QSize &size);
+    bool isReady(const QSize &size) const;
     void cancel();
 
 public slots:
@@ -189,7 +202,9 @@ signals:
     void infoSignal(const QString &msg) const;
 
 protected:
-    QImage mImg;
+    // mImg is rotated by mOrientation once its pixels are needed upright
+    mutable QImage mImg;
+    mutable DkJpgTransform::Transform mOrientation = DkJpgTransform::transform_identity;
     QImage mScaledImg;
     QSize mSize;
 
@@ -198,7 +213,7 @@ protected:
 
     ComputeState mComputeState = l_not_computed;
 
-    QImage computeIntern(const QImage &src, const QSize &size);
+    QImage computeIntern(const QImage &src, const QSize &size, DkJpgTransform::Transform orientation);
     void init();
 };
 //
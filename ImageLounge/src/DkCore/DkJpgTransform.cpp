@@ -0,0 +1,379 @@
+/*******************************************************************************************************
+ DkJpgTransform.cpp
+ Created on:	19.10.2026
+
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+
+ Copyright (C) 2011-2026 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2026 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2026 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkJpgTransform.h"
+#include "DkMetaData.h"
+#include "DkSettings.h"
+
+#pragma warning(push, 0) // no warnings from includes - begin
+#include <QDebug>
+#include <QFileInfo>
+#include <QImage>
+
+#include <cstring>
+
+#ifdef WITH_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+#pragma warning(pop) // no warnings from includes - end
+
+namespace nmc
+{
+
+namespace
+{
+// the transforms as integer matrices (x' = a*x + b*y, y' = c*x + d*y) - y points down
+const int transformMatrix[DkJpgTransform::transform_end][4] = {
+    {1, 0, 0, 1}, // identity
+    {-1, 0, 0, 1}, // flip horizontally
+    {-1, 0, 0, -1}, // rotate 180
+    {1, 0, 0, -1}, // flip vertically
+    {0, 1, 1, 0}, // transpose
+    {0, -1, 1, 0}, // rotate 90 cw
+    {0, -1, -1, 0}, // transverse
+    {0, 1, -1, 0}, // rotate 270 cw
+};
+
+bool isTransposed(DkJpgTransform::Transform t)
+{
+    return t != DkJpgTransform::transform_invalid && transformMatrix[t][0] == 0;
+}
+
+#ifdef WITH_TURBOJPEG
+int toTjOp(DkJpgTransform::Transform t)
+{
+    switch (t) {
+    case DkJpgTransform::transform_flip_h:
+        return TJXOP_HFLIP;
+    case DkJpgTransform::transform_rotate_180:
+        return TJXOP_ROT180;
+    case DkJpgTransform::transform_flip_v:
+        return TJXOP_VFLIP;
+    case DkJpgTransform::transform_transpose:
+        return TJXOP_TRANSPOSE;
+    case DkJpgTransform::transform_rotate_90:
+        return TJXOP_ROT90;
+    case DkJpgTransform::transform_transverse:
+        return TJXOP_TRANSVERSE;
+    case DkJpgTransform::transform_rotate_270:
+        return TJXOP_ROT270;
+    default:
+        return TJXOP_NONE;
+    }
+}
+#endif
+}
+
+// DkJpgTransform --------------------------------------------------------------------
+bool DkJpgTransform::isAvailable()
+{
+#ifdef WITH_TURBOJPEG
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool DkJpgTransform::isJpg(const QString &filePath)
+{
+    QString suffix = QFileInfo(filePath).suffix().toLower();
+    return suffix == "jpg" || suffix == "jpeg" || suffix == "jpe" || suffix == "jfif";
+}
+
+/**
+ * Maps a (clockwise) rotation angle to a transform.
+ * @param angle the angle in degrees
+ * @return Transform transform_invalid if angle is not a multiple of 90
+ **/
+DkJpgTransform::Transform DkJpgTransform::fromAngle(int angle)
+{
+    switch (((angle % 360) + 360) % 360) {
+    case 0:
+        return transform_identity;
+    case 90:
+        return transform_rotate_90;
+    case 180:
+        return transform_rotate_180;
+    case 270:
+        return transform_rotate_270;
+    default:
+        return transform_invalid;
+    }
+}
+
+/**
+ * Returns the transform that DkBasicLoader applies to display a jpg upright.
+ * Like the loader, we only consider the rotation of the Exif orientation.
+ **/
+DkJpgTransform::Transform DkJpgTransform::exifTransform(const QSharedPointer<DkMetaDataT> &metaData)
+{
+    if (!metaData || DkSettingsManager::param().metaData().ignoreExifOrientation)
+        return transform_identity;
+
+    int angle = metaData->getOrientationDegree();
+
+    return angle == -1 ? transform_identity : fromAngle(angle);
+}
+
+/**
+ * Returns the transform that is equivalent to applying first and then second.
+ **/
+DkJpgTransform::Transform DkJpgTransform::combine(Transform first, Transform second)
+{
+    if (first == transform_invalid || second == transform_invalid)
+        return transform_invalid;
+
+    const int *f = transformMatrix[first];
+    const int *s = transformMatrix[second];
+
+    // second * first
+    int m[4] = {s[0] * f[0] + s[1] * f[2], s[0] * f[1] + s[1] * f[3], s[2] * f[0] + s[3] * f[2], s[2] * f[1] + s[3] * f[3]};
+
+    for (int idx = 0; idx < transform_end; idx++) {
+        const int *t = transformMatrix[idx];
+        if (t[0] == m[0] && t[1] == m[1] && t[2] == m[2] && t[3] == m[3])
+            return (Transform)idx;
+    }
+
+    return transform_invalid;
+}
+
+QTransform DkJpgTransform::toQTransform(Transform t)
+{
+    if (t == transform_invalid)
+        return QTransform();
+
+    const int *m = transformMatrix[t];
+    return QTransform(m[0], m[2], m[1], m[3], 0, 0);
+}
+
+QSize DkJpgTransform::transformedSize(const QSize &size, Transform t)
+{
+    return isTransposed(t) ? size.transposed() : size;
+}
+
+/**
+ * Transforms the pixels of img.
+ * This is what viewers avoid by drawing with toQTransform().
+ * @param img the image
+ * @param t the transform
+ * @return QImage the transformed image
+ **/
+QImage DkJpgTransform::apply(const QImage &img, Transform t)
+{
+    if (img.isNull() || t == transform_invalid || t == transform_identity)
+        return img;
+
+    return img.transformed(toQTransform(t));
+}
+
+/**
+ * Reads the jpg header.
+ * @param jpg the jpg file
+ * @param mcuSize if not null, the size of the minimum coded unit is returned
+ * @return QSize the image size or an empty size if the header is not supported
+ **/
+QSize DkJpgTransform::imageSize(const QByteArray &jpg, QSize *mcuSize)
+{
+    QSize size;
+
+#ifdef WITH_TURBOJPEG
+    tjhandle handle = tjInitDecompress();
+
+    if (!handle)
+        return size;
+
+    int width = 0, height = 0, subsamp = 0, colorspace = 0;
+    if (tjDecompressHeader3(handle,
+                            reinterpret_cast<const unsigned char *>(jpg.constData()),
+                            (unsigned long)jpg.size(),
+                            &width,
+                            &height,
+                            &subsamp,
+                            &colorspace)
+            == 0
+        && subsamp >= 0 && subsamp < TJ_NUMSAMP) {
+        size = QSize(width, height);
+
+        if (mcuSize)
+            *mcuSize = QSize(tjMCUWidth[subsamp], tjMCUHeight[subsamp]);
+    }
+
+    tjDestroy(handle);
+#else
+    Q_UNUSED(jpg);
+    Q_UNUSED(mcuSize);
+#endif
+
+    return size;
+}
+
+/**
+ * Checks if the transform is lossless (no partial MCUs are dropped).
+ * @param jpg the jpg file
+ * @param t the transform
+ * @param crop the crop rectangle in transformed coordinates (optional)
+ * @return bool true if transform() will succeed
+ **/
+bool DkJpgTransform::canTransform(const QByteArray &jpg, Transform t, const QRect &crop)
+{
+    if (!isAvailable() || t == transform_invalid)
+        return false;
+
+    QSize mcu;
+    QSize size = imageSize(jpg, &mcu);
+
+    if (size.isEmpty() || mcu.isEmpty())
+        return false;
+
+    // edges that end up on the top/left must not have partial MCUs
+    bool wOk = size.width() % mcu.width() == 0;
+    bool hOk = size.height() % mcu.height() == 0;
+    bool ok = true;
+
+    switch (t) {
+    case transform_flip_h:
+    case transform_rotate_270:
+        ok = wOk;
+        break;
+    case transform_flip_v:
+    case transform_rotate_90:
+        ok = hOk;
+        break;
+    case transform_rotate_180:
+    case transform_transverse:
+        ok = wOk && hOk;
+        break;
+    default:
+        break;
+    }
+
+    if (ok && !crop.isNull()) {
+        // MCUs of transposed images are transposed too - so we check the larger side
+        int m = qMax(mcu.width(), mcu.height());
+        QRect r(QPoint(), transformedSize(size, t));
+
+        ok = !crop.isEmpty() && r.contains(crop) && crop.x() % m == 0 && crop.y() % m == 0;
+    }
+
+    return ok;
+}
+
+/**
+ * Transforms the jpg without decoding it.
+ * All markers (Exif, ICC profiles, comments) are copied.
+ * Use updateMetaData() to fix the Exif orientation, size and thumbnail.
+ * @param src the jpg file
+ * @param dst the transformed jpg file
+ * @param t the transform
+ * @param crop the crop rectangle in transformed coordinates (optional)
+ * @return bool true if the image was transformed
+ **/
+bool DkJpgTransform::transform(const QByteArray &src, QByteArray &dst, Transform t, const QRect &crop)
+{
+    if (t == transform_identity && crop.isNull()) {
+        dst = src;
+        return true;
+    }
+
+    bool transformed = false;
+
+#ifdef WITH_TURBOJPEG
+    tjhandle handle = tjInitTransform();
+
+    if (!handle)
+        return false;
+
+    tjtransform xform;
+    memset(&xform, 0, sizeof(xform));
+    xform.op = toTjOp(t);
+    xform.options = TJXOPT_PERFECT;
+
+    if (!crop.isNull()) {
+        xform.options |= TJXOPT_CROP;
+        xform.r.x = crop.x();
+        xform.r.y = crop.y();
+        xform.r.w = crop.width();
+        xform.r.h = crop.height();
+    }
+
+    unsigned char *dstBuf = 0;
+    unsigned long dstSize = 0;
+
+    if (tjTransform(handle, reinterpret_cast<const unsigned char *>(src.constData()), (unsigned long)src.size(), 1, &dstBuf, &dstSize, &xform, 0) == 0) {
+        dst = QByteArray(reinterpret_cast<const char *>(dstBuf), (int)dstSize);
+        transformed = true;
+    } else
+        qInfo() << "[DkJpgTransform] lossless transform failed:" << tjGetErrorStr();
+
+    tjFree(dstBuf);
+    tjDestroy(handle);
+#else
+    Q_UNUSED(dst);
+#endif
+
+    return transformed;
+}
+
+/**
+ * Updates the metadata of a transformed jpg.
+ * The orientation is cleared, the size is updated and the Exif thumbnail is transformed too.
+ * @param metaData the metadata of the source image
+ * @param size the size of the source image
+ * @param t the transform
+ * @param crop the crop rectangle in transformed coordinates (optional)
+ **/
+void DkJpgTransform::updateMetaData(const QSharedPointer<DkMetaDataT> &metaData, const QSize &size, Transform t, const QRect &crop)
+{
+    if (!metaData || !metaData->isLoaded() || t == transform_invalid)
+        return;
+
+    QSize tSize = transformedSize(size, t);
+    QSize dstSize = crop.isNull() ? tSize : crop.size();
+
+    metaData->setExifValue("Exif.Image.ImageWidth", QString::number(dstSize.width()));
+    metaData->setExifValue("Exif.Image.ImageLength", QString::number(dstSize.height()));
+    metaData->clearOrientation();
+
+    QImage thumb = metaData->getThumbnail();
+
+    if (thumb.isNull())
+        return;
+
+    thumb = thumb.transformed(toQTransform(t));
+
+    if (!crop.isNull() && !tSize.isEmpty()) {
+        double sx = (double)thumb.width() / tSize.width();
+        double sy = (double)thumb.height() / tSize.height();
+        QRect tc(qRound(crop.x() * sx), qRound(crop.y() * sy), qMax(qRound(crop.width() * sx), 1), qMax(qRound(crop.height() * sy), 1));
+        thumb = thumb.copy(tc);
+    }
+
+    metaData->setThumbnail(thumb);
+}
+
+}
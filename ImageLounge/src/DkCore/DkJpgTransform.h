@@ -0,0 +1,94 @@
+/*******************************************************************************************************
+ DkJpgTransform.h
+ Created on:	19.10.2026
+
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+
+ Copyright (C) 2011-2026 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2026 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2026 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0) // no warnings from includes - begin
+#include <QByteArray>
+#include <QImage>
+#include <QRect>
+#include <QSharedPointer>
+#include <QSize>
+#include <QString>
+#include <QTransform>
+#pragma warning(pop) // no warnings from includes - end
+
+#ifndef DllCoreExport
+#ifdef DK_CORE_DLL_EXPORT
+#define DllCoreExport Q_DECL_EXPORT
+#elif DK_DLL_IMPORT
+#define DllCoreExport Q_DECL_IMPORT
+#else
+#define DllCoreExport Q_DECL_IMPORT
+#endif
+#endif
+
+namespace nmc
+{
+
+class DkMetaDataT;
+
+/**
+ * Lossless rotation, flipping and cropping of jpgs (like jpegtran).
+ * The DCT coefficients are rearranged instead of decoding and re-encoding the image.
+ * This requires TurboJPEG (WITH_TURBOJPEG) - isAvailable() is false otherwise.
+ **/
+class DllCoreExport DkJpgTransform
+{
+public:
+    // ordered like the Exif orientations (1-8) that need the transform to be displayed upright
+    enum Transform {
+        transform_invalid = -1, // not a lossless transform
+        transform_identity = 0,
+        transform_flip_h,
+        transform_rotate_180,
+        transform_flip_v,
+        transform_transpose,
+        transform_rotate_90, // clockwise
+        transform_transverse,
+        transform_rotate_270,
+
+        transform_end
+    };
+
+    static bool isAvailable();
+    static bool isJpg(const QString &filePath);
+
+    static Transform fromAngle(int angle);
+    static Transform exifTransform(const QSharedPointer<DkMetaDataT> &metaData);
+    static Transform combine(Transform first, Transform second);
+    static QTransform toQTransform(Transform t);
+    static QSize transformedSize(const QSize &size, Transform t);
+    static QImage apply(const QImage &img, Transform t);
+
+    static QSize imageSize(const QByteArray &jpg, QSize *mcuSize = 0);
+    static bool canTransform(const QByteArray &jpg, Transform t, const QRect &crop = QRect());
+    static bool transform(const QByteArray &src, QByteArray &dst, Transform t, const QRect &crop = QRect());
+    static void updateMetaData(const QSharedPointer<DkMetaDataT> &metaData, const QSize &size, Transform t, const QRect &crop = QRect());
+};
+
+}
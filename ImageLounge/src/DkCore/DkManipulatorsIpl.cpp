@@ -250,6 +250,37 @@ int DkBlurManipulator::sigma() const
     return mSigma;
 }
 
+// DkBlurCache --------------------------------------------------------------------
+/**
+ * Returns the cached blurred image.
+ * @param img the source image
+ * @param sigma the blur's sigma
+ * @return QImage the blurred image or a null image if img was not blurred with sigma
+ **/
+QImage DkBlurCache::blurred(const QImage &img, int sigma) const
+{
+    QMutexLocker locker(&mMutex);
+
+    if (mKey != img.cacheKey() || mSigma != sigma)
+        return QImage();
+
+    return mBlurred;
+}
+
+void DkBlurCache::setBlurred(const QImage &img, int sigma, const QImage &blurred)
+{
+    QMutexLocker locker(&mMutex);
+
+    mKey = img.cacheKey();
+    mSigma = sigma;
+    mBlurred = blurred;
+}
+
+void DkBlurCache::clear()
+{
+    setBlurred(QImage(), -1, QImage());
+}
+
 // DkUnsharpMaskManipulator --------------------------------------------------------------------
 DkUnsharpMaskManipulator::DkUnsharpMaskManipulator(QAction *action)
     : DkBaseManipulatorExt(action)
@@ -259,7 +290,23 @@ DkUnsharpMaskManipulator::DkUnsharpMaskManipulator(QAction *action)
 QImage DkUnsharpMaskManipulator::apply(const QImage &img) const
 {
     QImage imgC = img.copy();
-    DkImage::unsharpMask(imgC, (float)sigma(), 1.0f + amount() / 100.0f);
+
+    int s = sigma();
+    QImage blurred = mBlurCache ? mBlurCache->blurred(img, s) : QImage();
+
+    if (blurred.isNull()) {
+        blurred = img.copy();
+        DkImage::gaussianBlur(blurred, (float)s);
+
+        if (mBlurCache)
+            mBlurCache->setBlurred(img, s, blurred);
+    }
+
+    // the blur might have changed the format
+    if (blurred.format() != imgC.format())
+        imgC = imgC.convertToFormat(blurred.format());
+
+    DkImage::unsharpMask(imgC, blurred, 1.0f + amount() / 100.0f);
     return imgC;
 }
 
@@ -291,6 +338,15 @@ void DkUnsharpMaskManipulator::setAmount(int amount)
     action()->trigger();
 }
 
+/**
+ * Sets a cache for the blurred image.
+ * Only interactive edits should use it - batch processing blurs every image once anyway.
+ **/
+void DkUnsharpMaskManipulator::setBlurCache(QSharedPointer<DkBlurCache> cache)
+{
+    mBlurCache = cache;
+}
+
 int DkUnsharpMaskManipulator::amount() const
 {
     return mAmount;
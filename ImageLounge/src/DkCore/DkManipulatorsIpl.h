@@ -32,6 +32,8 @@
 
 #pragma warning(push, 0) // no warnings from includes
 #include <QAction>
+#include <QImage>
+#include <QMutex>
 #pragma warning(pop)
 
 #pragma warning(disable : 4251) // TODO: remove
@@ -161,6 +163,24 @@ private:
     int mSigma = 5;
 };
 
+/**
+ * Keeps the last blurred image of a source image.
+ * The unsharp mask widget uses it, so that changing the amount does not blur again.
+ **/
+class DllCoreExport DkBlurCache
+{
+public:
+    QImage blurred(const QImage &img, int sigma) const;
+    void setBlurred(const QImage &img, int sigma, const QImage &blurred);
+    void clear();
+
+private:
+    mutable QMutex mMutex;
+    qint64 mKey = 0;
+    int mSigma = -1;
+    QImage mBlurred;
+};
+
 class DllCoreExport DkUnsharpMaskManipulator : public DkBaseManipulatorExt
 {
 public:
@@ -175,9 +195,13 @@ public:
     void setAmount(int amount);
     int amount() const;
 
+    void setBlurCache(QSharedPointer<DkBlurCache> cache);
+
 private:
     int mSigma = 30;
     int mAmount = 15;
+
+    QSharedPointer<DkBlurCache> mBlurCache; // null if not edited interactively (e.g. batch)
 };
 
 class DllCoreExport DkRotateManipulator : public DkBaseManipulatorExt
@@ -422,4 +422,112 @@ std::ostream &DkRotatingRect::put(std::ostream &s)
     return s;
 }
 
+// DkPrefixSum --------------------------------------------------------------------
+DkPrefixSum::DkPrefixSum(int size)
+{
+    resize(size);
+}
+
+/**
+ * Initializes the prefix sums in O(n).
+ * @param values the values
+ **/
+void DkPrefixSum::assign(const QVector<int> &values)
+{
+    mValues = values;
+    mTree.fill(0, values.size() + 1);
+
+    for (int idx = 1; idx <= values.size(); idx++) {
+        mTree[idx] += values[idx - 1];
+
+        int p = idx + (idx & -idx);
+        if (p <= values.size())
+            mTree[p] += mTree[idx];
+    }
+}
+
+/**
+ * Resizes the prefix sums - all values are set to 0.
+ **/
+void DkPrefixSum::resize(int size)
+{
+    mValues.fill(0, size);
+    mTree.fill(0, size + 1);
+}
+
+int DkPrefixSum::size() const
+{
+    return mValues.size();
+}
+
+void DkPrefixSum::set(int idx, int value)
+{
+    if (idx < 0 || idx >= mValues.size())
+        return;
+
+    int delta = value - mValues[idx];
+
+    if (delta == 0)
+        return;
+
+    mValues[idx] = value;
+
+    for (int tIdx = idx + 1; tIdx < mTree.size(); tIdx += tIdx & -tIdx)
+        mTree[tIdx] += delta;
+}
+
+int DkPrefixSum::value(int idx) const
+{
+    if (idx < 0 || idx >= mValues.size())
+        return 0;
+
+    return mValues[idx];
+}
+
+/**
+ * Returns the sum of all values before idx.
+ * @param idx the (exclusive) end index
+ * @return int sum of [0, idx)
+ **/
+int DkPrefixSum::prefix(int idx) const
+{
+    int sum = 0;
+
+    for (int tIdx = qMin(idx, mValues.size()); tIdx > 0; tIdx -= tIdx & -tIdx)
+        sum += mTree[tIdx];
+
+    return sum;
+}
+
+int DkPrefixSum::total() const
+{
+    return prefix(mValues.size());
+}
+
+/**
+ * Returns the index whose range [prefix(idx), prefix(idx+1)) contains sum.
+ * Values must not be negative.
+ * @param sum the sum to search for
+ * @return int the index or size() if sum >= total()
+ **/
+int DkPrefixSum::upperBound(int sum) const
+{
+    int pos = 0;
+    int mask = 1;
+
+    while (mask * 2 < mTree.size())
+        mask *= 2;
+
+    for (; mask > 0; mask /= 2) {
+        int next = pos + mask;
+
+        if (next < mTree.size() && mTree[next] <= sum) {
+            pos = next;
+            sum -= mTree[next];
+        }
+    }
+
+    return pos;
+}
+
 }
@@ -31,6 +31,7 @@
 #include <QDebug>
 #include <QPointF>
 #include <QPolygonF>
+#include <QVector>
 #include <cmath>
 #include <float.h>
 #pragma warning(pop) // no warnings from includes - end
@@ -896,4 +897,30 @@ protected:
     QPolygonF mRect;
 };
 
+/**
+ * Prefix sums with logarithmic updates (Fenwick tree).
+ * Use it if single values change frequently and
+ * prefix sums (e.g. offsets) are queried.
+ **/
+class DllCoreExport DkPrefixSum
+{
+public:
+    DkPrefixSum(int size = 0);
+
+    void assign(const QVector<int> &values);
+    void resize(int size);
+    int size() const;
+
+    void set(int idx, int value);
+    int value(int idx) const;
+
+    int prefix(int idx) const;
+    int total() const;
+    int upperBound(int sum) const;
+
+protected:
+    QVector<int> mTree; // 1-based
+    QVector<int> mValues;
+};
+
 }
@@ -97,6 +97,8 @@ void DkMetaDataT::update(const QSharedPointer<DkMetaDataT> &other)
 
 void DkMetaDataT::readMetaData(const QString &filePath, QSharedPointer<QByteArray> ba)
 {
+    DkTraceScope ts("readMetaData", DkTraceLog::cat_metadata, filePath);
+
     if (mUseSidecar) {
         loadSidecar(filePath);
         return;
@@ -192,6 +194,53 @@ bool DkMetaDataT::saveMetaData(const QString &filePath, bool force)
     return true;
 }
 
+/**
+ * @brief saveMetaDataToFile() writes the metadata directly to filePath.
+ *
+ * Other than saveMetaData(filePath) the file is not loaded to a buffer first,
+ * Exiv2 works on the file itself. This is used by the save pipeline which writes
+ * a temporary file, so the file may be rewritten in place.
+ * If Exiv2 cannot open the path (unicode paths on Windows), we fall back to the buffer.
+ *
+ * @param filePath path to the (freshly written) image file
+ */
+bool DkMetaDataT::saveMetaDataToFile(const QString &filePath)
+{
+    if (mExifState != loaded && mExifState != dirty)
+        return false;
+
+    // Exiv2 opens files with the local 8 bit encoding
+    QByteArray encodedPath = QFile::encodeName(filePath);
+    if (QFile::decodeName(encodedPath) != filePath)
+        return saveMetaData(filePath, true);
+
+    qint64 oldSize = QFileInfo(filePath).size();
+
+    try {
+        Exiv2::Image::AutoPtr exifImgN = Exiv2::ImageFactory::open(encodedPath.toStdString());
+
+        if (exifImgN.get() == 0)
+            return false;
+
+        exifImgN->readMetadata();
+        exifImgN->setExifData(mExifImg->exifData());
+        exifImgN->setXmpData(mExifImg->xmpData());
+        exifImgN->setIptcData(mExifImg->iptcData());
+        exifImgN->writeMetadata();
+    } catch (...) {
+        qDebug() << "[DkMetaDataT] could not write metadata to" << filePath;
+        return false;
+    }
+
+    // catch exif bug - see saveMetaData(ba)
+    if (QFileInfo(filePath).size() <= qRound(oldSize * 0.5f))
+        return false;
+
+    mExifState = loaded;
+
+    return true;
+}
+
 /**
  * @brief saveMetaData() updates the exif record of an in-memory copy of the image file
  *
@@ -305,34 +354,7 @@ int DkMetaDataT::getOrientationDegree() const
 
             if (pos != exifData.end() && pos->count() != 0) {
                 Exiv2::Value::AutoPtr v = pos->getValue();
-                orientation = (int)pos->toFloat();
-
-                switch (orientation) {
-                case 6:
-                    orientation = 90;
-                    break;
-                case 7:
-                    orientation = 90;
-                    break;
-                case 3:
-                    orientation = 180;
-                    break;
-                case 4:
-                    orientation = 180;
-                    break;
-                case 8:
-                    orientation = -90;
-                    break;
-                case 5:
-                    orientation = -90;
-                    break;
-                case 1:
-                    orientation = 0;
-                    break;
-                default:
-                    orientation = -1;
-                    break;
-                }
+                orientation = orientationToDegree((int)pos->toFloat());
             }
         }
     } catch (...) {
@@ -342,6 +364,33 @@ int DkMetaDataT::getOrientationDegree() const
     return orientation;
 }
 
+/**
+ * Maps the Exif orientation tag to a rotation angle.
+ * @param orientation the Exif orientation (1-8)
+ * @return int the angle in degrees or -1 if the orientation is illegal
+ **/
+int DkMetaDataT::orientationToDegree(int orientation)
+{
+    switch (orientation) {
+    case 6:
+        return 90;
+    case 7:
+        return 90;
+    case 3:
+        return 180;
+    case 4:
+        return 180;
+    case 8:
+        return -90;
+    case 5:
+        return -90;
+    case 1:
+        return 0;
+    default:
+        return -1;
+    }
+}
+
 DkMetaDataT::ExifOrientationState DkMetaDataT::checkExifOrientation() const
 {
     if (mExifState != loaded && mExifState != dirty)
@@ -406,7 +455,7 @@ int DkMetaDataT::getRating() const
             pos = xmpData.findKey(key);
             if (pos != xmpData.end() && pos->count() != 0) {
                 Exiv2::Value::AutoPtr v = pos->getValue();
-                xmpRating = v->toFloat();
+                xmpRating = (float)ratingFromPercent(qRound(v->toFloat()));
             }
         }
     }
@@ -421,6 +470,20 @@ int DkMetaDataT::getRating() const
     return qRound(fRating);
 }
 
+/**
+ * Maps Xmp.MicrosoftPhoto.Rating (percent) to stars.
+ * setRating() writes 1, 25, 50, 75, 99 for 1-5 stars.
+ * @param percent the rating in percent
+ * @return int the number of stars (0-5)
+ **/
+int DkMetaDataT::ratingFromPercent(int percent)
+{
+    if (percent <= 0)
+        return 0;
+
+    return qBound(1, qRound(percent / 25.0) + 1, 5);
+}
+
 QSize DkMetaDataT::getImageSize() const
 {
     QSize size;
@@ -795,13 +858,23 @@ bool DkMetaDataT::isTiff() const
 
 bool DkMetaDataT::isJpg() const
 {
-    QString newSuffix = QFileInfo(mFilePath).suffix();
-    return newSuffix.contains(QRegExp("(jpg|jpeg)", Qt::CaseInsensitive)) != 0;
+    return isJpg(mFilePath);
 }
 
 bool DkMetaDataT::isRaw() const
 {
-    QString newSuffix = QFileInfo(mFilePath).suffix();
+    return isRaw(mFilePath);
+}
+
+bool DkMetaDataT::isJpg(const QString &filePath)
+{
+    QString newSuffix = QFileInfo(filePath).suffix();
+    return newSuffix.contains(QRegExp("(jpg|jpeg)", Qt::CaseInsensitive)) != 0;
+}
+
+bool DkMetaDataT::isRaw(const QString &filePath)
+{
+    QString newSuffix = QFileInfo(filePath).suffix();
     return newSuffix.contains(QRegExp("(nef|crw|cr2|arw)", Qt::CaseInsensitive)) != 0;
 }
 
@@ -100,10 +100,13 @@ public:
     void readMetaData(const QString &filePath, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
     bool saveMetaData(const QString &filePath, bool force = false);
     bool saveMetaData(QSharedPointer<QByteArray> &ba, bool force = false);
+    bool saveMetaDataToFile(const QString &filePath);
 
     int getOrientationDegree() const;
+    static int orientationToDegree(int orientation);
     ExifOrientationState checkExifOrientation() const;
     int getRating() const;
+    static int ratingFromPercent(int percent);
     QSize getImageSize() const;
     QString getDescription() const;
     QVector2D getResolution() const;
@@ -142,6 +145,8 @@ public:
     bool isTiff() const;
     bool isJpg() const;
     bool isRaw() const;
+    static bool isJpg(const QString &filePath);
+    static bool isRaw(const QString &filePath);
     bool isAVIF() const;
     bool isHEIF() const;
     bool isJXL() const;
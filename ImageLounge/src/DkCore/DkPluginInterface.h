@@ -121,6 +121,14 @@ public:
 class DkBatchPluginInterface : public DkPluginInterface
 {
 public:
+    enum Threading {
+        threading_shared = 0, // runPlugin() is called concurrently on this instance
+        threading_serialized, // runPlugin() is never called concurrently
+        threading_per_thread, // each thread calls its own instance (see createInstance())
+
+        threading_end
+    };
+
     virtual int interfaceType() const
     {
         return interface_batch;
@@ -144,6 +152,49 @@ public:
     virtual QSharedPointer<DkImageContainer>
     runPlugin(const QString &runID, QSharedPointer<DkImageContainer> imgC, const DkSaveInfo &saveInfo, QSharedPointer<DkBatchInfo> &batchInfo) const = 0;
 
+    /// <summary>
+    /// Processes several images at once. Plugins that benefit from batching (e.g. ML based ones)
+    /// override this function and batchSize(). The default implementation calls runPlugin() for each image.
+    /// </summary>
+    /// <param name="runID">The run identifier.</param>
+    /// <param name="imgCs">The image containers to be processed.</param>
+    /// <param name="saveInfos">The save info of each image.</param>
+    /// <param name="batchInfos">Receives one batch info per image.</param>
+    /// <returns>The processed image containers (same order as imgCs)</returns>
+    virtual QVector<QSharedPointer<DkImageContainer>> runBatch(const QString &runID,
+                                                               const QVector<QSharedPointer<DkImageContainer>> &imgCs,
+                                                               const QVector<DkSaveInfo> &saveInfos,
+                                                               QVector<QSharedPointer<DkBatchInfo>> &batchInfos) const
+    {
+        QVector<QSharedPointer<DkImageContainer>> results;
+        batchInfos.resize(imgCs.size());
+
+        for (int idx = 0; idx < imgCs.size(); idx++)
+            results << runPlugin(runID, imgCs[idx], saveInfos.value(idx), batchInfos[idx]);
+
+        return results;
+    };
+
+    // the preferred number of images passed to runBatch()
+    virtual int batchSize() const
+    {
+        return 1;
+    };
+
+    // tells the batch how runPlugin() may be called by concurrent batch items (see Threading)
+    virtual int threading() const
+    {
+        return threading_shared;
+    };
+
+    // returns a new instance with the current settings - needed for threading_per_thread
+    // preLoadPlugin() is called for each instance, postLoadPlugin() only for this instance:
+    // it gets the batch infos of all instances - so per-instance results must be stored in DkBatchInfo
+    virtual DkBatchPluginInterface *createInstance() const
+    {
+        return 0;
+    };
+
     virtual void preLoadPlugin() const = 0; // is called before batch processing
     virtual void postLoadPlugin(const QVector<QSharedPointer<DkBatchInfo>> &batchInfo) const = 0; // is called after batch processing
 
@@ -255,5 +306,5 @@ protected:
 
 // Change this version number if DkPluginInterface is changed!
 Q_DECLARE_INTERFACE(nmc::DkPluginInterface, "com.nomacs.ImageLounge.DkPluginInterface/3.6")
-Q_DECLARE_INTERFACE(nmc::DkBatchPluginInterface, "com.nomacs.ImageLounge.DkBatchPluginInterface/3.6")
+Q_DECLARE_INTERFACE(nmc::DkBatchPluginInterface, "com.nomacs.ImageLounge.DkBatchPluginInterface/3.7")
 Q_DECLARE_INTERFACE(nmc::DkViewPortInterface, "com.nomacs.ImageLounge.DkViewPortInterface/3.8")
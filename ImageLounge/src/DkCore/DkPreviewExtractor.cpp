@@ -0,0 +1,229 @@
+/*******************************************************************************************************
+ DkPreviewExtractor.cpp
+ Created on:	19.10.2026
+
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+
+ Copyright (C) 2011-2026 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2026 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2026 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkPreviewExtractor.h"
+#include "DkExifReader.h"
+#include "DkMetaData.h"
+#include "DkTimer.h"
+
+#pragma warning(push, 0) // no warnings from includes - begin
+#include <QBuffer>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QtEndian>
+
+#include <cstring>
+#pragma warning(pop) // no warnings from includes - end
+
+namespace nmc
+{
+
+namespace
+{
+const quint16 psdResourceThumb = 1036; // Photoshop 5.0+
+const quint16 psdResourceThumbBgr = 1033; // Photoshop 4.0 (BGR)
+const qint64 psdThumbHeaderSize = 28;
+const quint32 psdMaxResourceSize = 64 * 1024 * 1024;
+}
+
+// DkPreviewExtractor --------------------------------------------------------------------
+/**
+ * Returns true if filePath might have embedded previews (PSD, TIFF, RAW).
+ **/
+bool DkPreviewExtractor::isSupported(const QString &filePath)
+{
+    QString suffix = QFileInfo(filePath).suffix().toLower();
+
+    return suffix == "psd" || suffix == "psb" || suffix == "tif" || suffix == "tiff" || DkMetaDataT::isRaw(filePath);
+}
+
+/**
+ * Loads the smallest embedded preview which is at least minSize
+ * (longer side). If there is no such preview, a null image is returned.
+ * @param filePath the file path
+ * @param ba the (optional) file buffer
+ * @param minSize the minimal size of the longer side
+ * @param exif a reader that already parsed the file (optional) - TIFF and RAW files are not parsed again
+ * @return QImage the preview (not rotated)
+ **/
+QImage DkPreviewExtractor::loadPreview(const QString &filePath, const QSharedPointer<QByteArray> &ba, int minSize, const DkExifReader *exif)
+{
+    DkTraceScope ts("loadPreview", DkTraceLog::cat_thumbnail, filePath);
+
+    QString suffix = QFileInfo(filePath).suffix().toLower();
+
+    if (suffix == "psd" || suffix == "psb")
+        return loadPsdPreview(filePath, ba, minSize);
+
+    return loadTiffPreview(filePath, ba, minSize, exif);
+}
+
+QImage DkPreviewExtractor::loadPsdPreview(const QString &filePath, const QSharedPointer<QByteArray> &ba, int minSize)
+{
+    QByteArray data;
+    QSharedPointer<QIODevice> device;
+
+    if (ba && !ba->isEmpty()) {
+        data = QByteArray::fromRawData(ba->constData(), ba->size());
+        device = QSharedPointer<QIODevice>(new QBuffer(&data));
+    } else
+        device = QSharedPointer<QIODevice>(new QFile(filePath));
+
+    if (!device->open(QIODevice::ReadOnly))
+        return QImage();
+
+    // header (26 bytes) + color mode data
+    QByteArray header = device->read(26);
+    if (header.size() != 26 || !header.startsWith("8BPS"))
+        return QImage();
+
+    QByteArray lenBa = device->read(4);
+    if (lenBa.size() != 4 || !device->seek(device->pos() + qFromBigEndian<quint32>(lenBa.constData())))
+        return QImage();
+
+    // image resources
+    lenBa = device->read(4);
+    if (lenBa.size() != 4)
+        return QImage();
+
+    quint32 resLength = qFromBigEndian<quint32>(lenBa.constData());
+    if (resLength > psdMaxResourceSize)
+        return QImage();
+
+    QByteArray res = device->read(resLength);
+    const uchar *ptr = reinterpret_cast<const uchar *>(res.constData());
+    qint64 pos = 0;
+
+    while (pos + 12 <= res.size()) {
+        if (memcmp(ptr + pos, "8BIM", 4) != 0)
+            break;
+
+        quint16 id = qFromBigEndian<quint16>(ptr + pos + 4);
+
+        // pascal string padded to an even size
+        qint64 nameLength = ptr[pos + 6] + 1;
+        nameLength += nameLength % 2;
+
+        qint64 dataPos = pos + 6 + nameLength + 4;
+        if (dataPos > res.size())
+            break;
+
+        quint32 size = qFromBigEndian<quint32>(ptr + dataPos - 4);
+        if (dataPos + size > (quint64)res.size())
+            break;
+
+        if ((id == psdResourceThumb || id == psdResourceThumbBgr) && size > psdThumbHeaderSize) {
+            const uchar *thumb = ptr + dataPos;
+            quint32 format = qFromBigEndian<quint32>(thumb); // 1 = JPG
+            QSize tSize(qFromBigEndian<quint32>(thumb + 4), qFromBigEndian<quint32>(thumb + 8));
+
+            if (format == 1 && qMax(tSize.width(), tSize.height()) >= minSize) {
+                QByteArray jpg = QByteArray::fromRawData(reinterpret_cast<const char *>(thumb + psdThumbHeaderSize), size - psdThumbHeaderSize);
+                QImage img = readJpg(jpg, tSize, minSize);
+
+                return id == psdResourceThumbBgr ? img.rgbSwapped() : img;
+            }
+
+            return QImage();
+        }
+
+        pos = dataPos + size + (size % 2);
+    }
+
+    return QImage();
+}
+
+QImage DkPreviewExtractor::loadTiffPreview(const QString &filePath, const QSharedPointer<QByteArray> &ba, int minSize, const DkExifReader *exif)
+{
+    DkExifReader localReader;
+
+    if (!exif || !exif->isValid()) {
+        localReader.read(filePath, ba);
+        exif = &localReader;
+    }
+
+    if (!exif->isValid() || exif->container() != DkExifReader::container_tiff)
+        return QImage();
+
+    // find the smallest preview that is large enough
+    DkExifReader::Preview best;
+    int bestSize = -1;
+
+    for (const DkExifReader::Preview &p : exif->previews()) {
+        int s = qMax(p.size.width(), p.size.height());
+
+        if (s >= minSize && (bestSize == -1 || s < bestSize)) {
+            best = p;
+            bestSize = s;
+        }
+    }
+
+    if (best.size.isEmpty())
+        return QImage();
+
+    if (best.offset >= 0)
+        return readJpg(exif->previewData(best), best.size, minSize);
+
+    // reduced resolution page
+    QImage img;
+    QBuffer buffer;
+    QImageReader imgReader;
+
+    if (ba && !ba->isEmpty()) {
+        buffer.setData(*ba);
+        imgReader.setDevice(&buffer);
+    } else
+        imgReader.setFileName(filePath);
+
+    imgReader.setFormat("tiff");
+
+    if (imgReader.jumpToImage(best.page))
+        imgReader.read(&img);
+
+    return img;
+}
+
+QImage DkPreviewExtractor::readJpg(const QByteArray &data, const QSize &size, int minSize)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+
+    QImageReader reader(&buffer, "jpg");
+
+    // let the JPG decoder downscale (DCT scaling) if the preview is much larger than needed
+    if (minSize > 0 && qMax(size.width(), size.height()) > 2 * minSize)
+        reader.setScaledSize(size.scaled(minSize, minSize, Qt::KeepAspectRatio));
+
+    QImage img;
+    reader.read(&img);
+
+    return img;
+}
+
+}
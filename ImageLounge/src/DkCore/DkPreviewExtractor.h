@@ -0,0 +1,72 @@
+/*******************************************************************************************************
+ DkPreviewExtractor.h
+ Created on:	19.10.2026
+
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+
+ Copyright (C) 2011-2026 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2026 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2026 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0) // no warnings from includes - begin
+#include <QByteArray>
+#include <QImage>
+#include <QSharedPointer>
+#include <QString>
+#pragma warning(pop) // no warnings from includes - end
+
+#ifndef DllCoreExport
+#ifdef DK_CORE_DLL_EXPORT
+#define DllCoreExport Q_DECL_EXPORT
+#elif DK_DLL_IMPORT
+#define DllCoreExport Q_DECL_IMPORT
+#else
+#define DllCoreExport Q_DECL_IMPORT
+#endif
+#endif
+
+namespace nmc
+{
+
+class DkExifReader;
+
+/**
+ * Loads embedded previews without decoding the main image.
+ * Supported are the JPG thumbnail of PSDs (image resource 1036),
+ * reduced resolution pages of TIFFs and the JPG previews of RAW files.
+ **/
+class DllCoreExport DkPreviewExtractor
+{
+public:
+    static bool isSupported(const QString &filePath);
+    static QImage loadPreview(const QString &filePath,
+                              const QSharedPointer<QByteArray> &ba = QSharedPointer<QByteArray>(),
+                              int minSize = 0,
+                              const DkExifReader *exif = 0);
+
+private:
+    static QImage loadPsdPreview(const QString &filePath, const QSharedPointer<QByteArray> &ba, int minSize);
+    static QImage loadTiffPreview(const QString &filePath, const QSharedPointer<QByteArray> &ba, int minSize, const DkExifReader *exif);
+    static QImage readJpg(const QByteArray &data, const QSize &size, int minSize);
+};
+
+}
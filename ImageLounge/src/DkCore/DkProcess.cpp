@@ -26,6 +26,8 @@
  *******************************************************************************************************/
 
 #include "DkProcess.h"
+#include "DkBasicLoader.h"
+#include "DkExifReader.h"
 #include "DkImageContainer.h"
 #include "DkImageStorage.h"
 #include "DkManipulators.h"
@@ -38,10 +40,23 @@
 #include "DkMetaData.h"
 
 #pragma warning(push, 0) // no warnings from includes - begin
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QImageReader>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QSaveFile>
+#include <QSettings>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QThreadPool>
 #include <QWidget>
 #include <QtConcurrentMap>
+#include <qmath.h>
 #pragma warning(pop) // no warnings from includes - end
 
 #include <cassert>
@@ -290,40 +305,136 @@ bool DkBatchTransform::compute(QSharedPointer<DkImageContainer> container, QStri
         return true;
     }
 
+    DkTimer dt;
+    QImage img = container->image();
+
+    // crop from metadata -> resize -> rotate -> crop from rectangle is planned as a single affine warp
+    QTransform cropT;
+    QSize size = img.size();
+
     DkRotatingRect rect = container->cropRect();
-    if (mCropFromMetadata) {
-        if (!rect.isEmpty())
-            container->cropImage(rect, QColor(), false);
-    }
+    if (mCropFromMetadata && !rect.isEmpty()) {
+        QPointF cropSize;
+        rect.getTransform(cropT, cropSize);
 
-    QImage img = container->image();
-    QImage tmpImg;
+        if (cropSize.x() >= 0.5 && cropSize.y() >= 0.5) {
+            size = QSize(qRound(cropSize.x()), qRound(cropSize.y()));
+            container->getMetaData()->clearXMPRect();
+        } else
+            cropT.reset();
+    }
 
     // resize
+    double sx = 1.0;
+    double sy = 1.0;
+
     if (isResizeActive()) {
-        QSize size;
+        QSize rSize;
         float sf = 1.0f;
 
-        if (prepareProperties(img.size(), size, sf, logStrings))
-            tmpImg = DkImage::resizeImage(img, size, sf, mResizeIplMethod, mResizeCorrectGamma);
-        else
-            tmpImg = img;
-    } else
-        tmpImg = img;
+        if (prepareProperties(size, rSize, sf, logStrings)) {
+            // relative scales were partly applied by reduced decoding
+            if (mResizeMode == resize_mode_default)
+                rSize = QSize(qRound(size.width() * sf / container->getLoader()->decodeScale()),
+                              qRound(size.height() * sf / container->getLoader()->decodeScale()));
+
+            sx = (double)rSize.width() / size.width();
+            sy = (double)rSize.height() / size.height();
+        }
+    }
+
+    // the warp only samples well between 1/2 and 1 (reduced decoding brings most jpgs there)
+    // otherwise, the source is resampled with the user's interpolation first
+    QImage src = img;
+    QTransform srcT;
+    double scale = qMin(sx, sy);
+    bool scaled = sx != 1.0 || sy != 1.0;
+
+    if (scaled && (scale < 0.5 || scale > 1.0 || mResizeIplMethod > DkImage::ipl_linear)) {
+        src = DkImage::resizeImage(img, QSize(qRound(img.width() * sx), qRound(img.height() * sy)), 1.0, mResizeIplMethod, mResizeCorrectGamma);
+
+        if (src.isNull()) {
+            logStrings.append(QObject::tr("%1 error, could not transform image.").arg(name()));
+            return false;
+        }
+
+        srcT = QTransform::fromScale((double)img.width() / src.width(), (double)img.height() / src.height());
+
+        // the crop rectangle is applied to the resampled image
+        if (cropT.isIdentity()) {
+            sx = (double)src.width() / img.width();
+            sy = (double)src.height() / img.height();
+        }
+
+        scaled = false;
+    } else if (scaled && mResizeCorrectGamma) {
+        src = img.copy();
+        DkImage::gammaToLinear(src);
+    }
+
+    QSize scaledSize(qRound(size.width() * sx), qRound(size.height() * sy));
 
     // rotate
+    QTransform rotT;
     if (mAngle != 0) {
-        QTransform rotationMatrix;
-        rotationMatrix.rotate((double)mAngle);
-        tmpImg = tmpImg.transformed(rotationMatrix);
+        rotT.rotate((double)mAngle);
+        rotT = QImage::trueMatrix(rotT, scaledSize.width(), scaledSize.height());
     }
 
     // crop from rectangle
-    if (cropFromRectangle()) {
-        QRect r = mCropRect.intersected(container->image().rect());
-        tmpImg = tmpImg.copy(r);
+    QRect outRect = rotT.mapRect(QRect(QPoint(), scaledSize));
+    outRect.moveTopLeft(QPoint());
+
+    if (cropFromRectangle())
+        outRect = mCropRect.intersected(outRect);
+
+    if (outRect.isEmpty()) {
+        logStrings.append(QObject::tr("%1 error, could not transform image.").arg(name()));
+        return false;
+    }
+
+    QTransform t = srcT * cropT * QTransform::fromScale(sx, sy) * rotT * QTransform::fromTranslate(-outRect.x(), -outRect.y());
+
+    // rotations by 90° and integer crops do not need interpolation
+    bool axisAligned = (qFuzzyIsNull(t.m12()) && qFuzzyIsNull(t.m21())) || (qFuzzyIsNull(t.m11()) && qFuzzyIsNull(t.m22()));
+    bool hasAlpha = src.hasAlphaChannel() || !axisAligned;
+
+    auto isInteger = [](double v) {
+        return qAbs(v - qRound(v)) < 1e-6;
+    };
+
+    // unscaled and on the pixel grid - every output pixel is a source pixel
+    bool pixelAligned = axisAligned && !scaled && isInteger(t.m11()) && isInteger(t.m12()) && isInteger(t.m21()) && isInteger(t.m22())
+        && qAbs(t.determinant()) > 0.5 && isInteger(t.dx()) && isInteger(t.dy());
+
+    QImage tmpImg;
+
+    if (pixelAligned) {
+        // keep the image format (e.g. grayscale, indexed or 16 bit images)
+        QTransform rotOnlyT(t.m11(), t.m12(), t.m21(), t.m22(), 0, 0);
+        QRectF area = t.mapRect(QRectF(QPointF(), src.size()));
+
+        QImage rotImg = rotOnlyT.isIdentity() ? src : src.transformed(rotOnlyT);
+        tmpImg = rotImg.copy(QRect(QPoint(qRound(-area.left()), qRound(-area.top())), outRect.size()));
+    } else {
+        tmpImg = QImage(outRect.size(), hasAlpha ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+        tmpImg.fill(hasAlpha ? Qt::transparent : Qt::black);
+
+        QPainter painter(&tmpImg);
+        painter.setTransform(t);
+
+        if (!axisAligned)
+            painter.setRenderHints(QPainter::SmoothPixmapTransform | QPainter::Antialiasing);
+        else if (scaled && mResizeIplMethod != DkImage::ipl_nearest)
+            painter.setRenderHint(QPainter::SmoothPixmapTransform);
+
+        painter.drawImage(QPoint(), src);
+        painter.end();
     }
 
+    if (scaled && mResizeCorrectGamma)
+        DkImage::linearToGamma(tmpImg);
+
     // logs
     if (!tmpImg.isNull()) {
         container->setImage(tmpImg, QObject::tr("transformed"));
@@ -338,6 +449,16 @@ bool DkBatchTransform::compute(QSharedPointer<DkImageContainer> container, QStri
         } else
             logStrings.append(QObject::tr("%1 image transformed and cropped.").arg(name()));
 
+        double mpx = (double)img.width() * img.height() / container->getLoader()->decodeScale() / container->getLoader()->decodeScale() / 1e6;
+        logStrings.append(QObject::tr("%1 %2 x %3 -> %4 x %5 px in %6 (%7 MPix/s)")
+                              .arg(name())
+                              .arg(img.width())
+                              .arg(img.height())
+                              .arg(tmpImg.width())
+                              .arg(tmpImg.height())
+                              .arg(dt.getTotal())
+                              .arg(mpx / qMax(dt.elapsed(), 1) * 1000.0, 0, 'f', 1));
+
     } else {
         logStrings.append(QObject::tr("%1 error, could not transform image.").arg(name()));
         return false;
@@ -346,6 +467,62 @@ bool DkBatchTransform::compute(QSharedPointer<DkImageContainer> container, QStri
     return true;
 }
 
+/**
+ * Returns the minimal image size that compute() needs.
+ * If the image is downscaled by 2 or more, it can be decoded with a reduced resolution.
+ * @param imgSize the size of the (upright) image file
+ * @return QSize an empty size if the full resolution is needed
+ **/
+QSize DkBatchTransform::minDecodeSize(const QSize &imgSize) const
+{
+    // crop rects from metadata change the image size before resizing
+    if (!isActive() || !isResizeActive() || mCropFromMetadata || imgSize.isEmpty())
+        return QSize();
+
+    QSize size;
+    float sf = 1.0f;
+    QStringList logs;
+
+    if (!prepareProperties(imgSize, size, sf, logs))
+        return QSize();
+
+    if (mResizeMode == resize_mode_default)
+        size = QSize(qCeil(imgSize.width() * sf), qCeil(imgSize.height() * sf));
+
+    if (size.width() * 2 > imgSize.width() || size.height() * 2 > imgSize.height())
+        return QSize();
+
+    return size;
+}
+
+/**
+ * Returns the lossless jpg transform that is equivalent to compute().
+ * Resizing and cropping from metadata cannot be done losslessly.
+ * @param imgSize the size of the (not rotated) jpg
+ * @param exifTransform the transform that is applied when loading the jpg
+ * @param crop the crop rectangle in transformed coordinates (null if no crop is needed)
+ * @return DkJpgTransform::Transform transform_invalid if compute() has to decode the image
+ **/
+DkJpgTransform::Transform DkBatchTransform::losslessTransform(const QSize &imgSize, DkJpgTransform::Transform exifTransform, QRect &crop) const
+{
+    crop = QRect();
+
+    if (!isActive() || isResizeActive() || mCropFromMetadata)
+        return DkJpgTransform::transform_invalid;
+
+    DkJpgTransform::Transform t = DkJpgTransform::combine(exifTransform, DkJpgTransform::fromAngle(mAngle));
+
+    // compute() crops the rotated image
+    if (t != DkJpgTransform::transform_invalid && cropFromRectangle()) {
+        crop = mCropRect.intersected(QRect(QPoint(), DkJpgTransform::transformedSize(imgSize, t)));
+
+        if (crop.isEmpty())
+            return DkJpgTransform::transform_invalid;
+    }
+
+    return t;
+}
+
 bool DkBatchTransform::prepareProperties(const QSize &imgSize, QSize &size, float &scaleFactor, QStringList &logStrings) const
 {
     float sf = 1.0f;
@@ -453,6 +630,219 @@ DkManipulatorManager DkManipulatorBatch::manager() const
 }
 
 #ifdef WITH_PLUGINS
+// DkBatchPluginRunner --------------------------------------------------------------------
+DkBatchPluginRunner::DkBatchPluginRunner(QSharedPointer<DkPluginContainer> plugin, const QString &runID)
+{
+    mPlugin = plugin;
+    mRunID = runID;
+}
+
+/**
+ * Runs the plugin on a single image.
+ * The call blocks until the image is processed - possibly together with images of other threads.
+ * @param imgC the image to be processed
+ * @param saveInfo the item's save info
+ * @param info receives the plugin's batch info
+ * @param timing receives the time spent in the plugin (for the batch log)
+ * @return QSharedPointer<DkImageContainer> the processed image
+ **/
+QSharedPointer<DkImageContainer>
+DkBatchPluginRunner::run(QSharedPointer<DkImageContainer> imgC, const DkSaveInfo &saveInfo, QSharedPointer<DkBatchInfo> &info, QString &timing)
+{
+    DkBatchPluginInterface *bPlugin = mPlugin->batchPlugin();
+
+    // basic plugins are called as they always were
+    if (!bPlugin) {
+        DkTimer dt;
+        QSharedPointer<DkImageContainer> result = mPlugin->plugin()->runPlugin(mRunID, imgC);
+        addTime(dt.elapsed(), 1);
+        timing = dt.getTotal();
+        return result;
+    }
+
+    // a batch cannot be larger than the number of concurrent items
+    int batchSize = qMin(bPlugin->batchSize(), QThreadPool::globalInstance()->maxThreadCount());
+
+    if (batchSize > 1)
+        return runBatched(batchSize, imgC, saveInfo, info, timing);
+
+    bool serialize = false;
+    DkBatchPluginInterface *p = instance(serialize);
+
+    QMutexLocker locker(serialize ? &mCallMutex : 0);
+
+    DkTimer dt;
+    QSharedPointer<DkImageContainer> result = p->runPlugin(mRunID, imgC, saveInfo, info);
+    addTime(dt.elapsed(), 1);
+    timing = dt.getTotal();
+
+    return result;
+}
+
+/**
+ * Returns the plugin instance that should be called by the current thread.
+ * @param serialize true if calls to the instance must be serialized
+ * @return DkBatchPluginInterface* the plugin instance
+ **/
+DkBatchPluginInterface *DkBatchPluginRunner::instance(bool &serialize)
+{
+    DkBatchPluginInterface *bPlugin = mPlugin->batchPlugin();
+    serialize = bPlugin->threading() == DkBatchPluginInterface::threading_serialized;
+
+    if (bPlugin->threading() != DkBatchPluginInterface::threading_per_thread)
+        return bPlugin;
+
+    QThread *thread = QThread::currentThread();
+    QSharedPointer<DkBatchPluginInterface> inst;
+
+    {
+        QMutexLocker locker(&mInstanceMutex);
+        inst = mInstances.value(thread);
+    }
+
+    if (!inst) {
+        inst = QSharedPointer<DkBatchPluginInterface>(bPlugin->createInstance());
+
+        // new instances are initialized like the main instance (e.g. ML models are loaded)
+        if (inst)
+            inst->preLoadPlugin();
+
+        // only this thread adds its instance - so we don't need to lock while initializing
+        QMutexLocker locker(&mInstanceMutex);
+        mInstances.insert(thread, inst);
+    }
+
+    // the plugin cannot create instances - so we have to share the main instance
+    if (!inst) {
+        qWarning() << mPlugin->pluginName() << "does not create instances - calls are serialized";
+        serialize = true;
+        return bPlugin;
+    }
+
+    return inst.data();
+}
+
+QSharedPointer<DkImageContainer> DkBatchPluginRunner::runBatched(int batchSize,
+                                                                 QSharedPointer<DkImageContainer> imgC,
+                                                                 const DkSaveInfo &saveInfo,
+                                                                 QSharedPointer<DkBatchInfo> &info,
+                                                                 QString &timing)
+{
+    QSharedPointer<Item> item(new Item());
+    item->imgC = imgC;
+    item->saveInfo = saveInfo;
+
+    QElapsedTimer waiting;
+    waiting.start();
+
+    QMutexLocker locker(&mQueueMutex);
+    mQueue << item;
+
+    while (!item->done) {
+        // the thread that fills the batch (or waited long enough) processes it
+        if (!item->taken && (mQueue.size() >= batchSize || waiting.elapsed() >= mMaxWaitMs)) {
+            QVector<QSharedPointer<Item>> batch = mQueue.mid(0, batchSize);
+            mQueue.remove(0, batch.size());
+
+            for (const QSharedPointer<Item> &i : batch)
+                i->taken = true;
+
+            locker.unlock();
+            processBatch(batch);
+            locker.relock();
+
+            for (const QSharedPointer<Item> &i : batch)
+                i->done = true;
+
+            mQueueCondition.wakeAll();
+        } else if (item->taken)
+            mQueueCondition.wait(&mQueueMutex);
+        else
+            mQueueCondition.wait(&mQueueMutex, (unsigned long)qMax(mMaxWaitMs - waiting.elapsed(), (qint64)1));
+    }
+
+    info = item->info;
+    timing = QObject::tr("%1 ms (batch of %2)").arg(item->ms).arg(item->batchSize);
+
+    return item->result;
+}
+
+void DkBatchPluginRunner::processBatch(const QVector<QSharedPointer<Item>> &batch)
+{
+    QVector<QSharedPointer<DkImageContainer>> imgCs;
+    QVector<DkSaveInfo> saveInfos;
+
+    for (const QSharedPointer<Item> &i : batch) {
+        imgCs << i->imgC;
+        saveInfos << i->saveInfo;
+    }
+
+    DkTimer dt;
+    QVector<QSharedPointer<DkBatchInfo>> batchInfos;
+    QVector<QSharedPointer<DkImageContainer>> results;
+
+    // other threads wait for this batch - so we must not leave with an exception
+    try {
+        bool serialize = false;
+        DkBatchPluginInterface *p = instance(serialize);
+
+        QMutexLocker locker(serialize ? &mCallMutex : 0);
+        results = p->runBatch(mRunID, imgCs, saveInfos, batchInfos);
+    } catch (...) {
+        qWarning() << "[Plugin Batch]" << mPlugin->pluginName() << "failed to process a batch of" << batch.size() << "images";
+        results.clear();
+        batchInfos.clear();
+    }
+
+    int ms = dt.elapsed();
+
+    for (int idx = 0; idx < batch.size(); idx++) {
+        batch[idx]->result = results.value(idx);
+        batch[idx]->info = batchInfos.value(idx);
+        batch[idx]->batchSize = batch.size();
+        batch[idx]->ms = ms;
+    }
+
+    addTime(ms, batch.size());
+}
+
+void DkBatchPluginRunner::addTime(int ms, int numImages)
+{
+    QMutexLocker locker(&mStatsMutex);
+    mTotalMs += ms;
+    mNumImages += numImages;
+    mNumCalls++;
+}
+
+/**
+ * Releases the per-thread plugin instances and resets the timing.
+ **/
+void DkBatchPluginRunner::release()
+{
+    QMutexLocker locker(&mInstanceMutex);
+    mInstances.clear();
+
+    QMutexLocker statsLocker(&mStatsMutex);
+    mTotalMs = 0;
+    mNumImages = 0;
+    mNumCalls = 0;
+}
+
+QString DkBatchPluginRunner::summary() const
+{
+    QMutexLocker locker(&mStatsMutex);
+
+    if (!mNumImages)
+        return QObject::tr("%1 was not called").arg(mPlugin->pluginName());
+
+    return QObject::tr("%1 processed %2 images in %3 ms (%4 ms per image, %5 calls)")
+        .arg(mPlugin->pluginName())
+        .arg(mNumImages)
+        .arg(mTotalMs)
+        .arg((double)mTotalMs / mNumImages, 0, 'f', 1)
+        .arg(mNumCalls);
+}
+
 // DkPluginBatch --------------------------------------------------------------------
 DkPluginBatch::DkPluginBatch()
 {
@@ -528,6 +918,11 @@ void DkPluginBatch::postLoad(const QVector<QSharedPointer<DkBatchInfo>> &batchIn
                 plugin->postLoadPlugin(fInfos);
             }
         }
+
+        if (mRunners[idx]) {
+            qInfo() << "[Plugin Batch]" << mRunners[idx]->summary();
+            mRunners[idx]->release();
+        }
     }
 }
 
@@ -543,7 +938,7 @@ bool DkPluginBatch::compute(QSharedPointer<DkImageContainer> container,
 
     for (int idx = 0; idx < mPlugins.size(); idx++) {
         QSharedPointer<DkPluginContainer> pluginContainer = mPlugins[idx];
-        QString runID = mRunIDs[idx];
+        QSharedPointer<DkBatchPluginRunner> runner = mRunners[idx];
 
         if (pluginContainer) {
             // get plugin
@@ -553,24 +948,26 @@ bool DkPluginBatch::compute(QSharedPointer<DkImageContainer> container,
             if (plugin && (plugin->interfaceType() == DkPluginInterface::interface_basic || plugin->interfaceType() == DkPluginInterface::interface_batch)) {
                 // apply the plugin
                 QSharedPointer<DkImageContainer> result;
+                QString timing;
 
-                if (plugin->interfaceType() == DkPluginInterface::interface_basic)
-                    result = plugin->runPlugin(runID, container);
-                else if (plugin->interfaceType() == DkPluginInterface::interface_batch) {
-                    DkBatchPluginInterface *bPlugin = pluginContainer->batchPlugin();
+                if (plugin->interfaceType() == DkPluginInterface::interface_basic) {
+                    QSharedPointer<DkBatchInfo> dummy;
+                    result = runner->run(container, saveInfo, dummy, timing);
+                } else if (plugin->interfaceType() == DkPluginInterface::interface_batch) {
                     QSharedPointer<DkBatchInfo> info;
 
-                    if (bPlugin)
-                        result = bPlugin->runPlugin(runID, container, saveInfo, info);
+                    if (pluginContainer->batchPlugin())
+                        result = runner->run(container, saveInfo, info, timing);
                     else
                         logStrings.append(QObject::tr("%1 Cannot cast batch plugin %2.").arg(name()).arg(pluginContainer->pluginName()));
 
                     batchInfos << info;
                 }
 
-                if (result && result->hasImage())
+                if (result && result->hasImage()) {
                     container = result;
-                else
+                    logStrings.append(QObject::tr("%1 %2 applied in %3.").arg(name()).arg(pluginContainer->pluginName()).arg(timing));
+                } else
                     logStrings.append(QObject::tr("%1 Cannot apply %2.").arg(name()).arg(pluginContainer->pluginName()));
             } else
                 logStrings.append(QObject::tr("%1 illegal plugin interface: %2").arg(name()).arg(pluginContainer->pluginName()));
@@ -620,6 +1017,8 @@ void DkPluginBatch::loadAllPlugins()
         QString runID;
         loadPlugin(cPluginString, pluginContainer, runID);
         mPlugins << pluginContainer; // also add the empty ones...
+        mRunners << (pluginContainer ? QSharedPointer<DkBatchPluginRunner>(new DkBatchPluginRunner(pluginContainer, runID))
+                                     : QSharedPointer<DkBatchPluginRunner>());
         mRunIDs << runID;
 
         if (pluginContainer) {
@@ -654,6 +1053,191 @@ void DkPluginBatch::loadPlugin(const QString &pluginString, QSharedPointer<DkPlu
 }
 #endif
 
+// DkBatchManifest --------------------------------------------------------------------
+DkBatchManifest::DkBatchManifest(const QString &filePath, const QByteArray &profileHash)
+{
+    mFilePath = filePath;
+    mProfileHash = profileHash;
+}
+
+/**
+ * Loads the entries of previous runs and opens the manifest for appending.
+ * The file is compacted on the way so that it does not grow with every run.
+ * @return bool false if the manifest cannot be written
+ **/
+bool DkBatchManifest::open()
+{
+    QMutexLocker locker(&mMutex);
+
+    QFile file(mFilePath);
+    if (file.open(QIODevice::ReadOnly)) {
+        // later entries replace earlier ones (e.g. files that failed before)
+        while (!file.atEnd()) {
+            Entry e = fromJson(file.readLine());
+
+            if (!e.inputPath.isEmpty())
+                mEntries.insert(e.inputPath, e);
+        }
+        file.close();
+    }
+
+    QFileInfo fi(mFilePath);
+    if (!fi.absoluteDir().exists() && !QDir().mkpath(fi.absolutePath()))
+        return false;
+
+    QSaveFile compacted(mFilePath);
+    if (!compacted.open(QIODevice::WriteOnly))
+        return false;
+
+    for (const Entry &e : mEntries)
+        compacted.write(toJson(e));
+
+    if (!compacted.commit())
+        return false;
+
+    mFile.setFileName(mFilePath);
+    return mFile.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+/**
+ * Returns true if the input was processed with the same profile before.
+ * Size and modification date are compared first, the content hash is only
+ * computed if the file was touched.
+ * @param inputPath the input file
+ * @param outputPath the output file of the current run
+ * @return bool true if the file does not need to be processed
+ **/
+bool DkBatchManifest::isUnchanged(const QString &inputPath, const QString &outputPath)
+{
+    Entry e;
+    {
+        QMutexLocker locker(&mMutex);
+
+        if (!mEntries.contains(inputPath))
+            return false;
+
+        e = mEntries.value(inputPath);
+    }
+
+    if (e.status != status_done || e.profileHash != mProfileHash || e.outputPath != outputPath)
+        return false;
+
+    // the user might have deleted the results
+    if (!QFileInfo::exists(outputPath))
+        return false;
+
+    QFileInfo fi(inputPath);
+    if (!fi.exists() || fi.size() != e.size)
+        return false;
+
+    if (fi.lastModified().toMSecsSinceEpoch() == e.modified)
+        return true;
+
+    if (fileHash(inputPath) != e.hash)
+        return false;
+
+    // the file was just touched - remember the new date
+    e.modified = fi.lastModified().toMSecsSinceEpoch();
+    write(e);
+
+    return true;
+}
+
+/**
+ * Appends the result of a file to the manifest.
+ * @param inputPath the input file
+ * @param outputPath the output file
+ * @param success true if the file was processed without errors
+ * @param timeMs the processing time
+ **/
+void DkBatchManifest::add(const QString &inputPath, const QString &outputPath, bool success, int timeMs)
+{
+    Entry e;
+    e.inputPath = inputPath;
+    e.outputPath = outputPath;
+    e.profileHash = mProfileHash;
+    e.status = success ? status_done : status_failed;
+    e.timeMs = timeMs;
+
+    // we stat the input after processing since it might have been processed in place
+    QFileInfo fi(inputPath);
+    if (success && fi.exists()) {
+        e.size = fi.size();
+        e.modified = fi.lastModified().toMSecsSinceEpoch();
+        e.hash = fileHash(inputPath);
+    }
+
+    write(e);
+}
+
+QString DkBatchManifest::filePath() const
+{
+    return mFilePath;
+}
+
+QByteArray DkBatchManifest::fileHash(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (!hash.addData(&file))
+        return QByteArray();
+
+    return hash.result().toHex();
+}
+
+void DkBatchManifest::write(const Entry &entry)
+{
+    QByteArray line = toJson(entry);
+
+    QMutexLocker locker(&mMutex);
+    mEntries.insert(entry.inputPath, entry);
+
+    // flush each line - a crashed run should lose at most one file
+    if (mFile.isOpen()) {
+        mFile.write(line);
+        mFile.flush();
+    }
+}
+
+QByteArray DkBatchManifest::toJson(const Entry &entry) const
+{
+    QJsonObject o;
+    o["input"] = entry.inputPath;
+    o["size"] = entry.size;
+    o["modified"] = entry.modified;
+    o["hash"] = QString::fromLatin1(entry.hash);
+    o["profile"] = QString::fromLatin1(entry.profileHash);
+    o["output"] = entry.outputPath;
+    o["status"] = entry.status == status_done ? "done" : "failed";
+    o["ms"] = entry.timeMs;
+
+    return QJsonDocument(o).toJson(QJsonDocument::Compact) + '\n';
+}
+
+DkBatchManifest::Entry DkBatchManifest::fromJson(const QByteArray &line) const
+{
+    Entry e;
+
+    // a crash might leave a partial line
+    QJsonObject o = QJsonDocument::fromJson(line).object();
+    if (o.isEmpty())
+        return e;
+
+    e.inputPath = o["input"].toString();
+    e.size = (qint64)o["size"].toDouble(-1);
+    e.modified = (qint64)o["modified"].toDouble(-1);
+    e.hash = o["hash"].toString().toLatin1();
+    e.profileHash = o["profile"].toString().toLatin1();
+    e.outputPath = o["output"].toString();
+    e.status = o["status"].toString() == "done" ? status_done : status_failed;
+    e.timeMs = o["ms"].toInt();
+
+    return e;
+}
+
 // DkBatchProcess --------------------------------------------------------------------
 DkBatchProcess::DkBatchProcess(const DkSaveInfo &saveInfo)
 {
@@ -665,6 +1249,11 @@ void DkBatchProcess::setProcessChain(const QVector<QSharedPointer<DkAbstractBatc
     mProcessFunctions = processes;
 }
 
+void DkBatchProcess::setManifest(QSharedPointer<DkBatchManifest> manifest)
+{
+    mManifest = manifest;
+}
+
 QString DkBatchProcess::inputFile() const
 {
     return mSaveInfo.inputFilePath();
@@ -690,10 +1279,35 @@ bool DkBatchProcess::wasProcessed() const
     return mIsProcessed;
 }
 
+bool DkBatchProcess::wasSkipped() const
+{
+    return mIsSkipped;
+}
+
 bool DkBatchProcess::compute()
 {
+    DkTraceScope ts("batchItem", DkTraceLog::cat_batch, mSaveInfo.inputFilePath());
     mIsProcessed = true;
 
+    if (mManifest && mManifest->isUnchanged(mSaveInfo.inputFilePath(), mSaveInfo.outputFilePath())) {
+        mLogStrings.append(QObject::tr("%1 is unchanged since the last run -> skipping").arg(mSaveInfo.inputFilePath()));
+        mIsSkipped = true;
+        return true;
+    }
+
+    DkTimer dt;
+    bool success = computeFile();
+
+    mLogStrings.append(QObject::tr("%1 %2 in %3").arg(QFileInfo(mSaveInfo.inputFilePath()).fileName(), success ? QObject::tr("processed") : QObject::tr("failed"), dt.getTotal()));
+
+    if (mManifest)
+        mManifest->add(mSaveInfo.inputFilePath(), mSaveInfo.outputFilePath(), success, dt.elapsed());
+
+    return success;
+}
+
+bool DkBatchProcess::computeFile()
+{
     QFileInfo fInfoIn(mSaveInfo.inputFilePath());
     QFileInfo fInfoOut(mSaveInfo.outputFilePath());
 
@@ -748,8 +1362,17 @@ bool DkBatchProcess::process()
 {
     mLogStrings.append(QObject::tr("processing %1").arg(mSaveInfo.inputFilePath()));
 
+    // jpgs that are only rotated or cropped are not decoded
+    if (processLossless())
+        return mFailure == 0;
+
     QSharedPointer<DkImageContainer> imgC(new DkImageContainer(mSaveInfo.inputFilePath()));
 
+    // images are decoded with a reduced resolution if they are downscaled anyway
+    QSize minSize = minDecodeSize();
+    if (!minSize.isEmpty())
+        imgC->getLoader()->setMinDecodeSize(minSize);
+
     if (!imgC->loadImage() || imgC->image().isNull()) {
         mLogStrings.append(QObject::tr("Error while loading..."));
         mFailure++;
@@ -803,6 +1426,105 @@ bool DkBatchProcess::process()
     return true;
 }
 
+/**
+ * Returns the minimal size the image has to be decoded with.
+ * This is only known if the first active process function is a DkBatchTransform.
+ * @return QSize an empty size if the image must be decoded with full resolution
+ **/
+QSize DkBatchProcess::minDecodeSize() const
+{
+    QSharedPointer<DkBatchTransform> bt;
+
+    for (const QSharedPointer<DkAbstractBatch> &batch : mProcessFunctions) {
+        if (batch && batch->isActive()) {
+            bt = qSharedPointerDynamicCast<DkBatchTransform>(batch);
+            break;
+        }
+    }
+
+    if (!bt)
+        return QSize();
+
+    // reading the header is cheap
+    QImageReader reader(mSaveInfo.inputFilePath());
+    QSize size = reader.size();
+
+    DkExifReader exif;
+    if (exif.read(mSaveInfo.inputFilePath()) && qAbs(exif.orientationDegree()) == 90 && !DkSettingsManager::param().metaData().ignoreExifOrientation)
+        size.transpose();
+
+    return bt->minDecodeSize(size);
+}
+
+/**
+ * Rotates/crops jpgs without decoding them if the only process function is a lossless DkBatchTransform.
+ * @return bool false if the file has to be processed with process()
+ **/
+bool DkBatchProcess::processLossless()
+{
+    if (!DkJpgTransform::isAvailable() || mProcessFunctions.size() != 1 || (mSaveInfo.mode() & DkSaveInfo::mode_do_not_save_output)
+        || !DkJpgTransform::isJpg(mSaveInfo.inputFilePath()) || !DkJpgTransform::isJpg(mSaveInfo.outputFilePath()))
+        return false;
+
+    QSharedPointer<DkBatchTransform> bt = qSharedPointerDynamicCast<DkBatchTransform>(mProcessFunctions.first());
+
+    if (!bt)
+        return false;
+
+    QSharedPointer<QByteArray> ba = DkFileBuffer::load(mSaveInfo.inputFilePath());
+    if (!ba || ba->isEmpty())
+        return false;
+
+    QSharedPointer<DkMetaDataT> md(new DkMetaDataT());
+    try {
+        md->readMetaData(mSaveInfo.inputFilePath(), ba);
+    } catch (...) {
+    }
+
+    QSize imgSize = DkJpgTransform::imageSize(*ba);
+    QRect crop;
+    DkJpgTransform::Transform t = bt->losslessTransform(imgSize, DkJpgTransform::exifTransform(md), crop);
+
+    QSharedPointer<QByteArray> jpg(new QByteArray());
+    if (!DkJpgTransform::canTransform(*ba, t, crop) || !DkJpgTransform::transform(*ba, *jpg, t, crop))
+        return false;
+
+    // the jpg is in memory - from here on we do not fall back
+    DkJpgTransform::updateMetaData(md, imgSize, t, crop);
+    updateMetaData(md.data());
+
+    try {
+        if (md->isLoaded())
+            md->saveMetaData(jpg, true);
+    } catch (...) {
+        mLogStrings.append(QObject::tr("Could not save the meta data"));
+    }
+
+    mLogStrings.append(QObject::tr("%1 jpg transformed losslessly.").arg(bt->name()));
+
+    if (!prepareDeleteExisting()) {
+        mFailure++;
+        return true;
+    }
+
+    // the output might be the input - so we never leave torn files
+    QFileInfo fInfo(mSaveInfo.outputFilePath());
+    QSaveFile file(fInfo.isSymLink() ? fInfo.symLinkTarget() : mSaveInfo.outputFilePath());
+
+    if (file.open(QIODevice::WriteOnly) && file.write(*jpg) == jpg->size() && file.commit()) {
+        mLogStrings.append(QObject::tr("%1 saved...").arg(mSaveInfo.outputFilePath()));
+    } else {
+        mLogStrings.append(QObject::tr("Could not save: %1").arg(mSaveInfo.outputFilePath()));
+        file.cancelWriting();
+        mFailure++;
+    }
+
+    if (!deleteOrRestoreExisting())
+        mFailure++;
+
+    return true;
+}
+
 bool DkBatchProcess::renameFile()
 {
     if (QFileInfo(mSaveInfo.outputFilePath()).exists()) {
@@ -993,6 +1715,39 @@ bool DkBatchConfig::isOk() const
     return true;
 }
 
+/**
+ * Returns a hash of all settings that influence the results.
+ * The file list is not part of it so that adding files does not invalidate previous results.
+ * @return QByteArray the hash as hex string
+ **/
+QByteArray DkBatchConfig::profileHash() const
+{
+    QTemporaryFile tmpFile;
+    if (!tmpFile.open())
+        return QByteArray();
+
+    QSettings settings(tmpFile.fileName(), QSettings::IniFormat);
+    saveSettings(settings);
+
+    QStringList keys = settings.allKeys();
+    keys.sort();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    for (const QString &key : keys) {
+        if (key == "General/FileList")
+            continue;
+
+        QVariant val = settings.value(key);
+        QString valStr = val.type() == QVariant::StringList ? val.toStringList().join(";") : val.toString();
+
+        hash.addData(key.toUtf8());
+        hash.addData(valStr.toUtf8());
+    }
+
+    return hash.result().toHex();
+}
+
 // DkBatchProcessing --------------------------------------------------------------------
 DkBatchProcessing::DkBatchProcessing(const DkBatchConfig &config, QWidget *parent /*= 0*/)
     : QObject(parent)
@@ -1009,6 +1764,16 @@ void DkBatchProcessing::init()
 
     QStringList fileList = mBatchConfig.getFileList();
 
+    QSharedPointer<DkBatchManifest> manifest;
+    if (!mBatchConfig.getManifestPath().isEmpty()) {
+        manifest = QSharedPointer<DkBatchManifest>(new DkBatchManifest(mBatchConfig.getManifestPath(), mBatchConfig.profileHash()));
+
+        if (!manifest->open()) {
+            qWarning() << "I cannot write the batch manifest to" << mBatchConfig.getManifestPath();
+            manifest.clear();
+        }
+    }
+
     for (int idx = 0; idx < fileList.size(); idx++) {
         DkSaveInfo si = mBatchConfig.saveInfo();
 
@@ -1024,6 +1789,7 @@ void DkBatchProcessing::init()
 
         DkBatchProcess cProcess(si);
         cProcess.setProcessChain(mBatchConfig.getProcessFunctions());
+        cProcess.setManifest(manifest);
 
         mBatchItems.push_back(cProcess);
     }
@@ -1107,10 +1873,11 @@ void DkBatchProcessing::postLoad()
     }
 }
 
-void DkBatchProcessing::computeBatch(const QString &settingsPath, const QString &logPath)
+void DkBatchProcessing::computeBatch(const QString &settingsPath, const QString &logPath, const QString &manifestPath)
 {
     DkTimer dt;
     DkBatchConfig bc = DkBatchProfile::loadProfile(settingsPath);
+    bc.setManifestPath(manifestPath);
 
     // guarantee that the output path exists
     if (!QDir().mkpath(bc.getOutputDirPath())) {
@@ -1126,6 +1893,9 @@ void DkBatchProcessing::computeBatch(const QString &settingsPath, const QString
 
     qInfo() << "batch finished with" << process->getNumFailures() << "errors in" << dt;
 
+    if (!manifestPath.isEmpty())
+        qInfo() << process->getNumSkipped() << "unchanged files skipped, manifest:" << manifestPath;
+
     if (!logPath.isEmpty()) {
         QFileInfo fi(logPath);
 
@@ -1180,6 +1950,18 @@ int DkBatchProcessing::getNumProcessed() const
     return numProcessed;
 }
 
+int DkBatchProcessing::getNumSkipped() const
+{
+    int numSkipped = 0;
+
+    for (DkBatchProcess batch : mBatchItems) {
+        if (batch.wasSkipped())
+            numSkipped++;
+    }
+
+    return numSkipped;
+}
+
 QList<int> DkBatchProcessing::getCurrentResults()
 {
     if (mResList.empty()) {
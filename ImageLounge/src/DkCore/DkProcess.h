@@ -30,13 +30,18 @@
 #pragma warning(push, 0) // no warnings from includes - begin
 #include <QDir>
 #include <QFileInfo>
+#include <QFile>
 #include <QFutureWatcher>
+#include <QHash>
+#include <QMutex>
 #include <QSharedPointer>
 #include <QStringList>
 #include <QUrl>
+#include <QWaitCondition>
 #pragma warning(pop) // no warnings from includes - end
 
 #include "DkBatchInfo.h"
+#include "DkJpgTransform.h"
 #include "DkManipulators.h"
 
 #pragma warning(disable : 4251) // TODO: remove
@@ -54,6 +59,7 @@
 // Qt defines
 class QImage;
 class QSettings;
+class QThread;
 
 namespace nmc
 {
@@ -61,6 +67,7 @@ namespace nmc
 // nomacs defines
 class DkImageContainer;
 class DkPluginContainer;
+class DkBatchPluginInterface;
 class DkBaseManipulator;
 class DkMetaDataT;
 
@@ -107,6 +114,63 @@ private:
 };
 
 #ifdef WITH_PLUGINS
+/**
+ * Calls one plugin for concurrent batch items.
+ * Depending on the plugin's threading model, calls are forwarded to the shared instance,
+ * serialized or forwarded to one instance per thread.
+ * Plugins with a batch size > 1 get the images of concurrent items at once (see DkBatchPluginInterface::runBatch()).
+ * The time spent in the plugin is accumulated.
+ **/
+class DllCoreExport DkBatchPluginRunner
+{
+public:
+    DkBatchPluginRunner(QSharedPointer<DkPluginContainer> plugin, const QString &runID);
+
+    QSharedPointer<DkImageContainer>
+    run(QSharedPointer<DkImageContainer> imgC, const DkSaveInfo &saveInfo, QSharedPointer<DkBatchInfo> &info, QString &timing);
+    void release();
+    QString summary() const;
+
+protected:
+    struct Item {
+        QSharedPointer<DkImageContainer> imgC;
+        DkSaveInfo saveInfo;
+        QSharedPointer<DkImageContainer> result;
+        QSharedPointer<DkBatchInfo> info;
+        bool taken = false;
+        bool done = false;
+        int batchSize = 0;
+        int ms = 0;
+    };
+
+    DkBatchPluginInterface *instance(bool &serialize);
+    QSharedPointer<DkImageContainer> runBatched(int batchSize,
+                                                QSharedPointer<DkImageContainer> imgC,
+                                                const DkSaveInfo &saveInfo,
+                                                QSharedPointer<DkBatchInfo> &info,
+                                                QString &timing);
+    void processBatch(const QVector<QSharedPointer<Item>> &batch);
+    void addTime(int ms, int numImages);
+
+    QSharedPointer<DkPluginContainer> mPlugin;
+    QString mRunID;
+
+    QMutex mCallMutex; // serializes plugin calls
+    QMutex mInstanceMutex;
+    QHash<QThread *, QSharedPointer<DkBatchPluginInterface>> mInstances;
+
+    // images that wait to be batched
+    QMutex mQueueMutex;
+    QWaitCondition mQueueCondition;
+    QVector<QSharedPointer<Item>> mQueue;
+    int mMaxWaitMs = 100; // partial batches are processed after this time
+
+    mutable QMutex mStatsMutex;
+    qint64 mTotalMs = 0;
+    int mNumImages = 0;
+    int mNumCalls = 0;
+};
+
 class DllCoreExport DkPluginBatch : public DkAbstractBatch
 {
 public:
@@ -131,6 +195,7 @@ protected:
     void loadPlugin(const QString &pluginString, QSharedPointer<DkPluginContainer> &plugin, QString &runID) const;
 
     QVector<QSharedPointer<DkPluginContainer>> mPlugins;
+    QVector<QSharedPointer<DkBatchPluginRunner>> mRunners;
     QStringList mRunIDs;
     QStringList mPluginList;
 };
@@ -194,6 +259,9 @@ public:
     virtual QString name() const override;
     virtual bool isActive() const override;
 
+    DkJpgTransform::Transform losslessTransform(const QSize &imgSize, DkJpgTransform::Transform exifTransform, QRect &crop) const;
+    QSize minDecodeSize(const QSize &imgSize) const;
+
     int angle() const;
     bool cropMetatdata() const;
     bool cropFromRectangle() const;
@@ -224,23 +292,77 @@ protected:
     QRect mCropRect;
 };
 
+/**
+ * Keeps track of batch results across runs.
+ * Every processed file is appended (as JSON line) to the manifest once it is finished.
+ * Hence, interrupted runs resume where they stopped and reruns only process
+ * files that are new or changed (or were processed with a different profile).
+ **/
+class DllCoreExport DkBatchManifest
+{
+public:
+    DkBatchManifest(const QString &filePath, const QByteArray &profileHash);
+
+    enum Status {
+        status_failed = 0,
+        status_done,
+
+        status_end
+    };
+
+    struct Entry {
+        QString inputPath;
+        qint64 size = -1;
+        qint64 modified = -1; // ms since epoch
+        QByteArray hash;
+        QByteArray profileHash;
+        QString outputPath;
+        Status status = status_failed;
+        int timeMs = 0;
+    };
+
+    bool open();
+    bool isUnchanged(const QString &inputPath, const QString &outputPath);
+    void add(const QString &inputPath, const QString &outputPath, bool success, int timeMs);
+
+    QString filePath() const;
+    static QByteArray fileHash(const QString &filePath);
+
+protected:
+    void write(const Entry &entry);
+    QByteArray toJson(const Entry &entry) const;
+    Entry fromJson(const QByteArray &line) const;
+
+    QString mFilePath;
+    QByteArray mProfileHash;
+
+    QHash<QString, Entry> mEntries;
+    QFile mFile;
+    QMutex mMutex;
+};
+
 class DllCoreExport DkBatchProcess
 {
 public:
     DkBatchProcess(const DkSaveInfo &saveInfo = DkSaveInfo());
 
     void setProcessChain(const QVector<QSharedPointer<DkAbstractBatch>> processes);
+    void setManifest(QSharedPointer<DkBatchManifest> manifest);
     bool compute(); // do the work
     QStringList getLog() const;
     bool hasFailed() const;
     bool wasProcessed() const;
+    bool wasSkipped() const;
     QString inputFile() const;
     QString outputFile() const;
 
     QVector<QSharedPointer<DkBatchInfo>> batchInfo() const;
 
 protected:
+    bool computeFile();
     bool process();
+    bool processLossless();
+    QSize minDecodeSize() const;
     bool prepareDeleteExisting();
     bool deleteOrRestoreExisting();
     bool deleteOriginalFile();
@@ -251,9 +373,11 @@ protected:
     DkSaveInfo mSaveInfo;
     int mFailure = 0;
     bool mIsProcessed = false;
+    bool mIsSkipped = false;
 
     QVector<QSharedPointer<DkBatchInfo>> mInfos;
     QVector<QSharedPointer<DkAbstractBatch>> mProcessFunctions;
+    QSharedPointer<DkBatchManifest> mManifest;
     QStringList mLogStrings;
 };
 
@@ -267,6 +391,7 @@ public:
     virtual void loadSettings(QSettings &settings);
 
     bool isOk() const;
+    QByteArray profileHash() const;
 
     void setFileList(const QStringList &fileList)
     {
@@ -288,6 +413,10 @@ public:
     {
         mSaveInfo = saveInfo;
     };
+    void setManifestPath(const QString &manifestPath)
+    {
+        mManifestPath = manifestPath;
+    };
 
     QStringList getFileList() const
     {
@@ -309,6 +438,10 @@ public:
     {
         return mSaveInfo;
     };
+    QString getManifestPath() const
+    {
+        return mManifestPath;
+    };
 
 protected:
     DkSaveInfo mSaveInfo;
@@ -316,6 +449,7 @@ protected:
     QStringList mFileList;
     QString mOutputDirPath;
     QString mFileNamePattern;
+    QString mManifestPath; // not part of the profile
 
     QVector<QSharedPointer<DkAbstractBatch>> mProcessFunctions;
 };
@@ -342,6 +476,7 @@ public:
     int getNumFailures() const;
     int getNumItems() const;
     int getNumProcessed() const;
+    int getNumSkipped() const;
 
     bool isComputing() const;
     QList<int> getCurrentResults();
@@ -361,7 +496,7 @@ public:
 
     void postLoad();
 
-    static void computeBatch(const QString &settingsPath, const QString &logPath);
+    static void computeBatch(const QString &settingsPath, const QString &logPath, const QString &manifestPath = QString());
 
 public slots:
     // user interaction
@@ -485,6 +485,8 @@ void DkSettings::load(QSettings &settings, bool defaults)
 
     resources_p.cacheMemory = settings.value("cacheMemory", resources_p.cacheMemory).toFloat();
     resources_p.historyMemory = settings.value("historyMemory", resources_p.historyMemory).toFloat();
+    resources_p.thumbMemory = settings.value("thumbMemory", resources_p.thumbMemory).toFloat();
+    resources_p.thumbCompressedMemory = settings.value("thumbCompressedMemory", resources_p.thumbCompressedMemory).toFloat();
     resources_p.nativeDialog = settings.value("nativeDialog", resources_p.nativeDialog).toBool();
     resources_p.maxImagesCached = settings.value("maxImagesCached", resources_p.maxImagesCached).toInt();
     resources_p.waitForLastImg = settings.value("waitForLastImg", resources_p.waitForLastImg).toBool();
@@ -762,6 +764,10 @@ void DkSettings::save(QSettings &settings, bool force)
         settings.setValue("cacheMemory", resources_p.cacheMemory);
     if (force || resources_p.historyMemory != resources_d.historyMemory)
         settings.setValue("historyMemory", resources_p.historyMemory);
+    if (force || resources_p.thumbMemory != resources_d.thumbMemory)
+        settings.setValue("thumbMemory", resources_p.thumbMemory);
+    if (force || resources_p.thumbCompressedMemory != resources_d.thumbCompressedMemory)
+        settings.setValue("thumbCompressedMemory", resources_p.thumbCompressedMemory);
     if (force || resources_p.nativeDialog != resources_d.nativeDialog)
         settings.setValue("nativeDialog", resources_p.nativeDialog);
     if (force || resources_p.maxImagesCached != resources_d.maxImagesCached)
@@ -915,6 +921,8 @@ void DkSettings::setToDefaultSettings()
 
     resources_p.cacheMemory = 256;
     resources_p.historyMemory = 128;
+    resources_p.thumbMemory = 128;
+    resources_p.thumbCompressedMemory = 512;
     resources_p.nativeDialog = true;
     resources_p.maxImagesCached = 5;
     resources_p.filterRawImages = true;
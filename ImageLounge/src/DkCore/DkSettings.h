@@ -125,6 +125,8 @@ public:
         sort_date_created,
         sort_date_modified,
         sort_random,
+        sort_date_taken,
+        sort_rating,
         sort_end,
     };
 
@@ -309,6 +311,8 @@ public:
     struct Resources {
         float cacheMemory;
         float historyMemory;
+        float thumbMemory;
+        float thumbCompressedMemory;
         bool nativeDialog;
         int maxImagesCached;
         bool waitForLastImg;
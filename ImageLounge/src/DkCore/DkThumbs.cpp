@@ -27,8 +27,10 @@
 
 #include "DkThumbs.h"
 #include "DkBasicLoader.h"
+#include "DkExifReader.h"
 #include "DkImageStorage.h"
 #include "DkMetaData.h"
+#include "DkPreviewExtractor.h"
 #include "DkSettings.h"
 #include "DkTimer.h"
 #include "DkUtils.h"
@@ -38,6 +40,7 @@
 #include <QFileInfo>
 #include <QImageReader>
 #include <QMutex>
+#include <QPointer>
 #include <QStringList>
 #include <QThreadPool>
 #include <QTimer>
@@ -47,6 +50,315 @@
 namespace nmc
 {
 
+// DkThumbStore --------------------------------------------------------------------
+DkThumbStore::DkThumbStore()
+{
+}
+
+DkThumbStore::~DkThumbStore()
+{
+    mCompressFuture.waitForFinished();
+}
+
+DkThumbStore &DkThumbStore::instance()
+{
+    static DkThumbStore inst;
+    return inst;
+}
+
+/**
+ * Adds a thumbnail to the store.
+ * @param img the thumbnail
+ * @return quint64 the key of the thumbnail (0 if img is null)
+ **/
+quint64 DkThumbStore::insert(const QImage &img)
+{
+    if (img.isNull())
+        return 0;
+
+    QImage cImg = img.hasAlphaChannel() ? img.convertToFormat(QImage::Format_ARGB32_Premultiplied) : img.convertToFormat(QImage::Format_RGB888);
+
+    QMutexLocker locker(&mMutex);
+
+    quint64 key = mNextKey++;
+    setDecoded(key, mEntries[key], cImg);
+    limit();
+
+    return key;
+}
+
+void DkThumbStore::remove(quint64 key)
+{
+    if (!key)
+        return;
+
+    QMutexLocker locker(&mMutex);
+
+    auto it = mEntries.find(key);
+
+    if (it == mEntries.end())
+        return;
+
+    // compressing entries are skipped by compressQueued()
+    if (it->state == state_decoded) {
+        mBytes -= imageBytes(it->img);
+        mDecodedLru.erase(it->lruIt);
+    } else if (it->state == state_compressing) {
+        mBytes -= imageBytes(it->img);
+        mCompressingBytes -= imageBytes(it->img);
+    } else {
+        mCompressedBytes -= it->blob.size();
+        mCompressedLru.erase(it->lruIt);
+    }
+
+    mEntries.erase(it);
+}
+
+/**
+ * Returns the thumbnail and decodes it if needed.
+ * Decoding is done without locking the store.
+ * @param key the thumbnail key
+ * @return QImage the thumbnail or a null image if it was dropped
+ **/
+QImage DkThumbStore::image(quint64 key)
+{
+    QByteArray blob;
+
+    {
+        QMutexLocker locker(&mMutex);
+
+        auto it = mEntries.find(key);
+
+        if (it == mEntries.end())
+            return QImage();
+
+        // it is used again - so it is not compressed
+        if (it->state != state_compressed) {
+            QImage img = it->img;
+            setDecoded(key, it.value(), img);
+            return img;
+        }
+
+        blob = it->blob;
+    }
+
+    QImage img;
+    img.loadFromData(blob);
+
+    if (!img.hasAlphaChannel())
+        img = img.convertToFormat(QImage::Format_RGB888);
+
+    QMutexLocker locker(&mMutex);
+
+    auto it = mEntries.find(key);
+
+    if (it == mEntries.end())
+        return img;
+
+    // another thread might have decoded it in the meantime
+    if (it->state != state_compressed)
+        img = it->img;
+
+    setDecoded(key, it.value(), img);
+    limit();
+
+    return img;
+}
+
+/**
+ * Returns true if the thumbnail was not dropped.
+ * The store is only locked if any thumbnail was dropped since the last call
+ * so that this is cheap enough to be called whenever thumbnails are painted.
+ * @param key the thumbnail key
+ * @param numDropped the number of dropped thumbnails when key was last seen (it is updated)
+ * @return bool true if the thumbnail is available
+ **/
+bool DkThumbStore::contains(quint64 key, int &numDropped) const
+{
+    int nd = mNumDropped.loadAcquire();
+
+    if (nd == numDropped)
+        return true;
+
+    QMutexLocker locker(&mMutex);
+
+    if (!mEntries.contains(key))
+        return false;
+
+    numDropped = nd;
+    return true;
+}
+
+/**
+ * Returns the number of thumbnails that were dropped so far.
+ **/
+int DkThumbStore::numDropped() const
+{
+    return mNumDropped.loadAcquire();
+}
+
+/**
+ * Returns the memory of decoded thumbnails.
+ * @return double the memory in MB
+ **/
+double DkThumbStore::memory() const
+{
+    QMutexLocker locker(&mMutex);
+    return mBytes / (1024.0 * 1024.0);
+}
+
+/**
+ * Returns the memory of compressed thumbnails.
+ * @return double the memory in MB
+ **/
+double DkThumbStore::compressedMemory() const
+{
+    QMutexLocker locker(&mMutex);
+    return mCompressedBytes / (1024.0 * 1024.0);
+}
+
+int DkThumbStore::numImages() const
+{
+    QMutexLocker locker(&mMutex);
+    return mEntries.size();
+}
+
+int DkThumbStore::numCompressed() const
+{
+    QMutexLocker locker(&mMutex);
+    return (int)mCompressedLru.size();
+}
+
+/**
+ * Makes e the most recently used decoded thumbnail.
+ * The store has to be locked.
+ **/
+void DkThumbStore::setDecoded(quint64 key, Entry &e, const QImage &img)
+{
+    if (e.state == state_decoded && !e.img.isNull()) {
+        mDecodedLru.splice(mDecodedLru.begin(), mDecodedLru, e.lruIt);
+        return;
+    }
+
+    if (e.state == state_compressed) {
+        mCompressedBytes -= e.blob.size();
+        mCompressedLru.erase(e.lruIt);
+        e.blob.clear();
+    }
+
+    if (e.state == state_compressing)
+        mCompressingBytes -= imageBytes(e.img);
+    else
+        mBytes += imageBytes(img);
+
+    e.img = img;
+    e.state = state_decoded;
+    mDecodedLru.push_front(key);
+    e.lruIt = mDecodedLru.begin();
+}
+
+/**
+ * Queues the least recently used thumbnails for compression and drops compressed ones.
+ * The store has to be locked.
+ **/
+void DkThumbStore::limit()
+{
+    qint64 maxBytes = qRound64(DkSettingsManager::param().resources().thumbMemory * 1024.0 * 1024.0);
+
+    // compress the least recently used thumbnails
+    while (mBytes - mCompressingBytes > maxBytes && !mDecodedLru.empty()) {
+        quint64 key = mDecodedLru.back();
+        mDecodedLru.pop_back();
+
+        Entry &e = mEntries[key];
+        e.state = state_compressing;
+        mCompressQueue << qMakePair(key, e.img);
+        mCompressingBytes += imageBytes(e.img);
+    }
+
+    if (!mCompressQueue.isEmpty() && !mCompressing) {
+        mCompressing = true;
+        mCompressFuture = QtConcurrent::run([this]() {
+            compressQueued();
+        });
+    }
+
+    dropCompressed();
+}
+
+/**
+ * Drops the least recently used compressed thumbnails.
+ * The store has to be locked.
+ **/
+void DkThumbStore::dropCompressed()
+{
+    qint64 maxCompressedBytes = qRound64(DkSettingsManager::param().resources().thumbCompressedMemory * 1024.0 * 1024.0);
+
+    while (mCompressedBytes > maxCompressedBytes && !mCompressedLru.empty()) {
+        quint64 key = mCompressedLru.back();
+        mCompressedLru.pop_back();
+
+        auto it = mEntries.find(key);
+        mCompressedBytes -= it->blob.size();
+        mEntries.erase(it);
+        mNumDropped.fetchAndAddRelease(1);
+    }
+}
+
+/**
+ * Compresses the queued thumbnails (worker thread).
+ * The store is only locked to exchange the images.
+ **/
+void DkThumbStore::compressQueued()
+{
+    for (;;) {
+        QVector<QPair<quint64, QImage>> queue;
+
+        {
+            QMutexLocker locker(&mMutex);
+
+            if (mCompressQueue.isEmpty()) {
+                mCompressing = false;
+                return;
+            }
+
+            queue.swap(mCompressQueue);
+        }
+
+        for (const QPair<quint64, QImage> &q : queue) {
+            QByteArray blob;
+            QBuffer buffer(&blob);
+            buffer.open(QIODevice::WriteOnly);
+            q.second.save(&buffer, q.second.hasAlphaChannel() ? "PNG" : "JPG", q.second.hasAlphaChannel() ? -1 : 90);
+
+            QMutexLocker locker(&mMutex);
+
+            auto it = mEntries.find(q.first);
+
+            // removed or used again
+            if (it == mEntries.end() || it->state != state_compressing)
+                continue;
+
+            mBytes -= imageBytes(it->img);
+            mCompressingBytes -= imageBytes(it->img);
+            mCompressedBytes += blob.size();
+
+            it->img = QImage();
+            it->blob = blob;
+            it->state = state_compressed;
+            mCompressedLru.push_front(q.first);
+            it->lruIt = mCompressedLru.begin();
+
+            dropCompressed();
+        }
+    }
+}
+
+qint64 DkThumbStore::imageBytes(const QImage &img) const
+{
+    return img.sizeInBytes();
+}
+
 /**
  * Default constructor.
  * @param file the corresponding file
@@ -54,14 +366,73 @@ namespace nmc
  **/
 DkThumbNail::DkThumbNail(const QString &filePath, const QImage &img)
 {
-    mImg = DkImage::createThumb(img);
     mFile = filePath;
-    mMaxThumbSize = qRound(max_thumb_size * DkSettingsManager::param().dpiScaleFactor());
+    mMaxThumbSize = displaySize();
     mImgExists = true;
+    storeImage(DkImage::createThumb(img, mMaxThumbSize));
+}
+
+DkThumbNail::DkThumbNail(const DkThumbNail &o)
+{
+    *this = o;
+}
+
+DkThumbNail &DkThumbNail::operator=(const DkThumbNail &o)
+{
+    if (this == &o)
+        return *this;
+
+    // each thumbnail owns its store entry
+    storeImage(o.getImage());
+    mFile = o.mFile;
+    mImgExists = o.mImgExists;
+    mMaxThumbSize = o.mMaxThumbSize;
+
+    return *this;
 }
 
 DkThumbNail::~DkThumbNail()
 {
+    DkThumbStore::instance().remove(mImgKey);
+}
+
+/**
+ * Returns the thumbnail.
+ * It might be decompressed if it was not used recently.
+ * @return QImage the thumbnail.
+ **/
+QImage DkThumbNail::getImage() const
+{
+    if (!mImgKey)
+        return QImage();
+
+    return DkThumbStore::instance().image(mImgKey);
+}
+
+void DkThumbNail::storeImage(const QImage &img)
+{
+    DkThumbStore::instance().remove(mImgKey);
+
+    // read it before inserting - drops in between just make the next hasImage() lock
+    mNumDropped = DkThumbStore::instance().numDropped();
+    mImgKey = img.isNull() ? 0 : DkThumbStore::instance().insert(img);
+    mImgSize = img.size();
+}
+
+/**
+ * Returns the largest size thumbnails are currently displayed with.
+ * The preview bar and the thumbnail grid share the thumbnails, so the larger size is used.
+ * @return int the maximal thumbnail side (in device pixels)
+ **/
+int DkThumbNail::displaySize()
+{
+    int ds = qMax(DkSettingsManager::param().effectiveThumbSize(), DkSettingsManager::param().effectiveThumbPreviewSize());
+
+    // squared thumbnails are cropped - keep the short side of (up to 2:1) images large enough
+    if (DkSettingsManager::param().display().displaySquaredThumbs)
+        ds *= 2;
+
+    return qMin(ds, qRound(max_thumb_size * DkSettingsManager::param().dpiScaleFactor()));
 }
 
 /**
@@ -72,8 +443,8 @@ void DkThumbNail::compute(int forceLoad)
 {
     // this is so complicated to be thread-safe
     // if we use member vars in the thread and the object gets deleted during thread execution we crash...
-    mImg = computeIntern(mFile, QSharedPointer<QByteArray>(), forceLoad, mMaxThumbSize);
-    mImg = DkImage::createThumb(mImg);
+    QImage img = computeIntern(mFile, QSharedPointer<QByteArray>(), forceLoad, mMaxThumbSize);
+    storeImage(DkImage::createThumb(img, mMaxThumbSize));
 }
 
 /**
@@ -91,36 +462,60 @@ void DkThumbNail::compute(int forceLoad)
 QImage DkThumbNail::computeIntern(const QString &filePath, const QSharedPointer<QByteArray> ba, int forceLoad, int maxThumbSize)
 {
     DkTimer dt;
+    DkTraceScope ts("computeThumb", DkTraceLog::cat_thumbnail, filePath);
     // qDebug() << "[thumb] file: " << filePath;
 
     // see if we can read the thumbnail from the exif data
     QImage thumb;
     DkMetaDataT metaData;
+    DkExifReader exifReader;
 
     QSharedPointer<QByteArray> baZip = QSharedPointer<QByteArray>();
 #ifdef WITH_QUAZIP
-    if (QFileInfo(mFile).dir().path().contains(DkZipContainer::zipMarker()))
+    if (QFileInfo(filePath).dir().path().contains(DkZipContainer::zipMarker()))
         baZip = DkZipContainer::extractImage(DkZipContainer::decodeZipFile(filePath), DkZipContainer::decodeImageFile(filePath));
 #endif
-    try {
-        // [DIEM] READ  build crashed here 09.06.2016
-        if (baZip && !baZip->isEmpty())
-            metaData.readMetaData(filePath, baZip);
-        else if (!ba || ba->isEmpty())
-            metaData.readMetaData(filePath);
-        else
-            metaData.readMetaData(filePath, ba);
-
-        // read the full image if we want to create new thumbnails
-        if (forceLoad != force_save_thumb)
-            thumb = metaData.getThumbnail();
-    } catch (...) {
-        // do nothing - we'll load the full file
+
+    // we only need Exiv2 if the thumbnail is written back to the file
+    bool fastExif = false;
+    if (forceLoad != save_thumb && forceLoad != force_save_thumb)
+        fastExif = exifReader.read(filePath, (baZip && !baZip->isEmpty()) ? baZip : ba);
+
+    if (fastExif) {
+        // the full image is loaded anyway
+        if (forceLoad != force_full_thumb)
+            thumb = exifReader.thumbnail();
+    } else {
+        try {
+            // [DIEM] READ  build crashed here 09.06.2016
+            if (baZip && !baZip->isEmpty())
+                metaData.readMetaData(filePath, baZip);
+            else if (!ba || ba->isEmpty())
+                metaData.readMetaData(filePath);
+            else
+                metaData.readMetaData(filePath, ba);
+
+            // read the full image if we want to create new thumbnails
+            if (forceLoad != force_save_thumb)
+                thumb = metaData.getThumbnail();
+        } catch (...) {
+            // do nothing - we'll load the full file
+        }
     }
     removeBlackBorder(thumb);
 
     bool exifThumb = !thumb.isNull();
-    int orientation = metaData.getOrientationDegree();
+
+    // embedded previews (PSD, TIFF, RAW) are way faster than decoding the whole image
+    if (forceLoad != force_full_thumb && forceLoad != force_save_thumb && DkPreviewExtractor::isSupported(filePath)
+        && (thumb.isNull() || qMax(thumb.width(), thumb.height()) < maxThumbSize)) {
+        QImage preview = DkPreviewExtractor::loadPreview(filePath, (baZip && !baZip->isEmpty()) ? baZip : ba, maxThumbSize, fastExif ? &exifReader : 0);
+
+        if (!preview.isNull())
+            thumb = preview;
+    }
+
+    int orientation = fastExif ? exifReader.orientationDegree() : metaData.getOrientationDegree();
 
     if (exifThumb && (metaData.isAVIF() || metaData.isHEIF() || metaData.isJXL()) && orientation != -1 && orientation != 0) {
         // do not rotate together with full image but rotate Exif thumb only
@@ -136,6 +531,9 @@ QImage DkThumbNail::computeIntern(const QString &filePath, const QSharedPointer<
     // diem: do_not_force is the generic load - so also rescale these
     bool rescale = forceLoad == do_not_force;
 
+    // the loader does not rotate pixels - we rotate the (small) thumbnail instead
+    DkJpgTransform::Transform loaderOrientation = DkJpgTransform::transform_identity;
+
     if ((forceLoad != force_exif_thumb || fInfo.size() < 1e5) && (thumb.isNull() || forceLoad == force_full_thumb || forceLoad == force_save_thumb)) { // braces
 
         // try to read the image
@@ -143,10 +541,10 @@ QImage DkThumbNail::computeIntern(const QString &filePath, const QSharedPointer<
 
         if (baZip && !baZip->isEmpty()) {
             if (loader.loadGeneral(lFilePath, baZip, true, true))
-                thumb = loader.image();
+                thumb = loader.rawPixmap(&loaderOrientation);
         } else {
             if (loader.loadGeneral(lFilePath, ba, true, true))
-                thumb = loader.image();
+                thumb = loader.rawPixmap(&loaderOrientation);
         }
     }
 
@@ -176,11 +574,12 @@ QImage DkThumbNail::computeIntern(const QString &filePath, const QSharedPointer<
         thumb = thumb.scaled(QSize(w, h), Qt::KeepAspectRatio, Qt::SmoothTransformation);
     }
 
-    if (orientation != -1 && orientation != 0 && (metaData.isJpg() || metaData.isRaw())) {
+    if (orientation != -1 && orientation != 0 && (DkMetaDataT::isJpg(filePath) || DkMetaDataT::isRaw(filePath))) {
         QTransform rotationMatrix;
         rotationMatrix.rotate((double)orientation);
         thumb = thumb.transformed(rotationMatrix);
-    }
+    } else
+        thumb = DkJpgTransform::apply(thumb, loaderOrientation);
 
     // save the thumbnail if the caller either forces it, or the save thumb is requested and the image did not have any before
     if (forceLoad == force_save_thumb || (forceLoad == save_thumb && !exifThumb)) {
@@ -270,7 +669,7 @@ void DkThumbNail::removeBlackBorder(QImage &img)
  **/
 void DkThumbNail::setImage(const QImage img)
 {
-    mImg = DkImage::createThumb(img);
+    storeImage(DkImage::createThumb(img, mMaxThumbSize));
 }
 
 /**
@@ -287,58 +686,263 @@ DkThumbNailT::DkThumbNailT(const QString &filePath, const QImage &img)
 
 DkThumbNailT::~DkThumbNailT()
 {
-    mThumbWatcher.blockSignals(true);
-    mThumbWatcher.cancel();
+    DkThumbScheduler::instance().cancel(this);
 }
 
-bool DkThumbNailT::fetchThumb(int forceLoad /* = false */, QSharedPointer<QByteArray> ba)
+/**
+ * Requests the thumbnail from the DkThumbScheduler.
+ * If the thumbnail is already requested, its priority is updated.
+ * @param forceLoad flag for loading/saving the thumbnail from exif only.
+ * @param ba optional: the file buffer.
+ * @param priority the DkThumbScheduler::Priority of this request.
+ * @return bool true if a new request was started.
+ **/
+bool DkThumbNailT::fetchThumb(int forceLoad /* = false */, QSharedPointer<QByteArray> ba, int priority)
 {
     if (forceLoad == force_full_thumb || forceLoad == force_save_thumb || forceLoad == save_thumb)
-        mImg = QImage();
+        storeImage(QImage());
 
-    if (!mImg.isNull() || !mImgExists || mFetching)
+    // bump the request (e.g. it is visible again)
+    if (mFetching) {
+        DkThumbScheduler::instance().request(this, mForceLoad, ba, priority);
+        return false;
+    }
+
+    bool outdated = isOutdated();
+
+    if ((hasImage() == loaded && !outdated) || !mImgExists)
         return false;
 
+    // the current thumbnail is shown until the larger one is loaded
+    if (outdated)
+        mMaxThumbSize = displaySize();
+
     // check if we can load the file
     // though if it might seem over engineered: it is much faster cascading it here
     if (!DkUtils::hasValidSuffix(getFilePath()) && !QFileInfo(getFilePath()).suffix().isEmpty() && !DkUtils::isValid(getFilePath()))
         return false;
 
-    // we have to do our own bool here
-    // watcher.isRunning() returns false if the thread is waiting in the pool
     mFetching = true;
     mForceLoad = forceLoad;
 
-    connect(&mThumbWatcher, SIGNAL(finished()), this, SLOT(thumbLoaded()), Qt::UniqueConnection);
-
-    mThumbWatcher.setFuture(QtConcurrent::run(DkThumbsThreadPool::pool(), // load thumbnails on their dedicated pool
-                                              this,
-                                              &nmc::DkThumbNailT::computeCall,
-                                              mFile,
-                                              ba,
-                                              forceLoad,
-                                              mMaxThumbSize));
+    DkThumbScheduler::instance().request(this, forceLoad, ba, priority);
 
     return true;
 }
 
-QImage DkThumbNailT::computeCall(const QString &filePath, QSharedPointer<QByteArray> ba, int forceLoad, int maxThumbSize)
+/**
+ * Cancels a pending request.
+ * Requests that are already computed are not stopped but their result is ignored.
+ **/
+void DkThumbNailT::cancelFetch()
 {
-    QImage thumb = DkThumbNail::computeIntern(filePath, ba, forceLoad, maxThumbSize);
-    return DkImage::createThumb(thumb);
+    if (!mFetching)
+        return;
+
+    DkThumbScheduler::instance().cancel(this);
+    mFetching = false;
 }
 
-void DkThumbNailT::thumbLoaded()
+int DkThumbNailT::hasImage() const
 {
-    QFuture<QImage> future = mThumbWatcher.future();
+    if (mFetching && DkThumbScheduler::instance().isRunning(this))
+        return loading;
+    else
+        return DkThumbNail::hasImage();
+}
 
-    mImg = future.result();
+void DkThumbNailT::thumbLoaded(const QImage &img)
+{
+    storeImage(img);
 
-    if (mImg.isNull() && mForceLoad != force_exif_thumb)
+    if (img.isNull() && mForceLoad != force_exif_thumb)
         mImgExists = false;
 
     mFetching = false;
-    emit thumbLoadedSignal(!mImg.isNull());
+    emit thumbLoadedSignal(!img.isNull());
+}
+
+// DkThumbScheduler --------------------------------------------------------------------
+DkThumbScheduler::DkThumbScheduler()
+    : QObject()
+{
+}
+
+DkThumbScheduler &DkThumbScheduler::instance()
+{
+    static DkThumbScheduler inst;
+    return inst;
+}
+
+/**
+ * Requests a thumbnail.
+ * If another thumbnail requests the same file, the jobs are merged.
+ * If thumb is already waiting, its job is moved to the front of the queue.
+ * @param thumb the requesting thumbnail (it is notified via thumbLoaded).
+ * @param forceLoad the DkThumbNail load flag.
+ * @param ba optional: the file buffer.
+ * @param priority the request's priority.
+ **/
+void DkThumbScheduler::request(DkThumbNailT *thumb, int forceLoad, QSharedPointer<QByteArray> ba, int priority)
+{
+    priority = qBound(0, priority, priority_end - 1);
+
+    JobPtr job = mRequests.value(thumb);
+
+    if (!job) {
+        job = findJob(thumb->getFilePath(), forceLoad, thumb->getMaxThumbSize());
+
+        if (!job) {
+            job = JobPtr(new Job());
+            job->filePath = thumb->getFilePath();
+            job->forceLoad = forceLoad;
+            job->maxThumbSize = thumb->getMaxThumbSize();
+            job->priority = priority;
+            mJobs.insert(job->filePath, job);
+        }
+
+        job->requesters << thumb;
+        mRequests.insert(thumb, job);
+    }
+
+    if (!job->ba && ba)
+        job->ba = ba;
+
+    if (!job->running)
+        enqueue(job, priority);
+
+    schedule();
+}
+
+/**
+ * Cancels the request of thumb.
+ * The job is removed if no one else is waiting for it.
+ * @param thumb the requesting thumbnail.
+ **/
+void DkThumbScheduler::cancel(DkThumbNailT *thumb)
+{
+    JobPtr job = mRequests.take(thumb);
+
+    if (!job)
+        return;
+
+    job->requesters.removeAll(thumb);
+
+    // running jobs can't be stopped - we just drop the result
+    if (job->requesters.isEmpty() && !job->running)
+        removeJob(job);
+}
+
+/**
+ * Cancels all pending requests.
+ **/
+void DkThumbScheduler::cancelAll()
+{
+    QList<const DkThumbNailT *> thumbs = mRequests.keys();
+
+    for (const DkThumbNailT *t : thumbs) {
+        JobPtr job = mRequests.value(t);
+        if (job && !job->running)
+            const_cast<DkThumbNailT *>(t)->cancelFetch();
+    }
+}
+
+bool DkThumbScheduler::isRunning(const DkThumbNailT *thumb) const
+{
+    JobPtr job = mRequests.value(thumb);
+    return job && job->running;
+}
+
+DkThumbScheduler::JobPtr DkThumbScheduler::findJob(const QString &filePath, int forceLoad, int maxThumbSize) const
+{
+    // saving must not be skipped - so these are never merged with plain requests
+    bool plain = forceLoad == DkThumbNail::do_not_force || forceLoad == DkThumbNail::force_exif_thumb;
+
+    for (auto it = mJobs.constFind(filePath); it != mJobs.constEnd() && it.key() == filePath; ++it) {
+        const JobPtr &job = it.value();
+
+        if (job->maxThumbSize != maxThumbSize)
+            continue;
+
+        // any thumbnail is fine for plain requests
+        if (job->forceLoad == forceLoad || (plain && job->forceLoad != DkThumbNail::force_exif_thumb))
+            return job;
+    }
+
+    return JobPtr();
+}
+
+void DkThumbScheduler::enqueue(JobPtr job, int priority)
+{
+    auto qIt = mQueue.find(job->queueKey);
+    if (qIt != mQueue.end() && qIt->second == job)
+        mQueue.erase(qIt);
+
+    // LIFO within the same priority: the latest request is served first
+    job->priority = qMin(job->priority, priority);
+    job->queueKey = std::make_pair(job->priority, -(++mSequence));
+    mQueue[job->queueKey] = job;
+}
+
+void DkThumbScheduler::removeJob(JobPtr job)
+{
+    auto qIt = mQueue.find(job->queueKey);
+    if (qIt != mQueue.end() && qIt->second == job)
+        mQueue.erase(qIt);
+
+    mJobs.remove(job->filePath, job);
+}
+
+void DkThumbScheduler::schedule()
+{
+    int maxRunning = DkThumbsThreadPool::pool()->maxThreadCount();
+
+    while (mNumRunning < maxRunning && !mQueue.empty()) {
+        JobPtr job = mQueue.begin()->second;
+        mQueue.erase(mQueue.begin());
+
+        job->running = true;
+        mNumRunning++;
+
+        auto watcher = new QFutureWatcher<QImage>(this);
+        connect(watcher, &QFutureWatcher<QImage>::finished, this, [this, watcher, job]() {
+            QImage img = watcher->result();
+            watcher->deleteLater();
+            jobFinished(job, img);
+        });
+
+        QString filePath = job->filePath;
+        QSharedPointer<QByteArray> ba = job->ba;
+        int forceLoad = job->forceLoad;
+        int maxThumbSize = job->maxThumbSize;
+
+        watcher->setFuture(QtConcurrent::run(DkThumbsThreadPool::pool(), // load thumbnails on their dedicated pool
+                                             [filePath, ba, forceLoad, maxThumbSize]() {
+                                                 QImage thumb = DkThumbNail::computeIntern(filePath, ba, forceLoad, maxThumbSize);
+                                                 return DkImage::createThumb(thumb, maxThumbSize);
+                                             }));
+    }
+}
+
+void DkThumbScheduler::jobFinished(JobPtr job, const QImage &img)
+{
+    mNumRunning--;
+    job->running = false;
+    mJobs.remove(job->filePath, job);
+
+    // notifying might trigger new requests (or delete requesters) - so clean up first
+    QVector<QPointer<DkThumbNailT>> requesters;
+    for (DkThumbNailT *t : job->requesters) {
+        mRequests.remove(t);
+        requesters << t;
+    }
+
+    for (QPointer<DkThumbNailT> t : requesters) {
+        if (t)
+            t->thumbLoaded(img);
+    }
+
+    schedule();
 }
 
 // DkThumbsThreadPool --------------------------------------------------------------------
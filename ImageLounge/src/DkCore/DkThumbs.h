@@ -28,12 +28,18 @@
 #pragma once
 
 #pragma warning(push, 0) // no warnings from includes - begin
+#include <QAtomicInt>
 #include <QColor>
 #include <QDir>
 #include <QFutureWatcher>
+#include <QHash>
 #include <QImage>
+#include <QMutex>
 #include <QSharedPointer>
 #include <QThread>
+#include <QVector>
+#include <list>
+#include <map>
 #pragma warning(pop) // no warnings from includes - end
 
 #pragma warning(disable : 4251) // TODO: remove
@@ -53,8 +59,73 @@ class QThreadPool;
 namespace nmc
 {
 
+class DkThumbNailT;
+
 #define max_thumb_size 400
 
+/**
+ * Memory capped store for thumbnail images.
+ * Thumbnails are kept in a compact format (RGB888 if they have no alpha).
+ * If the decoded thumbnails exceed DkSettings::Resources::thumbMemory,
+ * the least recently used ones are compressed (JPG or PNG) in the background and decoded on demand.
+ * If the compressed thumbnails exceed DkSettings::Resources::thumbCompressedMemory,
+ * the least recently used ones are dropped (and need to be loaded again).
+ * The store is thread-safe.
+ **/
+class DllCoreExport DkThumbStore
+{
+public:
+    static DkThumbStore &instance();
+
+    quint64 insert(const QImage &img);
+    void remove(quint64 key);
+    QImage image(quint64 key);
+    bool contains(quint64 key, int &numDropped) const;
+    int numDropped() const;
+
+    double memory() const;
+    double compressedMemory() const;
+    int numImages() const;
+    int numCompressed() const;
+
+private:
+    DkThumbStore();
+    DkThumbStore(const DkThumbStore &);
+    ~DkThumbStore();
+
+    enum State {
+        state_decoded,
+        state_compressing,
+        state_compressed,
+    };
+
+    struct Entry {
+        QImage img;
+        QByteArray blob;
+        State state = state_decoded;
+        std::list<quint64>::iterator lruIt; // position in the list of its state (none if compressing)
+    };
+
+    void setDecoded(quint64 key, Entry &e, const QImage &img);
+    void limit();
+    void dropCompressed();
+    void compressQueued();
+    qint64 imageBytes(const QImage &img) const;
+
+    mutable QMutex mMutex;
+    QHash<quint64, Entry> mEntries;
+    std::list<quint64> mDecodedLru; // most recent first
+    std::list<quint64> mCompressedLru; // most recent first
+    QVector<QPair<quint64, QImage>> mCompressQueue;
+    QFuture<void> mCompressFuture;
+    bool mCompressing = false;
+    quint64 mNextKey = 1;
+    qint64 mBytes = 0; // decoded and compressing
+    qint64 mCompressingBytes = 0;
+    qint64 mCompressedBytes = 0;
+    QAtomicInt mNumDropped;
+};
+
 /**
  * This class holds thumbnails.
  **/
@@ -74,6 +145,8 @@ public:
      * @param img the thumbnail image
      **/
     DkThumbNail(const QString &filePath = QString(), const QImage &img = QImage());
+    DkThumbNail(const DkThumbNail &o);
+    DkThumbNail &operator=(const DkThumbNail &o);
 
     /**
      * Default destructor.
@@ -98,9 +171,15 @@ public:
      * Returns the thumbnail.
      * @return QImage the thumbnail.
      **/
-    QImage getImage() const
+    QImage getImage() const;
+
+    /**
+     * Returns the size of the thumbnail without accessing it.
+     * @return QSize the thumbnail size (it is only valid if the thumbnail is loaded)
+     **/
+    QSize getImageSize() const
     {
-        return mImg;
+        return mImgSize;
     };
 
     /**
@@ -120,14 +199,24 @@ public:
      **/
     int hasImage() const
     {
-        if (!mImg.isNull())
+        if (mImgKey && DkThumbStore::instance().contains(mImgKey, mNumDropped))
             return loaded;
-        else if (mImg.isNull() && mImgExists)
+        else if (mImgExists)
             return not_loaded;
         else
             return exists_not;
     };
 
+    /**
+     * Returns true if thumbnails are displayed larger than this one was loaded.
+     * Thumbnails are stored with their display size, so it needs to be fetched again.
+     * @return bool true if the thumbnail is too small
+     **/
+    bool isOutdated() const
+    {
+        return displaySize() > mMaxThumbSize;
+    };
+
     void setMaxThumbSize(int maxSize)
     {
         mMaxThumbSize = maxSize;
@@ -155,16 +244,81 @@ public:
         force_save_thumb,
     };
 
+    static QImage computeIntern(const QString &file, QSharedPointer<QByteArray> ba, int forceLoad, int maxThumbSize);
+    static int displaySize();
+
 protected:
-    QImage computeIntern(const QString &file, QSharedPointer<QByteArray> ba, int forceLoad, int maxThumbSize);
+    void storeImage(const QImage &img);
 
-    QImage mImg;
+    quint64 mImgKey = 0; // see DkThumbStore
+    QSize mImgSize;
+    mutable int mNumDropped = 0; // see DkThumbStore::contains
     QString mFile;
     // int s;
     bool mImgExists;
     int mMaxThumbSize;
 };
 
+/**
+ * Schedules thumbnail jobs on the DkThumbsThreadPool.
+ * Jobs are ordered by priority (visible > near viewport > prefetch > background)
+ * and - within the same priority - the most recent request is served first.
+ * Requests for the same file are merged and requests of thumbnails that
+ * scrolled away can be cancelled before they are started.
+ * Note: the scheduler lives in the GUI thread and must only be called from there.
+ **/
+class DllCoreExport DkThumbScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Priority {
+        priority_visible = 0,
+        priority_near,
+        priority_prefetch,
+        priority_background,
+
+        priority_end
+    };
+
+    static DkThumbScheduler &instance();
+
+    void request(DkThumbNailT *thumb, int forceLoad, QSharedPointer<QByteArray> ba, int priority);
+    void cancel(DkThumbNailT *thumb);
+    void cancelAll();
+
+    bool isRunning(const DkThumbNailT *thumb) const;
+
+private:
+    DkThumbScheduler();
+    DkThumbScheduler(const DkThumbScheduler &);
+
+    struct Job {
+        QString filePath;
+        int forceLoad = DkThumbNail::do_not_force;
+        int maxThumbSize = max_thumb_size;
+        QSharedPointer<QByteArray> ba;
+        int priority = priority_background;
+        std::pair<int, qint64> queueKey;
+        bool running = false;
+        QVector<DkThumbNailT *> requesters;
+    };
+
+    typedef QSharedPointer<Job> JobPtr;
+
+    JobPtr findJob(const QString &filePath, int forceLoad, int maxThumbSize) const;
+    void enqueue(JobPtr job, int priority);
+    void removeJob(JobPtr job);
+    void schedule();
+    void jobFinished(JobPtr job, const QImage &img);
+
+    QMultiHash<QString, JobPtr> mJobs; // file path -> pending & running jobs
+    QHash<const DkThumbNailT *, JobPtr> mRequests;
+    std::map<std::pair<int, qint64>, JobPtr> mQueue; // (priority, -sequence) -> pending job
+    qint64 mSequence = 0;
+    int mNumRunning = 0;
+};
+
 class DllCoreExport DkThumbNailT : public QObject, public DkThumbNail
 {
     Q_OBJECT
@@ -173,19 +327,14 @@ public:
     DkThumbNailT(const QString &mFile = QString(), const QImage &mImg = QImage());
     ~DkThumbNailT();
 
-    bool fetchThumb(int forceLoad = do_not_force, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
+    bool fetchThumb(int forceLoad = do_not_force, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>(), int priority = DkThumbScheduler::priority_visible);
+    void cancelFetch();
 
     /**
      * Returns whether the thumbnail was loaded, or does not exist.
      * @return int a status (loaded | not loaded | exists not | loading)
      **/
-    int hasImage() const
-    {
-        if (mThumbWatcher.isRunning())
-            return loading;
-        else
-            return DkThumbNail::hasImage();
-    };
+    int hasImage() const;
 
     void setImage(const QImage img)
     {
@@ -196,13 +345,10 @@ public:
 signals:
     void thumbLoadedSignal(bool loaded = true);
 
-protected slots:
-    void thumbLoaded();
-
 protected:
-    QImage computeCall(const QString &filePath, QSharedPointer<QByteArray> ba, int forceLoad, int maxThumbSize);
+    friend class DkThumbScheduler;
+    void thumbLoaded(const QImage &img);
 
-    QFutureWatcher<QImage> mThumbWatcher;
     bool mFetching;
     int mForceLoad;
 };
@@ -32,8 +32,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "DkUtils.h"
 
 #pragma warning(push, 0) // no warnings from includes - begin
+#include <QCoreApplication>
 #include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
 #include <QString>
+#include <QThread>
+#include <algorithm>
 #include <qmath.h>
 #pragma warning(pop) // no warnings from includes - end
 
@@ -69,12 +79,12 @@ QDebug operator<<(QDebug d, const DkTimer &timer)
  **/
 QString DkTimer::getTotal() const
 {
-    return qPrintable(stringifyTime(mTimer.elapsed()));
+    return qPrintable(stringifyTime(elapsed()));
 }
 
 QDataStream &DkTimer::put(QDataStream &s) const
 {
-    s << stringifyTime(mTimer.elapsed());
+    s << stringifyTime(elapsed());
 
     return s;
 }
@@ -128,6 +138,321 @@ void DkTimer::start()
 
 int DkTimer::elapsed() const
 {
-    return mTimer.elapsed();
+    return (int)mTimer.elapsed();
+}
+
+/**
+ * Returns the elapsed time in microseconds.
+ * @return qint64 the time since start() in us
+ **/
+qint64 DkTimer::elapsedMicro() const
+{
+    return mTimer.nsecsElapsed() / 1000;
+}
+
+// DkTraceLog --------------------------------------------------------------------
+DkTraceLog::DkTraceLog()
+{
+    mClock.start();
+}
+
+DkTraceLog &DkTraceLog::instance()
+{
+    static DkTraceLog inst;
+    return inst;
+}
+
+/**
+ * Enables tracing. All spans recorded from now on are written
+ * to filePath when stop() is called.
+ * @param filePath the trace JSON file
+ **/
+void DkTraceLog::start(const QString &filePath)
+{
+    QMutexLocker locker(&mMutex);
+    mFilePath = filePath;
+    mSpans.clear();
+    mEnabled.storeRelaxed(1);
+
+    qInfo() << "[DkTraceLog] tracing to" << filePath;
+}
+
+/**
+ * Disables tracing and writes all recorded spans.
+ * @return bool true if the trace file was written
+ **/
+bool DkTraceLog::stop()
+{
+    if (!isEnabled())
+        return false;
+
+    mEnabled.storeRelaxed(0);
+
+    QVector<Span> spans;
+    QStringList threadNames;
+    QString filePath;
+    {
+        QMutexLocker locker(&mMutex);
+        spans.swap(mSpans);
+        threadNames = mThreadNames;
+        filePath = mFilePath;
+    }
+
+    return write(filePath, spans, threadNames);
+}
+
+/**
+ * Returns the trace clock in microseconds.
+ **/
+qint64 DkTraceLog::now() const
+{
+    return mClock.nsecsElapsed() / 1000;
+}
+
+void DkTraceLog::addSpan(const char *name, Category cat, qint64 startUs, qint64 durationUs, const QString &arg)
+{
+    if (!isEnabled())
+        return;
+
+    QMutexLocker locker(&mMutex);
+
+    Span s;
+    s.name = name;
+    s.cat = cat;
+    s.tid = threadId();
+    s.start = startUs;
+    s.duration = durationUs;
+    s.arg = arg;
+
+    mSpans.append(s);
+}
+
+QString DkTraceLog::categoryName(Category cat)
+{
+    switch (cat) {
+    case cat_io:
+        return "io";
+    case cat_decode:
+        return "decode";
+    case cat_metadata:
+        return "metadata";
+    case cat_resize:
+        return "resize";
+    case cat_paint:
+        return "paint";
+    case cat_thumbnail:
+        return "thumbnail";
+    case cat_batch:
+        return "batch";
+    default:
+        return "unknown";
+    }
+}
+
+int DkTraceLog::threadId()
+{
+    // NOTE: mMutex must be locked here
+    Qt::HANDLE h = QThread::currentThreadId();
+
+    auto it = mThreadIds.constFind(h);
+    if (it != mThreadIds.constEnd())
+        return it.value();
+
+    int tid = mThreadNames.size() + 1;
+    mThreadIds.insert(h, tid);
+
+    QThread *t = QThread::currentThread();
+    if (QCoreApplication::instance() && t == QCoreApplication::instance()->thread())
+        mThreadNames << "main";
+    else if (t && !t->objectName().isEmpty())
+        mThreadNames << t->objectName();
+    else
+        mThreadNames << QString("worker %1").arg(tid);
+
+    return tid;
+}
+
+bool DkTraceLog::write(const QString &filePath, const QVector<Span> &spans, const QStringList &threadNames) const
+{
+    qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray events;
+
+    for (int idx = 0; idx < threadNames.size(); idx++) {
+        QJsonObject args;
+        args["name"] = threadNames[idx];
+
+        QJsonObject e;
+        e["name"] = "thread_name";
+        e["ph"] = "M";
+        e["pid"] = pid;
+        e["tid"] = idx + 1;
+        e["args"] = args;
+        events.append(e);
+    }
+
+    for (const Span &s : spans) {
+        QJsonObject e;
+        e["name"] = QString::fromLatin1(s.name);
+        e["cat"] = categoryName((Category)s.cat);
+        e["ph"] = "X";
+        e["ts"] = s.start;
+        e["dur"] = s.duration;
+        e["pid"] = pid;
+        e["tid"] = s.tid;
+
+        if (!s.arg.isEmpty()) {
+            QJsonObject args;
+            args["file"] = s.arg;
+            e["args"] = args;
+        }
+
+        events.append(e);
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ms";
+
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "[DkTraceLog] could not write trace to" << filePath;
+        return false;
+    }
+
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    qInfo() << "[DkTraceLog]" << spans.size() << "spans written to" << filePath;
+
+    return true;
+}
+
+// DkTraceScope --------------------------------------------------------------------
+DkTraceScope::DkTraceScope(const char *name, DkTraceLog::Category cat, const QString &arg)
+    : mName(name)
+    , mCat(cat)
+{
+    DkTraceLog &log = DkTraceLog::instance();
+
+    // keep this cheap - it's on all hot paths
+    if (!log.isEnabled())
+        return;
+
+    mArg = arg;
+    mStart = log.now();
+}
+
+DkTraceScope::~DkTraceScope()
+{
+    if (mStart < 0)
+        return;
+
+    DkTraceLog &log = DkTraceLog::instance();
+    log.addSpan(mName, mCat, mStart, log.now() - mStart, mArg);
+}
+
+// DkFrameStats --------------------------------------------------------------------
+DkFrameStats::DkFrameStats()
+{
+}
+
+/**
+ * Resets the statistics.
+ * @param refreshRate the display's refresh rate in Hz
+ **/
+void DkFrameStats::start(double refreshRate)
+{
+    mPeriodMs = 1000.0 / (refreshRate > 1.0 ? refreshRate : 60.0);
+    mIntervalsMs.clear();
+    mLastFrame = -1;
+    mTimer.start();
+}
+
+/**
+ * Call this once per presented frame.
+ **/
+void DkFrameStats::addFrame()
+{
+    if (!mTimer.isValid())
+        return;
+
+    qint64 now = mTimer.nsecsElapsed();
+
+    if (mLastFrame >= 0)
+        mIntervalsMs << (now - mLastFrame) / 1e6;
+
+    mLastFrame = now;
+}
+
+int DkFrameStats::frames() const
+{
+    return mIntervalsMs.empty() ? 0 : mIntervalsMs.size() + 1;
+}
+
+int DkFrameStats::droppedFrames() const
+{
+    int dropped = 0;
+    for (double ms : mIntervalsMs) {
+        if (ms > 1.5 * mPeriodMs)
+            dropped += qMax(1, qRound(ms / mPeriodMs) - 1);
+    }
+
+    return dropped;
+}
+
+double DkFrameStats::meanFrameMs() const
+{
+    if (mIntervalsMs.empty())
+        return 0.0;
+
+    double sum = 0.0;
+    for (double ms : mIntervalsMs)
+        sum += ms;
+
+    return sum / mIntervalsMs.size();
+}
+
+double DkFrameStats::maxFrameMs() const
+{
+    double mx = 0.0;
+    for (double ms : mIntervalsMs)
+        mx = qMax(mx, ms);
+
+    return mx;
+}
+
+/**
+ * Returns the p-th percentile of the frame intervals.
+ * @param p the percentile in [0 1]
+ * @return double the frame interval in ms
+ **/
+double DkFrameStats::percentileFrameMs(double p) const
+{
+    if (mIntervalsMs.empty())
+        return 0.0;
+
+    QVector<double> sorted = mIntervalsMs;
+    std::sort(sorted.begin(), sorted.end());
+
+    int idx = qBound(0, qCeil(p * sorted.size()) - 1, sorted.size() - 1);
+    return sorted[idx];
+}
+
+double DkFrameStats::fps() const
+{
+    double mean = meanFrameMs();
+    return mean > 0.0 ? 1000.0 / mean : 0.0;
+}
+
+QString DkFrameStats::toString() const
+{
+    return QString("%1 frames, %2 dropped, %3 fps (mean %4 ms, p95 %5 ms, max %6 ms, refresh period %7 ms)")
+        .arg(frames())
+        .arg(droppedFrames())
+        .arg(fps(), 0, 'f', 1)
+        .arg(meanFrameMs(), 0, 'f', 2)
+        .arg(percentileFrameMs(0.95), 0, 'f', 2)
+        .arg(maxFrameMs(), 0, 'f', 2)
+        .arg(mPeriodMs, 0, 'f', 2);
 }
 }
\ No newline at end of file
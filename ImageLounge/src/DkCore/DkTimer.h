@@ -29,8 +29,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <time.h>
 
 #pragma warning(push, 0) // no warnings from includes - begin
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
 #include <QObject>
-#include <QTime>
+#include <QStringList>
+#include <QVector>
 #pragma warning(pop) // no warnings from includes - end
 
 #ifndef DllCoreExport
@@ -71,10 +76,119 @@ public:
     virtual QDataStream &put(QDataStream &s) const;
     QString stringifyTime(int ct) const;
     int elapsed() const;
+    qint64 elapsedMicro() const;
     void start();
 
 protected:
-    QTime mTimer;
+    QElapsedTimer mTimer;
+};
+
+/**
+ * Collects timing spans of all threads and writes them as
+ * Chrome/Perfetto trace JSON (chrome://tracing, ui.perfetto.dev).
+ * Tracing is disabled by default - spans then cost a single atomic load.
+ **/
+class DllCoreExport DkTraceLog
+{
+public:
+    enum Category {
+        cat_io = 0,
+        cat_decode,
+        cat_metadata,
+        cat_resize,
+        cat_paint,
+        cat_thumbnail,
+        cat_batch,
+
+        cat_end
+    };
+
+    static DkTraceLog &instance();
+
+    bool isEnabled() const
+    {
+        return mEnabled.loadRelaxed() != 0;
+    };
+
+    void start(const QString &filePath);
+    bool stop();
+
+    qint64 now() const;
+    void addSpan(const char *name, Category cat, qint64 startUs, qint64 durationUs, const QString &arg = QString());
+
+    static QString categoryName(Category cat);
+
+private:
+    DkTraceLog();
+    DkTraceLog(const DkTraceLog &);
+
+    struct Span {
+        const char *name;
+        int cat;
+        int tid;
+        qint64 start;
+        qint64 duration;
+        QString arg;
+    };
+
+    int threadId();
+    bool write(const QString &filePath, const QVector<Span> &spans, const QStringList &threadNames) const;
+
+    QAtomicInt mEnabled;
+    QElapsedTimer mClock;
+    QString mFilePath;
+
+    QMutex mMutex;
+    QVector<Span> mSpans;
+    QHash<Qt::HANDLE, int> mThreadIds;
+    QStringList mThreadNames;
+};
+
+/**
+ * Measures the lifetime of a scope and reports it to the DkTraceLog.
+ * Usage: DkTraceScope ts("loadGeneral", DkTraceLog::cat_decode, filePath);
+ **/
+class DllCoreExport DkTraceScope
+{
+public:
+    DkTraceScope(const char *name, DkTraceLog::Category cat, const QString &arg = QString());
+    ~DkTraceScope();
+
+private:
+    const char *mName;
+    DkTraceLog::Category mCat;
+    QString mArg;
+    qint64 mStart = -1;
+
+    Q_DISABLE_COPY(DkTraceScope)
+};
+
+/**
+ * Collects frame intervals of an animation (e.g. slideshow transitions).
+ * A frame counts as dropped if it took longer than 1.5 refresh periods.
+ **/
+class DllCoreExport DkFrameStats
+{
+public:
+    DkFrameStats();
+
+    void start(double refreshRate = 60.0);
+    void addFrame();
+
+    int frames() const;
+    int droppedFrames() const;
+    double meanFrameMs() const;
+    double maxFrameMs() const;
+    double percentileFrameMs(double p) const;
+    double fps() const;
+
+    QString toString() const;
+
+private:
+    QElapsedTimer mTimer;
+    qint64 mLastFrame = -1;
+    double mPeriodMs = 1000.0 / 60.0;
+    QVector<double> mIntervalsMs;
 };
 
 }
@@ -29,12 +29,24 @@
 #include "DkMath.h"
 #include "DkNoMacs.h"
 #include "DkSettings.h"
+#include "DkThumbs.h"
 #include "DkViewPort.h"
 
 #if defined(Q_OS_LINUX) && !defined(Q_OS_OPENBSD)
 #include <sys/sysinfo.h>
 #endif
 
+#if !defined(Q_OS_WIN)
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_MAC
+#include <mach/mach.h>
+#endif
+
 #ifndef WITH_OPENCV
 #include <cassert>
 #endif
@@ -46,6 +58,7 @@
 #include <QCoreApplication>
 #include <QDate>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
 #include <QFuture>
 #include <QMainWindow>
@@ -55,6 +68,7 @@
 #include <QPixmap>
 #include <QRegExp>
 #include <QStandardPaths>
+#include <QStorageInfo>
 #include <QString>
 #include <QStringList>
 #include <QTranslator>
@@ -72,6 +86,8 @@
 #ifdef Q_OS_WIN
 #include "shlwapi.h"
 #pragma comment(lib, "shlwapi.lib")
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
 #endif
 
 #if !defined(QT_NO_DEBUG_OUTPUT)
@@ -162,6 +178,266 @@ double DkMemory::getFreeMemory()
     return mem;
 }
 
+/**
+ * Returns the peak resident set size of this process.
+ * @return double the peak memory in MB or -1 if it is not available
+ **/
+double DkMemory::getPeakMemory()
+{
+    double mem = -1;
+
+#ifdef Q_OS_WIN
+
+    PROCESS_MEMORY_COUNTERS pmc;
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        mem = (double)pmc.PeakWorkingSetSize;
+
+#else
+
+    struct rusage usage;
+
+    if (!getrusage(RUSAGE_SELF, &usage)) {
+#ifdef Q_OS_MAC
+        mem = (double)usage.ru_maxrss; // bytes on macOS
+#else
+        mem = (double)usage.ru_maxrss * 1024; // kilobytes elsewhere
+#endif
+    }
+
+#endif
+
+    // convert to MB
+    if (mem > 0)
+        mem /= (1024 * 1024);
+
+    return mem;
+}
+
+/**
+ * Returns the current resident set size of this process.
+ * @return double the memory in MB or -1 if it is not available
+ **/
+double DkMemory::getCurrentMemory()
+{
+    double mem = -1;
+
+#ifdef Q_OS_WIN
+
+    PROCESS_MEMORY_COUNTERS pmc;
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        mem = (double)pmc.WorkingSetSize;
+
+#elif defined Q_OS_LINUX
+
+    // statm: size resident shared ... (in pages)
+    QFile file("/proc/self/statm");
+
+    if (file.open(QIODevice::ReadOnly)) {
+        QList<QByteArray> vals = file.readAll().split(' ');
+
+        if (vals.size() > 1)
+            mem = vals[1].toDouble() * sysconf(_SC_PAGESIZE);
+    }
+
+#elif defined Q_OS_MAC
+
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS)
+        mem = (double)info.resident_size;
+
+#endif
+
+    // convert to MB
+    if (mem > 0)
+        mem /= (1024 * 1024);
+
+    return mem;
+}
+
+/**
+ * Returns the memory used by thumbnails (decoded and compressed).
+ * @return double the thumbnail memory in MB
+ **/
+double DkMemory::getThumbnailMemory()
+{
+    return DkThumbStore::instance().memory() + DkThumbStore::instance().compressedMemory();
+}
+
+QString DkMemory::thumbnailStats()
+{
+    const DkThumbStore &s = DkThumbStore::instance();
+
+    return QObject::tr("%1 thumbnails (%2 compressed): %3 MB decoded, %4 MB compressed")
+        .arg(s.numImages())
+        .arg(s.numCompressed())
+        .arg(s.memory(), 0, 'f', 1)
+        .arg(s.compressedMemory(), 0, 'f', 1);
+}
+
+// DkFileBuffer --------------------------------------------------------------------
+namespace
+{
+// reading small files is faster than mapping them
+const qint64 minMapSize = 256 * 1024;
+
+bool isMappable(const QString &filePath, qint64 size)
+{
+#ifdef Q_OS_WIN
+    // mapped files cannot be renamed, replaced or deleted on Windows - so we never map them
+    Q_UNUSED(filePath);
+    Q_UNUSED(size);
+    return false;
+#else
+    return size >= minMapSize && size < INT_MAX && !DkFileBuffer::isNetworkPath(filePath);
+#endif
+}
+}
+
+/**
+ * Returns the file content.
+ * The file is memory mapped if possible (see DkFileBuffer).
+ * @param filePath the file to be loaded
+ * @param mapped if false, the file is copied to memory - use this for buffers that are kept
+ * @return QSharedPointer<QByteArray> the file content (empty if the file could not be read)
+ **/
+QSharedPointer<QByteArray> DkFileBuffer::load(const QString &filePath, bool mapped)
+{
+    QSharedPointer<QFile> file(new QFile(filePath));
+
+    if (!file->open(QIODevice::ReadOnly))
+        return QSharedPointer<QByteArray>(new QByteArray());
+
+    qint64 size = file->size();
+    uchar *data = mapped && isMappable(filePath, size) ? file->map(0, size) : 0;
+
+    if (!data)
+        return QSharedPointer<QByteArray>(new QByteArray(file->readAll()));
+
+#ifndef Q_OS_WIN
+    // decoders mostly read front to back
+    madvise(data, size, MADV_SEQUENTIAL);
+#endif
+
+    // the file (and its mapping) lives as long as the buffer
+    return QSharedPointer<QByteArray>(new QByteArray(QByteArray::fromRawData(reinterpret_cast<const char *>(data), (int)size)), [file](QByteArray *ba) {
+        delete ba;
+        file->close();
+    });
+}
+
+/**
+ * Asks the OS to read the file in the background.
+ * Files that are mapped for decoding do not need to be buffered: once prefetched,
+ * mapping them is cheap and nothing is copied or kept mapped in the meantime.
+ * @param filePath the file to be read ahead
+ * @return bool true if the file is mapped by load(), false if it should be buffered instead
+ **/
+bool DkFileBuffer::prefetch(const QString &filePath)
+{
+    QFile file(filePath);
+
+    if (!file.open(QIODevice::ReadOnly) || !isMappable(filePath, file.size()))
+        return false;
+
+#ifndef Q_OS_WIN
+    // the page cache keeps the pages after unmapping
+    qint64 size = file.size();
+    uchar *data = file.map(0, size);
+
+    if (!data)
+        return false;
+
+    madvise(data, size, MADV_WILLNEED);
+    file.unmap(data);
+#endif
+
+    return true;
+}
+
+/**
+ * Returns true if filePath is on a network drive.
+ * Network files are not mapped: the mapping might become
+ * invalid if the connection is lost.
+ **/
+bool DkFileBuffer::isNetworkPath(const QString &filePath)
+{
+    if (filePath.startsWith("//") || filePath.startsWith("\\\\"))
+        return true;
+
+#ifdef Q_OS_WIN
+    QString root = QStorageInfo(filePath).rootPath();
+
+    return GetDriveTypeW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(root).utf16())) == DRIVE_REMOTE;
+#else
+    static const QSet<QByteArray> networkFs = {"nfs", "nfs4", "cifs", "smbfs", "smb3", "9p", "afs", "ncpfs", "fuse.sshfs", "fuse.gvfsd-fuse"};
+
+    return networkFs.contains(QStorageInfo(filePath).fileSystemType());
+#endif
+}
+
+// DkFileFilter --------------------------------------------------------------------
+DkFileFilter::DkFileFilter(const QStringList &nameFilters)
+{
+    mNameFilters = nameFilters;
+
+    for (const QString &nf : nameFilters) {
+        QString f = nf.trimmed();
+
+        if (f.isEmpty())
+            continue;
+
+        // *.jpg -> fast path
+        if (f.startsWith("*.")) {
+            QString suffix = f.mid(2);
+            if (!suffix.contains(QRegularExpression("[\\*\\?\\[\\]]"))) {
+                mSuffixes.insert(suffix.toLower());
+                continue;
+            }
+        }
+
+        QRegularExpression re(QRegularExpression::wildcardToRegularExpression(f), QRegularExpression::CaseInsensitiveOption);
+        re.optimize();
+        mPatterns << re;
+    }
+}
+
+/**
+ * Returns true if fileName matches one of the name filters.
+ * @param fileName the file name (without path)
+ * @return bool true if the file name is accepted
+ **/
+bool DkFileFilter::matches(const QString &fileName) const
+{
+    if (!mSuffixes.isEmpty()) {
+        // *.tar.gz style filters need every dot to be checked
+        for (int idx = fileName.lastIndexOf('.'); idx > 0; idx = fileName.lastIndexOf('.', idx - 1)) {
+            if (mSuffixes.contains(fileName.mid(idx + 1).toLower()))
+                return true;
+        }
+    }
+
+    for (const QRegularExpression &re : mPatterns) {
+        if (re.match(fileName).hasMatch())
+            return true;
+    }
+
+    return false;
+}
+
+bool DkFileFilter::isEmpty() const
+{
+    return mSuffixes.isEmpty() && mPatterns.isEmpty();
+}
+
+QStringList DkFileFilter::nameFilters() const
+{
+    return mNameFilters;
+}
+
 // DkUtils --------------------------------------------------------------------
 #ifdef Q_OS_WIN
 
@@ -658,14 +934,18 @@ bool DkUtils::isSavable(const QString &fileName)
 
 bool DkUtils::hasValidSuffix(const QString &fileName)
 {
-    for (int idx = 0; idx < DkSettingsManager::param().app().fileFilters.size(); idx++) {
-        QRegExp exp = QRegExp(DkSettingsManager::param().app().fileFilters.at(idx), Qt::CaseInsensitive);
-        exp.setPatternSyntax(QRegExp::Wildcard);
-        if (exp.exactMatch(fileName))
-            return true;
+    // compiling the filters is expensive - so we do it only if they change
+    thread_local QStringList cachedFilters;
+    thread_local DkFileFilter filter;
+
+    const QStringList &fileFilters = DkSettingsManager::param().app().fileFilters;
+
+    if (cachedFilters != fileFilters) {
+        cachedFilters = fileFilters;
+        filter = DkFileFilter(fileFilters);
     }
 
-    return false;
+    return filter.matches(fileName);
 }
 
 QStringList DkUtils::suffixOnly(const QStringList &fileFilters)
@@ -869,6 +1149,26 @@ bool DkUtils::moveToTrash(const QString &filePath)
     return file.moveToTrash();
 }
 
+/**
+ * Atomically replaces dstPath with srcPath.
+ * Readers either see the old or the new file, never a partially written one.
+ * Both files must be on the same volume.
+ * @param srcPath the (temporary) file that replaces dstPath
+ * @param dstPath the target file (it's fine if it does not exist)
+ * @return bool true if dstPath was replaced
+ **/
+bool DkUtils::replaceFile(const QString &srcPath, const QString &dstPath)
+{
+#ifdef Q_OS_WIN
+    return MoveFileExW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(srcPath).utf16()),
+                       reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(dstPath).utf16()),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)
+        != 0;
+#else
+    return ::rename(QFile::encodeName(srcPath).constData(), QFile::encodeName(dstPath).constData()) == 0;
+#endif
+}
+
 QString DkUtils::readableByte(float bytes)
 {
     if (bytes >= 1024 * 1024 * 1024) {
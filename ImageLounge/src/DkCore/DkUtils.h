@@ -33,6 +33,10 @@
 #pragma warning(push, 0) // no warnings from includes - begin
 #include <QDebug>
 #include <QFileInfo>
+#include <QRegularExpression>
+#include <QSet>
+#include <QSharedPointer>
+#include <QStringList>
 #include <QVector>
 
 #include <QSharedMemory>
@@ -197,6 +201,7 @@ public:
     static QString readableByte(float bytes);
     static QStringList filterStringList(const QString &query, const QStringList &list);
     static bool moveToTrash(const QString &filePath);
+    static bool replaceFile(const QString &srcPath, const QString &dstPath);
     static QList<QUrl> findUrlsInTextNewline(QString text);
 
 #ifdef WITH_OPENCV
@@ -449,6 +454,50 @@ class DllCoreExport DkMemory
 public:
     static double getTotalMemory();
     static double getFreeMemory();
+    static double getPeakMemory();
+    static double getCurrentMemory();
+    static double getThumbnailMemory();
+    static QString thumbnailStats();
+};
+
+/**
+ * Zero copy file buffers.
+ * Files on local drives are memory mapped and wrapped into a QByteArray
+ * which stays valid as long as the returned shared pointer lives.
+ * Hence, do not keep copies of the QByteArray itself (they do not own the mapping).
+ * Writing to the buffer detaches it (i.e. the mapped file is never modified).
+ * Small files, files on network drives and all files on Windows (mapped files cannot be deleted there) are read as usual.
+ * Mapped buffers are meant for one-shot reads (e.g. decoding): if another program truncates the file
+ * while it is mapped, reading the buffer raises SIGBUS. Buffers that are kept (e.g. cached) are not mapped.
+ * Instead of keeping a buffer, prefetch() lets the OS read the file ahead so that mapping it for decoding is cheap.
+ **/
+class DllCoreExport DkFileBuffer
+{
+public:
+    static QSharedPointer<QByteArray> load(const QString &filePath, bool mapped = true);
+    static bool prefetch(const QString &filePath);
+    static bool isNetworkPath(const QString &filePath);
+};
+
+/**
+ * Compiled file name filter.
+ * Name filters (e.g. *.jpg) are parsed once: plain suffix filters end up
+ * in a hash set and only 'real' wildcards (e.g. *.jp*) are kept as regular expressions.
+ * Matching is case insensitive.
+ **/
+class DllCoreExport DkFileFilter
+{
+public:
+    DkFileFilter(const QStringList &nameFilters = QStringList());
+
+    bool matches(const QString &fileName) const;
+    bool isEmpty() const;
+    QStringList nameFilters() const;
+
+protected:
+    QStringList mNameFilters;
+    QSet<QString> mSuffixes; // lower case, without dot
+    QVector<QRegularExpression> mPatterns;
 };
 
 class DllCoreExport DkFileNameConverter
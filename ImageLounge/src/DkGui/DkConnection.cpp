@@ -31,10 +31,13 @@
 #pragma warning(push, 0) // no warnings from includes - begin
 #include <QBuffer>
 #include <QByteArray>
+#include <QDataStream>
 #include <QDebug>
-#include <QHostInfo>
+#include <QGuiApplication>
+#include <QScreen>
 #include <QThread>
 #include <QTimer>
+#include <QtEndian>
 #pragma warning(pop) // no warnings from includes - end
 
 namespace nmc
@@ -43,18 +46,19 @@ namespace nmc
 // DkConnection --------------------------------------------------------------------
 
 DkConnection::DkConnection(QObject *parent)
-    : QTcpSocket(parent)
+    : QLocalSocket(parent)
 {
-    mNumBytesForCurrentDataType = -1;
     mIsGreetingMessageSent = false;
     mIsSynchronizeMessageSent = false;
     connectionCreated = false;
     mSynchronizedTimer = new QTimer(this);
 
+    mTransformTimer = new QTimer(this);
+    mTransformTimer->setSingleShot(true);
+
     connect(mSynchronizedTimer, SIGNAL(timeout()), this, SLOT(synchronizedTimerTimeout()));
+    connect(mTransformTimer, SIGNAL(timeout()), this, SLOT(sendPendingTransform()));
     connect(this, SIGNAL(readyRead()), this, SLOT(processReadyRead()));
-
-    setReadBufferSize(MaxBufferSize);
 }
 
 void DkConnection::setTitle(const QString &newTitle)
@@ -62,6 +66,67 @@ void DkConnection::setTitle(const QString &newTitle)
     mCurrentTitle = newTitle;
 }
 
+/**
+ * Writes a message (header + payload).
+ * Pending transforms are flushed first so that the message order is kept.
+ * @param type the message type
+ * @param payload the message data
+ * @return bool true if the message was written entirely
+ **/
+bool DkConnection::sendMessage(DataType type, const QByteArray &payload)
+{
+    if (type != newTransform && !mPendingTransform.isEmpty())
+        sendPendingTransform();
+
+    QByteArray data(SyncHeaderSize, 0);
+    uchar *h = reinterpret_cast<uchar *>(data.data());
+    qToBigEndian<quint32>(SyncProtocolMagic, h);
+    h[4] = SyncProtocolVersion;
+    h[5] = (uchar)type;
+    qToBigEndian<quint32>((quint32)payload.size(), h + 6);
+    data.append(payload);
+
+    return write(data) == data.size();
+}
+
+/**
+ * Extracts the next complete message from the input buffer.
+ * The payload is stored in mBuffer and its type in mCurrentDataType.
+ * @return bool false if no complete message is available
+ **/
+bool DkConnection::readMessage()
+{
+    if (mInBuffer.size() < SyncHeaderSize)
+        return false;
+
+    const uchar *h = reinterpret_cast<const uchar *>(mInBuffer.constData());
+    quint32 size = qFromBigEndian<quint32>(h + 6);
+
+    if (qFromBigEndian<quint32>(h) != SyncProtocolMagic || h[4] != SyncProtocolVersion || size > (quint32)MaxBufferSize) {
+        qWarning() << "[DkConnection] incompatible sync message received - closing connection";
+        mInBuffer.clear();
+        abort();
+        return false;
+    }
+
+    if (mInBuffer.size() < SyncHeaderSize + (int)size)
+        return false;
+
+    mCurrentDataType = h[5] < Undefined ? (DataType)h[5] : Undefined;
+    mBuffer = mInBuffer.mid(SyncHeaderSize, size);
+    mInBuffer.remove(0, SyncHeaderSize + size);
+
+    return true;
+}
+
+int DkConnection::frameInterval() const
+{
+    QScreen *s = QGuiApplication::primaryScreen();
+    qreal rate = s ? s->refreshRate() : 60.0;
+
+    return qMax(1, qRound(1000.0 / qMax(rate, 1.0)));
+}
+
 void DkConnection::sendStartSynchronizeMessage()
 {
     // qDebug() << "sending Synchronize Message to " << this->peerName() << ":" << this->peerPort();
@@ -75,11 +140,8 @@ void DkConnection::sendStartSynchronizeMessage()
         qDebug() << "mSynchronizedPeersServerPorts: " << mSynchronizedPeersServerPorts[i];
         ds << mSynchronizedPeersServerPorts[i];
     }
-    // QByteArray data = "SYNCHRONIZE" + SeparatorToken + QByteArray::number(synchronize.size()) + SeparatorToken + synchronize;
-    QByteArray data = "STARTSYNCHRONIZE";
-    data.append(SeparatorToken).append(QByteArray::number(ba.size())).append(SeparatorToken).append(ba);
-    qDebug() << "sending startsynchronize:" << data;
-    if (write(data) == data.size())
+
+    if (sendMessage(startSynchronize, ba))
         mIsSynchronizeMessageSent = true;
 }
 
@@ -87,11 +149,7 @@ void DkConnection::sendStopSynchronizeMessage()
 {
     if (mState == Synchronized) { // only send message if connection is synchronized
         // qDebug() << "sending disable synchronize Message to " << this->peerName() << ":" << this->peerPort();
-        QByteArray synchronize = "disable synchronizing";
-        // QByteArray data = "DISABLESYNCHRONIZE" + SeparatorToken + QByteArray::number(synchronize.size()) + SeparatorToken + synchronize;
-        QByteArray data = "STOPSYNCHRONIZE";
-        data.append(SeparatorToken).append(QByteArray::number(synchronize.size())).append(SeparatorToken).append(synchronize);
-        if (write(data) == data.size())
+        if (sendMessage(stopSynchronize, QByteArray()))
             mIsSynchronizeMessageSent = false;
         mState = ReadyForUse;
     }
@@ -102,11 +160,7 @@ void DkConnection::sendNewTitleMessage(const QString &newtitle)
     mCurrentTitle = newtitle;
     // qDebug() << "sending new Title (\"" << newtitle << "\") Message to " << this->peerName() << ":" << this->peerPort();
 
-    QByteArray newTitleBA = newtitle.toUtf8();
-    // QByteArray data = "NEWTITLE" + SeparatorToken + QByteArray::number(newTitleBA.size()) + SeparatorToken + newTitleBA;
-    QByteArray data = "NEWTITLE";
-    data.append(SeparatorToken).append(QByteArray::number(newTitleBA.size())).append(SeparatorToken).append(newTitleBA);
-    write(data);
+    sendMessage(newTitle, newtitle.toUtf8());
 }
 
 void DkConnection::sendNewPositionMessage(QRect position, bool opacity, bool overlaid)
@@ -118,10 +172,7 @@ void DkConnection::sendNewPositionMessage(QRect position, bool opacity, bool ove
     ds << opacity;
     ds << overlaid;
 
-    // QByteArray data = "NEWTITLE" + SeparatorToken + QByteArray::number(ba.size()) + SeparatorToken + ba;
-    QByteArray data = "NEWPOSITION";
-    data.append(SeparatorToken).append(QByteArray::number(ba.size())).append(SeparatorToken).append(ba);
-    write(data);
+    sendMessage(newPosition, ba);
 }
 
 void DkConnection::sendNewTransformMessage(QTransform transform, QTransform imgTransform, QPointF canvasSize)
@@ -133,10 +184,32 @@ void DkConnection::sendNewTransformMessage(QTransform transform, QTransform imgT
     ds << imgTransform;
     ds << canvasSize;
 
-    // QByteArray data = "NEWTRANSFORM" + SeparatorToken + QByteArray::number(ba.size()) + SeparatorToken + ba;
-    QByteArray data = "NEWTRANSFORM";
-    data.append(SeparatorToken).append(QByteArray::number(ba.size())).append(SeparatorToken).append(ba);
-    write(data);
+    // the latest transform wins - we send at most one per frame
+    mPendingTransform = ba;
+
+    if (mTransformTimer->isActive())
+        return;
+
+    qint64 fi = frameInterval();
+
+    if (!mLastTransformSent.isValid() || mLastTransformSent.elapsed() >= fi)
+        sendPendingTransform();
+    else
+        mTransformTimer->start(int(fi - mLastTransformSent.elapsed()));
+}
+
+void DkConnection::sendPendingTransform()
+{
+    mTransformTimer->stop();
+
+    if (mPendingTransform.isEmpty())
+        return;
+
+    QByteArray ba = mPendingTransform;
+    mPendingTransform.clear();
+
+    sendMessage(newTransform, ba);
+    mLastTransformSent.start();
 }
 
 void DkConnection::sendNewFileMessage(qint16 op, const QString &filename)
@@ -146,19 +219,15 @@ void DkConnection::sendNewFileMessage(qint16 op, const QString &filename)
     QDataStream ds(&ba, QIODevice::ReadWrite);
     ds << op;
     ds << filename;
-    QByteArray data = "NEWFILE";
-    data.append(SeparatorToken).append(QByteArray::number(ba.size())).append(SeparatorToken).append(ba);
-    write(data);
+
+    sendMessage(newFile, ba);
 }
 
 void DkConnection::sendNewGoodbyeMessage()
 {
     // qDebug() << "sending good bye to " << peerName() << ":" << this->peerPort();
 
-    QByteArray ba = "GoodBye"; // scherz?
-    QByteArray data = "GOODBYE";
-    data.append(SeparatorToken).append(QByteArray::number(ba.size())).append(SeparatorToken).append(ba);
-    write(data);
+    sendMessage(GoodBye, QByteArray());
     waitForBytesWritten();
 }
 
@@ -167,113 +236,54 @@ void DkConnection::synchronizedPeersListChanged(QList<quint16> newList)
     mSynchronizedPeersServerPorts = newList;
 }
 
-bool DkConnection::readProtocolHeader()
-{
-    QByteArray greetingBA = QByteArray("GREETING").append(SeparatorToken);
-    QByteArray synchronizeBA = QByteArray("STARTSYNCHRONIZE").append(SeparatorToken);
-    QByteArray disableSynchronizeBA = QByteArray("STOPSYNCHRONIZE").append(SeparatorToken);
-    QByteArray newtitleBA = QByteArray("NEWTITLE").append(SeparatorToken);
-    QByteArray newtransformBA = QByteArray("NEWTRANSFORM").append(SeparatorToken);
-    QByteArray newpositionBA = QByteArray("NEWPOSITION").append(SeparatorToken);
-    QByteArray newFileBA = QByteArray("NEWFILE").append(SeparatorToken);
-    QByteArray goodbyeBA = QByteArray("GOODBYE").append(SeparatorToken);
-
-    if (mBuffer == greetingBA) {
-        // qDebug() << "Greeting received from:" << this->peerAddress() << ":" << this->peerPort();
-        mCurrentDataType = Greeting;
-    } else if (mBuffer == synchronizeBA) {
-        // qDebug() << "Synchronize received from:" << this->peerAddress() << ":" << this->peerPort();
-        mCurrentDataType = startSynchronize;
-    } else if (mBuffer == disableSynchronizeBA) {
-        // qDebug() << "StopSynchronize received from:" << this->peerAddress() << ":" << this->peerPort();
-        mCurrentDataType = stopSynchronize;
-    } else if (mBuffer == newtitleBA) {
-        // qDebug() << "New Title received from:" << this->peerAddress() << ":" << this->peerPort();
-        mCurrentDataType = newTitle;
-    } else if (mBuffer == newtransformBA) {
-        // qDebug() << "New Transform received from:" << this->peerAddress() << ":" << this->peerPort();
-        mCurrentDataType = newTransform;
-    } else if (mBuffer == newpositionBA) {
-        // qDebug() << "New Position received from:" << this->peerAddress() << ":" << this->peerPort();
-        mCurrentDataType = newPosition;
-    } else if (mBuffer == newFileBA) {
-        // qDebug() << "New File received from:" << this->peerAddress() << ":" << this->peerPort();
-        mCurrentDataType = newFile;
-    } else if (mBuffer == goodbyeBA) {
-        // qDebug() << "Goodbye received from:" << this->peerAddress() << ":" << this->peerPort();
-        mCurrentDataType = GoodBye;
-    } else {
-        qDebug() << QString(mBuffer);
-        qDebug() << "Undefined received from:" << this->peerAddress() << ":" << this->peerPort();
-        mCurrentDataType = Undefined;
-        // abort();
-        // return false;
-        return true;
-    }
-
-    mBuffer.clear();
-    mNumBytesForCurrentDataType = dataLengthForCurrentDataType();
-    return true;
-}
-
-int DkConnection::readDataIntoBuffer(int maxSize)
+void DkConnection::processReadyRead()
 {
-    if (maxSize > MaxBufferSize)
-        return 0;
+    mInBuffer.append(readAll());
 
-    int numBytesBeforeRead = mBuffer.size();
-    if (numBytesBeforeRead == MaxBufferSize) {
-        qDebug() << "DkConnection::readDataIntoBuffer: Connection aborted";
+    if (mInBuffer.size() > MaxBufferSize + SyncHeaderSize) {
+        qDebug() << "DkConnection::processReadyRead: Connection aborted";
+        mInBuffer.clear();
         abort();
-        return 0;
+        return;
     }
 
-    while (bytesAvailable() > 0 && mBuffer.size() < maxSize) {
-        mBuffer.append(read(1));
-        if (mBuffer.endsWith(SeparatorToken)) {
-            break;
-        }
-    }
-    return mBuffer.size() - numBytesBeforeRead;
-}
+    // only the latest transform of this batch is processed
+    QByteArray latestTransform;
 
-bool DkConnection::hasEnoughData()
-{
-    if (mNumBytesForCurrentDataType <= 0) {
-        mNumBytesForCurrentDataType = dataLengthForCurrentDataType();
-    }
+    auto flushTransform = [&]() {
+        if (latestTransform.isEmpty())
+            return;
 
-    // qDebug() << "numBytesForCurrentDataType:" << numBytesForCurrentDataType;
-    // qDebug() << "bytesAvailable:" << bytesAvailable();
-    // qDebug() << "buffer size:" << buffer.size();
+        DataType type = mCurrentDataType;
+        QByteArray payload = mBuffer;
 
-    if (bytesAvailable() < mNumBytesForCurrentDataType || mNumBytesForCurrentDataType <= 0) {
-        return false;
-    }
+        mCurrentDataType = newTransform;
+        mBuffer = latestTransform;
+        processData();
+        latestTransform.clear();
 
-    return true;
-}
+        mCurrentDataType = type;
+        mBuffer = payload;
+    };
 
-int DkConnection::dataLengthForCurrentDataType()
-{
-    if (bytesAvailable() <= 0 || readDataIntoBuffer() <= 0 || !mBuffer.endsWith(SeparatorToken))
-        return 0;
+    while (readMessage()) {
+        if (mCurrentDataType == newTransform && mState == Synchronized) {
+            latestTransform = mBuffer;
+            continue;
+        }
 
-    mBuffer.chop(1);
-    int number = mBuffer.toInt();
-    mBuffer.clear();
-    return number;
-}
+        flushTransform();
 
-void DkConnection::processReadyRead()
-{
-    if (readDataIntoBuffer() <= 0)
-        return;
-    if (!readProtocolHeader())
-        return;
-    checkState();
+        if (mState == WaitingForGreeting || mCurrentDataType == startSynchronize || mCurrentDataType == stopSynchronize || mCurrentDataType == GoodBye)
+            checkState();
+        else
+            processData();
+
+        if (state() != QLocalSocket::ConnectedState)
+            return;
+    }
 
-    readWhileBytesAvailable();
+    flushTransform();
 }
 
 void DkConnection::checkState()
@@ -284,15 +294,6 @@ void DkConnection::checkState()
             return;
         }
 
-        if (!hasEnoughData())
-            return;
-
-        mBuffer = read(mNumBytesForCurrentDataType);
-        if (mBuffer.size() != mNumBytesForCurrentDataType) {
-            abort();
-            return;
-        }
-
         if (!isValid()) {
             abort();
             return;
@@ -302,26 +303,15 @@ void DkConnection::checkState()
             sendGreetingMessage(mCurrentTitle);
 
         mState = ReadyForUse;
-        mPortOfPeer = peerPort(); // save peer port ... otherwise connections where this instance is server can not be removed from peerList
 
         readGreetingMessage();
 
         mBuffer.clear();
-        mNumBytesForCurrentDataType = 0;
         mCurrentDataType = Undefined;
         return;
     }
 
     if (mState == ReadyForUse && mCurrentDataType == startSynchronize) {
-        if (!hasEnoughData())
-            return;
-
-        mBuffer = read(mNumBytesForCurrentDataType);
-        if (mBuffer.size() != mNumBytesForCurrentDataType) {
-            abort();
-            return;
-        }
-
         QDataStream ds(mBuffer);
         QList<quint16> synchronizedPeersOfOtherInstance;
         quint16 numberOfSynchronizedPeers;
@@ -335,7 +325,6 @@ void DkConnection::checkState()
             // qDebug() << peerId;
         }
         mCurrentDataType = Undefined;
-        mNumBytesForCurrentDataType = 0;
         mBuffer.clear();
 
         if (!isValid()) {
@@ -355,15 +344,10 @@ void DkConnection::checkState()
     if (mState == Synchronized && mCurrentDataType == stopSynchronize) {
         mState = ReadyForUse;
         this->mIsSynchronizeMessageSent = false;
+        mPendingTransform.clear();
         emit connectionStopSynchronize(this);
-        mBuffer = read(mNumBytesForCurrentDataType);
-        if (mBuffer.size() != mNumBytesForCurrentDataType) {
-            abort();
-            return;
-        }
 
         mCurrentDataType = Undefined;
-        mNumBytesForCurrentDataType = 0;
         mBuffer.clear();
 
         return;
@@ -373,45 +357,13 @@ void DkConnection::checkState()
         // qDebug() << "received GoodBye from " << peerAddress() << ":" << peerPort();
         emit connectionGoodBye(this);
         mCurrentDataType = Undefined;
-        mNumBytesForCurrentDataType = 0;
         mBuffer.clear();
         abort();
         return;
     }
-}
 
-void DkConnection::readWhileBytesAvailable()
-{
-    do {
-        if (mCurrentDataType == Undefined) {
-            if (readDataIntoBuffer() <= 0)
-                return;
-            if (!readProtocolHeader())
-                return;
-            checkState();
-        }
-        if (!hasEnoughData()) {
-            return;
-        }
-
-        mBuffer = read(mNumBytesForCurrentDataType);
-        if (mBuffer.size() != mNumBytesForCurrentDataType) {
-            abort();
-            return;
-        }
-        processData();
-
-    } while (bytesAvailable() > 0);
-}
-
-bool DkConnection::readDataTypeIntoBuffer()
-{
-    mBuffer = read(mNumBytesForCurrentDataType);
-    if (mBuffer.size() != mNumBytesForCurrentDataType) {
-        abort();
-        return false;
-    }
-    return true;
+    mCurrentDataType = Undefined;
+    mBuffer.clear();
 }
 
 void DkConnection::processData()
@@ -463,7 +415,6 @@ void DkConnection::processData()
     }
 
     mCurrentDataType = Undefined;
-    mNumBytesForCurrentDataType = 0;
     mBuffer.clear();
 }
 
@@ -479,45 +430,15 @@ DkLocalConnection::DkLocalConnection(QObject *parent /* =0 */)
 {
 }
 
-void DkLocalConnection::processReadyRead()
-{
-    if (mCurrentLocalDataType == Quit) { // long message (copied from lan connection) -> does this work here correctly?
-        readWhileBytesAvailable();
-        return;
-    }
-
-    // if (readDataIntoBuffer() <= 0)
-    //	return;
-    // if (!readProtocolHeader())
-    //	return;
-
-    DkConnection::processReadyRead();
-}
-
 void DkLocalConnection::processData()
 {
-    if (mCurrentLocalDataType == Quit) {
+    if (mCurrentDataType == Quit) {
         emit connectionQuitReceived();
     }
 
     DkConnection::processData();
 }
 
-bool DkLocalConnection::readProtocolHeader()
-{
-    QByteArray quitBA = QByteArray("QUIT").append(SeparatorToken);
-
-    if (mBuffer == quitBA) {
-        mCurrentLocalDataType = Quit;
-    } else {
-        return DkConnection::readProtocolHeader();
-    }
-
-    mBuffer.clear();
-    mNumBytesForCurrentDataType = dataLengthForCurrentDataType();
-    return true;
-}
-
 void DkLocalConnection::sendGreetingMessage(const QString &currentTitle)
 {
     mCurrentTitle = currentTitle;
@@ -530,15 +451,7 @@ void DkLocalConnection::sendGreetingMessage(const QString &currentTitle)
     // qDebug() << "local tcp: " << mLocalTcpServerPort;
     // qDebug() << "peer id: " << mPeerId;
 
-    QByteArray data = "GREETING";
-    data.append(SeparatorToken);
-    data.append(QByteArray::number(ba.size()));
-    data.append(SeparatorToken);
-    data.append(ba);
-
-    // qDebug() << "greeting message: " << data;
-
-    if (write(data) == data.size()) {
+    if (sendMessage(Greeting, ba)) {
         mIsGreetingMessageSent = true;
     }
 }
@@ -550,6 +463,9 @@ void DkLocalConnection::readGreetingMessage()
     ds >> this->mPeerServerPort;
     ds >> title;
 
+    // local sockets have no port - the peer is identified by its server id
+    mPortOfPeer = mPeerServerPort;
+
     // qDebug() << "emitting readyForUse";
     emit connectionReadyForUse(mPeerServerPort, title, this);
 }
@@ -560,13 +476,7 @@ void DkLocalConnection::sendQuitMessage()
     QDataStream ds(&ba, QIODevice::ReadWrite);
     ds << "updating";
 
-    QByteArray data = "QUIT";
-    data.append(SeparatorToken);
-    data.append(QByteArray::number(ba.size()));
-    data.append(SeparatorToken);
-    data.append(ba);
-
-    if (write(data) == data.size()) {
+    if (sendMessage(Quit, ba)) {
         mIsGreetingMessageSent = true;
     }
 }
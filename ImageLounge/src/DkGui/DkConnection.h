@@ -28,10 +28,10 @@
 #pragma once
 
 #pragma warning(push, 0) // no warnings from includes - begin
-#include <QHostAddress>
+#include <QElapsedTimer>
 #include <QImage>
+#include <QLocalSocket>
 #include <QRect>
-#include <QTcpSocket>
 #include <QTransform>
 #pragma warning(pop) // no warnings from includes - end
 
@@ -58,9 +58,19 @@ namespace nmc
 {
 
 static const int MaxBufferSize = 102400000;
-static const char SeparatorToken = '<';
 
-class DllCoreExport DkConnection : public QTcpSocket
+// binary framing: magic (4) | version (1) | type (1) | payload size (4) - big endian
+static const quint32 SyncProtocolMagic = 0x4e4d4353; // NMCS
+static const quint8 SyncProtocolVersion = 2;
+static const int SyncHeaderSize = 10;
+
+/**
+ * Connection to another nomacs instance on the same host.
+ * Messages are binary frames (see SyncProtocolMagic) sent through a local socket.
+ * Transform messages are coalesced: at most one is sent per display frame and
+ * only the latest transform is sent (or processed if several are received at once).
+ **/
+class DllCoreExport DkConnection : public QLocalSocket
 {
     Q_OBJECT
 
@@ -115,17 +125,13 @@ public slots:
 
 protected:
     enum ConnectionState { WaitingForGreeting, ReadyForUse, Synchronized };
-    enum DataType { Greeting, startSynchronize, stopSynchronize, newTitle, newPosition, newTransform, newFile, GoodBye, Undefined };
+    enum DataType { Greeting = 0, startSynchronize, stopSynchronize, newTitle, newPosition, newTransform, newFile, GoodBye, Quit, Undefined };
 
-    virtual bool readProtocolHeader();
+    bool sendMessage(DataType type, const QByteArray &payload);
+    bool readMessage();
     virtual void checkState();
-    int readDataIntoBuffer(int maxSize = MaxBufferSize);
-    bool readDataTypeIntoBuffer();
     virtual void processData();
-    virtual void readWhileBytesAvailable();
     virtual void readGreetingMessage() = 0;
-    bool hasEnoughData();
-    int dataLengthForCurrentDataType();
     virtual bool allowedToSynchronize()
     {
         return true;
@@ -133,9 +139,9 @@ protected:
 
     ConnectionState mState = WaitingForGreeting;
     DataType mCurrentDataType = Undefined;
-    QByteArray mBuffer;
+    QByteArray mBuffer; // payload of the current message
+    QByteArray mInBuffer; // raw data received
     QString mCurrentTitle;
-    int mNumBytesForCurrentDataType = 0;
     quint16 mPortOfPeer = 0;
     quint16 mPeerServerPort = 0;
     bool mIsGreetingMessageSent = false;
@@ -146,9 +152,15 @@ protected slots:
 
 private slots:
     void synchronizedTimerTimeout();
+    void sendPendingTransform();
 
 protected:
+    int frameInterval() const;
+
     QTimer *mSynchronizedTimer;
+    QTimer *mTransformTimer;
+    QElapsedTimer mLastTransformSent;
+    QByteArray mPendingTransform;
     QList<quint16> mSynchronizedPeersServerPorts;
     quint16 mPeerId;
 };
@@ -174,19 +186,13 @@ signals:
     void connectionQuitReceived();
 
 protected slots:
-    void processReadyRead();
     void processData();
     void sendQuitMessage();
 
-protected:
-    enum LocalDataType { Quit, Undefined };
-
 private:
-    bool readProtocolHeader();
     void readGreetingMessage();
 
     quint16 mLocalTcpServerPort;
-    LocalDataType mCurrentLocalDataType = Undefined;
 };
 
 }
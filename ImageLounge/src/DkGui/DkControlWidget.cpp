@@ -324,7 +324,7 @@ void DkControlWidget::update()
 
 void DkControlWidget::showWidgetsSettings()
 {
-    if (mViewport->getImage().isNull()) {
+    if (mViewport->getImageSize().isEmpty()) {
         showPreview(false);
         showScroller(false);
         showMetaData(false);
@@ -380,7 +380,7 @@ void DkControlWidget::showPreview(bool visible)
     if (visible && !mFilePreview->isVisible())
         mFilePreview->show();
     else if (!visible && mFilePreview->isVisible())
-        mFilePreview->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the viewport
+        mFilePreview->hide(!mViewport->getImageSize().isEmpty()); // do not save settings if we have no image in the viewport
 }
 
 void DkControlWidget::showScroller(bool visible)
@@ -391,7 +391,7 @@ void DkControlWidget::showScroller(bool visible)
     if (visible && !mFolderScroll->isVisible())
         mFolderScroll->show();
     else if (!visible && mFolderScroll->isVisible())
-        mFolderScroll->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the viewport
+        mFolderScroll->hide(!mViewport->getImageSize().isEmpty()); // do not save settings if we have no image in the viewport
 }
 
 void DkControlWidget::showMetaData(bool visible)
@@ -403,7 +403,7 @@ void DkControlWidget::showMetaData(bool visible)
         mMetaDataInfo->show();
         qDebug() << "showing metadata...";
     } else if (!visible && mMetaDataInfo->isVisible())
-        mMetaDataInfo->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the viewport
+        mMetaDataInfo->hide(!mViewport->getImageSize().isEmpty()); // do not save settings if we have no image in the viewport
 }
 
 void DkControlWidget::showFileInfo(bool visible)
@@ -415,7 +415,7 @@ void DkControlWidget::showFileInfo(bool visible)
         mFileInfoLabel->show();
         mRatingLabel->block(mFileInfoLabel->isVisible());
     } else if (!visible && mFileInfoLabel->isVisible()) {
-        mFileInfoLabel->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the viewport
+        mFileInfoLabel->hide(!mViewport->getImageSize().isEmpty()); // do not save settings if we have no image in the viewport
         mRatingLabel->block(false);
     }
 }
@@ -428,7 +428,7 @@ void DkControlWidget::showPlayer(bool visible)
     if (visible)
         mPlayer->show();
     else
-        mPlayer->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the viewport
+        mPlayer->hide(!mViewport->getImageSize().isEmpty()); // do not save settings if we have no image in the viewport
 }
 
 void DkControlWidget::startSlideshow(bool start)
@@ -444,10 +444,23 @@ void DkControlWidget::showOverview(bool visible)
     if (visible && !mZoomWidget->isVisible()) {
         mZoomWidget->show();
     } else if (!visible && mZoomWidget->isVisible()) {
-        mZoomWidget->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the mViewport
+        mZoomWidget->hide(!mViewport->getImageSize().isEmpty()); // do not save settings if we have no image in the mViewport
     }
 }
 
+/**
+ * Returns the image the histogram is computed from.
+ * The histogram does not depend on the orientation, so the pixels are not rotated for it.
+ * @return QImage the current image
+ **/
+QImage DkControlWidget::histogramImage() const
+{
+    QSharedPointer<DkImageContainerT> imgC = mViewport->imageContainer();
+    QImage img = imgC ? imgC->rawPixmap(0) : QImage();
+
+    return img.isNull() ? mViewport->getImage() : img;
+}
+
 void DkControlWidget::showHistogram(bool visible)
 {
     if (!mHistogram)
@@ -455,12 +468,12 @@ void DkControlWidget::showHistogram(bool visible)
 
     if (visible && !mHistogram->isVisible()) {
         mHistogram->show();
-        if (!mViewport->getImage().isNull())
-            mHistogram->drawHistogram(mViewport->getImage());
+        if (!mViewport->getImageSize().isEmpty())
+            mHistogram->drawHistogram(histogramImage());
         else
             mHistogram->clearHistogram();
     } else if (!visible && mHistogram->isVisible()) {
-        mHistogram->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the mViewport
+        mHistogram->hide(!mViewport->getImageSize().isEmpty()); // do not save settings if we have no image in the mViewport
     }
 }
 
@@ -472,7 +485,7 @@ void DkControlWidget::showCommentWidget(bool visible)
     if (visible && !mCommentWidget->isVisible()) {
         mCommentWidget->show();
     } else if (!visible && mCommentWidget->isVisible()) {
-        mCommentWidget->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the mViewport
+        mCommentWidget->hide(!mViewport->getImageSize().isEmpty()); // do not save settings if we have no image in the mViewport
     }
 }
 
@@ -619,11 +632,12 @@ void DkControlWidget::updateImage(QSharedPointer<DkImageContainerT> imgC)
 
     QSharedPointer<DkMetaDataT> metaData = imgC->getMetaData();
 
-    QString dateString = metaData->getExifValue("DateTimeOriginal");
-    mFileInfoLabel->updateInfo(imgC->filePath(), "", dateString, metaData->getRating());
+    // the fast Exif reader is used while the metadata is not loaded yet
+    int rating = imgC->rating();
+    mFileInfoLabel->updateInfo(imgC->filePath(), "", imgC->dateTaken(), rating);
     mFileInfoLabel->setEdited(imgC->isEdited());
     mCommentWidget->setMetaData(metaData); // reset
-    updateRating(metaData->getRating());
+    updateRating(rating);
 
     connect(imgC.get(), SIGNAL(imageUpdatedSignal()), this, SIGNAL(imageUpdatedSignal()));
 }
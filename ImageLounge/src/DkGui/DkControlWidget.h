@@ -162,6 +162,7 @@ protected:
     // functions
     void init();
     void connectWidgets();
+    QImage histogramImage() const;
 
     // layout (switching of HUD contexts)
     QVector<QWidget *> mWidgets;
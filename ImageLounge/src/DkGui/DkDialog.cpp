@@ -31,7 +31,9 @@
 #include "DkBaseViewPort.h"
 #include "DkBasicWidgets.h"
 #include "DkCentralWidget.h"
+#include "DkImageLoader.h"
 #include "DkImageStorage.h"
+#include "DkMetaData.h"
 #include "DkPluginManager.h"
 #include "DkSettings.h"
 #include "DkThumbs.h"
@@ -86,6 +88,7 @@
 #include <QStringListModel>
 #include <QTableView>
 #include <QTextEdit>
+#include <QThreadPool>
 #include <QTimer>
 #include <QToolBar>
 #include <QToolButton>
@@ -2595,14 +2598,39 @@ int DkExportTiffDialog::exportImages(const QString &saveFilePath, int from, int
 {
     mProcessing = true;
 
+    DkTimer dt;
     QFileInfo saveInfo(saveFilePath);
 
-    // Do your job
-    for (int idx = from; idx <= to; idx++) {
-        QFileInfo cInfo(saveInfo.absolutePath(), saveInfo.baseName() + QString::number(idx) + "." + saveInfo.suffix());
-        qDebug() << "trying to save: " << cInfo.absoluteFilePath();
+    // pages are decoded sequentially from one handle and encoded in parallel
+    DkTiffPageReader reader;
+    if (!reader.open(mFilePath)) {
+        emit infoMessage(tr("Sorry, I could not open: %1").arg(mFilePath));
+        mProcessing = false;
+        return QDialog::Rejected;
+    }
+
+    QSharedPointer<DkMetaDataT> metaData = mLoader.getMetaData();
+
+    // bound the number of decoded pages in memory
+    int maxPending = qMax(QThreadPool::globalInstance()->maxThreadCount() * 2, 2);
+    QList<QPair<int, QFuture<QString>>> pending;
+    int numExported = 0;
+    int lastPreview = -1;
+
+    auto finishPage = [&]() {
+        QPair<int, QFuture<QString>> p = pending.takeFirst();
+        QString msg = p.second.result();
 
-        emit updateProgress(idx - 1);
+        if (!msg.isEmpty())
+            emit infoMessage(msg);
+        else
+            numExported++;
+
+        emit updateProgress(p.first);
+    };
+
+    for (int idx = from; idx <= to && mProcessing; idx++) {
+        QFileInfo cInfo(saveInfo.absolutePath(), saveInfo.baseName() + QString::number(idx) + "." + saveInfo.suffix());
 
         // user wants to overwrite files
         if (cInfo.exists() && overwrite) {
@@ -2613,30 +2641,61 @@ int DkExportTiffDialog::exportImages(const QString &saveFilePath, int from, int
             continue;
         }
 
-        if (!mLoader.loadPageAt(idx)) { // load next
+        QImage img = reader.readPage(idx);
+
+        if (img.isNull()) {
             emit infoMessage(tr("Sorry, I could not load page: %1").arg(idx));
             continue;
         }
 
-        QString lSaveFilePath = mLoader.save(cInfo.absoluteFilePath(), mLoader.image(), 90); // TODO: ask user for compression?
-        QFileInfo lSaveInfo = QFileInfo(lSaveFilePath);
-
-        if (!lSaveInfo.exists() || !lSaveInfo.isFile())
-            emit infoMessage(tr("Sorry, I could not save: %1").arg(cInfo.fileName()));
+        // don't flood the GUI with previews
+        if (lastPreview < 0 || dt.elapsed() - lastPreview > 200) {
+            emit updateImage(img);
+            lastPreview = dt.elapsed();
+        }
 
-        emit updateImage(mLoader.image());
-        emit updateProgress(idx);
+        pending.append(qMakePair(idx, QtConcurrent::run(&DkExportTiffDialog::exportPage, img, cInfo.absoluteFilePath(), metaData)));
 
-        // user canceled?
-        if (!mProcessing)
-            return QDialog::Rejected;
+        while (pending.size() >= maxPending)
+            finishPage();
     }
 
+    while (!pending.isEmpty())
+        finishPage();
+
+    qInfo() << numExported << "pages exported in" << dt << "-" << qRound(numExported * 1000.0 / qMax(dt.elapsed(), 1)) << "pages/s";
+
+    // user canceled?
+    if (!mProcessing)
+        return QDialog::Rejected;
+
+    emit infoMessage(tr("%1 pages exported in %2 (%3 pages/s)").arg(numExported).arg(dt.getTotal()).arg(numExported * 1000.0 / qMax(dt.elapsed(), 1), 0, 'f', 1));
     mProcessing = false;
 
     return QDialog::Accepted;
 }
 
+/**
+ * Encodes and writes a single page.
+ * This is called from the thread pool, hence every page gets its own loader and metadata.
+ * @return QString an error message or an empty string if the page was saved
+ **/
+QString DkExportTiffDialog::exportPage(const QImage &img, const QString &filePath, QSharedPointer<DkMetaDataT> metaData)
+{
+    DkBasicLoader loader;
+
+    if (metaData)
+        loader.setMetaData(metaData->copy());
+
+    QString savePath = loader.save(filePath, img, 90); // TODO: ask user for compression?
+    QFileInfo saveInfo(savePath);
+
+    if (savePath.isEmpty() || !saveInfo.isFile())
+        return tr("Sorry, I could not save: %1").arg(QFileInfo(filePath).fileName());
+
+    return QString();
+}
+
 void DkExportTiffDialog::setFile(const QString &filePath)
 {
     if (!QFileInfo(filePath).exists())
@@ -4105,6 +4164,9 @@ void DkDialogManager::openPrintDialog() const
         return;
     }
 
+    if (mCentralWidget->getCurrentImageLoader() && !mCentralWidget->getCurrentImageLoader()->confirmReducedResolution())
+        return;
+
     DkPrintPreviewDialog *previewDialog = new DkPrintPreviewDialog(DkUtils::getMainWindow());
     previewDialog->setImage(imgC->image());
 
@@ -650,6 +650,7 @@ protected:
     void createLayout();
     void enableTIFFSave(bool enable);
     void enableAll(bool enable);
+    static QString exportPage(const QImage &img, const QString &filePath, QSharedPointer<DkMetaDataT> metaData);
 
     void dropEvent(QDropEvent *event) override;
     void dragEnterEvent(QDragEnterEvent *event) override;
@@ -343,6 +343,10 @@ DkUnsharpMaskWidget::DkUnsharpMaskWidget(QSharedPointer<DkBaseManipulatorExt> ma
     QMetaObject::connectSlotsByName(this);
 
     manipulator->setWidget(this);
+
+    // changing the amount does not blur the image again
+    mBlurCache = QSharedPointer<DkBlurCache>(new DkBlurCache());
+    this->manipulator()->setBlurCache(mBlurCache);
 }
 
 void DkUnsharpMaskWidget::createLayout()
@@ -377,6 +381,14 @@ QSharedPointer<DkUnsharpMaskManipulator> DkUnsharpMaskWidget::manipulator() cons
     return qSharedPointerDynamicCast<DkUnsharpMaskManipulator>(baseManipulator());
 }
 
+void DkUnsharpMaskWidget::hideEvent(QHideEvent *event)
+{
+    // do not keep a full sized image if sharpening is done
+    mBlurCache->clear();
+
+    DkBaseManipulatorWidget::hideEvent(event);
+}
+
 // DkRotateWidget --------------------------------------------------------------------
 DkRotateWidget::DkRotateWidget(QSharedPointer<DkBaseManipulatorExt> manipulator, QWidget *parent)
     : DkBaseManipulatorWidget(manipulator, parent)
@@ -113,8 +113,13 @@ public slots:
     void on_sigmaSlider_valueChanged(int val);
     void on_amountSlider_valueChanged(int val);
 
+protected:
+    void hideEvent(QHideEvent *event) override;
+
 private:
     void createLayout();
+
+    QSharedPointer<DkBlurCache> mBlurCache;
 };
 
 class DkRotateWidget : public DkBaseManipulatorWidget
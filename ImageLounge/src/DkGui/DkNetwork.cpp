@@ -41,6 +41,7 @@
 #include <QDir>
 #include <QHostInfo>
 #include <QList>
+#include <QLockFile>
 #include <QMessageBox>
 #include <QMimeData>
 #include <QMutex>
@@ -50,8 +51,8 @@
 #include <QNetworkInterface>
 #include <QNetworkProxyFactory>
 #include <QProcess>
+#include <QStandardPaths>
 #include <QStringBuilder>
-#include <QTcpSocket>
 #include <QThread>
 #include <QTimer>
 #include <QUrl>
@@ -90,7 +91,7 @@ void DkClientManager::connectionReadyForUse(quint16 peerServerPort, const QStrin
     // qDebug() << "connection ready for use" << connection->peerPort() << " with title:" << title << " peerServerPort:" << peerServerPort;
 
     mNewPeerId++;
-    DkPeer *peer = new DkPeer(connection->peerPort(), mNewPeerId, connection->peerAddress(), peerServerPort, title, connection, false, "", false, this);
+    DkPeer *peer = new DkPeer(connection->getPeerPort(), mNewPeerId, QHostAddress::LocalHost, peerServerPort, title, connection, false, "", false, this);
     connection->setPeerId(mNewPeerId);
     mPeerList.addPeer(peer);
 
@@ -220,10 +221,10 @@ void DkClientManager::sendNewFile(qint16 op, const QString &filename)
     }
 }
 
-void DkClientManager::newConnection(int socketDescriptor)
+void DkClientManager::newConnection(quintptr socketDescriptor)
 {
     DkConnection *connection = createConnection();
-    connection->setSocketDescriptor(socketDescriptor);
+    connection->setSocketDescriptor((qintptr)socketDescriptor);
     connection->setTitle(mCurrentTitle);
     mStartUpConnections.append(connection);
     // qDebug() << "new Connection " << connection->peerPort();
@@ -320,7 +321,7 @@ quint16 DkLocalClientManager::getServerPort() const
     if (!mServer)
         return 0;
 
-    return mServer->serverPort();
+    return mServer->id();
 }
 
 QMimeData *DkLocalClientManager::mimeData() const
@@ -337,8 +338,8 @@ QMimeData *DkLocalClientManager::mimeData() const
 
 void DkLocalClientManager::startServer()
 {
-    mServer = new DkLocalTcpServer(this);
-    connect(mServer, SIGNAL(serverReiceivedNewConnection(int)), this, SLOT(newConnection(int)));
+    mServer = new DkLocalSyncServer(this);
+    connect(mServer, &DkLocalSyncServer::serverReceivedNewConnection, this, &DkLocalClientManager::newConnection);
 
     // TODO: hook on thread
     searchForOtherClients();
@@ -369,12 +370,14 @@ void DkLocalClientManager::searchForOtherClients()
 {
     assert(mServer);
 
-    for (int i = local_tcp_port_start; i <= local_tcp_port_end; i++) {
-        if (i == mServer->serverPort())
+    // only connect to instances that are registered
+    for (quint16 id : DkLocalSyncServer::registeredIds()) {
+        if (id == mServer->id())
             continue;
 
         DkConnection *connection = createConnection();
-        connection->connectToHost(QHostAddress::LocalHost, (qint16)i);
+        connection->setProperty("syncId", id);
+        connection->connectToServer(DkLocalSyncServer::serverName(id));
     }
 }
 
@@ -392,7 +395,7 @@ void DkLocalClientManager::connectionSynchronized(QList<quint16> synchronizedPee
     emit clientConnectedSignal(!aps.isEmpty());
 
     for (int i = 0; i < synchronizedPeersOfOtherClient.size(); i++) {
-        if (synchronizedPeersOfOtherClient[i] != mServer->serverPort()) {
+        if (synchronizedPeersOfOtherClient[i] != mServer->id()) {
             DkPeer *peer = mPeerList.getPeerByServerport(synchronizedPeersOfOtherClient[i]);
             if (!peer)
                 continue;
@@ -527,39 +530,187 @@ void DkLocalClientManager::connectionReceivedQuit()
     emit receivedQuit();
 }
 
+void DkLocalClientManager::connectionError(QLocalSocket::LocalSocketError socketError)
+{
+    DkConnection *c = qobject_cast<DkConnection *>(QObject::sender());
+
+    if (!c)
+        return;
+
+    // the instance is gone (e.g. it crashed) - remove it from the registry
+    if (socketError == QLocalSocket::ServerNotFoundError || socketError == QLocalSocket::ConnectionRefusedError) {
+        bool ok = false;
+        quint16 id = (quint16)c->property("syncId").toUInt(&ok);
+
+        if (ok)
+            DkLocalSyncServer::unregisterId(id);
+
+        mStartUpConnections.removeAll(c);
+        c->deleteLater();
+    }
+}
+
 DkLocalConnection *DkLocalClientManager::createConnection()
 {
     // wow - there is no one owning connection (except for QOBJECT)
     DkLocalConnection *connection = new DkLocalConnection(this);
-    connection->setLocalTcpServerPort(mServer->serverPort());
+    connection->setLocalTcpServerPort(mServer->id());
     connection->setTitle(mCurrentTitle);
     connectConnection(connection);
     connect(this, SIGNAL(synchronizedPeersListChanged(QList<quint16>)), connection, SLOT(synchronizedPeersListChanged(QList<quint16>)));
     connect(this, SIGNAL(sendQuitMessage()), connection, SLOT(sendQuitMessage()));
     connect(connection, SIGNAL(connectionQuitReceived()), this, SLOT(connectionReceivedQuit()));
     connect(connection, SIGNAL(connected()), this, SLOT(connectToNomacs()));
+    connect(connection, &QLocalSocket::errorOccurred, this, &DkLocalClientManager::connectionError);
 
     return connection;
 }
 
-// DkLocalTcpServer --------------------------------------------------------------------
-DkLocalTcpServer::DkLocalTcpServer(QObject *parent)
-    : QTcpServer(parent)
+// DkLocalSyncServer --------------------------------------------------------------------
+DkLocalSyncServer::DkLocalSyncServer(QObject *parent)
+    : QLocalServer(parent)
 {
-    for (int i = local_tcp_port_start; i < local_tcp_port_end; i++) {
-        if (listen(QHostAddress::LocalHost, (quint16)i)) {
+    setSocketOptions(QLocalServer::UserAccessOption);
+
+    QLockFile lock(registryPath() + ".lock");
+
+    if (!lock.tryLock(1000)) {
+        qWarning() << "[DkLocalSyncServer] could not lock" << registryPath() << "- sync server is not started";
+        return;
+    }
+
+    QList<quint16> ids = readRegistry();
+
+    for (quint16 i = local_sync_id_start; i <= local_sync_id_end; i++) {
+        if (ids.contains(i))
+            continue;
+
+        // the instance might be running but not registered (yet)
+        QLocalSocket socket;
+        socket.connectToServer(serverName(i));
+
+        if (socket.waitForConnected(100)) {
+            socket.disconnectFromServer();
+            continue;
+        }
+
+        // remove stale sockets of crashed instances (unix only)
+        if (socket.error() == QLocalSocket::ConnectionRefusedError)
+            QLocalServer::removeServer(serverName(i));
+
+        if (listen(serverName(i))) {
+            mId = i;
+            ids << i;
+            writeRegistry(ids);
             break;
         }
     }
-    // qDebug() << "TCP Listening on port " << this->serverPort();
+
+    if (!mId)
+        qWarning() << "[DkLocalSyncServer] could not start sync server:" << errorString();
+    // qDebug() << "Listening on " << fullServerName();
+}
+
+DkLocalSyncServer::~DkLocalSyncServer()
+{
+    if (mId)
+        unregisterId(mId);
 }
 
-void DkLocalTcpServer::incomingConnection(qintptr socketDescriptor)
+quint16 DkLocalSyncServer::id() const
 {
-    emit serverReiceivedNewConnection((int)socketDescriptor);
+    return mId;
+}
+
+QString DkLocalSyncServer::serverName(quint16 id)
+{
+    QString user = qEnvironmentVariable("USERNAME", qEnvironmentVariable("USER"));
+
+    return QString("nomacs-sync-%1-%2").arg(user).arg(id);
+}
+
+/**
+ * Returns the ids of all running instances.
+ * Note: ids of crashed instances are removed when connecting to them fails.
+ * @return QList<quint16> the registered ids
+ **/
+QList<quint16> DkLocalSyncServer::registeredIds()
+{
+    QLockFile lock(registryPath() + ".lock");
+
+    if (!lock.tryLock(1000)) {
+        qWarning() << "[DkLocalSyncServer] could not lock" << registryPath();
+        return QList<quint16>();
+    }
+
+    return readRegistry();
+}
+
+void DkLocalSyncServer::unregisterId(quint16 id)
+{
+    QLockFile lock(registryPath() + ".lock");
+
+    // if we fail, the id is removed by the next instance that cannot connect to it
+    if (!lock.tryLock(1000)) {
+        qWarning() << "[DkLocalSyncServer] could not lock" << registryPath() << "- id" << id << "is not removed";
+        return;
+    }
+
+    QList<quint16> ids = readRegistry();
+    ids.removeAll(id);
+    writeRegistry(ids);
+}
+
+void DkLocalSyncServer::incomingConnection(quintptr socketDescriptor)
+{
+    emit serverReceivedNewConnection(socketDescriptor);
     // qDebug() << "Server: NEW CONNECTION AVAIABLE";
 }
 
+QString DkLocalSyncServer::registryPath()
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+
+    if (dir.isEmpty())
+        dir = QDir::tempPath();
+
+    QString user = qEnvironmentVariable("USERNAME", qEnvironmentVariable("USER"));
+
+    return QDir(dir).absoluteFilePath(QString("nomacs-sync-%1.ids").arg(user));
+}
+
+QList<quint16> DkLocalSyncServer::readRegistry()
+{
+    QList<quint16> ids;
+    QFile file(registryPath());
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return ids;
+
+    for (const QByteArray &l : file.readAll().split('\n')) {
+        bool ok = false;
+        quint16 id = (quint16)l.trimmed().toUInt(&ok);
+
+        if (ok && id >= local_sync_id_start && id <= local_sync_id_end && !ids.contains(id))
+            ids << id;
+    }
+
+    return ids;
+}
+
+void DkLocalSyncServer::writeRegistry(const QList<quint16> &ids)
+{
+    QFile file(registryPath());
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qWarning() << "[DkLocalSyncServer] cannot write" << registryPath();
+        return;
+    }
+
+    for (quint16 id : ids)
+        file.write(QByteArray::number(id) + '\n');
+}
+
 DkPeer::DkPeer(quint16 port,
                quint16 peerId,
                const QHostAddress &hostAddress,
@@ -27,13 +27,14 @@
 
 #pragma once
 
-#define local_tcp_port_start 45454
-#define local_tcp_port_end 45484
+#define local_sync_id_start 45454
+#define local_sync_id_end 45484
 
 #pragma warning(push, 0) // no warnings from includes - begin
+#include <QHostAddress>
+#include <QLocalServer>
 #include <QMutex>
 #include <QSharedPointer>
-#include <QTcpServer>
 #include <QThread>
 #pragma warning(pop) // no warnings from includes - end
 
@@ -45,7 +46,7 @@ namespace nmc
 {
 
 // nomacs defines
-class DkLocalTcpServer;
+class DkLocalSyncServer;
 class DkLANTcpServer;
 class DkLANUdpSocket;
 
@@ -172,7 +173,7 @@ public slots:
     void sendGoodByeToAll();
 
 protected slots:
-    void newConnection(int socketDescriptor);
+    void newConnection(quintptr socketDescriptor);
     virtual void connectionReadyForUse(quint16 peerId, const QString &title, DkConnection *connection);
     virtual void connectionSynchronized(QList<quint16> synchronizedPeersOfOtherClient, DkConnection *connection) = 0;
     virtual void connectionStopSynchronized(DkConnection *connection) = 0;
@@ -226,26 +227,47 @@ private slots:
     void connectionSynchronized(QList<quint16> synchronizedPeersOfOtherClient, DkConnection *connection);
     virtual void connectionStopSynchronized(DkConnection *connection);
     void connectionReceivedQuit();
+    void connectionError(QLocalSocket::LocalSocketError socketError);
 
 private:
     DkLocalConnection *createConnection();
     void searchForOtherClients();
 
-    DkLocalTcpServer *mServer;
+    DkLocalSyncServer *mServer;
 };
 
-class DkLocalTcpServer : public QTcpServer
+/**
+ * Local socket server of this instance.
+ * Each instance claims an id (local_sync_id_start - local_sync_id_end) and
+ * registers it in a per-user registry file, so other instances know whom to
+ * connect to instead of probing all ids.
+ **/
+class DkLocalSyncServer : public QLocalServer
 {
     Q_OBJECT
 
 public:
-    DkLocalTcpServer(QObject *parent = 0);
+    DkLocalSyncServer(QObject *parent = 0);
+    ~DkLocalSyncServer();
+
+    quint16 id() const;
+
+    static QString serverName(quint16 id);
+    static QList<quint16> registeredIds();
+    static void unregisterId(quint16 id);
 
 signals:
-    void serverReiceivedNewConnection(int DkDescriptor);
+    void serverReceivedNewConnection(quintptr descriptor);
 
 protected:
-    void incomingConnection(qintptr socketDescriptor) override;
+    void incomingConnection(quintptr socketDescriptor) override;
+
+private:
+    static QString registryPath();
+    static QList<quint16> readRegistry();
+    static void writeRegistry(const QList<quint16> &ids);
+
+    quint16 mId = 0;
 };
 
 class DllCoreExport DkSyncManager
@@ -287,6 +287,8 @@ void DkNoMacs::createActions()
     connect(am.action(DkActionManager::menu_sort_date_created), SIGNAL(triggered(bool)), this, SLOT(changeSorting(bool)));
     connect(am.action(DkActionManager::menu_sort_date_modified), SIGNAL(triggered(bool)), this, SLOT(changeSorting(bool)));
     connect(am.action(DkActionManager::menu_sort_random), SIGNAL(triggered(bool)), this, SLOT(changeSorting(bool)));
+    connect(am.action(DkActionManager::menu_sort_date_taken), SIGNAL(triggered(bool)), this, SLOT(changeSorting(bool)));
+    connect(am.action(DkActionManager::menu_sort_rating), SIGNAL(triggered(bool)), this, SLOT(changeSorting(bool)));
     connect(am.action(DkActionManager::menu_sort_ascending), SIGNAL(triggered(bool)), this, SLOT(changeSorting(bool)));
     connect(am.action(DkActionManager::menu_sort_descending), SIGNAL(triggered(bool)), this, SLOT(changeSorting(bool)));
 
@@ -1360,6 +1362,10 @@ void DkNoMacs::changeSorting(bool change)
             DkSettingsManager::param().global().sortMode = DkSettings::sort_date_modified;
         else if (senderName == "menu_sort_random")
             DkSettingsManager::param().global().sortMode = DkSettings::sort_random;
+        else if (senderName == "menu_sort_date_taken")
+            DkSettingsManager::param().global().sortMode = DkSettings::sort_date_taken;
+        else if (senderName == "menu_sort_rating")
+            DkSettingsManager::param().global().sortMode = DkSettings::sort_rating;
         else if (senderName == "menu_sort_ascending")
             DkSettingsManager::param().global().sortDir = DkSettings::sort_ascending;
         else if (senderName == "menu_sort_descending")
@@ -1681,7 +1687,7 @@ void DkNoMacs::setWindowTitle(QSharedPointer<DkImageContainerT> imgC)
         return;
     }
 
-    setWindowTitle(imgC->filePath(), imgC->image().size(), imgC->isEdited(), imgC->getTitleAttribute());
+    setWindowTitle(imgC->filePath(), imgC->pixmapSize(), imgC->isEdited(), imgC->getTitleAttribute());
 }
 
 void DkNoMacs::setWindowTitle(const QString &filePath, const QSize &size, bool edited, const QString &attr)
@@ -1714,7 +1720,7 @@ void DkNoMacs::setWindowTitle(const QString &filePath, const QSize &size, bool e
     if (!size.isEmpty())
         attributes.sprintf(" - %i x %i", size.width(), size.height());
     if (size.isEmpty() && vp && !vp->getImageSize().isEmpty())
-        attributes.sprintf(" - %i x %i", vp->getImage().width(), vp->getImage().height());
+        attributes.sprintf(" - %i x %i", vp->getImageSize().width(), vp->getImageSize().height());
     if (DkSettingsManager::param().app().privateMode)
         attributes.append(tr(" [Private Mode]"));
 
@@ -1042,6 +1042,42 @@ void DkFilePreference::createLayout()
     historyGroup->addWidget(historyBox);
     historyGroup->addWidget(hLabel);
 
+    // thumbnail memory
+    QSpinBox *thumbMemBox = new QSpinBox(this);
+    thumbMemBox->setObjectName("thumbMemBox");
+    thumbMemBox->setMinimum(16);
+    thumbMemBox->setMaximum(maxRam);
+    thumbMemBox->setSuffix(" MB");
+    thumbMemBox->setMaximumWidth(200);
+    thumbMemBox->setValue(qRound(DkSettingsManager::param().resources().thumbMemory));
+
+    QLabel *tmLabel = new QLabel(tr("Thumbnails exceeding this size are compressed until they are shown again. [%1-%2 MB]")
+                                     .arg(thumbMemBox->minimum())
+                                     .arg(thumbMemBox->maximum()),
+                                 this);
+
+    QSpinBox *thumbCompressedMemBox = new QSpinBox(this);
+    thumbCompressedMemBox->setObjectName("thumbCompressedMemBox");
+    thumbCompressedMemBox->setMinimum(16);
+    thumbCompressedMemBox->setMaximum(maxRam);
+    thumbCompressedMemBox->setSuffix(" MB");
+    thumbCompressedMemBox->setMaximumWidth(200);
+    thumbCompressedMemBox->setValue(qRound(DkSettingsManager::param().resources().thumbCompressedMemory));
+
+    QLabel *tcmLabel = new QLabel(tr("Compressed thumbnails exceeding this size are dropped and loaded again if needed. [%1-%2 MB]")
+                                      .arg(thumbCompressedMemBox->minimum())
+                                      .arg(thumbCompressedMemBox->maximum()),
+                                  this);
+
+    QLabel *thumbStatsLabel = new QLabel(DkMemory::thumbnailStats(), this);
+
+    DkGroupWidget *thumbMemGroup = new DkGroupWidget(tr("Thumbnail Memory"), this);
+    thumbMemGroup->addWidget(thumbMemBox);
+    thumbMemGroup->addWidget(tmLabel);
+    thumbMemGroup->addWidget(thumbCompressedMemBox);
+    thumbMemGroup->addWidget(tcmLabel);
+    thumbMemGroup->addWidget(thumbStatsLabel);
+
     // loading policy
     QVector<QRadioButton *> loadButtons;
     loadButtons.append(new QRadioButton(tr("Skip Images"), this));
@@ -1101,6 +1137,7 @@ void DkFilePreference::createLayout()
     l->addWidget(tempFolderGroup);
     l->addWidget(cacheGroup);
     l->addWidget(historyGroup);
+    l->addWidget(thumbMemGroup);
     l->addWidget(loadGroup);
     l->addWidget(saveGroup);
     l->addWidget(skipGroup);
@@ -1149,6 +1186,20 @@ void DkFilePreference::on_historyBox_valueChanged(int value) const
     }
 }
 
+void DkFilePreference::on_thumbMemBox_valueChanged(int value) const
+{
+    if (DkSettingsManager::param().resources().thumbMemory != value) {
+        DkSettingsManager::param().resources().thumbMemory = (float)value;
+    }
+}
+
+void DkFilePreference::on_thumbCompressedMemBox_valueChanged(int value) const
+{
+    if (DkSettingsManager::param().resources().thumbCompressedMemory != value) {
+        DkSettingsManager::param().resources().thumbCompressedMemory = (float)value;
+    }
+}
+
 void DkFilePreference::paintEvent(QPaintEvent *event)
 {
     // fixes stylesheets which are not applied to custom widgets
@@ -229,6 +229,8 @@ public slots:
     void on_skipBox_valueChanged(int value) const;
     void on_cacheBox_valueChanged(int value) const;
     void on_historyBox_valueChanged(int value) const;
+    void on_thumbMemBox_valueChanged(int value) const;
+    void on_thumbCompressedMemBox_valueChanged(int value) const;
     void on_saveGroup_buttonClicked(int buttonId) const;
 
 signals:
@@ -271,7 +271,20 @@ void DkFilePreview::drawThumbs(QPainter *painter)
 {
     // qDebug() << "drawing thumbs: " << worldMatrix.dx();
 
-    bufferDim = (orientation == Qt::Horizontal) ? QRectF(QPointF(0, yOffset / 2), QSize(xOffset, 0)) : QRectF(QPointF(yOffset / 2, 0), QSize(0, xOffset));
+    updateExtents();
+
+    int ts = DkSettingsManager::param().effectiveThumbSize(this);
+    int limit = orientation == Qt::Horizontal ? width() : height();
+    int translation = qRound(orientation == Qt::Horizontal ? worldMatrix.dx() : worldMatrix.dy());
+
+    // update file rect for move to current file timer
+    if (scrollToCurrentImage && currentFileIdx >= 0 && currentFileIdx < mThumbs.size()) {
+        QSize imgSize = previewSize(currentFileIdx, ts);
+        newFileRect = worldMatrix.mapRect(thumbRect(currentFileIdx, imgSize, xOffset + mExtents.prefix(currentFileIdx)));
+    }
+
+    // find the first visible thumbnail
+    mFirstThumbIdx = qMin(mExtents.upperBound(qMax(-translation - xOffset, 0)), mThumbs.size());
     thumbRects.clear();
 
     DkTimer dt;
@@ -279,74 +292,30 @@ void DkFilePreview::drawThumbs(QPainter *painter)
     // mouse over effect
     QPoint p = worldMatrix.inverted().map(mapFromGlobal(QCursor::pos()));
 
-    for (int idx = 0; idx < mThumbs.size(); idx++) {
-        QSharedPointer<DkThumbNailT> thumb = mThumbs.at(idx)->getThumb();
-        QImage img;
-
-        // if the image is loaded draw that (it might be edited)
-        if (mThumbs.at(idx)->hasImage()) {
-            img = mThumbs.at(idx)->imageScaledToHeight(DkSettingsManager::param().effectiveThumbSize(this));
-        } else {
-            if (thumb->hasImage() == DkThumbNail::exists_not) {
-                thumbRects.push_back(QRectF());
-                continue;
-            }
-
-            if (thumb->hasImage() == DkThumbNail::loaded)
-                img = thumb->getImage();
-        }
-
-        // if (img.width() > max_thumb_size * DkSettingsManager::param().dpiScaleFactor())
-        //	qDebug() << thumb->getFilePath() << "size:" << img.size();
+    QVector<QSharedPointer<DkThumbNailT>> requestedThumbs;
 
-        QPointF anchor = orientation == Qt::Horizontal ? bufferDim.topRight() : bufferDim.bottomLeft();
-        QRectF r = !img.isNull()
-            ? QRectF(anchor, img.size())
-            : QRectF(anchor, QSize(DkSettingsManager::param().effectiveThumbSize(this), DkSettingsManager::param().effectiveThumbSize(this)));
-        if (orientation == Qt::Horizontal && height() - yOffset < r.height() * 2)
-            r.setSize(QSizeF(qFloor(r.width() * (float)(height() - yOffset) / r.height()), height() - yOffset));
-        else if (orientation == Qt::Vertical && width() - yOffset < r.width() * 2)
-            r.setSize(QSizeF(width() - yOffset, qFloor(r.height() * (float)(width() - yOffset) / r.width())));
+    int start = xOffset + mExtents.prefix(mFirstThumbIdx);
 
-        // check if the size is still valid
-        if (r.width() < 1 || r.height() < 1)
-            continue; // this brings us in serious problems with the selection
-
-        // center vertically
-        if (orientation == Qt::Horizontal)
-            r.moveCenter(QPoint(qFloor(r.center().x()), height() / 2));
-        else
-            r.moveCenter(QPoint(width() / 2, qFloor(r.center().y())));
+    for (int idx = mFirstThumbIdx; idx < mThumbs.size() && start + translation <= limit; idx++) {
+        QSharedPointer<DkThumbNailT> thumb = mThumbs.at(idx)->getThumb();
+        QImage img = previewImage(idx, ts);
+        QRectF r = thumbRect(idx, img.size(), start);
 
-        // update the buffer dim
-        if (orientation == Qt::Horizontal)
-            bufferDim.setRight(qFloor(bufferDim.right() + r.width()) + qCeil(xOffset / 2.0f));
-        else
-            bufferDim.setBottom(qFloor(bufferDim.bottom() + r.height()) + qCeil(xOffset / 2.0f));
+        // the thumbnail might have been loaded in the meantime
+        mExtents.set(idx, extent(r));
+        start += mExtents.value(idx);
         thumbRects.push_back(r);
 
-        QRectF imgWorldRect = worldMatrix.mapRect(r);
-
-        // update file rect for move to current file timer
-        if (scrollToCurrentImage && idx == currentFileIdx)
-            newFileRect = imgWorldRect;
-
-        // is the current image within the canvas?
-        if ((orientation == Qt::Horizontal && imgWorldRect.right() < 0) || (orientation == Qt::Vertical && imgWorldRect.bottom() < 0)) {
+        if (r.isNull())
             continue;
-        }
 
-        if (((orientation == Qt::Horizontal && imgWorldRect.left() > width()) || (orientation == Qt::Vertical && imgWorldRect.top() > height()))
-            && scrollToCurrentImage) {
-            continue;
-        } else if ((orientation == Qt::Horizontal && imgWorldRect.left() > width()) || (orientation == Qt::Vertical && imgWorldRect.top() > height())) {
-            break;
-        }
+        QRectF imgWorldRect = worldMatrix.mapRect(r);
 
         // only fetch thumbs if we are not moving too fast...
-        if (thumb->hasImage() == DkThumbNail::not_loaded && fabs(currentDx) < 40) {
-            thumb->fetchThumb();
-            connect(thumb.data(), SIGNAL(thumbLoadedSignal()), this, SLOT(update()));
+        if ((thumb->hasImage() == DkThumbNail::not_loaded || thumb->isOutdated()) && fabs(currentDx) < 40) {
+            thumb->fetchThumb(DkThumbNail::do_not_force, QSharedPointer<QByteArray>(), DkThumbScheduler::priority_visible);
+            connect(thumb.data(), SIGNAL(thumbLoadedSignal()), this, SLOT(update()), Qt::UniqueConnection);
+            requestedThumbs << thumb;
         }
 
         bool isLeftGradient = (orientation == Qt::Horizontal && worldMatrix.dx() < 0 && imgWorldRect.left() < leftGradient.finalStop().x())
@@ -371,6 +340,146 @@ void DkFilePreview::drawThumbs(QPainter *painter)
 
         // painter->fillRect(QRect(0,0,200, 110), leftGradient);
     }
+
+    bufferDim = (orientation == Qt::Horizontal) ? QRectF(QPointF(0, yOffset / 2), QSize(xOffset, 0)) : QRectF(QPointF(yOffset / 2, 0), QSize(0, xOffset));
+    if (orientation == Qt::Horizontal)
+        bufferDim.setRight(xOffset + mExtents.total());
+    else
+        bufferDim.setBottom(xOffset + mExtents.total());
+
+    // cancel thumbs that scrolled away before they are loaded
+    for (QSharedPointer<DkThumbNailT> t : mRequestedThumbs) {
+        if (!requestedThumbs.contains(t))
+            t->cancelFetch();
+    }
+
+    mRequestedThumbs = requestedThumbs;
+}
+
+/**
+ * Returns the image that is drawn for thumbnail idx.
+ * @param idx the thumbnail index
+ * @param thumbSize the (effective) thumbnail size
+ * @return QImage the image - it is null if the thumbnail is not loaded yet
+ **/
+QImage DkFilePreview::previewImage(int idx, int thumbSize) const
+{
+    // if the image is loaded draw that (it might be edited)
+    if (mThumbs.at(idx)->hasImage())
+        return mThumbs.at(idx)->imageScaledToHeight(thumbSize);
+
+    QSharedPointer<DkThumbNailT> thumb = mThumbs.at(idx)->getThumb();
+
+    if (thumb->hasImage() == DkThumbNail::loaded)
+        return thumb->getImage();
+
+    return QImage();
+}
+
+/**
+ * Returns the size of previewImage() without loading or scaling the image.
+ * @param idx the thumbnail index
+ * @param thumbSize the (effective) thumbnail size
+ * @return QSize the image size - it is empty if the thumbnail is not loaded yet
+ **/
+QSize DkFilePreview::previewSize(int idx, int thumbSize) const
+{
+    if (mThumbs.at(idx)->hasImage()) {
+        QSize s = mThumbs.at(idx)->pixmapSize();
+
+        if (s.isEmpty())
+            return QSize();
+
+        return QSize(qMax(qRound(s.width() * thumbSize / (double)s.height()), 1), thumbSize);
+    }
+
+    QSharedPointer<DkThumbNailT> thumb = mThumbs.at(idx)->getThumb();
+
+    if (thumb->hasImage() == DkThumbNail::loaded)
+        return thumb->getImageSize();
+
+    return QSize();
+}
+
+/**
+ * Computes the rectangle of thumbnail idx.
+ * @param idx the thumbnail index
+ * @param imgSize the size of the preview image (see previewSize())
+ * @param start the position along the filmstrip
+ * @return QRectF the thumbnail's rectangle - or a null rectangle if it is not shown
+ **/
+QRectF DkFilePreview::thumbRect(int idx, const QSize &imgSize, int start) const
+{
+    if (imgSize.isEmpty() && mThumbs.at(idx)->getThumb()->hasImage() == DkThumbNail::exists_not)
+        return QRectF();
+
+    int ts = DkSettingsManager::param().effectiveThumbSize(this);
+
+    QPointF anchor = orientation == Qt::Horizontal ? QPointF(start, yOffset / 2) : QPointF(yOffset / 2, start);
+    QRectF r = !imgSize.isEmpty() ? QRectF(anchor, imgSize) : QRectF(anchor, QSize(ts, ts));
+    if (orientation == Qt::Horizontal && height() - yOffset < r.height() * 2)
+        r.setSize(QSizeF(qFloor(r.width() * (float)(height() - yOffset) / r.height()), height() - yOffset));
+    else if (orientation == Qt::Vertical && width() - yOffset < r.width() * 2)
+        r.setSize(QSizeF(width() - yOffset, qFloor(r.height() * (float)(width() - yOffset) / r.width())));
+
+    // check if the size is still valid
+    if (r.width() < 1 || r.height() < 1)
+        return QRectF();
+
+    // center vertically
+    if (orientation == Qt::Horizontal)
+        r.moveCenter(QPoint(qFloor(r.center().x()), height() / 2));
+    else
+        r.moveCenter(QPoint(width() / 2, qFloor(r.center().y())));
+
+    return r;
+}
+
+/**
+ * Returns the space a thumbnail occupies along the filmstrip.
+ **/
+int DkFilePreview::extent(const QRectF &thumbRect) const
+{
+    if (thumbRect.isNull())
+        return 0;
+
+    float length = orientation == Qt::Horizontal ? (float)thumbRect.width() : (float)thumbRect.height();
+    return qFloor(length) + qCeil(xOffset / 2.0f);
+}
+
+/**
+ * Rebuilds the thumbnail extents if the layout changed.
+ * Otherwise, they are updated incrementally while painting.
+ * Only the stored image sizes are used - no image is loaded or scaled.
+ **/
+void DkFilePreview::updateExtents()
+{
+    int ts = DkSettingsManager::param().effectiveThumbSize(this);
+    QVector<int> key = {(int)orientation, width(), height(), ts, xOffset, yOffset};
+
+    if (key == mExtentsKey && mExtents.size() == mThumbs.size())
+        return;
+
+    QVector<int> extents(mThumbs.size());
+
+    for (int idx = 0; idx < mThumbs.size(); idx++)
+        extents[idx] = extent(thumbRect(idx, previewSize(idx, ts), 0));
+
+    mExtents.assign(extents);
+    mExtentsKey = key;
+}
+
+/**
+ * Returns the thumbnail index at pos (widget coordinates) or -1.
+ **/
+int DkFilePreview::thumbIndexAt(const QPoint &pos) const
+{
+    for (int idx = 0; idx < thumbRects.size(); idx++) {
+        if (worldMatrix.mapRect(thumbRects.at(idx)).contains(pos))
+            return mFirstThumbIdx + idx;
+    }
+
+    return -1;
 }
 
 void DkFilePreview::drawNoImgEffect(QPainter *painter, const QRectF &r)
@@ -552,25 +661,21 @@ void DkFilePreview::mouseMoveEvent(QMouseEvent *event)
         selected = -1;
 
         // find out where the mouse is
-        for (int idx = 0; idx < thumbRects.size(); idx++) {
-            if (worldMatrix.mapRect(thumbRects.at(idx)).contains(event->pos())) {
-                selected = idx;
-
-                if (selected <= mThumbs.size() && selected >= 0) {
-                    QSharedPointer<DkThumbNailT> thumb = mThumbs.at(selected)->getThumb();
-                    // selectedImg = DkImage::colorizePixmap(QPixmap::fromImage(thumb->getImage()), DkSettingsManager::param().display().highlightColor, 0.3f);
-
-                    // important: setText shows the label - if you then hide it here again you'll get a stack overflow
-                    // if (fileLabel->height() < height())
-                    //	fileLabel->setText(thumbs.at(selected).getFile().fileName(), -1);
-                    QFileInfo fileInfo(thumb->getFilePath());
-                    QString toolTipInfo = tr("Name: ") + fileInfo.fileName() + "\n" + tr("Size: ") + DkUtils::readableByte((float)fileInfo.size()) + "\n"
-                        + tr("Created: ") + fileInfo.birthTime().toString(Qt::SystemLocaleDate);
-                    setToolTip(toolTipInfo);
-                    setStatusTip(fileInfo.fileName());
-                }
-                break;
-            }
+        int idx = thumbIndexAt(event->pos());
+
+        if (idx >= 0 && idx < mThumbs.size()) {
+            selected = idx;
+            QSharedPointer<DkThumbNailT> thumb = mThumbs.at(selected)->getThumb();
+            // selectedImg = DkImage::colorizePixmap(QPixmap::fromImage(thumb->getImage()), DkSettingsManager::param().display().highlightColor, 0.3f);
+
+            // important: setText shows the label - if you then hide it here again you'll get a stack overflow
+            // if (fileLabel->height() < height())
+            //	fileLabel->setText(thumbs.at(selected).getFile().fileName(), -1);
+            QFileInfo fileInfo(thumb->getFilePath());
+            QString toolTipInfo = tr("Name: ") + fileInfo.fileName() + "\n" + tr("Size: ") + DkUtils::readableByte((float)fileInfo.size()) + "\n"
+                + tr("Created: ") + fileInfo.birthTime().toString(Qt::SystemLocaleDate);
+            setToolTip(toolTipInfo);
+            setStatusTip(fileInfo.fileName());
         }
 
         if (selected != -1 || selected != oldSelection)
@@ -612,13 +717,13 @@ void DkFilePreview::mouseReleaseEvent(QMouseEvent *event)
 
     if (mouseTrace < 20) {
         // find out where the mouse did click
-        for (int idx = 0; idx < thumbRects.size(); idx++) {
-            if (idx < mThumbs.size() && worldMatrix.mapRect(thumbRects.at(idx)).contains(event->pos())) {
-                if (mThumbs.at(idx)->isFromZip())
-                    emit changeFileSignal(idx - currentFileIdx);
-                else
-                    emit loadFileSignal(mThumbs.at(idx)->filePath() /*, event->modifiers() == Qt::ControlModifier*/);
-            }
+        int idx = thumbIndexAt(event->pos());
+
+        if (idx >= 0 && idx < mThumbs.size()) {
+            if (mThumbs.at(idx)->isFromZip())
+                emit changeFileSignal(idx - currentFileIdx);
+            else
+                emit loadFileSignal(mThumbs.at(idx)->filePath() /*, event->modifiers() == Qt::ControlModifier*/);
         }
     } else
         unsetCursor();
@@ -808,8 +913,25 @@ void DkFilePreview::setFileInfo(QSharedPointer<DkImageContainerT> cImage)
 
 void DkFilePreview::updateThumbs(QVector<QSharedPointer<DkImageContainerT>> thumbs)
 {
+    // keep the extents of thumbnails that are still in the folder
+    QHash<const DkImageContainerT *, int> oldExtents;
+    if (mExtents.size() == mThumbs.size()) {
+        for (int idx = 0; idx < mThumbs.size(); idx++)
+            oldExtents.insert(mThumbs.at(idx).data(), mExtents.value(idx));
+    }
+
     mThumbs = thumbs;
 
+    int ts = DkSettingsManager::param().effectiveThumbSize(this);
+    QVector<int> extents(mThumbs.size());
+
+    for (int idx = 0; idx < mThumbs.size(); idx++) {
+        auto it = oldExtents.constFind(mThumbs.at(idx).data());
+        extents[idx] = it != oldExtents.constEnd() ? it.value() : extent(thumbRect(idx, previewSize(idx, ts), 0));
+    }
+
+    mExtents.assign(extents); // updateExtents() rebuilds them if the layout changed in the meantime
+
     for (int idx = 0; idx < thumbs.size(); idx++) {
         if (thumbs.at(idx)->isSelected()) {
             currentFileIdx = idx;
@@ -836,9 +958,16 @@ DkThumbLabel::DkThumbLabel(QSharedPointer<DkThumbNailT> thumb, QGraphicsItem *pa
     mFetchingThumb = false;
     mIsHovered = false;
 
-    setThumb(thumb);
-    setFlag(ItemIsSelectable, true);
+    // style dummy
+    mNoImagePen.setColor(QColor(150, 150, 150));
+    mNoImageBrush = QColor(100, 100, 100, 50);
+
+    QColor col = DkSettingsManager::param().display().highlightColor;
+    col.setAlpha(90);
+    mSelectBrush = col;
+    mSelectPen.setColor(DkSettingsManager::param().display().highlightColor);
 
+    setThumb(thumb);
     setAcceptHoverEvents(true);
 }
 
@@ -846,28 +975,62 @@ DkThumbLabel::~DkThumbLabel()
 {
 }
 
+/**
+ * Assigns a new thumbnail to the label.
+ * Labels are recycled by the DkThumbScene while scrolling,
+ * so all state of the previous thumbnail is reset.
+ * @param thumb the new thumbnail
+ **/
 void DkThumbLabel::setThumb(QSharedPointer<DkThumbNailT> thumb)
 {
-    this->mThumb = thumb;
+    if (mThumb == thumb)
+        return;
+
+    if (mThumb) {
+        cancelLoading();
+        disconnect(mThumb.data(), SIGNAL(thumbLoadedSignal()), this, SLOT(updateLabel()));
+    }
+
+    mThumb = thumb;
+    mThumbInitialized = false;
+    mFetchingThumb = false;
+    mIsHovered = false;
+
+    mIcon.setPixmap(QPixmap());
+    mIcon.setScale(1.0f);
+    mIcon.setPos(0, 0);
+    mText.setPlainText(QString());
+    setToolTip(QString());
 
     if (thumb.isNull())
         return;
 
     connect(thumb.data(), SIGNAL(thumbLoadedSignal()), this, SLOT(updateLabel()));
-    QFileInfo fileInfo(thumb->getFilePath());
-    QString toolTipInfo = tr("Name: ") + fileInfo.fileName() + "\n" + tr("Size: ") + DkUtils::readableByte((float)fileInfo.size()) + "\n" + tr("Created: ")
-        + fileInfo.birthTime().toString(Qt::SystemLocaleDate);
+    update();
+}
 
-    setToolTip(toolTipInfo);
+void DkThumbLabel::setIndex(int idx)
+{
+    mIdx = idx;
+}
 
-    // style dummy
-    mNoImagePen.setColor(QColor(150, 150, 150));
-    mNoImageBrush = QColor(100, 100, 100, 50);
+int DkThumbLabel::index() const
+{
+    return mIdx;
+}
 
-    QColor col = DkSettingsManager::param().display().highlightColor;
-    col.setAlpha(90);
-    mSelectBrush = col;
-    mSelectPen.setColor(DkSettingsManager::param().display().highlightColor);
+void DkThumbLabel::setThumbSelected(bool selected)
+{
+    if (mSelected == selected)
+        return;
+
+    mSelected = selected;
+    update();
+}
+
+bool DkThumbLabel::isThumbSelected() const
+{
+    return mSelected;
 }
 
 QPixmap DkThumbLabel::pixmap() const
@@ -877,9 +1040,20 @@ QPixmap DkThumbLabel::pixmap() const
 
 void DkThumbLabel::cancelLoading()
 {
+    if (mFetchingThumb && mThumb)
+        mThumb->cancelFetch();
+
     mFetchingThumb = false;
 }
 
+void DkThumbLabel::fetchThumb(int priority)
+{
+    if (mThumb && (mThumb->hasImage() == DkThumbNail::not_loaded || mThumb->isOutdated())) {
+        mThumb->fetchThumb(DkThumbNail::do_not_force, QSharedPointer<QByteArray>(), priority);
+        mFetchingThumb = true;
+    }
+}
+
 QRectF DkThumbLabel::boundingRect() const
 {
     int sz = DkSettingsManager::param().effectiveThumbPreviewSize();
@@ -913,10 +1087,7 @@ void DkThumbLabel::updateLabel()
     if (!pm.isNull()) {
         mIcon.setTransformationMode(Qt::SmoothTransformation);
         mIcon.setPixmap(pm);
-        mIcon.setFlag(ItemIsSelectable, true);
     }
-    if (pm.isNull())
-        setFlag(ItemIsSelectable, false); // if we cannot load it -> disable selection
 
     // update label
     mText.setPos(0, pm.height());
@@ -955,6 +1126,13 @@ void DkThumbLabel::updateSize()
     // update();
 }
 
+void DkThumbLabel::mousePressEvent(QGraphicsSceneMouseEvent *event)
+{
+    // the selection is handled by the DkThumbScene
+    // we need to accept the event though - otherwise we don't get double clicks
+    event->accept();
+}
+
 void DkThumbLabel::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event)
 {
     if (mThumb.isNull())
@@ -965,6 +1143,15 @@ void DkThumbLabel::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event)
 
 void DkThumbLabel::hoverEnterEvent(QGraphicsSceneHoverEvent *)
 {
+    // the tool tip needs file information - so we only do it if it's needed
+    if (toolTip().isEmpty() && mThumb) {
+        QFileInfo fileInfo(mThumb->getFilePath());
+        QString toolTipInfo = tr("Name: ") + fileInfo.fileName() + "\n" + tr("Size: ") + DkUtils::readableByte((float)fileInfo.size()) + "\n"
+            + tr("Created: ") + fileInfo.birthTime().toString(Qt::SystemLocaleDate);
+
+        setToolTip(toolTipInfo);
+    }
+
     mIsHovered = true;
     emit showFileSignal(mThumb->getFilePath());
     update();
@@ -985,9 +1172,9 @@ void DkThumbLabel::setVisible(bool visible)
 
 void DkThumbLabel::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
-    if (!mFetchingThumb && mThumb->hasImage() == DkThumbNail::not_loaded) {
-        mThumb->fetchThumb();
-        mFetchingThumb = true;
+    // (re-)requesting bumps the thumbnail in the scheduler's queue
+    if (mThumb->hasImage() == DkThumbNail::not_loaded || mThumb->isOutdated()) {
+        fetchThumb(DkThumbScheduler::priority_visible);
     } else if (!mThumbInitialized && (mThumb->hasImage() == DkThumbNail::loaded || mThumb->hasImage() == DkThumbNail::exists_not)) {
         updateLabel();
         mThumbInitialized = true;
@@ -1052,7 +1239,7 @@ void DkThumbLabel::paint(QPainter *painter, const QStyleOptionGraphicsItem *opti
     }
 
     // render selected
-    if (isSelected()) {
+    if (mSelected) {
         painter->setBrush(mSelectBrush);
         painter->setPen(mSelectPen);
         painter->drawRect(boundingRect());
@@ -1066,9 +1253,14 @@ DkThumbScene::DkThumbScene(QWidget *parent /* = 0 */)
     setObjectName("DkThumbWidget");
 }
 
+/**
+ * Computes the grid and updates the labels.
+ * Positions are computed from the thumbnail index,
+ * so this is independent of the number of files.
+ **/
 void DkThumbScene::updateLayout()
 {
-    if (mThumbLabels.empty())
+    if (mThumbs.empty())
         return;
 
     QSize pSize;
@@ -1079,45 +1271,149 @@ void DkThumbScene::updateLayout()
     int psz = DkSettingsManager::param().effectiveThumbPreviewSize();
     mXOffset = 2; // qCeil(psz*0.1f);
     mNumCols = qMax(qFloor(((float)pSize.width() - mXOffset) / (psz + mXOffset)), 1);
-    mNumCols = qMin(mThumbLabels.size(), mNumCols);
-    mNumRows = qCeil((float)mThumbLabels.size() / mNumCols);
+    mNumCols = qMin(mThumbs.size(), mNumCols);
+    mNumRows = qCeil((float)mThumbs.size() / mNumCols);
 
     int tso = psz + mXOffset;
     setSceneRect(0, 0, mNumCols * tso + mXOffset, mNumRows * tso + mXOffset);
 
-    DkTimer dt;
-    int cYOffset = mXOffset;
+    // positions have changed - so we re-assign all labels
+    updateVisibleLabels(true);
+
+    int selIdx = selectedThumbIndex();
+    if (selIdx != -1)
+        ensureVisible(selIdx);
+
+    mFirstLayout = false;
+}
 
-    for (int rIdx = 0; rIdx < mNumRows; rIdx++) {
-        int cXOffset = mXOffset;
+/**
+ * Materializes labels for the visible rows (plus one viewport above & below).
+ * Labels that scrolled out of this range are recycled.
+ * @param relayout if true, all labels are re-positioned
+ **/
+void DkThumbScene::updateVisibleLabels(bool relayout)
+{
+    if (mThumbs.empty() || mNumCols <= 0)
+        return;
 
-        for (int cIdx = 0; cIdx < mNumCols; cIdx++) {
-            int tIdx = rIdx * mNumCols + cIdx;
+    int firstIdx = 0;
+    int lastIdx = mThumbs.size() - 1;
 
-            if (tIdx < 0 || tIdx >= mThumbLabels.size())
-                break;
+    if (!views().empty()) {
+        QGraphicsView *v = views().first();
+        QRectF vr = v->mapToScene(v->viewport()->rect()).boundingRect();
 
-            DkThumbLabel *cLabel = mThumbLabels.at(tIdx);
-            cLabel->setPos(cXOffset, cYOffset);
-            cLabel->updateSize();
+        int tso = DkSettingsManager::param().effectiveThumbPreviewSize() + mXOffset;
+        int numVisRows = qCeil(vr.height() / tso) + 1;
+        int firstRow = qFloor((vr.top() - mXOffset) / tso) - numVisRows;
+        int lastRow = firstRow + 3 * numVisRows;
 
-            cXOffset += psz + mXOffset;
+        firstIdx = qMax(firstRow * mNumCols, 0);
+        lastIdx = qMin((lastRow + 1) * mNumCols - 1, mThumbs.size() - 1);
+    }
+
+    if (firstIdx > lastIdx)
+        return;
+
+    // recycle labels that are out of range
+    for (auto it = mLabels.begin(); it != mLabels.end();) {
+        if (it.key() < firstIdx || it.key() > lastIdx) {
+            disconnect(mThumbs.at(it.key()).data(), SIGNAL(thumbLoadedSignal()), this, SIGNAL(thumbLoadedSignal()));
+            it.value()->setIndex(-1);
+            mFreeLabels << it.value();
+            it = mLabels.erase(it);
+        } else {
+            if (relayout) {
+                it.value()->setPos(thumbRect(it.key()).topLeft());
+                it.value()->updateSize();
+            }
+            ++it;
         }
+    }
+
+    for (int idx = firstIdx; idx <= lastIdx; idx++) {
+        if (mLabels.contains(idx))
+            continue;
+
+        DkThumbLabel *label = takeLabel();
+        label->setThumb(mThumbs.at(idx)->getThumb());
+        label->setIndex(idx);
+        label->setThumbSelected(mSelected.testBit(idx));
+        label->setPos(thumbRect(idx).topLeft());
+        label->updateSize();
+        label->show();
+        connect(mThumbs.at(idx).data(), SIGNAL(thumbLoadedSignal()), this, SIGNAL(thumbLoadedSignal()), Qt::UniqueConnection);
 
-        // update ypos
-        cYOffset += psz + mXOffset; // 20 for label
+        mLabels.insert(idx, label);
     }
 
-    for (int idx = 0; idx < mThumbLabels.size(); idx++) {
-        if (mThumbLabels.at(idx)->isSelected())
-            mThumbLabels.at(idx)->ensureVisible();
+    // hide labels that were not re-used
+    for (DkThumbLabel *label : mFreeLabels) {
+        if (label->isVisible()) {
+            label->setThumb(QSharedPointer<DkThumbNailT>());
+            label->hide();
+        }
     }
+}
 
-    mFirstLayout = false;
+DkThumbLabel *DkThumbScene::takeLabel()
+{
+    if (!mFreeLabels.isEmpty())
+        return mFreeLabels.takeLast();
+
+    DkThumbLabel *label = new DkThumbLabel();
+    connect(label, SIGNAL(loadFileSignal(const QString &, bool)), this, SIGNAL(loadFileSignal(const QString &, bool)));
+    connect(label, SIGNAL(showFileSignal(const QString &)), this, SLOT(showFile(const QString &)));
+
+    addItem(label);
+    mThumbLabels << label;
+
+    return label;
+}
+
+/**
+ * Returns the scene rectangle of the thumbnail at index idx.
+ **/
+QRectF DkThumbScene::thumbRect(int idx) const
+{
+    if (mNumCols <= 0 || idx < 0)
+        return QRectF();
+
+    int psz = DkSettingsManager::param().effectiveThumbPreviewSize();
+    int tso = psz + mXOffset;
+
+    return QRectF(mXOffset + (idx % mNumCols) * tso, mXOffset + (idx / mNumCols) * tso, psz, psz);
+}
+
+/**
+ * Returns the index of the thumbnail at pos or -1.
+ **/
+int DkThumbScene::thumbIndexAt(const QPointF &pos) const
+{
+    if (mNumCols <= 0)
+        return -1;
+
+    int tso = DkSettingsManager::param().effectiveThumbPreviewSize() + mXOffset;
+    int col = qFloor((pos.x() - mXOffset) / tso);
+    int row = qFloor((pos.y() - mXOffset) / tso);
+
+    if (col < 0 || col >= mNumCols || row < 0)
+        return -1;
+
+    int idx = row * mNumCols + col;
+
+    if (idx >= mThumbs.size() || !thumbRect(idx).contains(pos))
+        return -1;
+
+    return idx;
 }
 
 void DkThumbScene::updateThumbs(QVector<QSharedPointer<DkImageContainerT>> thumbs)
 {
+    // drop the requests of the last folder - visible thumbnails are requested again
+    DkThumbScheduler::instance().cancelAll();
+
     this->mThumbs = thumbs;
     updateThumbLabels();
 }
@@ -1129,18 +1425,9 @@ void DkThumbScene::updateThumbLabels()
     blockSignals(false);
 
     mThumbLabels.clear();
-
-    for (int idx = 0; idx < mThumbs.size(); idx++) {
-        DkThumbLabel *thumb = new DkThumbLabel(mThumbs.at(idx)->getThumb());
-        connect(thumb, SIGNAL(loadFileSignal(const QString &, bool)), this, SIGNAL(loadFileSignal(const QString &, bool)));
-        connect(thumb, SIGNAL(showFileSignal(const QString &)), this, SLOT(showFile(const QString &)));
-        connect(mThumbs.at(idx).data(), SIGNAL(thumbLoadedSignal()), this, SIGNAL(thumbLoadedSignal()));
-
-        // thumb->show();
-        addItem(thumb);
-        mThumbLabels.append(thumb);
-        // thumbsNotLoaded.append(thumb);
-    }
+    mFreeLabels.clear();
+    mLabels.clear();
+    mSelected = QBitArray(mThumbs.size());
 
     showFile();
 
@@ -1193,7 +1480,7 @@ void DkThumbScene::keyPressEvent(QKeyEvent *event)
         break;
     }
     case Qt::Key_Right: {
-        selectThumb(qMin(idx + 1, mThumbLabels.size() - 1));
+        selectThumb(qMin(idx + 1, mThumbs.size() - 1));
         break;
     }
     case Qt::Key_Up: {
@@ -1201,23 +1488,57 @@ void DkThumbScene::keyPressEvent(QKeyEvent *event)
         break;
     }
     case Qt::Key_Down: {
-        selectThumb(qMin(idx + mNumCols, mThumbLabels.size() - 1));
+        selectThumb(qMin(idx + mNumCols, mThumbs.size() - 1));
         break;
     }
     }
 }
 
+void DkThumbScene::mousePressEvent(QGraphicsSceneMouseEvent *event)
+{
+    mPendingSelectIdx = -1;
+
+    if (event->button() == Qt::LeftButton) {
+        int idx = thumbIndexAt(event->scenePos());
+
+        if (idx == -1) {
+            if (event->modifiers() == Qt::NoModifier)
+                selectThumbs(false);
+        } else if (event->modifiers() & Qt::ControlModifier) {
+            selectThumb(idx, !mSelected.testBit(idx));
+        } else if (!mSelected.testBit(idx)) {
+            setSelection(idx, idx, true, true);
+        } else {
+            // we might drag the selection - so we wait for the release
+            mPendingSelectIdx = idx;
+        }
+    }
+
+    QGraphicsScene::mousePressEvent(event);
+}
+
+void DkThumbScene::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
+{
+    if (mPendingSelectIdx != -1 && event->button() == Qt::LeftButton
+        && (event->scenePos() - event->buttonDownScenePos(Qt::LeftButton)).manhattanLength() < QApplication::startDragDistance())
+        setSelection(mPendingSelectIdx, mPendingSelectIdx, true, true);
+
+    mPendingSelectIdx = -1;
+
+    QGraphicsScene::mouseReleaseEvent(event);
+}
+
 void DkThumbScene::showFile(const QString &filePath)
 {
     if (filePath == QDir::currentPath() || filePath.isEmpty()) {
-        int sf = getSelectedFiles().size();
+        int sf = mSelected.count(true);
 
         QString info;
 
         if (sf > 1)
             info = QString::number(sf) + tr(" selected");
         else
-            info = QString::number(mThumbLabels.size()) + tr(" images");
+            info = QString::number(mThumbs.size()) + tr(" images");
 
         DkStatusBarManager::instance().setMessage(tr("%1 | %2").arg(info, currentDir()));
     } else
@@ -1229,14 +1550,25 @@ void DkThumbScene::ensureVisible(QSharedPointer<DkImageContainerT> img) const
     if (!img)
         return;
 
-    for (DkThumbLabel *label : mThumbLabels) {
-        if (label->getThumb()->getFilePath() == img->filePath()) {
-            label->ensureVisible();
+    for (int idx = 0; idx < mThumbs.size(); idx++) {
+        if (mThumbs.at(idx)->filePath() == img->filePath()) {
+            ensureVisible(idx);
             break;
         }
     }
 }
 
+void DkThumbScene::ensureVisible(int idx) const
+{
+    QRectF r = thumbRect(idx);
+
+    if (r.isNull())
+        return;
+
+    for (QGraphicsView *v : views())
+        v->ensureVisible(r);
+}
+
 QString DkThumbScene::currentDir() const
 {
     if (mThumbs.empty() || !mThumbs[0])
@@ -1247,15 +1579,19 @@ QString DkThumbScene::currentDir() const
 
 int DkThumbScene::selectedThumbIndex(bool first)
 {
-    int selIdx = -1;
-    for (int idx = 0; idx < mThumbLabels.size(); idx++) {
-        if (first && mThumbLabels[idx]->isSelected())
-            return idx;
-        else if (mThumbLabels[idx]->isSelected())
-            selIdx = idx;
+    if (first) {
+        for (int idx = 0; idx < mSelected.size(); idx++) {
+            if (mSelected.testBit(idx))
+                return idx;
+        }
+    } else {
+        for (int idx = mSelected.size() - 1; idx >= 0; idx--) {
+            if (mSelected.testBit(idx))
+                return idx;
+        }
     }
 
-    return selIdx;
+    return -1;
 }
 
 void DkThumbScene::toggleThumbLabels(bool show)
@@ -1303,7 +1639,7 @@ void DkThumbScene::resizeThumbs(float dx)
 
 void DkThumbScene::cancelLoading()
 {
-    DkThumbsThreadPool::clear();
+    DkThumbScheduler::instance().cancelAll();
 
     for (auto t : mThumbLabels)
         t->cancelLoading();
@@ -1316,11 +1652,11 @@ void DkThumbScene::selectAllThumbs(bool selected)
 
 void DkThumbScene::selectThumbs(bool selected /* = true */, int from /* = 0 */, int to /* = -1 */)
 {
-    if (mThumbLabels.empty())
+    if (mThumbs.empty())
         return;
 
     if (to == -1)
-        to = mThumbLabels.size() - 1;
+        to = mThumbs.size() - 1;
 
     if (from > to) {
         int tmp = to;
@@ -1328,32 +1664,53 @@ void DkThumbScene::selectThumbs(bool selected /* = true */, int from /* = 0 */,
         from = tmp;
     }
 
-    blockSignals(true);
-    for (int idx = from; idx <= to && idx < mThumbLabels.size(); idx++) {
-        mThumbLabels.at(idx)->setSelected(selected);
-    }
-    blockSignals(false);
-    emit selectionChanged();
-    showFile(); // update selection label
+    setSelection(from, to, selected);
 }
 
 void DkThumbScene::selectThumb(int idx, bool select)
 {
-    if (mThumbLabels.empty())
+    if (mThumbs.empty())
         return;
 
-    if (idx < 0 || idx >= mThumbLabels.size()) {
+    if (idx < 0 || idx >= mThumbs.size()) {
         qWarning() << "index out of bounds in selectThumbs()" << idx;
         return;
     }
 
-    blockSignals(true);
-    mThumbLabels[idx]->setSelected(select);
-    blockSignals(false);
+    setSelection(idx, idx, select);
+    ensureVisible(idx);
+}
+
+/**
+ * Updates the selection bits and the materialized labels.
+ * @param from the first index
+ * @param to the last index (inclusive)
+ * @param select if true, the thumbnails are selected
+ * @param exclusive if true, all other thumbnails are deselected
+ **/
+void DkThumbScene::setSelection(int from, int to, bool select, bool exclusive)
+{
+    from = qMax(from, 0);
+    to = qMin(to, mSelected.size() - 1);
+
+    if (exclusive)
+        mSelected.fill(false);
+
+    for (int idx = from; idx <= to; idx++) {
+        // if we cannot load it -> disable selection
+        mSelected.setBit(idx, select && mThumbs.at(idx)->getThumb()->hasImage() != DkThumbNail::exists_not);
+    }
+
+    for (auto it = mLabels.constBegin(); it != mLabels.constEnd(); ++it)
+        it.value()->setThumbSelected(mSelected.testBit(it.key()));
 
     emit selectionChanged();
     showFile(); // update selection label
-    ensureVisible(mThumbs[idx]);
+}
+
+bool DkThumbScene::isThumbSelected(int idx) const
+{
+    return idx >= 0 && idx < mSelected.size() && mSelected.testBit(idx);
 }
 
 void DkThumbScene::copySelected() const
@@ -1529,22 +1886,21 @@ QStringList DkThumbScene::getSelectedFiles() const
 {
     QStringList fileList;
 
-    for (int idx = 0; idx < mThumbLabels.size(); idx++) {
-        if (mThumbLabels.at(idx) && mThumbLabels.at(idx)->isSelected()) {
-            fileList.append(mThumbLabels.at(idx)->getThumb()->getFilePath());
-        }
+    for (int idx = 0; idx < mSelected.size(); idx++) {
+        if (mSelected.testBit(idx))
+            fileList.append(mThumbs.at(idx)->filePath());
     }
 
     return fileList;
 }
 
-QVector<DkThumbLabel *> DkThumbScene::getSelectedThumbs() const
+QVector<QSharedPointer<DkThumbNailT>> DkThumbScene::getSelectedThumbs() const
 {
-    QVector<DkThumbLabel *> selected;
+    QVector<QSharedPointer<DkThumbNailT>> selected;
 
-    for (DkThumbLabel *label : mThumbLabels) {
-        if (label->isSelected())
-            selected << label;
+    for (int idx = 0; idx < mSelected.size(); idx++) {
+        if (mSelected.testBit(idx))
+            selected << mThumbs.at(idx)->getThumb();
     }
 
     return selected;
@@ -1552,23 +1908,15 @@ QVector<DkThumbLabel *> DkThumbScene::getSelectedThumbs() const
 
 int DkThumbScene::findThumb(DkThumbLabel *thumb) const
 {
-    int thumbIdx = -1;
-
-    for (int idx = 0; idx < mThumbLabels.size(); idx++) {
-        if (thumb == mThumbLabels.at(idx)) {
-            thumbIdx = idx;
-            break;
-        }
-    }
-
-    return thumbIdx;
+    return thumb ? thumb->index() : -1;
 }
 
 bool DkThumbScene::allThumbsSelected() const
 {
-    for (DkThumbLabel *label : mThumbLabels)
-        if (label->flags() & QGraphicsItem::ItemIsSelectable && !label->isSelected())
+    for (int idx = 0; idx < mSelected.size(); idx++) {
+        if (!mSelected.testBit(idx) && mThumbs.at(idx)->getThumb()->hasImage() != DkThumbNail::exists_not)
             return false;
+    }
 
     return true;
 }
@@ -1580,6 +1928,8 @@ DkThumbsView::DkThumbsView(DkThumbScene *scene, QWidget *parent /* = 0 */)
     setObjectName("DkThumbsView");
     this->scene = scene;
     connect(scene, SIGNAL(thumbLoadedSignal()), this, SLOT(fetchThumbs()));
+    connect(verticalScrollBar(), SIGNAL(valueChanged(int)), scene, SLOT(updateVisibleLabels()));
+    connect(verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(updateThumbRequests()));
 
     setResizeAnchor(QGraphicsView::AnchorUnderMouse);
     setAcceptDrops(true);
@@ -1608,7 +1958,7 @@ void DkThumbsView::mousePressEvent(QMouseEvent *event)
 
     qDebug() << "mouse pressed";
 
-    DkThumbLabel *itemClicked = static_cast<DkThumbLabel *>(scene->itemAt(mapToScene(event->pos()), QTransform()));
+    DkThumbLabel *itemClicked = dynamic_cast<DkThumbLabel *>(scene->itemAt(mapToScene(event->pos()), QTransform()));
 
     // this is a bit of a hack
     // what we want to achieve: if the user is selecting with e.g. shift or ctrl
@@ -1636,11 +1986,11 @@ void DkThumbsView::mouseMoveEvent(QMouseEvent *event)
                 mimeData->setUrls(urls);
 
                 // create thumb image
-                QVector<DkThumbLabel *> tl = scene->getSelectedThumbs();
+                QVector<QSharedPointer<DkThumbNailT>> tl = scene->getSelectedThumbs();
                 QVector<QImage> imgs;
 
                 for (int idx = 0; idx < tl.size() && idx < 3; idx++) {
-                    imgs << tl[idx]->getThumb()->getImage();
+                    imgs << tl[idx]->getImage();
                 }
 
                 QPixmap pm = DkImage::merge(imgs).scaledToHeight(73); // 73: see https://www.youtube.com/watch?v=TIYMmbHik08
@@ -1661,7 +2011,7 @@ void DkThumbsView::mouseReleaseEvent(QMouseEvent *event)
 {
     QGraphicsView::mouseReleaseEvent(event);
 
-    DkThumbLabel *itemClicked = static_cast<DkThumbLabel *>(scene->itemAt(mapToScene(event->pos()), QTransform()));
+    DkThumbLabel *itemClicked = dynamic_cast<DkThumbLabel *>(scene->itemAt(mapToScene(event->pos()), QTransform()));
 
     if (lastShiftIdx != -1 && event->modifiers() & Qt::ShiftModifier && itemClicked != 0) {
         scene->selectThumbs(true, lastShiftIdx, scene->findThumb(itemClicked));
@@ -1671,6 +2021,14 @@ void DkThumbsView::mouseReleaseEvent(QMouseEvent *event)
         lastShiftIdx = -1;
 }
 
+void DkThumbsView::resizeEvent(QResizeEvent *event)
+{
+    QGraphicsView::resizeEvent(event);
+
+    // more rows might be visible now
+    scene->updateVisibleLabels();
+}
+
 void DkThumbsView::dragEnterEvent(QDragEnterEvent *event)
 {
     QGraphicsView::dragEnterEvent(event);
@@ -1749,12 +2107,44 @@ void DkThumbsView::fetchThumbs()
             continue;
         }
 
-        if (th->pixmap().isNull()) {
+        if (th->isVisible() && th->pixmap().isNull()) {
             th->update();
         }
     }
 }
 
+/**
+ * Prefetches thumbnails next to the viewport and cancels
+ * requests of thumbnails that scrolled away.
+ * Visible thumbnails are requested when they are painted.
+ **/
+void DkThumbsView::updateThumbRequests()
+{
+    QRectF visibleRect = mapToScene(viewport()->rect()).boundingRect();
+    QRectF nearRect = visibleRect.adjusted(0, -visibleRect.height(), 0, visibleRect.height());
+
+    QVector<QPointer<DkThumbLabel>> requestedLabels;
+
+    for (QGraphicsItem *item : scene->items(nearRect, Qt::IntersectsItemShape)) {
+        DkThumbLabel *th = dynamic_cast<DkThumbLabel *>(item);
+
+        if (!th || !th->isVisible())
+            continue;
+
+        if (!visibleRect.intersects(th->sceneBoundingRect()))
+            th->fetchThumb(DkThumbScheduler::priority_near);
+
+        requestedLabels << th;
+    }
+
+    for (QPointer<DkThumbLabel> th : mRequestedLabels) {
+        if (th && !requestedLabels.contains(th))
+            th->cancelLoading();
+    }
+
+    mRequestedLabels = requestedLabels;
+}
+
 // DkThumbScrollWidget --------------------------------------------------------------------
 DkThumbScrollWidget::DkThumbScrollWidget(QWidget *parent /* = 0 */, Qt::WindowFlags flags /* = 0 */)
     : DkFadeWidget(parent, flags)
@@ -1883,15 +2273,12 @@ void DkThumbScrollWidget::batchPrint() const
 
 void DkThumbScrollWidget::on_loadFile_triggered()
 {
-    auto selected = mThumbsScene->selectedItems();
+    QStringList selected = mThumbsScene->getSelectedFiles();
 
     if (selected.isEmpty())
         return;
 
-    auto thumb = dynamic_cast<DkThumbLabel *>(selected.first());
-
-    if (thumb && thumb->getThumb())
-        mThumbsScene->loadFileSignal(thumb->getThumb()->getFilePath(), false);
+    mThumbsScene->loadFileSignal(selected.first(), false);
 }
 
 void DkThumbScrollWidget::updateThumbs(QVector<QSharedPointer<DkImageContainerT>> thumbs)
@@ -28,18 +28,21 @@
 #pragma once
 
 #pragma warning(push, 0) // no warnings from includes - begin
+#include <QBitArray>
 #include <QDrag>
 #include <QFileInfo>
 #include <QGraphicsObject>
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QPen>
+#include <QPointer>
 #include <QProcess>
 #include <QSharedPointer>
 #pragma warning(pop) // no warnings from includes - end
 
 #include "DkBaseWidgets.h"
 #include "DkImageContainer.h"
+#include "DkMath.h"
 
 #ifndef DllCoreExport
 #ifdef DK_CORE_DLL_EXPORT
@@ -136,6 +139,7 @@ protected:
 
 private:
     QVector<QSharedPointer<DkImageContainerT>> mThumbs;
+    QVector<QSharedPointer<DkThumbNailT>> mRequestedThumbs;
     QTransform worldMatrix;
 
     QPoint lastMousePos;
@@ -144,7 +148,10 @@ private:
     QTimer *moveImageTimer;
 
     QRectF bufferDim;
-    QVector<QRectF> thumbRects;
+    QVector<QRectF> thumbRects; // visible thumbs only (starting at mFirstThumbIdx)
+    int mFirstThumbIdx = 0;
+    DkPrefixSum mExtents; // thumb sizes along the filmstrip
+    QVector<int> mExtentsKey;
 
     QLinearGradient leftGradient;
     QLinearGradient rightGradient;
@@ -178,6 +185,12 @@ private:
     void init();
     void initOrientations();
     void drawThumbs(QPainter *painter);
+    QImage previewImage(int idx, int thumbSize) const;
+    QSize previewSize(int idx, int thumbSize) const;
+    QRectF thumbRect(int idx, const QSize &imgSize, int start) const;
+    int extent(const QRectF &thumbRect) const;
+    void updateExtents();
+    int thumbIndexAt(const QPoint &pos) const;
     void drawFadeOut(QLinearGradient gradient, QRectF imgRect, QImage *img);
     void drawSelectedEffect(QPainter *painter, const QRectF &r);
     void drawCurrentImgEffect(QPainter *painter, const QRectF &r);
@@ -204,6 +217,12 @@ public:
     void setVisible(bool visible);
     QPixmap pixmap() const;
     void cancelLoading();
+    void fetchThumb(int priority);
+
+    void setIndex(int idx);
+    int index() const;
+    void setThumbSelected(bool selected);
+    bool isThumbSelected() const;
 
 public slots:
     void updateLabel();
@@ -213,6 +232,7 @@ signals:
     void showFileSignal(const QString &filePath = QString()) const;
 
 protected:
+    void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
     void mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event) override;
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0) override;
     void hoverEnterEvent(QGraphicsSceneHoverEvent *event) override;
@@ -228,6 +248,8 @@ protected:
     QPen mSelectPen;
     QBrush mSelectBrush;
     bool mIsHovered = false;
+    bool mSelected = false;
+    int mIdx = -1;
     QPointF mLastMove;
 };
 
@@ -240,18 +262,24 @@ public:
 
     void updateLayout();
     QStringList getSelectedFiles() const;
-    QVector<DkThumbLabel *> getSelectedThumbs() const;
+    QVector<QSharedPointer<DkThumbNailT>> getSelectedThumbs() const;
     int selectedThumbIndex(bool first = true);
+    bool isThumbSelected(int idx) const;
 
     void setImageLoader(QSharedPointer<DkImageLoader> loader);
     void copyImages(const QMimeData *mimeData, const Qt::DropAction &da = Qt::CopyAction) const;
     int findThumb(DkThumbLabel *thumb) const;
     bool allThumbsSelected() const;
     void ensureVisible(QSharedPointer<DkImageContainerT> img) const;
+    void ensureVisible(int idx) const;
     QString currentDir() const;
 
+    QRectF thumbRect(int idx) const;
+    int thumbIndexAt(const QPointF &pos) const;
+
 public slots:
     void updateThumbLabels();
+    void updateVisibleLabels(bool relayout = false);
     void cancelLoading();
     void increaseThumbs();
     void decreaseThumbs();
@@ -276,13 +304,23 @@ signals:
 protected:
     void connectLoader(QSharedPointer<DkImageLoader> loader, bool connectSignals = true);
     void keyPressEvent(QKeyEvent *event) override;
+    void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
+    void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
+
+    void setSelection(int from, int to, bool select, bool exclusive = false);
+    DkThumbLabel *takeLabel();
 
     int mXOffset = 0;
     int mNumRows = 0;
     int mNumCols = 0;
     bool mFirstLayout = true;
+    int mPendingSelectIdx = -1;
 
-    QVector<DkThumbLabel *> mThumbLabels;
+    // only labels of the visible rows exist - they are recycled while scrolling
+    QVector<DkThumbLabel *> mThumbLabels; // all labels (owned by the scene)
+    QVector<DkThumbLabel *> mFreeLabels;
+    QHash<int, DkThumbLabel *> mLabels; // thumb index -> label
+    QBitArray mSelected;
     QSharedPointer<DkImageLoader> mLoader;
     QVector<QSharedPointer<DkImageContainerT>> mThumbs;
 };
@@ -299,6 +337,7 @@ signals:
 
 public slots:
     void fetchThumbs();
+    void updateThumbRequests();
 
 protected:
     void wheelEvent(QWheelEvent *event) override;
@@ -308,10 +347,12 @@ protected:
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
 
     DkThumbScene *scene;
     QPointF mousePos;
     int lastShiftIdx;
+    QVector<QPointer<DkThumbLabel>> mRequestedLabels;
 };
 
 class DllCoreExport DkThumbScrollWidget : public DkFadeWidget
@@ -40,6 +40,7 @@
 #include "DkSettings.h"
 #include "DkStatusBar.h"
 #include "DkThumbsWidgets.h" // needed in the connects -> shall we move them to mController?
+#include "DkTimer.h"
 #include "DkToolbars.h"
 #include "DkUtils.h"
 #include "DkWidgets.h"
@@ -56,8 +57,10 @@
 #include <QMessageBox>
 #include <QMimeData>
 #include <QMovie>
+#include <QScreen>
 #include <QSvgRenderer>
 #include <QVBoxLayout>
+#include <QWindow>
 #include <QtConcurrentRun>
 
 #include <qmath.h>
@@ -89,8 +92,11 @@ DkViewPort::DkViewPort(QWidget *parent)
     mRepeatZoomTimer->setInterval(20);
     connect(mRepeatZoomTimer, SIGNAL(timeout()), this, SLOT(repeatZoom()));
 
-    mAnimationTimer->setInterval(5);
+    // the interval is adapted to the screen's refresh rate when a transition starts
+    mAnimationTimer->setTimerType(Qt::PreciseTimer);
+    mAnimationTimer->setInterval(16);
     connect(mAnimationTimer, SIGNAL(timeout()), this, SLOT(animateFade()));
+    connect(&mImgStorage, SIGNAL(imageUpdated()), this, SLOT(startPendingTransition()));
 
     // no border
     setMouseTracking(true); // receive mouse event everytime
@@ -261,7 +267,12 @@ void DkViewPort::updateImage(QSharedPointer<DkImageContainerT> image, bool loade
         return;
 
     if (mLoader->hasImage()) {
-        setImage(mLoader->getPixmap()); // modified image (for view), may differ from lastImage after rotate
+        // modified image (for view), may differ from lastImage after rotate
+        // the Exif orientation is applied when drawing
+        DkJpgTransform::Transform orientation = DkJpgTransform::transform_identity;
+        QImage img = mLoader->getRawPixmap(&orientation);
+        updateRegionLoader(image, orientation);
+        setImage(img, orientation);
     }
 
     emit imageUpdatedSignal();
@@ -296,14 +307,45 @@ void DkViewPort::loadImage(QSharedPointer<DkImageContainerT> img)
             return;
 
         if (img->hasImage()) {
+            DkJpgTransform::Transform orientation = DkJpgTransform::transform_identity;
+            QImage rawImg = img->rawPixmap(&orientation);
+
             mLoader->setCurrentImage(img);
-            setImage(img->image());
+            updateRegionLoader(img, orientation);
+            setImage(rawImg, orientation);
         }
         mLoader->load(img);
     }
 }
 
 void DkViewPort::setImage(QImage newImg)
+{
+    setRegionLoader(); // this image is not backed by its file
+    setImage(newImg, DkJpgTransform::transform_identity);
+}
+
+/**
+ * Huge images are loaded with reduced resolution.
+ * For these, zoomed regions are decoded from the file.
+ * @param imgC the image container that is displayed next
+ * @param orientation the transform that displays the image upright
+ **/
+void DkViewPort::updateRegionLoader(QSharedPointer<DkImageContainerT> imgC, DkJpgTransform::Transform orientation)
+{
+    QSharedPointer<DkRegionLoader> loader;
+
+    if (imgC && !imgC->isEdited() && imgC->getLoader()->decodeScale() < 1.0)
+        loader = QSharedPointer<DkRegionLoader>(new DkRegionLoader(imgC->filePath()));
+
+    setRegionLoader(loader, orientation);
+}
+
+/**
+ * Sets the image to be displayed.
+ * @param newImg the image (pixels as decoded)
+ * @param orientation the transform that displays newImg upright - it is applied when drawing
+ **/
+void DkViewPort::setImage(QImage newImg, DkJpgTransform::Transform orientation)
 {
     // calling show here fixes issues with the HUD
     show();
@@ -318,7 +360,7 @@ void DkViewPort::setImage(QImage newImg)
 
     mController->getOverview()->setImage(QImage()); // clear overview
 
-    mImgStorage.setImage(newImg);
+    mImgStorage.setImage(newImg, orientation);
 
     if (mLoader->hasMovie() && !mLoader->isEdited())
         loadMovie();
@@ -348,17 +390,21 @@ void DkViewPort::setImage(QImage newImg)
     }
 
     mController->getPlayer()->startTimer();
-    mController->getOverview()->setImage(newImg); // TODO: maybe we could make use of the image pyramid here
+
+    // derived images (display size, overview, histogram) are computed in parallel on worker threads
+    mImgStorage.prefetch(mWorldMatrix.mapRect(mImgViewRect).toRect().size());
+    mController->getOverview()->setImage(newImg, orientation); // TODO: maybe we could make use of the image pyramid here
 
     mOldImgRect = mImgRect;
 
     // init fading
     if (DkSettingsManager::param().display().animationDuration && DkSettingsManager::param().display().transition != DkSettingsManager::param().trans_appear
         && (mController->getPlayer()->isPlaying() || DkUtils::getMainWindow()->isFullScreen() || DkSettingsManager::param().display().alwaysAnimate)) {
-        mAnimationTimer->start();
-        mAnimationTime.start();
-    } else
+        startTransition();
+    } else {
+        mTransitionPending = false;
         mAnimationValue = 0.0f;
+    }
 
     //// set/clear crop rect
     // if (mLoader->getCurrentImage())
@@ -380,7 +426,7 @@ void DkViewPort::setImage(QImage newImg)
         DkStatusBarManager::instance().setMessage(QString::number(qRound((float)(mWorldMatrix.m11() * mImgMatrix.m11() * 100))) + "%",
                                                   DkStatusBar::status_zoom_info);
         DkStatusBarManager::instance().setMessage(DkUtils::formatToString(newImg.format()), DkStatusBar::status_format_info);
-        DkStatusBarManager::instance().setMessage(QString::number(newImg.width()) + " x " + QString::number(newImg.height()),
+        DkStatusBarManager::instance().setMessage(QString::number(getImageSize().width()) + " x " + QString::number(getImageSize().height()),
                                                   DkStatusBar::status_dimension_info);
 
         if (imageContainer())
@@ -908,6 +954,8 @@ void DkViewPort::manipulatorApplied()
 
 void DkViewPort::paintEvent(QPaintEvent *event)
 {
+    DkTraceScope ts("paintEvent", DkTraceLog::cat_paint);
+
     QPainter painter(viewport());
 
     if (!mImgStorage.isEmpty()) {
@@ -925,34 +973,10 @@ void DkViewPort::paintEvent(QPaintEvent *event)
             painter.setRenderHints(QPainter::SmoothPixmapTransform | QPainter::Antialiasing);
         }
 
-        if (DkSettingsManager::param().display().transition == DkSettings::trans_swipe && !mAnimationBuffer.isNull()) {
-            double dx = mNextSwipe ? width() * (mAnimationValue) : -width() * (mAnimationValue);
-
-            QTransform swipeTransform;
-            swipeTransform.translate(dx, 0);
-            painter.setTransform(swipeTransform);
-        }
-
-        // TODO: if fading is active we interpolate with background instead of the other image
-        double opacity = (DkSettingsManager::param().display().transition == DkSettings::trans_fade) ? 1.0 - mAnimationValue : 1.0;
-        draw(painter, opacity);
-
-        if (!mAnimationBuffer.isNull() && mAnimationValue > 0) {
-            float oldOp = (float)painter.opacity();
-
-            // fade transition
-            if (DkSettingsManager::param().display().transition == DkSettings::trans_fade) {
-                painter.setOpacity(mAnimationValue);
-            } else if (DkSettingsManager::param().display().transition == DkSettings::trans_swipe) {
-                double dx = mNextSwipe ? -width() * (1.0 - mAnimationValue) : width() * (1.0 - mAnimationValue);
-                QTransform swipeTransform;
-                swipeTransform.translate(dx, 0);
-                painter.setTransform(swipeTransform);
-            }
-
-            painter.drawImage(mFadeImgViewRect, mAnimationBuffer, mAnimationBuffer.rect());
-            painter.setOpacity(oldOp);
-        }
+        if (mAnimationTimer->isActive() || mTransitionPending)
+            drawTransition(painter);
+        else
+            draw(painter);
 
         // now disable world matrix for overlay display
         painter.setWorldMatrixEnabled(false);
@@ -1376,6 +1400,23 @@ QPoint DkViewPort::mapToImage(const QPoint &windowPos) const
     return xy;
 }
 
+/**
+ * Returns the color of a pixel.
+ * Huge images are displayed with reduced resolution, so we map to the displayed pixels.
+ * @param xy the pixel position in image coordinates
+ * @return QColor the pixel's color
+ **/
+QColor DkViewPort::imagePixel(const QPoint &xy) const
+{
+    QImage img = getImage();
+    QSize size = getImageSize();
+
+    if (img.isNull() || size.isEmpty())
+        return QColor();
+
+    return img.pixel((int)((qint64)xy.x() * img.width() / size.width()), (int)((qint64)xy.y() * img.height() / size.height()));
+}
+
 void DkViewPort::getPixelInfo(const QPoint &pos)
 {
     if (mImgStorage.isEmpty())
@@ -1386,7 +1427,7 @@ void DkViewPort::getPixelInfo(const QPoint &pos)
     if (xy.x() == -1 || xy.y() == -1)
         return;
 
-    QColor col = getImage().pixel(xy);
+    QColor col = imagePixel(xy);
 
     QString msg = "x: " + QString::number(xy.x()) + " y: " + QString::number(xy.y()) + " | r: " + QString::number(col.red())
         + " g: " + QString::number(col.green()) + " b: " + QString::number(col.blue());
@@ -1412,7 +1453,7 @@ QString DkViewPort::getCurrentPixelHexValue()
     if (xy.x() < 0 || xy.y() < 0 || xy.x() >= getImageSize().width() || xy.y() >= getImageSize().height())
         return QString();
 
-    QColor col = getImage().pixel(xy);
+    QColor col = imagePixel(xy);
 
     return col.name().toUpper().remove(0, 1);
 }
@@ -1436,6 +1477,12 @@ void DkViewPort::copyImage()
 {
     QMimeData *mimeData = createMime();
 
+    // the file is copied if it is not edited - otherwise the (maybe reduced) image
+    if (mimeData && mimeData->hasImage() && !mLoader->confirmReducedResolution()) {
+        delete mimeData;
+        return;
+    }
+
     QClipboard *clipboard = QApplication::clipboard();
     clipboard->setMimeData(mimeData);
 }
@@ -1464,7 +1511,7 @@ QMimeData *DkViewPort::createMime() const
 
 void DkViewPort::copyImageBuffer()
 {
-    if (getImage().isNull())
+    if (getImage().isNull() || (mLoader && !mLoader->confirmReducedResolution()))
         return;
 
     QMimeData *mimeData = new QMimeData;
@@ -1478,23 +1525,176 @@ void DkViewPort::copyImageBuffer()
 
 void DkViewPort::animateFade()
 {
-    mAnimationValue = 1.0f - (float)(mAnimationTime.elapsed() / 1000.0) / DkSettingsManager::param().display().animationDuration;
+    // the progress only depends on the time - so late frames do not stretch the transition
+    double t = mAnimationTime.elapsedMicro() / (DkSettingsManager::param().display().animationDuration * 1e6);
+    t = qBound(0.0, t, 1.0);
 
     // slow in - slow out
-    double speed = mAnimationValue > 0.5 ? fabs(1.0 - mAnimationValue) : fabs(mAnimationValue);
-    speed *= .05;
-
-    mAnimationValue += (float)speed;
+    mAnimationValue = 1.0 - t * t * (3.0 - 2.0 * t);
 
-    if (mAnimationValue <= 0) {
-        mAnimationBuffer = QImage();
+    if (t >= 1.0) {
         mAnimationTimer->stop();
         mAnimationValue = 0;
+        mAnimationBuffer = QImage();
+        mTransitionBuffer = QImage();
+
+        qInfo() << "transition:" << qPrintable(mFrameStats.toString());
     }
 
     update();
 }
 
+/**
+ * Starts a slideshow transition from the last image (mAnimationBuffer) to the current one.
+ * The current image is rendered once with screen resolution so that
+ * frames only blend two screen sized buffers.
+ * The display sized image is computed on a worker thread (see DkImageStorage::prefetch).
+ * Until it is ready, the last image is shown and the transition starts once it arrives.
+ * The clock ticks with the screen's refresh rate.
+ **/
+void DkViewPort::startTransition()
+{
+    mTransitionPending = true;
+
+    // downsampling the full resolution image here would stall the first frames
+    if (!mSvg && !mMovie && !mImgStorage.isReady(mWorldMatrix.mapRect(mImgViewRect).toRect().size())) {
+        mAnimationTimer->stop();
+        mTransitionBuffer = QImage();
+        return;
+    }
+
+    startPendingTransition();
+}
+
+/**
+ * Starts the transition that waits for the display sized image.
+ **/
+void DkViewPort::startPendingTransition()
+{
+    if (!mTransitionPending)
+        return;
+
+    mTransitionPending = false;
+
+    double hz = refreshRate();
+
+    // if computing the display sized image failed, the full resolution image is used
+    mTransitionBuffer = (mSvg || mMovie) ? QImage() : screenBuffer(mTransitionRect);
+    mTransitionMatrix = mImgMatrix * mWorldMatrix;
+
+    mAnimationTimer->setInterval(qMax(qFloor(1000.0 / hz), 1));
+    mAnimationTimer->start();
+    mFrameStats.start(hz);
+    mAnimationTime.start();
+}
+
+/**
+ * Draws one frame of the slideshow transition.
+ * While the transition waits for the new image, only the last image is drawn.
+ * @param painter a painter with the world matrix set
+ **/
+void DkViewPort::drawTransition(QPainter &painter)
+{
+    if (!mTransitionPending)
+        mFrameStats.addFrame();
+
+    bool swipe = DkSettingsManager::param().display().transition == DkSettings::trans_swipe;
+    bool fade = DkSettingsManager::param().display().transition == DkSettings::trans_fade;
+
+    // TODO: if fading is active we interpolate with background instead of the other image
+    double opacity = fade ? 1.0 - mAnimationValue : 1.0;
+    int dxNew = swipe && !mAnimationBuffer.isNull() ? qRound(mNextSwipe ? width() * mAnimationValue : -width() * mAnimationValue) : 0;
+
+    // the buffer is invalid if the user zoomed or panned meanwhile
+    if (!mTransitionBuffer.isNull() && mTransitionMatrix == mImgMatrix * mWorldMatrix) {
+        painter.setWorldMatrixEnabled(false);
+
+        if (DkUtils::getMainWindow()->isFullScreen())
+            painter.fillRect(QRect(QPoint(), size()), DkSettingsManager::param().slideShow().backgroundColor);
+
+        painter.setOpacity(opacity);
+        painter.drawImage(mTransitionRect.topLeft() + QPoint(dxNew, 0), mTransitionBuffer);
+        painter.setOpacity(1.0);
+        painter.setWorldMatrixEnabled(true);
+    } else if (!mTransitionPending) {
+        if (dxNew != 0) {
+            QTransform swipeTransform;
+            swipeTransform.translate(dxNew, 0);
+            painter.setTransform(swipeTransform);
+        }
+
+        draw(painter, opacity);
+    }
+
+    if (!mAnimationBuffer.isNull() && mAnimationValue > 0) {
+        int dxOld = swipe ? qRound(mNextSwipe ? -width() * (1.0 - mAnimationValue) : width() * (1.0 - mAnimationValue)) : 0;
+
+        painter.setWorldMatrixEnabled(false);
+        painter.setOpacity(fade ? mAnimationValue : 1.0);
+        painter.drawImage(mAnimationRect.topLeft() + QPoint(dxOld, 0), mAnimationBuffer);
+        painter.setOpacity(1.0);
+        painter.setWorldMatrixEnabled(true);
+    }
+}
+
+/**
+ * Renders the visible part of the current image with screen resolution.
+ * @param rect is set to the buffer's position in viewport coordinates
+ * @return QImage the rendered image (premultiplied ARGB)
+ **/
+QImage DkViewPort::screenBuffer(QRect &rect)
+{
+    QRect dr = mWorldMatrix.mapRect(mImgViewRect).toRect();
+    rect = dr.intersected(QRect(QPoint(), size()));
+
+    if (rect.isEmpty() || mImgStorage.isEmpty())
+        return QImage();
+
+    QTransform imgTransform;
+    QImage img = mImgStorage.image(dr.size(), imgTransform);
+
+    if (img.isNull())
+        return QImage();
+
+    // large downscaling: a fast (nearest neighbor) step to twice the target size first
+    QRectF ir = imgTransform.mapRect(QRectF(img.rect()));
+    if (ir.width() > 2.0 * dr.width() && ir.height() > 2.0 * dr.height()) {
+        QSizeF s(img.width() * 2.0 * dr.width() / ir.width(), img.height() * 2.0 * dr.height() / ir.height());
+        QImage small = img.scaled(s.toSize(), Qt::IgnoreAspectRatio, Qt::FastTransformation);
+
+        // map the small image's pixels to the original ones - the orientation is kept
+        imgTransform = QTransform::fromScale((double)img.width() / small.width(), (double)img.height() / small.height()) * imgTransform;
+        img = small;
+    }
+
+    QImage buffer(rect.size(), QImage::Format_ARGB32_Premultiplied);
+    buffer.fill(Qt::transparent);
+
+    QTransform t = imgTransform;
+    t *= QTransform::fromTranslate(-ir.x(), -ir.y());
+    t *= QTransform::fromScale(dr.width() / ir.width(), dr.height() / ir.height());
+    t *= QTransform::fromTranslate(dr.x() - rect.x(), dr.y() - rect.y());
+
+    QPainter p(&buffer);
+    p.setRenderHint(QPainter::SmoothPixmapTransform);
+    p.setTransform(t);
+    p.drawImage(QPointF(), img);
+
+    return buffer;
+}
+
+/**
+ * Returns the refresh rate of the screen that shows the viewport.
+ * @return double the refresh rate in Hz (60 if unknown)
+ **/
+double DkViewPort::refreshRate() const
+{
+    QWindow *w = window()->windowHandle();
+    QScreen *screen = w ? w->screen() : QGuiApplication::primaryScreen();
+
+    return screen && screen->refreshRate() > 1.0 ? screen->refreshRate() : 60.0;
+}
+
 void DkViewPort::togglePattern(bool show)
 {
     emit infoSignal((show) ? tr("Transparency Pattern Enabled") : tr("Transparency Pattern Disabled"));
@@ -1619,10 +1819,7 @@ bool DkViewPort::unloadImage(bool fileChange)
 {
     if (DkSettingsManager::param().display().animationDuration > 0
         && (mController->getPlayer()->isPlaying() || DkUtils::getMainWindow()->isFullScreen() || DkSettingsManager::param().display().alwaysAnimate)) {
-        QRect dr = mWorldMatrix.mapRect(mImgViewRect).toRect();
-        mAnimationBuffer = mImgStorage.image(dr.size());
-        mFadeImgViewRect = mImgViewRect;
-        mFadeImgRect = mImgRect;
+        mAnimationBuffer = screenBuffer(mAnimationRect);
         mAnimationValue = 1.0f;
     }
 
@@ -2392,6 +2589,12 @@ void DkViewPortContrast::draw(QPainter &painter, double opacity)
         painter.drawImage(mImgViewRect, mFalseColorImg, mImgRect);
 }
 
+void DkViewPortContrast::setImage(QImage newImg, DkJpgTransform::Transform orientation)
+{
+    // we need the pixels upright to split the channels
+    setImage(DkJpgTransform::apply(newImg, orientation));
+}
+
 void DkViewPortContrast::setImage(QImage newImg)
 {
     DkViewPort::setImage(newImg);
@@ -195,6 +195,7 @@ public slots:
     virtual void setEditedImage(const QImage &newImg, const QString &editName);
     virtual void setEditedImage(QSharedPointer<DkImageContainerT> img);
     virtual void setImage(QImage newImg) override;
+    virtual void setImage(QImage newImg, DkJpgTransform::Transform orientation);
 
     void settingsChanged();
     void pauseMovie(bool paused);
@@ -204,6 +205,7 @@ public slots:
     void nextMovieFrame();
     void previousMovieFrame();
     void animateFade();
+    void startPendingTransition();
     virtual void togglePattern(bool show) override;
 
 protected:
@@ -227,10 +229,14 @@ protected:
     // fading stuff
     QTimer *mAnimationTimer;
     DkTimer mAnimationTime;
-    QImage mAnimationBuffer;
+    DkFrameStats mFrameStats;
+    QImage mAnimationBuffer; // old image with screen resolution
+    QRect mAnimationRect;
+    QImage mTransitionBuffer; // new image with screen resolution
+    QRect mTransitionRect;
+    QTransform mTransitionMatrix;
+    bool mTransitionPending = false;
     double mAnimationValue;
-    QRectF mFadeImgViewRect;
-    QRectF mFadeImgRect;
     bool mNextSwipe = true;
 
     QImage mImgBg;
@@ -255,10 +261,16 @@ protected:
 
     void drawPolygon(QPainter &painter, const QPolygon &polygon);
     virtual void drawBackground(QPainter &painter);
+    void drawTransition(QPainter &painter);
+    void startTransition();
+    QImage screenBuffer(QRect &rect);
+    double refreshRate() const;
     void updateImageMatrix() override;
     void showZoom();
     void toggleLena(bool fullscreen);
     void getPixelInfo(const QPoint &pos);
+    void updateRegionLoader(QSharedPointer<DkImageContainerT> imgC, DkJpgTransform::Transform orientation);
+    QColor imagePixel(const QPoint &xy) const;
 };
 
 class DllCoreExport DkViewPortFrameless : public DkViewPort
@@ -316,6 +328,7 @@ public slots:
     QImage getImage() const override;
 
     virtual void setImage(QImage newImg) override;
+    virtual void setImage(QImage newImg, DkJpgTransform::Transform orientation) override;
 
 protected:
     virtual void draw(QPainter &painter, double opacity = 1.0) override;
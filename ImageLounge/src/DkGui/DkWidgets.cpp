@@ -337,7 +337,7 @@ void DkThumbsSaver::loadNext()
 
     for (int idx = 0; idx < mImages.size(); idx++) {
         connect(mImages.at(idx)->getThumb().data(), SIGNAL(thumbLoadedSignal(bool)), this, SLOT(thumbLoaded(bool)));
-        mImages.at(idx)->getThumb()->fetchThumb(force);
+        mImages.at(idx)->getThumb()->fetchThumb(force, QSharedPointer<QByteArray>(), DkThumbScheduler::priority_background);
     }
 }
 
@@ -692,13 +692,53 @@ DkOverview::DkOverview(QWidget *parent)
     setMaximumSize(200, 200);
     setCursor(Qt::ArrowCursor);
     setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::MinimumExpanding);
+
+    connect(&mOverviewWatcher, SIGNAL(finished()), this, SLOT(overviewComputed()));
+}
+
+/**
+ * Sets the image of the overview.
+ * The (small) overview image is computed on a worker thread.
+ * @param img the image (pixels as decoded)
+ * @param orientation the transform that displays img upright
+ **/
+void DkOverview::setImage(const QImage &img, DkJpgTransform::Transform orientation)
+{
+    mOverviewWatcher.cancel(); // drop results of the last image
+
+    mImg = img;
+    mOrientation = orientation;
+    mImgSize = DkJpgTransform::transformedSize(img.size(), orientation);
+    mImgT = QImage();
+
+    if (isVisible())
+        computeOverview();
+}
+
+void DkOverview::computeOverview()
+{
+    if (mImg.isNull())
+        return;
+
+    mOverviewWatcher.setFuture(QtConcurrent::run(&DkOverview::resizedImg, mImg, maximumSize(), mOrientation));
+    mImg = QImage(); // free-up space - the worker keeps its own reference
+}
+
+void DkOverview::overviewComputed()
+{
+    if (mOverviewWatcher.isCanceled())
+        return;
+
+    mImgT = mOverviewWatcher.result();
+    update();
 }
 
 void DkOverview::paintEvent(QPaintEvent *event)
 {
+    // not computed yet? we paint as soon as the worker is done
     if (mImgT.isNull()) {
-        mImgT = resizedImg(mImg);
-        mImg = QImage(); // free-up space
+        computeOverview();
+        return;
     }
 
     if (!mImgMatrix || !mWorldMatrix)
@@ -814,27 +854,36 @@ QRectF DkOverview::getImageRect() const
     return imgRect;
 }
 
-QImage DkOverview::resizedImg(const QImage &src)
+/**
+ * Creates the overview image.
+ * This function is thread-safe.
+ * @param src the image (pixels as decoded)
+ * @param maxSize the maximal size of the overview
+ * @param orientation the transform that displays src upright
+ * @return QImage the upright overview image
+ **/
+QImage DkOverview::resizedImg(const QImage &src, const QSize &maxSize, DkJpgTransform::Transform orientation)
 {
     if (src.isNull())
         return QImage();
 
-    QTransform overviewImgMatrix = getScaledImageMatrix(); // matrix that always resizes the image to the current mViewport
-
-    // is the overviewImgMatrix empty?
-    if (overviewImgMatrix.isIdentity())
-        return src;
+    DkTraceScope ts("overview", DkTraceLog::cat_resize);
 
     // fast downscaling
-    QImage sImg = src.scaled(maximumWidth() * 2, maximumHeight() * 2, Qt::KeepAspectRatio, Qt::FastTransformation);
-    sImg = sImg.scaled(maximumWidth(), maximumHeight(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    QSize s = DkJpgTransform::transformedSize(maxSize, orientation);
+    QImage sImg = src;
+
+    if (src.width() > s.width() || src.height() > s.height()) {
+        sImg = src.scaled(s * 2, Qt::KeepAspectRatio, Qt::FastTransformation);
+        sImg = sImg.scaled(s, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
 
-    return sImg;
+    return DkJpgTransform::apply(sImg, orientation);
 }
 
 QTransform DkOverview::getScaledImageMatrix()
 {
-    if (mImgT.isNull() && mImg.isNull())
+    if (mImgSize.isEmpty())
         return QTransform();
 
     int lm, tm, rm, bm;
@@ -2141,6 +2190,8 @@ DkHistogram::DkHistogram(QWidget *parent)
     mContextMenu->addAction(showStats);
 
     QMetaObject::connectSlotsByName(this);
+
+    connect(&mHistWatcher, SIGNAL(finished()), this, SLOT(histogramComputed()));
 }
 
 DkHistogram::~DkHistogram()
@@ -2253,113 +2304,139 @@ void DkHistogram::loadSettings()
 void DkHistogram::drawHistogram(QImage imgQt)
 {
     if (!isVisible() || imgQt.isNull()) {
+        mHistWatcher.cancel(); // drop pending results
         setPainted(false);
         return;
     }
 
+    // the pixels are counted on a worker - the histogram is updated once they are ready
+    mHistWatcher.setFuture(QtConcurrent::run(&DkHistogram::computeStats, imgQt));
+}
+
+/**
+ * Counts the pixel values of img.
+ * This function is thread-safe.
+ * @param img the image
+ * @return DkHistogram::Stats the histogram and its statistics
+ **/
+DkHistogram::Stats DkHistogram::computeStats(const QImage &img)
+{
     DkTimer dt;
 
-    // clear histogram values
-    mNumZeroPixels = 0;
-    mNumSaturatedPixels = 0;
-    mMaxBinValue = -1;
-    mMinBinValue = 256;
-    mMaxValue = 0;
-    mNumPixels = imgQt.width() * imgQt.height();
+    Stats s;
+    s.numPixels = img.width() * img.height();
 
     for (int idx = 0; idx < 256; idx++) {
-        mHist[0][idx] = 0;
-        mHist[1][idx] = 0;
-        mHist[2][idx] = 0;
+        s.hist[0][idx] = 0;
+        s.hist[1][idx] = 0;
+        s.hist[2][idx] = 0;
     }
 
     // count pixel- and total values, for
     // 8 bit images
-    if (imgQt.depth() == 8) {
-        qDebug() << "8 bit histogram -------------------";
-
-        for (int rIdx = 0; rIdx < imgQt.height(); rIdx++) {
-            const unsigned char *pixel = imgQt.constScanLine(rIdx);
+    if (img.depth() == 8) {
+        for (int rIdx = 0; rIdx < img.height(); rIdx++) {
+            const unsigned char *pixel = img.constScanLine(rIdx);
 
-            for (int cIdx = 0; cIdx < imgQt.width(); cIdx++, pixel++) {
-                mHist[0][*pixel]++;
-                mHist[1][*pixel]++;
-                mHist[2][*pixel]++;
+            for (int cIdx = 0; cIdx < img.width(); cIdx++, pixel++) {
+                s.hist[0][*pixel]++;
+                s.hist[1][*pixel]++;
+                s.hist[2][*pixel]++;
 
                 if (*pixel == 255)
-                    mNumSaturatedPixels++;
-                if (*pixel < mMinBinValue)
-                    mMinBinValue = *pixel;
-                if (*pixel > mMaxBinValue)
-                    mMaxBinValue = *pixel;
+                    s.numSaturatedPixels++;
+                if (*pixel < s.minBinValue)
+                    s.minBinValue = *pixel;
+                if (*pixel > s.maxBinValue)
+                    s.maxBinValue = *pixel;
             }
         }
     }
     // 24 bit images
-    else if (imgQt.depth() == 24) {
-        for (int rIdx = 0; rIdx < imgQt.height(); rIdx++) {
-            const unsigned char *pixel = imgQt.constScanLine(rIdx);
-            for (int cIdx = 0; cIdx < imgQt.width(); cIdx++) {
+    else if (img.depth() == 24) {
+        for (int rIdx = 0; rIdx < img.height(); rIdx++) {
+            const unsigned char *pixel = img.constScanLine(rIdx);
+            for (int cIdx = 0; cIdx < img.width(); cIdx++) {
                 // If I understood the api correctly, the first bits are 0 if we have 24bpp & < 8 bits per channel
                 unsigned char pixR = *pixel;
-                mHist[0][*pixel]++;
+                s.hist[0][*pixel]++;
                 pixel++;
                 unsigned char pixG = *pixel;
-                mHist[1][*pixel]++;
+                s.hist[1][*pixel]++;
                 pixel++;
                 unsigned char pixB = *pixel;
-                mHist[2][*pixel]++;
+                s.hist[2][*pixel]++;
                 pixel++;
 
                 if (pixR == 0 && pixG == 0 && pixB == 0) {
-                    mNumZeroPixels++;
+                    s.numZeroPixels++;
                 } else if (pixR == 255 && pixG == 255 && pixB == 255) {
-                    mNumSaturatedPixels++;
+                    s.numSaturatedPixels++;
                 }
             }
         }
     }
     // 32 bit images
-    else if (imgQt.depth() == 32) {
-        for (int rIdx = 0; rIdx < imgQt.height(); rIdx++) {
-            const QRgb *pixel = (QRgb *)(imgQt.constScanLine(rIdx));
+    else if (img.depth() == 32) {
+        for (int rIdx = 0; rIdx < img.height(); rIdx++) {
+            const QRgb *pixel = (QRgb *)(img.constScanLine(rIdx));
 
-            for (int cIdx = 0; cIdx < imgQt.width(); cIdx++, pixel++) {
+            for (int cIdx = 0; cIdx < img.width(); cIdx++, pixel++) {
                 size_t pixR = static_cast<size_t>(qRed(*pixel));
                 size_t pixG = static_cast<size_t>(qGreen(*pixel));
                 size_t pixB = static_cast<size_t>(qBlue(*pixel));
 
-                mHist[0][pixR]++;
-                mHist[1][pixG]++;
-                mHist[2][pixB]++;
+                s.hist[0][pixR]++;
+                s.hist[1][pixG]++;
+                s.hist[2][pixB]++;
 
                 if (pixR == 0 && pixG == 0 && pixB == 0) {
-                    mNumZeroPixels++;
+                    s.numZeroPixels++;
                 } else if (pixR == 255 && pixG == 255 && pixB == 255) {
-                    mNumSaturatedPixels++;
+                    s.numSaturatedPixels++;
                 }
             }
         }
     }
 
     // determine extreme values from the histogram
-    mNumDistinctValues = 0;
+    s.numDistinctValues = 0;
 
     for (int idx = 0; idx < 256; idx++) {
-        if (mHist[0][idx] > mMaxValue)
-            mMaxValue = mHist[0][idx];
-        if (mHist[1][idx] > mMaxValue)
-            mMaxValue = mHist[1][idx];
-        if (mHist[2][idx] > mMaxValue)
-            mMaxValue = mHist[2][idx];
-
-        if (mHist[0][idx] || mHist[1][idx] || mHist[2][idx]) {
-            mNumDistinctValues++;
+        if (s.hist[0][idx] > s.maxValue)
+            s.maxValue = s.hist[0][idx];
+        if (s.hist[1][idx] > s.maxValue)
+            s.maxValue = s.hist[1][idx];
+        if (s.hist[2][idx] > s.maxValue)
+            s.maxValue = s.hist[2][idx];
+
+        if (s.hist[0][idx] || s.hist[1][idx] || s.hist[2][idx]) {
+            s.numDistinctValues++;
         }
     }
 
+    qDebug() << "computing the histogram took me: " << dt;
+
+    return s;
+}
+
+void DkHistogram::histogramComputed()
+{
+    if (mHistWatcher.isCanceled())
+        return;
+
+    Stats s = mHistWatcher.result();
+
+    updateHistogramValues(s.hist);
+    mNumPixels = s.numPixels;
+    mNumDistinctValues = s.numDistinctValues;
+    mNumZeroPixels = s.numZeroPixels;
+    mNumSaturatedPixels = s.numSaturatedPixels;
+    mMinBinValue = s.minBinValue;
+    mMaxBinValue = s.maxBinValue;
+    mMaxValue = s.maxValue;
+
     setPainted(true);
-    qDebug() << "drawing the histogram took me: " << dt;
     update();
 }
 
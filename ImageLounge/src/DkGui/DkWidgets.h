@@ -465,12 +465,7 @@ public:
     DkOverview(QWidget *parent = 0);
     ~DkOverview(){};
 
-    void setImage(const QImage &img)
-    {
-        mImg = img;
-        mImgSize = img.size();
-        mImgT = QImage();
-    };
+    void setImage(const QImage &img, DkJpgTransform::Transform orientation = DkJpgTransform::transform_identity);
 
     void setTransforms(const QTransform *worldMatrix, const QTransform *imgMatrix)
     {
@@ -483,6 +478,9 @@ public:
         mViewPortRect = viewPortRect;
     };
 
+public slots:
+    void overviewComputed();
+
 signals:
     void moveViewSignal(const QPointF &dxy) const;
     void sendTransformSignal() const;
@@ -490,7 +488,9 @@ signals:
 protected:
     QImage mImg;
     QImage mImgT;
+    QFutureWatcher<QImage> mOverviewWatcher;
     QSize mImgSize;
+    DkJpgTransform::Transform mOrientation = DkJpgTransform::transform_identity; // applied to the (small) mImgT
     QTransform *mScaledImgMatrix;
     const QTransform *mWorldMatrix;
     const QTransform *mImgMatrix;
@@ -498,7 +498,8 @@ protected:
     QPointF mPosGrab;
     QPointF mEnterPos;
 
-    QImage resizedImg(const QImage &src);
+    void computeOverview();
+    static QImage resizedImg(const QImage &src, const QSize &maxSize, DkJpgTransform::Transform orientation);
     void paintEvent(QPaintEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
@@ -673,10 +674,23 @@ public:
         histogram_mode_end = 2,
     };
 
+    // pixel statistics - computed on a worker thread
+    struct Stats {
+        int hist[3][256];
+        int numPixels = 0;
+        int numDistinctValues = 0;
+        int numZeroPixels = 0;
+        int numSaturatedPixels = 0;
+        int minBinValue = 256;
+        int maxBinValue = -1;
+        int maxValue = 0;
+    };
+
     DkHistogram(QWidget *parent);
     ~DkHistogram();
 
     void drawHistogram(QImage img);
+    static Stats computeStats(const QImage &img);
     void clearHistogram();
     void setMaxHistogramValue(int maxValue);
     void updateHistogramValues(int histValues[][256]);
@@ -684,6 +698,7 @@ public:
 
 public slots:
     void on_toggleStats_triggered(bool show);
+    void histogramComputed();
 
 protected:
     virtual void mousePressEvent(QMouseEvent *event) override;
@@ -709,6 +724,7 @@ private:
     DisplayMode mDisplayMode = DisplayMode::histogram_mode_simple; /// determins shown histogram type
 
     QMenu *mContextMenu = 0;
+    QFutureWatcher<Stats> mHistWatcher;
 };
 
 class DkFileInfo
@@ -0,0 +1,449 @@
+/*******************************************************************************************************
+ DkBenchmark.cpp
+ Created on:	19.10.2026
+
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+
+ Copyright (C) 2011-2026 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2026 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2026 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkBenchmark.h"
+
+#include "DkBasicLoader.h"
+#include "DkImageLoader.h"
+#include "DkImageStorage.h"
+#include "DkManipulators.h"
+#include "DkProcess.h"
+#include "DkThumbs.h"
+#include "DkTimer.h"
+#include "DkUtils.h"
+#include "DkVersion.h"
+
+#pragma warning(push, 0) // no warnings from includes - begin
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSysInfo>
+#include <QThread>
+#include <QTextStream>
+
+#include <algorithm>
+#pragma warning(pop) // no warnings from includes - end
+
+namespace nmc
+{
+
+// DkBenchmark --------------------------------------------------------------------
+DkBenchmark::DkBenchmark(const QString &corpusDir, const QSize &imgSize, int iterations)
+{
+    mCorpusDir = corpusDir;
+    mImgSize = imgSize;
+    mIterations = qMax(iterations, 1);
+}
+
+void DkBenchmark::setFilter(const QString &filter)
+{
+    mFilter = filter;
+}
+
+void DkBenchmark::setNumFolderFiles(int numFiles)
+{
+    mNumFolderFiles = qMax(numFiles, 1);
+}
+
+void DkBenchmark::setNumBatchFiles(int numFiles)
+{
+    mNumBatchFiles = qMax(numFiles, 1);
+}
+
+/**
+ * Writes the synthetic corpus to the corpus directory.
+ * The corpus consists of one image per writable format,
+ * a folder with many small files (indexing/sorting) and
+ * a set of full sized images for batch processing.
+ * @return bool false if the corpus could not be written
+ **/
+bool DkBenchmark::prepareCorpus()
+{
+    DkTimer dt;
+    QDir corpusDir(mCorpusDir);
+
+    if (!corpusDir.mkpath("images") || !corpusDir.mkpath("folder") || !corpusDir.mkpath("batch-in") || !corpusDir.mkpath("batch-out")) {
+        qCritical() << "[DkBenchmark] cannot create corpus in" << mCorpusDir;
+        return false;
+    }
+
+    mImg = createSyntheticImage(mImgSize);
+
+    // the corpus of a previous run is reused - unless it was created with another size
+    QDir imgDir(corpusDir.absoluteFilePath("images"));
+    const QStringList benchImages = imgDir.entryList(QStringList() << "bench.*", QDir::Files);
+
+    bool stale = false;
+    for (const QString &fn : benchImages)
+        stale |= QImageReader(imgDir.absoluteFilePath(fn)).size() != mImgSize;
+
+    if (stale) {
+        qInfo() << "[DkBenchmark] image size changed - regenerating the corpus";
+
+        for (const QString &fn : benchImages)
+            imgDir.remove(fn);
+
+        QDir batchDir(corpusDir.absoluteFilePath("batch-in"));
+        for (const QString &fn : batchDir.entryList(QDir::Files))
+            batchDir.remove(fn);
+    }
+
+    // one image per format - we skip formats that Qt cannot write
+    const QList<QByteArray> writable = QImageWriter::supportedImageFormats();
+    const QStringList formats = {"jpg", "png", "tif", "bmp", "webp", "ppm"};
+
+    mImagePaths.clear();
+    for (const QString &f : formats) {
+        if (!writable.contains(f.toLatin1()))
+            continue;
+
+        QString fp = corpusDir.absoluteFilePath("images/bench." + f);
+        if (!QFileInfo::exists(fp) && !mImg.save(fp, f.toLatin1(), 90)) {
+            qWarning() << "[DkBenchmark] could not write" << fp;
+            continue;
+        }
+        mImagePaths << fp;
+    }
+
+    // many small files with unpadded numbers so that natural sorting is exercised
+    mFolderPath = corpusDir.absoluteFilePath("folder");
+    QString smallPath = corpusDir.absoluteFilePath("images/small.jpg");
+    if (!QFileInfo::exists(smallPath))
+        createSyntheticImage(QSize(64, 48)).save(smallPath, "jpg");
+
+    QDir folder(mFolderPath);
+    if (folder.entryList(QDir::Files).size() != mNumFolderFiles) {
+        for (const QString &fn : folder.entryList(QDir::Files))
+            folder.remove(fn);
+
+        for (int idx = 0; idx < mNumFolderFiles; idx++) {
+            // shuffle the creation order with a fixed stride
+            int num = (int)(((qint64)idx * 7919) % mNumFolderFiles);
+            QFile::copy(smallPath, folder.absoluteFilePath(QString("img-%1.jpg").arg(num)));
+        }
+    }
+
+    // full sized batch input
+    mBatchPaths.clear();
+    QString srcPath = corpusDir.absoluteFilePath("images/bench.jpg");
+    for (int idx = 0; idx < mNumBatchFiles; idx++) {
+        QString fp = corpusDir.absoluteFilePath(QString("batch-in/batch-%1.jpg").arg(idx, 3, 10, QChar('0')));
+        if (QFileInfo::exists(fp) || QFile::copy(srcPath, fp))
+            mBatchPaths << fp;
+    }
+
+    qInfo() << "[DkBenchmark] corpus prepared in" << dt;
+
+    return !mImagePaths.empty();
+}
+
+void DkBenchmark::run()
+{
+    mResults.clear();
+
+    benchLoad();
+    benchResize();
+    benchManipulators();
+    benchThumbnails();
+    benchFolder();
+    benchBatch();
+}
+
+void DkBenchmark::benchLoad()
+{
+    for (const QString &fp : mImagePaths) {
+        QFileInfo fi(fp);
+        DkBasicLoader bl;
+        QSharedPointer<QByteArray> ba = bl.loadFileToBuffer(fp);
+
+        // decode from memory so that we do not measure the disk
+        measure("load", fi.suffix(), megaPixels(mImgSize), "MPix", [&]() {
+            DkBasicLoader loader;
+            loader.loadGeneral(fp, ba, true, true);
+        });
+
+        measure("load-file", fi.suffix(), fi.size() / (1024.0 * 1024.0), "MB", [&]() {
+            DkBasicLoader loader;
+            loader.loadGeneral(fp, true, true);
+        });
+    }
+}
+
+void DkBenchmark::benchResize()
+{
+    const QStringList iplNames = {"nearest", "area", "linear", "cubic", "lanczos"};
+
+    for (int ipl = DkImage::ipl_nearest; ipl < DkImage::ipl_end; ipl++) {
+        measure("resize", iplNames[ipl], megaPixels(mImgSize), "MPix", [&]() {
+            DkImage::resizeImage(mImg, QSize(), 0.5, ipl, false);
+        });
+
+        measure("resize-gamma", iplNames[ipl], megaPixels(mImgSize), "MPix", [&]() {
+            DkImage::resizeImage(mImg, QSize(), 0.5, ipl, true);
+        });
+    }
+}
+
+void DkBenchmark::benchManipulators()
+{
+    DkManipulatorManager manager;
+    manager.createManipulators(0);
+
+    for (const QSharedPointer<DkBaseManipulator> &mpl : manager.manipulators()) {
+        QString name = mpl->name().remove("&").toLower().replace(" ", "-");
+
+        measure("manipulator", name, megaPixels(mImgSize), "MPix", [&]() {
+            mpl->apply(mImg);
+        });
+    }
+}
+
+void DkBenchmark::benchThumbnails()
+{
+    for (const QString &fp : mImagePaths) {
+        QString suffix = QFileInfo(fp).suffix();
+
+        measure("thumbnail", suffix, 1.0, "files", [&]() {
+            DkThumbNail thumb(fp);
+            thumb.compute(DkThumbNail::do_not_force);
+        });
+    }
+}
+
+void DkBenchmark::benchFolder()
+{
+    if (mFolderPath.isEmpty())
+        return;
+
+    double numFiles = mNumFolderFiles;
+
+    measure("folder", "filter", numFiles, "files", [&]() {
+        DkImageLoader loader;
+        loader.getFilteredFileInfoList(mFolderPath);
+    });
+
+    measure("folder", "index", numFiles, "files", [&]() {
+        DkImageLoader loader;
+        loader.loadDir(mFolderPath, false);
+    });
+
+    DkImageLoader loader;
+    loader.loadDir(mFolderPath, false);
+
+    measure("folder", "sort", numFiles, "files", [&]() {
+        loader.sort();
+    });
+}
+
+void DkBenchmark::benchBatch()
+{
+    if (mBatchPaths.empty())
+        return;
+
+    QSharedPointer<DkBatchTransform> transform(new DkBatchTransform());
+    transform->setProperties(0, false, QRect(), 0.5f, DkBatchTransform::resize_mode_default, DkBatchTransform::resize_prop_default, DkImage::ipl_area);
+
+    DkSaveInfo si;
+    si.setMode(DkSaveInfo::mode_overwrite);
+
+    DkBatchConfig config(mBatchPaths, QDir(mCorpusDir).absoluteFilePath("batch-out"), "<c:0>.jpg");
+    config.setSaveInfo(si);
+    config.setProcessFunctions(QVector<QSharedPointer<DkAbstractBatch>>() << transform);
+
+    measure("batch", "resize-jpg", mBatchPaths.size(), "files", [&]() {
+        DkBatchProcessing batch(config);
+        batch.compute();
+        batch.waitForFinished();
+    });
+}
+
+/**
+ * Runs fn once to warm up caches and then mIterations times.
+ * @param group the benchmark group (e.g. resize)
+ * @param name the benchmark name within the group
+ * @param work the work done per iteration (used for the throughput)
+ * @param unit the unit of work (e.g. MPix)
+ * @param fn the function to be measured
+ * @return bool true if the benchmark was run
+ **/
+bool DkBenchmark::measure(const QString &group, const QString &name, double work, const QString &unit, const std::function<void()> &fn)
+{
+    if (!isSelected(group, name))
+        return false;
+
+    Result r;
+    r.group = group;
+    r.name = name;
+    r.work = work;
+    r.unit = unit;
+
+    double memBefore = DkMemory::getCurrentMemory();
+    double memMax = memBefore;
+
+    // warm-up
+    fn();
+    memMax = qMax(memMax, DkMemory::getCurrentMemory());
+
+    for (int idx = 0; idx < mIterations; idx++) {
+        DkTimer dt;
+        fn();
+        r.timesMs << dt.elapsedMicro() / 1000.0;
+        memMax = qMax(memMax, DkMemory::getCurrentMemory());
+    }
+
+    // the RSS is sampled after each run - allocations that are freed within a run are not seen
+    r.memoryDelta = memBefore >= 0 ? memMax - memBefore : -1.0;
+    r.peakMemory = DkMemory::getPeakMemory();
+    mResults << r;
+
+    QVector<double> times = r.timesMs;
+    std::sort(times.begin(), times.end());
+    qInfo().noquote() << QString("[DkBenchmark] %1/%2").arg(group, name).leftJustified(40) << QString::number(times[times.size() / 2], 'f', 2) << "ms (median)";
+
+    return true;
+}
+
+bool DkBenchmark::isSelected(const QString &group, const QString &name) const
+{
+    return mFilter.isEmpty() || QString(group + "/" + name).contains(mFilter, Qt::CaseInsensitive);
+}
+
+/**
+ * Creates a deterministic test image.
+ * Gradients are mixed with a noise pattern, so that
+ * encoders cannot compress the image to nothing.
+ * @param size the image size
+ * @return QImage an RGB32 image
+ **/
+QImage DkBenchmark::createSyntheticImage(const QSize &size) const
+{
+    QImage img(size, QImage::Format_RGB32);
+
+    quint32 seed = 42;
+    for (int rIdx = 0; rIdx < img.height(); rIdx++) {
+        QRgb *ptr = reinterpret_cast<QRgb *>(img.scanLine(rIdx));
+
+        for (int cIdx = 0; cIdx < img.width(); cIdx++) {
+            seed = seed * 1664525u + 1013904223u; // LCG - the same on every platform
+            int noise = (seed >> 24) & 0x1f;
+
+            int r = cIdx * 255 / qMax(img.width() - 1, 1);
+            int g = rIdx * 255 / qMax(img.height() - 1, 1);
+            int b = ((cIdx ^ rIdx) & 0xff);
+
+            ptr[cIdx] = qRgb(qMin(r + noise, 255), qMin(g + noise, 255), qMin(b + noise, 255));
+        }
+    }
+
+    return img;
+}
+
+double DkBenchmark::megaPixels(const QSize &size) const
+{
+    return (double)size.width() * size.height() / 1e6;
+}
+
+QJsonObject DkBenchmark::toJson() const
+{
+    QJsonArray results;
+
+    for (const Result &r : mResults) {
+        QVector<double> times = r.timesMs;
+        std::sort(times.begin(), times.end());
+
+        double total = 0.0;
+        for (double t : times)
+            total += t;
+
+        double median = times[times.size() / 2];
+
+        QJsonObject o;
+        o["group"] = r.group;
+        o["name"] = r.name;
+        o["iterations"] = times.size();
+        o["min_ms"] = times.first();
+        o["median_ms"] = median;
+        o["mean_ms"] = total / times.size();
+        o["max_ms"] = times.last();
+        o["throughput"] = median > 0 ? r.work / (median / 1000.0) : 0.0;
+        o["throughput_unit"] = r.unit + "/s";
+        o["rss_delta_mb"] = r.memoryDelta;
+        o["process_peak_rss_mb"] = r.peakMemory; // of the whole process so far
+
+        results.append(o);
+    }
+
+    QJsonObject env;
+    env["version"] = NOMACS_VERSION_STR;
+    env["qt"] = qVersion();
+    env["os"] = QSysInfo::prettyProductName();
+    env["cpu"] = QSysInfo::currentCpuArchitecture();
+    env["threads"] = QThread::idealThreadCount();
+    env["image_width"] = mImgSize.width();
+    env["image_height"] = mImgSize.height();
+    env["folder_files"] = mNumFolderFiles;
+    env["batch_files"] = mNumBatchFiles;
+
+    QJsonObject root;
+    root["environment"] = env;
+    root["results"] = results;
+
+    return root;
+}
+
+/**
+ * Writes the results to filePath.
+ * @param filePath the json file or - for stdout
+ * @return bool true if the results were written
+ **/
+bool DkBenchmark::writeJson(const QString &filePath) const
+{
+    QByteArray json = QJsonDocument(toJson()).toJson(QJsonDocument::Indented);
+
+    if (filePath.isEmpty() || filePath == "-") {
+        QTextStream(stdout) << json;
+        return true;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "[DkBenchmark] cannot write" << filePath;
+        return false;
+    }
+
+    file.write(json);
+    qInfo() << "[DkBenchmark] results written to" << filePath;
+
+    return true;
+}
+
+}
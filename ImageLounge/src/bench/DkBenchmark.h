@@ -0,0 +1,103 @@
+/*******************************************************************************************************
+ DkBenchmark.h
+ Created on:	19.10.2026
+
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+
+ Copyright (C) 2011-2026 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2026 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2026 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0) // no warnings from includes - begin
+#include <QImage>
+#include <QJsonObject>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+#pragma warning(pop) // no warnings from includes - end
+
+namespace nmc
+{
+
+/**
+ * Headless benchmark runner for the core hot paths.
+ * A synthetic corpus is generated (deterministically) in a
+ * scratch folder so that numbers are comparable across commits.
+ * Results are written as JSON (one record per benchmark).
+ **/
+class DkBenchmark
+{
+public:
+    DkBenchmark(const QString &corpusDir, const QSize &imgSize = QSize(2048, 1536), int iterations = 5);
+
+    void setFilter(const QString &filter);
+    void setNumFolderFiles(int numFiles);
+    void setNumBatchFiles(int numFiles);
+
+    bool prepareCorpus();
+    void run();
+
+    QJsonObject toJson() const;
+    bool writeJson(const QString &filePath) const;
+
+protected:
+    struct Result {
+        QString group;
+        QString name;
+        QVector<double> timesMs;
+        double work = 0.0; // work done per iteration (e.g. MPix or files)
+        QString unit;
+        double memoryDelta = -1.0; // RSS growth while running the benchmark
+        double peakMemory = -1.0; // process peak (it never decreases)
+    };
+
+    void benchLoad();
+    void benchResize();
+    void benchManipulators();
+    void benchThumbnails();
+    void benchFolder();
+    void benchBatch();
+
+    bool measure(const QString &group, const QString &name, double work, const QString &unit, const std::function<void()> &fn);
+    bool isSelected(const QString &group, const QString &name) const;
+
+    QImage createSyntheticImage(const QSize &size) const;
+    double megaPixels(const QSize &size) const;
+
+    QString mCorpusDir;
+    QSize mImgSize;
+    int mIterations = 5;
+    int mNumFolderFiles = 2000;
+    int mNumBatchFiles = 32;
+    QString mFilter;
+
+    QImage mImg;
+    QStringList mImagePaths; // one file per format
+    QString mFolderPath;
+    QStringList mBatchPaths;
+
+    QVector<Result> mResults;
+};
+
+}
@@ -0,0 +1,116 @@
+/*******************************************************************************************************
+ main.cpp
+ Created on:	19.10.2026
+
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+
+ Copyright (C) 2011-2026 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2026 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2026 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkBenchmark.h"
+#include "DkMetaData.h"
+#include "DkSettings.h"
+#include "DkTimer.h"
+#include "DkVersion.h"
+
+#pragma warning(push, 0) // no warnings from includes - begin
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QDir>
+#pragma warning(pop) // no warnings from includes - end
+
+int main(int argc, char *argv[])
+{
+    // we never show a window - so don't require a display
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    // use a separate settings file so that the user's settings are not touched
+    QCoreApplication::setOrganizationName("nomacs");
+    QCoreApplication::setOrganizationDomain("https://nomacs.org");
+    QCoreApplication::setApplicationName("Image Lounge Bench");
+    QCoreApplication::setApplicationVersion(NOMACS_VERSION_STR);
+
+    QApplication app(argc, argv);
+
+    nmc::DkSettingsManager::instance().init();
+    nmc::DkMetaDataHelper::initialize();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QObject::tr("Benchmarks the nomacs core on a synthetic corpus."));
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption outputOpt(QStringList() << "o" << "output", QObject::tr("Writes the results to <results.json> (- for stdout)."), QObject::tr("results.json"), "-");
+    parser.addOption(outputOpt);
+
+    QCommandLineOption corpusOpt(QStringList() << "c" << "corpus",
+                                 QObject::tr("Generates the synthetic corpus in <directory>."),
+                                 QObject::tr("directory"),
+                                 QDir::temp().absoluteFilePath("nomacs-bench"));
+    parser.addOption(corpusOpt);
+
+    QCommandLineOption iterOpt(QStringList() << "i" << "iterations", QObject::tr("Number of timed <iterations> per benchmark."), QObject::tr("iterations"), "5");
+    parser.addOption(iterOpt);
+
+    QCommandLineOption sizeOpt(QStringList() << "s" << "size", QObject::tr("Size of the synthetic images <width>x<height>."), QObject::tr("size"), "2048x1536");
+    parser.addOption(sizeOpt);
+
+    QCommandLineOption filterOpt(QStringList() << "f" << "filter", QObject::tr("Runs only benchmarks containing <filter> (e.g. resize/cubic)."), QObject::tr("filter"));
+    parser.addOption(filterOpt);
+
+    QCommandLineOption folderOpt(QStringList() << "folder-files", QObject::tr("Number of files used for folder indexing."), QObject::tr("number"), "2000");
+    parser.addOption(folderOpt);
+
+    QCommandLineOption batchOpt(QStringList() << "batch-files", QObject::tr("Number of files used for batch processing."), QObject::tr("number"), "32");
+    parser.addOption(batchOpt);
+
+    QCommandLineOption traceOpt(QStringList() << "trace", QObject::tr("Writes a Chrome/Perfetto trace to <trace.json>."), QObject::tr("trace.json"));
+    parser.addOption(traceOpt);
+
+    parser.process(app);
+
+    QStringList sizeStr = parser.value(sizeOpt).split("x");
+    QSize size = sizeStr.size() == 2 ? QSize(sizeStr[0].toInt(), sizeStr[1].toInt()) : QSize();
+
+    if (size.isEmpty()) {
+        qCritical() << "illegal image size:" << parser.value(sizeOpt);
+        return 1;
+    }
+
+    nmc::DkBenchmark bench(parser.value(corpusOpt), size, parser.value(iterOpt).toInt());
+    bench.setFilter(parser.value(filterOpt));
+    bench.setNumFolderFiles(parser.value(folderOpt).toInt());
+    bench.setNumBatchFiles(parser.value(batchOpt).toInt());
+
+    if (!bench.prepareCorpus())
+        return 1;
+
+    if (parser.isSet(traceOpt))
+        nmc::DkTraceLog::instance().start(parser.value(traceOpt));
+
+    bench.run();
+
+    nmc::DkTraceLog::instance().stop();
+
+    return bench.writeJson(parser.value(outputOpt)) ? 0 : 1;
+}
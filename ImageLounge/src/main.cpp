@@ -154,6 +154,11 @@ int main(int argc, char *argv[]) {
 		QObject::tr("log-path.txt"));
 	parser.addOption(batchLogOpt);
 
+	QCommandLineOption batchManifestOpt(QStringList() << "batch-manifest",
+		QObject::tr("Records batch results in <manifest.jsonl> so that reruns only process new or changed files."),
+		QObject::tr("manifest.jsonl"));
+	parser.addOption(batchManifestOpt);
+
 	QCommandLineOption importSettingsOpt(QStringList() << "import-settings",
 		QObject::tr("Imports the settings from <settings-path.ini> and saves them."),
 		QObject::tr("settings-path.ini"));
@@ -162,7 +167,16 @@ int main(int argc, char *argv[]) {
 	QCommandLineOption registerFilesOpt(QStringList() << "register-files", QObject::tr("Register file associations (Windows only)."));
 	parser.addOption(registerFilesOpt);
 
+	QCommandLineOption traceOpt(QStringList() << "trace",
+		QObject::tr("Writes a Chrome/Perfetto trace of loading, decoding and painting to <trace.json>."),
+		QObject::tr("trace.json"));
+	parser.addOption(traceOpt);
+
 	parser.process(app);
+
+	// start tracing as early as possible so that startup is covered too
+	if (!parser.value(traceOpt).isEmpty())
+		nmc::DkTraceLog::instance().start(parser.value(traceOpt));
 	
 	// CMD parser --------------------------------------------------------------------
 	nmc::DkPluginManager::createPluginsPath();
@@ -175,7 +189,8 @@ int main(int argc, char *argv[]) {
 			logPath = parser.value(batchLogOpt);
 
 		QString batchSettingsPath = parser.value(batchOpt);
-		nmc::DkBatchProcessing::computeBatch(batchSettingsPath, logPath);
+		nmc::DkBatchProcessing::computeBatch(batchSettingsPath, logPath, parser.value(batchManifestOpt));
+		nmc::DkTraceLog::instance().stop();
 		
 		return 0;
 	}
@@ -336,6 +351,8 @@ int main(int argc, char *argv[]) {
 	// restore message handler, workaround for: https://github.com/nomacs/nomacs/issues/874
 	qInstallMessageHandler(0);
 
+	nmc::DkTraceLog::instance().stop();
+
 	if (w)
 		delete w;	// we need delete so that settings are saved (from destructors)
 	if (pw)
@@ -0,0 +1,415 @@
+/*******************************************************************************************************
+ DkImageStorageTest.cpp
+ Created on:	19.10.2026
+
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+
+ Copyright (C) 2011-2026 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2026 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2026 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkImageStorageTest.h"
+
+#include "DkImageStorage.h"
+
+#pragma warning(push, 0) // no warnings from includes - begin
+#include <QDebug>
+#include <QRandomGenerator>
+
+#include <atomic>
+#pragma warning(pop) // no warnings from includes - end
+
+namespace nmc
+{
+
+// DkImageStorageTest --------------------------------------------------------------------
+DkImageStorageTest::DkImageStorageTest()
+{
+}
+
+/**
+ * Runs all tests.
+ * @return int the number of failed tests
+ **/
+int DkImageStorageTest::run()
+{
+    testParallelRows();
+    testAlphaChannelUsed();
+    testThreshold();
+    testGammaTable();
+    testNormImage();
+    testAutoAdjust();
+    testHueSaturation();
+
+    qInfo().noquote() << QString("%1 of %2 tests passed").arg(mNumTests - mNumFailed).arg(mNumTests);
+
+    return mNumFailed;
+}
+
+void DkImageStorageTest::testParallelRows()
+{
+    for (int numRows : {0, 1, 31, 32, 33, 301, 4097}) {
+        QVector<int> visited(numRows, 0);
+        int *vPtr = visited.data();
+        std::atomic<bool> overlap(false);
+
+        DkImage::parallelRows(numRows, [&](int start, int end) {
+            for (int rIdx = start; rIdx < end; rIdx++) {
+                // blocks are disjoint, so no row is touched by two threads
+                if (vPtr[rIdx]++)
+                    overlap = true;
+            }
+        });
+
+        check(QString("parallelRows/%1").arg(numRows), !overlap && !visited.contains(0));
+    }
+}
+
+void DkImageStorageTest::testAlphaChannelUsed()
+{
+    for (QImage::Format f : {QImage::Format_ARGB32, QImage::Format_ARGB32_Premultiplied}) {
+        for (const QSize &s : {QSize(33, 7), QSize(257, 301)}) {
+            QImage img(s, f);
+            img.fill(Qt::white);
+
+            QString name = QString("alphaChannelUsed/%1/%2x%3").arg(f).arg(s.width()).arg(s.height());
+            check(name + "/opaque", !DkImage::alphaChannelUsed(img));
+
+            // a single transparent pixel in the last row
+            img.setPixel(s.width() - 1, s.height() - 1, qRgba(255, 255, 255, 254));
+            check(name + "/transparent", DkImage::alphaChannelUsed(img));
+        }
+    }
+
+    QImage rgb(257, 301, QImage::Format_RGB32);
+    rgb.fill(Qt::transparent);
+    check("alphaChannelUsed/RGB32", !DkImage::alphaChannelUsed(rgb));
+}
+
+void DkImageStorageTest::testThreshold()
+{
+    for (const QImage &img : createTestImages()) {
+        QString name = QString("thresholdImage/%1/%2x%3").arg(img.format()).arg(img.width()).arg(img.height());
+
+        for (bool color : {true, false}) {
+            // grayscaleImage needs color images
+            if (!color && img.format() == QImage::Format_Grayscale8)
+                continue;
+
+            QImage ref = color ? img.copy() : DkImage::grayscaleImage(img);
+
+            uchar lut[256];
+            for (int idx = 0; idx < 256; idx++)
+                lut[idx] = idx > 100.5 ? 255 : 0;
+            mapLutScalar(ref, lut);
+
+            check(name + (color ? "/color" : "/gray"), equal(DkImage::thresholdImage(img, 100.5, color), ref));
+        }
+    }
+}
+
+void DkImageStorageTest::testGammaTable()
+{
+    QRandomGenerator rng(42);
+
+    QVector<uchar> table(256);
+    for (uchar &v : table)
+        v = (uchar)rng.bounded(256);
+
+    // values that are not covered by a short table are kept
+    QVector<uchar> shortTable = table.mid(0, 100);
+
+    for (const QImage &img : createTestImages()) {
+        QString name = QString("mapGammaTable/%1/%2x%3").arg(img.format()).arg(img.width()).arg(img.height());
+
+        for (const QVector<uchar> &t : {table, shortTable}) {
+            uchar lut[256];
+            for (int idx = 0; idx < 256; idx++)
+                lut[idx] = idx < t.size() ? t[idx] : (uchar)idx;
+
+            QImage ref = img.copy();
+            mapLutScalar(ref, lut);
+
+            QImage res = img.copy();
+            DkImage::mapGammaTable(res, t);
+
+            check(name + QString("/%1").arg(t.size()), equal(res, ref));
+        }
+    }
+}
+
+void DkImageStorageTest::testNormImage()
+{
+    for (int minVal : {0, 20}) {
+        for (const QImage &img : createTestImages(minVal, 200)) {
+            QImage ref = img.copy();
+            bool refChanged = normImageScalar(ref);
+
+            QImage res = img.copy();
+            bool changed = DkImage::normImage(res);
+
+            check(QString("normImage/%1/%2x%3/%4").arg(img.format()).arg(img.width()).arg(img.height()).arg(minVal),
+                  changed == refChanged && equal(res, ref));
+        }
+    }
+}
+
+void DkImageStorageTest::testAutoAdjust()
+{
+    for (int minVal : {0, 20}) {
+        for (const QImage &img : createTestImages(minVal, minVal ? 200 : 255)) {
+            QImage ref = img.copy();
+            bool refChanged = autoAdjustImageScalar(ref);
+
+            QImage res = img.copy();
+            bool changed = DkImage::autoAdjustImage(res);
+
+            check(QString("autoAdjustImage/%1/%2x%3/%4").arg(img.format()).arg(img.width()).arg(img.height()).arg(minVal),
+                  changed == refChanged && equal(res, ref));
+        }
+    }
+}
+
+void DkImageStorageTest::testHueSaturation()
+{
+#ifdef WITH_OPENCV
+    const int hue = 37, sat = -25, brightness = 12;
+
+    for (const QImage &img : createTestImages()) {
+        // hue/saturation needs color images
+        if (img.format() == QImage::Format_Grayscale8)
+            continue;
+
+        int brightnessN = qRound(brightness / 100.0 * 255.0);
+        double satN = sat / 100.0 + 1.0;
+
+        cv::Mat hsvImg = DkImage::qImage2Mat(img);
+
+        if (hsvImg.channels() > 3)
+            cv::cvtColor(hsvImg, hsvImg, CV_RGBA2BGR);
+
+        cv::cvtColor(hsvImg, hsvImg, CV_BGR2HSV);
+
+        for (int rIdx = 0; rIdx < hsvImg.rows; rIdx++) {
+            unsigned char *iPtr = hsvImg.ptr<unsigned char>(rIdx);
+
+            for (int cIdx = 0; cIdx < hsvImg.cols * 3; cIdx += 3) {
+                int h = iPtr[cIdx] + hue;
+                if (h < 0)
+                    h += 180;
+                if (h >= 180)
+                    h -= 180;
+                iPtr[cIdx] = (unsigned char)h;
+
+                iPtr[cIdx + 1] = (unsigned char)qBound(0, qRound(iPtr[cIdx + 1] * satN), 255);
+                iPtr[cIdx + 2] = (unsigned char)qBound(0, iPtr[cIdx + 2] + brightnessN, 255);
+            }
+        }
+
+        cv::cvtColor(hsvImg, hsvImg, CV_HSV2BGR);
+        QImage ref = DkImage::mat2QImage(hsvImg);
+
+        check(QString("hueSaturation/%1/%2x%3").arg(img.format()).arg(img.width()).arg(img.height()),
+              equal(DkImage::hueSaturation(img, hue, sat, brightness), ref));
+    }
+#endif // WITH_OPENCV
+}
+
+void DkImageStorageTest::check(const QString &name, bool passed)
+{
+    mNumTests++;
+
+    if (!passed) {
+        mNumFailed++;
+        qWarning().noquote() << "[FAIL]" << name;
+    } else
+        qInfo().noquote() << "[PASS]" << name;
+}
+
+/**
+ * Compares the used bytes of two images (scan line padding is ignored).
+ * @return bool true if both images have the same format, size and pixels
+ **/
+bool DkImageStorageTest::equal(const QImage &img1, const QImage &img2) const
+{
+    if (img1.format() != img2.format() || img1.size() != img2.size())
+        return false;
+
+    // number of used bytes per line
+    const int bpl = (img1.width() * img1.depth() + 7) / 8;
+
+    for (int rIdx = 0; rIdx < img1.height(); rIdx++) {
+        if (memcmp(img1.constScanLine(rIdx), img2.constScanLine(rIdx), bpl) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+QImage DkImageStorageTest::createRandomImage(const QSize &size, QImage::Format format, int minVal, int maxVal) const
+{
+    // fixed seed - failures are reproducible
+    QRandomGenerator rng(size.width() * 31 + size.height() * 17 + format);
+
+    QImage img(size, format);
+    const int bpl = (img.width() * img.depth() + 7) / 8;
+
+    for (int rIdx = 0; rIdx < img.height(); rIdx++) {
+        uchar *ptr = img.scanLine(rIdx);
+
+        for (int cIdx = 0; cIdx < bpl; cIdx++)
+            ptr[cIdx] = (uchar)rng.bounded(minVal, maxVal + 1);
+    }
+
+    return img;
+}
+
+/**
+ * Returns random images of all formats the kernels support.
+ * Small images are processed in the calling thread, large ones in parallel.
+ **/
+QVector<QImage> DkImageStorageTest::createTestImages(int minVal, int maxVal) const
+{
+    QVector<QImage> imgs;
+
+    for (const QSize &s : {QSize(33, 7), QSize(257, 301)}) {
+        for (QImage::Format f : {QImage::Format_Grayscale8, QImage::Format_RGB888, QImage::Format_RGB32, QImage::Format_ARGB32})
+            imgs << createRandomImage(s, f, minVal, maxVal);
+    }
+
+    return imgs;
+}
+
+void DkImageStorageTest::mapLutScalar(QImage &img, const uchar *lut)
+{
+    // number of bytes per line used
+    int bpl = (img.width() * img.depth() + 7) / 8;
+    int pad = img.bytesPerLine() - bpl;
+
+    uchar *mPtr = img.bits();
+
+    for (int rIdx = 0; rIdx < img.height(); rIdx++) {
+        for (int cIdx = 0; cIdx < bpl; cIdx++, mPtr++)
+            *mPtr = lut[*mPtr];
+
+        mPtr += pad;
+    }
+}
+
+bool DkImageStorageTest::normImageScalar(QImage &img)
+{
+    uchar maxVal = 0;
+    uchar minVal = 255;
+
+    // number of used bytes per line
+    int bpl = (img.width() * img.depth() + 7) / 8;
+    int pad = img.bytesPerLine() - bpl;
+    uchar *mPtr = img.bits();
+    bool hasAlpha = img.hasAlphaChannel() || img.format() == QImage::Format_RGB32;
+
+    for (int rIdx = 0; rIdx < img.height(); rIdx++) {
+        for (int cIdx = 0; cIdx < bpl; cIdx++, mPtr++) {
+            if (hasAlpha && cIdx % 4 == 3)
+                continue;
+
+            if (*mPtr > maxVal)
+                maxVal = *mPtr;
+            if (*mPtr < minVal)
+                minVal = *mPtr;
+        }
+
+        mPtr += pad;
+    }
+
+    if ((minVal == 0 && maxVal == 255) || maxVal - minVal == 0)
+        return false;
+
+    uchar *ptr = img.bits();
+
+    for (int rIdx = 0; rIdx < img.height(); rIdx++) {
+        for (int cIdx = 0; cIdx < bpl; cIdx++, ptr++) {
+            if (hasAlpha && cIdx % 4 == 3)
+                continue;
+
+            *ptr = (uchar)qRound(255.0f * (*ptr - minVal) / (maxVal - minVal));
+        }
+
+        ptr += pad;
+    }
+
+    return true;
+}
+
+bool DkImageStorageTest::autoAdjustImageScalar(QImage &img)
+{
+    // for grayscale image - normalize is the same
+    if (img.format() <= QImage::Format_Indexed8 || img.format() == QImage::Format_Grayscale8)
+        return normImageScalar(img);
+    else if (img.format() != QImage::Format_ARGB32 && img.format() != QImage::Format_RGB32 && img.format() != QImage::Format_RGB888)
+        return false;
+
+    int channels = img.format() == QImage::Format_RGB888 ? 3 : 4;
+
+    uchar maxV[3] = {0, 0, 0};
+    uchar minV[3] = {255, 255, 255};
+    int hist[3][256] = {{0}};
+
+    for (int rIdx = 0; rIdx < img.height(); rIdx++) {
+        const uchar *ptr = img.constScanLine(rIdx);
+
+        for (int cIdx = 0; cIdx < img.width(); cIdx++, ptr += channels) {
+            for (int ch = 0; ch < 3; ch++) {
+                maxV[ch] = qMax(maxV[ch], ptr[ch]);
+                minV[ch] = qMin(minV[ch], ptr[ch]);
+                hist[ch][ptr[ch]]++;
+            }
+        }
+    }
+
+    bool ignore[3];
+    for (int ch = 0; ch < 3; ch++) {
+        ignore[ch] = maxV[ch] - minV[ch] == 0 || maxV[ch] - minV[ch] == 255;
+
+        if (ignore[ch]) {
+            maxV[ch] = DkImage::findHistPeak(hist[ch]);
+            ignore[ch] = maxV[ch] - minV[ch] <= 0 || maxV[ch] - minV[ch] == 255;
+        }
+    }
+
+    if (ignore[0] && ignore[1] && ignore[2])
+        return false;
+
+    for (int rIdx = 0; rIdx < img.height(); rIdx++) {
+        uchar *ptr = img.scanLine(rIdx);
+
+        for (int cIdx = 0; cIdx < img.width(); cIdx++, ptr += channels) {
+            for (int ch = 0; ch < 3; ch++) {
+                if (!ignore[ch] && ptr[ch] < maxV[ch])
+                    ptr[ch] = (uchar)qRound(255.0f * ((float)ptr[ch] - minV[ch]) / (maxV[ch] - minV[ch]));
+                else if (!ignore[ch])
+                    ptr[ch] = 255;
+            }
+        }
+    }
+
+    return true;
+}
+
+}
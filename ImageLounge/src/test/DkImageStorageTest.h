@@ -0,0 +1,75 @@
+/*******************************************************************************************************
+ DkImageStorageTest.h
+ Created on:	19.10.2026
+
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+
+ Copyright (C) 2011-2026 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2026 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2026 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0) // no warnings from includes - begin
+#include <QImage>
+#include <QString>
+#include <QVector>
+#pragma warning(pop) // no warnings from includes - end
+
+namespace nmc
+{
+
+/**
+ * Checks the row-parallel DkImage kernels against scalar reference implementations.
+ * Every kernel is run on deterministic random images of all supported formats
+ * (with odd widths so that scan lines are padded) and the results must match bit for bit.
+ **/
+class DkImageStorageTest
+{
+public:
+    DkImageStorageTest();
+
+    int run();
+
+protected:
+    void testParallelRows();
+    void testAlphaChannelUsed();
+    void testThreshold();
+    void testGammaTable();
+    void testNormImage();
+    void testAutoAdjust();
+    void testHueSaturation();
+
+    void check(const QString &name, bool passed);
+    bool equal(const QImage &img1, const QImage &img2) const;
+
+    QImage createRandomImage(const QSize &size, QImage::Format format, int minVal = 0, int maxVal = 255) const;
+    QVector<QImage> createTestImages(int minVal = 0, int maxVal = 255) const;
+
+    // scalar references
+    static void mapLutScalar(QImage &img, const uchar *lut);
+    static bool normImageScalar(QImage &img);
+    static bool autoAdjustImageScalar(QImage &img);
+
+    int mNumTests = 0;
+    int mNumFailed = 0;
+};
+
+}
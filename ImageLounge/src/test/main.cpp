@@ -0,0 +1,55 @@
+/*******************************************************************************************************
+ main.cpp
+ Created on:	19.10.2026
+
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+
+ Copyright (C) 2011-2026 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2026 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2026 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkImageStorageTest.h"
+#include "DkSettings.h"
+#include "DkVersion.h"
+
+#pragma warning(push, 0) // no warnings from includes - begin
+#include <QApplication>
+#pragma warning(pop) // no warnings from includes - end
+
+int main(int argc, char *argv[])
+{
+    // we never show a window - so don't require a display
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    // use a separate settings file so that the user's settings are not touched
+    QCoreApplication::setOrganizationName("nomacs");
+    QCoreApplication::setOrganizationDomain("https://nomacs.org");
+    QCoreApplication::setApplicationName("Image Lounge Test");
+    QCoreApplication::setApplicationVersion(NOMACS_VERSION_STR);
+
+    QApplication app(argc, argv);
+
+    nmc::DkSettingsManager::instance().init();
+
+    // the exit code is the number of failed tests
+    nmc::DkImageStorageTest imageStorageTest;
+    return imageStorageTest.run();
+}